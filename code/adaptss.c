@@ -0,0 +1,230 @@
+/* adaptss.c: ADAPTIVE CHAIN STRESS TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Allocate objects whose lifetimes change from phase to phase, in a
+ * pool whose chain was created with MPS_KEY_CHAIN_ADAPTIVE, and check
+ * that the nursery capacity follows the lifetimes, so that the
+ * mortality of nursery collections comes back into the target range
+ * after each phase change.  The same workload is run with a fixed
+ * chain first, and the adaptive chain must not collect more often
+ * than the fixed chain in the phases where most objects die young.
+ * See <design/strategy/#chain.adapt>.
+ */
+
+#include "mpm.h"
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define testArenaSIZE   ((size_t)64 << 20)
+#define objSLOTS        4
+#define phaseALLOC      ((size_t)24 << 20)
+#define rootsCOUNT      4000
+#define genCOUNT        2
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 64, 0.9 }, { 1024, 0.5 } };
+
+/* phases -- object lifetimes, in allocations, in each phase */
+
+static size_t phases[] = { 100, rootsCOUNT, 100 };
+#define phaseCOUNT NELEMS(phases)
+
+
+/* objNULL needs to be odd so that it's ignored in roots. */
+#define objNULL           ((mps_addr_t)MPS_WORD_CONST(0xDECEA5ED))
+
+static mps_addr_t roots[rootsCOUNT];
+
+/* fixedCollections -- collections in each phase with a fixed chain */
+
+static size_t fixedCollections[phaseCOUNT];
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(mps_ap_t ap, size_t size)
+{
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, NULL, 0);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+/* test -- run the phases and check the mortality at the end of each */
+
+static void test(mps_arena_t arena, mps_bool_t adaptive)
+{
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_root_t root;
+  mps_pool_t pool;
+  mps_ap_t ap;
+  size_t size = (objSLOTS + 2) * sizeof(mps_word_t);
+  size_t i, phase;
+
+  die(dylan_fmt(&format, arena), "fmt_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN_ADAPTIVE, adaptive);
+    die(mps_chain_create_k(&chain, arena, genCOUNT, testChain, args),
+        "chain_create");
+  } MPS_ARGS_END(args);
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, mps_class_amc(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_ap_create(&ap, pool, mps_rank_exact()), "ap_create");
+
+  for (i = 0; i < rootsCOUNT; ++i)
+    roots[i] = objNULL;
+  die(mps_root_create_table_masked(&root, arena, mps_rank_exact(),
+                                   (mps_rm_t)0, roots, rootsCOUNT,
+                                   (mps_word_t)1),
+      "root_create_table");
+
+  printf("%s chain:\n", adaptive ? "Adaptive" : "Fixed");
+  for (phase = 0; phase < phaseCOUNT; ++phase) {
+    size_t lifetime = phases[phase];
+    size_t objs = phaseALLOC / size;
+    size_t collections = 0, condemned = 0, live = 0;
+    double mortality;
+    mps_message_t message;
+
+    /* Each object is kept alive by the roots for lifetime
+       allocations. */
+    for (i = 0; i < objs; ++i) {
+      roots[i % lifetime] = make(ap, size);
+
+      while (mps_message_get(&message, arena, mps_message_type_gc())) {
+        /* Only count the collections in the last quarter of the
+           phase, by which time the chain should have adapted. */
+        if (i >= objs / 4 * 3) {
+          ++ collections;
+          condemned += mps_message_gc_condemned_size(arena, message);
+          live += mps_message_gc_live_size(arena, message);
+        }
+        mps_message_discard(arena, message);
+      }
+    }
+    for (i = 0; i < rootsCOUNT; ++i)
+      roots[i] = objNULL;
+
+    Insist(collections > 0);
+    mortality = 1.0 - (double)live / (double)condemned;
+    printf("  lifetime %lu: nursery %lukB, %lu collections, mortality %.2f\n",
+           (unsigned long)lifetime,
+           (unsigned long)ChainGen((Chain)chain, 0)->capacity,
+           (unsigned long)collections, mortality);
+    if (adaptive) {
+      GenDesc gen = ChainGen((Chain)chain, 0);
+      Insist(mortality >= CHAIN_ADAPT_MORTALITY_LOW - 0.15);
+      Insist(gen->capacity >= gen->minCapacity);
+      Insist(gen->capacity <= gen->maxCapacity);
+      /* Where most objects die young, adapting must not make the
+         nursery collect more often than the client's parameters. See
+         <design/strategy/#chain.adapt.high>. */
+      if (lifetime < rootsCOUNT)
+        Insist(collections <= fixedCollections[phase]);
+    } else {
+      fixedCollections[phase] = collections;
+    }
+  }
+
+  mps_arena_park(arena);
+  mps_ap_destroy(ap);
+  mps_root_destroy(root);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_release(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  mps_arena_t arena;
+  mps_thr_t thread;
+
+  testlib_init(argc, argv);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  mps_message_type_enable(arena, mps_message_type_gc());
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  test(arena, FALSE);
+  test(arena, TRUE);
+  mps_thread_dereg(thread);
+  mps_arena_destroy(arena);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
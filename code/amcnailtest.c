@@ -0,0 +1,261 @@
+/* amcnailtest.c: AMC NAILED SEGMENT SPLIT TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Fill an AMC segment with objects, keep a few of them alive only by
+ * ambiguous references so that the segment is nailed, and collect.
+ * Check that the dead grains between the pinned objects have been
+ * split off and freed, that the grains holding pinned objects are
+ * still in the pool, and that the pinned objects survived at their
+ * addresses.  One case pins the first and last objects in the
+ * segment, so the dead runs are cut out of the middle; the other pins
+ * only an object in the middle, so the lowest run includes the base
+ * of the segment.  See <design/poolamc/#nailed.split>.
+ */
+
+#include "mpm.h"
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define testArenaSIZE   ((size_t)16 << 20)
+#define segSIZE         ((size_t)64 << 10)
+#define objSLOTS        10
+#define objSIZE         ((objSLOTS + 2) * sizeof(mps_word_t))
+#define objsCOUNT       (segSIZE / objSIZE + 1)
+#define pinnedCOUNT     3
+
+
+static mps_arena_t arena;
+static mps_pool_t pool;
+static mps_ap_t ap;
+
+/* objs -- the objects in the segment under test
+ *
+ * Not a root: the arena is parked while they are allocated, and only
+ * the pinned ones are used after the collection.
+ */
+
+static mps_addr_t objs[objsCOUNT];
+
+/* pinned -- the ambiguous root that keeps the pinned objects alive */
+
+static mps_addr_t pinned[pinnedCOUNT];
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(void)
+{
+  mps_word_t v;
+  die(make_dylan_vector(&v, ap, objSLOTS), "make_dylan_vector");
+  return (mps_addr_t)v;
+}
+
+
+/* segOf -- the segment containing addr, or NULL */
+
+static Seg segOf(Addr addr)
+{
+  Seg seg;
+  if (SegOfAddr(&seg, (Arena)arena, addr))
+    return seg;
+  return NULL;
+}
+
+
+/* fill -- fill a fresh segment with objects
+ *
+ * Allocate until an object lands at the base of a new segment, then
+ * fill that segment.  Returns the number of objects in it, and its
+ * base in *baseReturn.
+ */
+
+static size_t fill(Addr *baseReturn)
+{
+  mps_addr_t p = make();
+  Seg seg = segOf((Addr)p);
+  size_t count;
+
+  while (segOf((Addr)p) == seg)
+    p = make();
+  seg = segOf((Addr)p);
+  Insist(seg != NULL);
+  Insist((Addr)p == SegBase(seg));
+  Insist(SegSize(seg) == segSIZE);
+  Insist(SegBuffer(seg) != NULL);
+
+  count = 0;
+  while (segOf((Addr)p) == seg) {
+    Insist(count < objsCOUNT);
+    Insist(count == 0
+           || (Addr)p == AddrAdd((Addr)objs[count - 1], objSIZE));
+    objs[count] = p;
+    ++count;
+    p = make();
+  }
+  /* The allocation point has moved on to another segment. */
+  Insist(SegBuffer(seg) == NULL);
+
+  *baseReturn = SegBase(seg);
+  return count;
+}
+
+
+/* test -- pin the objects at the given indexes in a fresh segment,
+ * collect, and check the result
+ */
+
+static void test(const size_t *pin, size_t pinCount)
+{
+  Size grainSize = ArenaGrainSize((Arena)arena);
+  Count grains = segSIZE / grainSize;
+  Count keptGrains = 0;
+  Index i, j;
+  Addr base;
+  size_t count;
+
+  Insist(pinCount <= pinnedCOUNT);
+  count = fill(&base);
+
+  for (i = 0; i < pinnedCOUNT; ++i)
+    pinned[i] = NULL;
+  for (i = 0; i < pinCount; ++i) {
+    Insist(pin[i] < count);
+    pinned[i] = objs[pin[i]];
+    DYLAN_VECTOR_SLOT(pinned[i], 0) = DYLAN_INT(i);
+  }
+
+  mps_arena_collect(arena);
+
+  /* A grain is kept if and only if it overlaps a pinned object. */
+  for (j = 0; j < grains; ++j) {
+    Addr grainBase = AddrAdd(base, j * grainSize);
+    Addr grainLimit = AddrAdd(grainBase, grainSize);
+    Bool keep = FALSE;
+    Seg seg = segOf(grainBase);
+    for (i = 0; i < pinCount; ++i) {
+      Addr objBase = (Addr)pinned[i];
+      if (objBase < grainLimit && grainBase < AddrAdd(objBase, objSIZE))
+        keep = TRUE;
+    }
+    if (keep) {
+      ++keptGrains;
+      Insist(seg != NULL);
+      Insist(SegPool(seg) == (Pool)pool);
+      Insist(SegSize(seg) < segSIZE);
+    } else {
+      Insist(seg == NULL);
+    }
+  }
+  Insist(0 < keptGrains);
+  Insist(keptGrains < grains);
+
+  /* The pinned objects are still there, and intact. */
+  for (i = 0; i < pinCount; ++i) {
+    Insist(pinned[i] == objs[pin[i]]);
+    Insist(segOf((Addr)pinned[i]) != NULL);
+    Insist(dylan_check(pinned[i]));
+    Insist(DYLAN_VECTOR_SLOT(pinned[i], 0) == DYLAN_INT(i));
+  }
+
+  printf("Kept %"PRIuLONGEST" of %"PRIuLONGEST" grains.\n",
+         (ulongest_t)keptGrains, (ulongest_t)grains);
+}
+
+
+int main(int argc, char *argv[])
+{
+  mps_fmt_t format;
+  mps_root_t root;
+  size_t middle = segSIZE / objSIZE / 2;
+  size_t last = segSIZE / objSIZE - 1;
+  size_t ends[pinnedCOUNT];
+
+  testlib_init(argc, argv);
+
+  die(mps_arena_create_k(&arena, mps_arena_class_vm(), mps_args_none),
+      "arena_create");
+  mps_arena_park(arena);
+  die(dylan_fmt(&format, arena), "fmt_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_EXTEND_BY, segSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_LARGE_SIZE, segSIZE);
+    die(mps_pool_create_k(&pool, arena, mps_class_amc(), args),
+        "pool_create(amc)");
+  } MPS_ARGS_END(args);
+  die(mps_ap_create(&ap, pool, mps_rank_exact()), "ap_create");
+  die(mps_root_create_table(&root, arena, mps_rank_ambig(), 0,
+                            pinned, pinnedCOUNT),
+      "root_create_table");
+
+  /* Pin the first, middle and last objects in the segment. */
+  ends[0] = 0;
+  ends[1] = middle;
+  ends[2] = last;
+  test(ends, 3);
+
+  /* Pin only the middle object. */
+  test(&middle, 1);
+
+  mps_root_destroy(root);
+  mps_ap_destroy(ap);
+  mps_pool_destroy(pool);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -0,0 +1,228 @@
+/* amsfrag.c: AMS FRAGMENTATION AND EVACUATION TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Allocate a lot of objects in an AMS pool, drop most of them so that
+ * the survivors are scattered thinly over the pool's segments, and
+ * collect.  Do this without evacuation, and then with it, and compare
+ * the memory the pool and the arena are left holding.  See
+ * <design/poolams/#evacuate>.
+ *
+ * The survivors refer to each other, and some of them are also
+ * referenced ambiguously, so that their segments are pinned.  Each
+ * survivor is checked after each collection.
+ */
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscams.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define testArenaSIZE   ((size_t)64 << 20)
+#define objCOUNT        50000
+#define objSLOTSMAX     16    /* not counting the tag and link */
+#define keepEVERY       16    /* keep one object in this many */
+#define ambigCOUNT      8     /* survivors referenced ambiguously */
+#define evacOCCUPANCY   0.5
+
+static mps_gen_param_s testChain[1] = { { 4096, 0.85 } };
+
+
+static mps_addr_t exactRefs[objCOUNT];
+static mps_addr_t ambigRefs[ambigCOUNT];
+
+
+/* make -- create an object with a tag, a link and some other slots */
+
+static mps_word_t make(mps_ap_t ap, size_t tag, mps_word_t link)
+{
+  mps_word_t obj;
+
+  die(make_dylan_vector(&obj, ap, 2 + rnd() % objSLOTSMAX),
+      "make_dylan_vector");
+  DYLAN_VECTOR_SLOT(obj, 0) = DYLAN_INT(tag);
+  DYLAN_VECTOR_SLOT(obj, 1) = link;
+  return obj;
+}
+
+
+/* check -- check the survivors and the objects they link to */
+
+static void check(void)
+{
+  size_t i;
+
+  for (i = 0; i < objCOUNT; ++i) {
+    mps_word_t obj = (mps_word_t)exactRefs[i], link;
+    if (obj == 0)
+      continue;
+    cdie(dylan_check((mps_addr_t)obj), "dylan_check");
+    Insist(DYLAN_VECTOR_SLOT(obj, 0) == DYLAN_INT(i));
+    link = DYLAN_VECTOR_SLOT(obj, 1);
+    if (link != DYLAN_INT(0)) {
+      cdie(dylan_check((mps_addr_t)link), "dylan_check link");
+      Insist(DYLAN_VECTOR_SLOT(link, 0) == DYLAN_INT(i - keepEVERY));
+    }
+  }
+  for (i = 0; i < ambigCOUNT; ++i)
+    Insist(exactRefs[i * keepEVERY * 64] == ambigRefs[i]);
+}
+
+
+/* test -- fragment the pool and report how much memory it keeps
+ *
+ * Returns the total size of the pool after the fragmenting
+ * collections.
+ */
+
+static size_t test(double occupancy)
+{
+  mps_arena_t arena;
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_pool_t pool;
+  mps_ap_t ap;
+  mps_root_t exactRoot, ambigRoot;
+  size_t i, peakSize, fragSize, fragCommitted, finalSize;
+  mps_word_t link;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  mps_arena_spare_commit_limit_set(arena, 0);
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, 1, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    MPS_ARGS_ADD(args, MPS_KEY_AMS_EVACUATE, occupancy);
+    die(mps_pool_create_k(&pool, arena, mps_class_ams(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_root_create_table(&exactRoot, arena, mps_rank_exact(), 0,
+                            exactRefs, objCOUNT),
+      "root_create_table(exact)");
+  die(mps_root_create_table(&ambigRoot, arena, mps_rank_ambig(), 0,
+                            ambigRefs, ambigCOUNT),
+      "root_create_table(ambig)");
+  die(mps_ap_create_k(&ap, pool, mps_args_none), "ap_create");
+
+  /* Allocate everything, linking each object to the one that will be
+   * the previous survivor. */
+  mps_arena_park(arena);
+  for (i = 0; i < objCOUNT; ++i) {
+    link = i >= keepEVERY ? (mps_word_t)exactRefs[i - keepEVERY]
+                          : DYLAN_INT(0);
+    exactRefs[i] = (mps_addr_t)make(ap, i, link);
+  }
+  peakSize = mps_pool_total_size(pool);
+
+  /* Drop most of the objects, and pin a few segments. */
+  for (i = 0; i < objCOUNT; ++i)
+    if (i % keepEVERY != 0)
+      exactRefs[i] = NULL;
+  for (i = 0; i < ambigCOUNT; ++i)
+    ambigRefs[i] = exactRefs[i * keepEVERY * 64];
+
+  /* The first collection leaves the survivors scattered; the second
+   * finds the segments sparsely occupied. */
+  die(mps_arena_collect(arena), "arena_collect");
+  check();
+  die(mps_arena_collect(arena), "arena_collect");
+  check();
+  fragSize = mps_pool_total_size(pool);
+  fragCommitted = mps_arena_committed(arena);
+
+  /* Allocate some more and collect again, so that the segments the
+   * survivors were copied to are condemned in turn. */
+  mps_arena_release(arena);
+  for (i = 0; i < objCOUNT; i += keepEVERY)
+    (void)make(ap, 0, DYLAN_INT(0));
+  die(mps_arena_collect(arena), "arena_collect");
+  check();
+  finalSize = mps_pool_total_size(pool);
+
+  printf("occupancy %.2f: pool size %lu peak, %lu fragmented, "
+         "%lu final; committed %lu\n", occupancy,
+         (unsigned long)peakSize, (unsigned long)fragSize,
+         (unsigned long)finalSize, (unsigned long)fragCommitted);
+
+  mps_arena_park(arena);
+  mps_ap_destroy(ap);
+  mps_root_destroy(ambigRoot);
+  mps_root_destroy(exactRoot);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+  return fragSize;
+}
+
+
+int main(int argc, char *argv[])
+{
+  size_t inPlace, evacuated;
+
+  testlib_init(argc, argv);
+
+  inPlace = test(0.0);
+  evacuated = test(evacOCCUPANCY);
+  printf("evacuation left the pool %.1f%% of the size\n",
+         100.0 * (double)evacuated / (double)inPlace);
+  Insist(evacuated < inPlace / 2);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -0,0 +1,275 @@
+/* amsscan.c: POOL CLASS AMS SCANNING BENCHMARK
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Measure how fast AMS scans a heap of many small objects, in MB of
+ * scanned heap (the survivors and the objects that weren't condemned)
+ * per second of collection.  See <design/poolams/#scan.run>.
+ *
+ * There are two AMS pools on one chain.  The old pool allocates in
+ * generation 1, which is never condemned by the chain, and its objects
+ * are held by a table root and refer to the objects in the young
+ * pool.  Half of the young objects are referenced only from the old
+ * ones; the other half form a linked list.  A minor collection
+ * condemns the young pool only, so it scans every old segment
+ * whole, and scans the grey young objects as they are found.  A full
+ * collection condemns both pools, so it scans only grey objects.
+ */
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscams.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define testArenaSIZE   ((size_t)512 << 20)
+#define oldCOUNT        100000
+#define youngCOUNT      100000  /* half linked from old, half in a list */
+#define slotsMAX        4       /* not counting the link */
+#define roundCOUNT      20
+
+static mps_gen_param_s testChain[2] = {
+  { 1024, 0.5 }, { (size_t)1 << 20, 0.5 } };
+
+
+static mps_arena_t arena;
+static mps_addr_t oldRefs[oldCOUNT];
+static mps_addr_t listRef[1];
+
+
+/* make -- create an object with a link and some other slots */
+
+static mps_word_t make(mps_ap_t ap, mps_word_t link)
+{
+  mps_word_t obj;
+
+  die(make_dylan_vector(&obj, ap, 1 + rnd() % slotsMAX),
+      "make_dylan_vector");
+  DYLAN_VECTOR_SLOT(obj, 0) = link;
+  return obj;
+}
+
+
+/* makeYoung -- replace all the young objects
+ *
+ * The arena is clamped, so that nothing is collected until the
+ * caller is ready to time it.
+ */
+
+static void makeYoung(mps_ap_t ap)
+{
+  size_t i;
+  mps_word_t list = DYLAN_INT(0);
+
+  mps_arena_clamp(arena);
+  for (i = 0; i < oldCOUNT; ++i) {
+    mps_word_t old = (mps_word_t)oldRefs[i];
+    DYLAN_VECTOR_SLOT(old, 0) =
+      i < youngCOUNT / 2 ? make(ap, DYLAN_INT(0)) : DYLAN_INT(0);
+  }
+  for (i = 0; i < youngCOUNT / 2; ++i)
+    list = make(ap, list);
+  listRef[0] = (mps_addr_t)list;
+}
+
+
+/* check -- check the young objects are all reachable */
+
+static void check(void)
+{
+  size_t i, length = 0;
+  mps_word_t obj;
+
+  for (i = 0; i < youngCOUNT / 2; ++i) {
+    obj = DYLAN_VECTOR_SLOT((mps_word_t)oldRefs[i], 0);
+    cdie(dylan_check((mps_addr_t)obj), "dylan_check old");
+  }
+  for (obj = (mps_word_t)listRef[0]; obj != DYLAN_INT(0);
+       obj = DYLAN_VECTOR_SLOT(obj, 0)) {
+    cdie(dylan_check((mps_addr_t)obj), "dylan_check list");
+    ++length;
+  }
+  Insist(length == youngCOUNT / 2);
+}
+
+
+/* report -- print the speed of some collections */
+
+static void report(const char *name, size_t collections, size_t scanned,
+                   double t)
+{
+  printf("%s: %lu collections, %.1f MB in %.3fs: %.1f MB/s\n",
+         name, (unsigned long)collections,
+         (double)scanned / (1024.0 * 1024.0), t,
+         (double)scanned / (1024.0 * 1024.0) / t);
+}
+
+
+/* collections -- count the collections that have finished
+ *
+ * The epoch doesn't count AMS collections, so count the messages.
+ * Adds the size of the heap that each collection scanned (the objects
+ * that survived, and those that weren't condemned) to *scannedIO.
+ */
+
+static size_t collections(size_t *scannedIO)
+{
+  size_t n = 0;
+  mps_message_t message;
+
+  while (mps_message_get(&message, arena, mps_message_type_gc())) {
+    *scannedIO += mps_message_gc_live_size(arena, message)
+      + mps_message_gc_not_condemned_size(arena, message);
+    mps_message_discard(arena, message);
+    ++n;
+  }
+  return n;
+}
+
+
+static void test(void)
+{
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_pool_t oldPool, youngPool;
+  mps_ap_t oldAp, youngAp;
+  mps_root_t oldRoot, listRoot;
+  mps_clock_t start;
+  size_t i, n, minors = 0, fulls = 0, minorScanned = 0, fullScanned = 0;
+  double minorTime = 0.0, fullTime = 0.0;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  mps_message_type_enable(arena, mps_message_type_gc());
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, 2, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    MPS_ARGS_ADD(args, MPS_KEY_GEN, 1);
+    die(mps_pool_create_k(&oldPool, arena, mps_class_ams(), args),
+        "pool_create(old)");
+  } MPS_ARGS_END(args);
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&youngPool, arena, mps_class_ams(), args),
+        "pool_create(young)");
+  } MPS_ARGS_END(args);
+  die(mps_root_create_table(&oldRoot, arena, mps_rank_exact(), 0,
+                            oldRefs, oldCOUNT),
+      "root_create_table(old)");
+  die(mps_root_create_table(&listRoot, arena, mps_rank_exact(), 0,
+                            listRef, 1),
+      "root_create_table(list)");
+  die(mps_ap_create_k(&oldAp, oldPool, mps_args_none), "ap_create(old)");
+  die(mps_ap_create_k(&youngAp, youngPool, mps_args_none),
+      "ap_create(young)");
+
+  mps_arena_clamp(arena);
+  for (i = 0; i < oldCOUNT; ++i)
+    oldRefs[i] = (mps_addr_t)make(oldAp, DYLAN_INT(0));
+  listRef[0] = (mps_addr_t)DYLAN_INT(0);
+
+  for (i = 0; i < roundCOUNT; ++i) {
+    /* Minor collection: stepping lets the chain start a collection
+     * of the young generation, which parking the arena finishes. */
+    makeYoung(youngAp);
+    start = mps_clock();
+    mps_arena_release(arena);
+    (void)mps_arena_step(arena, 0.0, 0.0);
+    mps_arena_park(arena);
+    minorTime += (double)(mps_clock() - start);
+    n = collections(&minorScanned);
+    Insist(n > 0);
+    minors += n;
+    check();
+
+    /* Full collection. */
+    makeYoung(youngAp);
+    start = mps_clock();
+    die(mps_arena_collect(arena), "arena_collect");
+    fullTime += (double)(mps_clock() - start);
+    fulls += collections(&fullScanned);
+    check();
+  }
+
+  report("minor", minors, minorScanned,
+         minorTime / (double)mps_clocks_per_sec());
+  report("full", fulls, fullScanned,
+         fullTime / (double)mps_clocks_per_sec());
+
+  mps_arena_park(arena);
+  mps_ap_destroy(youngAp);
+  mps_ap_destroy(oldAp);
+  mps_root_destroy(listRoot);
+  mps_root_destroy(oldRoot);
+  mps_pool_destroy(youngPool);
+  mps_pool_destroy(oldPool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  testlib_init(argc, argv);
+
+  test();
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -1,7 +1,7 @@
 /* amsss.c: POOL CLASS AMS STRESS TEST
  *
  * $Id$
- * Copyright (c) 2001-2014 Ravenbrook Limited.  See end of file for license.
+ * Copyright (c) 2001-2016 Ravenbrook Limited.  See end of file for license.
  * Portions copyright (c) 2002 Global Graphics Software.
  *
  * .design: Adapted from amcss.c, but not counting collections, just
@@ -197,18 +197,20 @@ static void test_pool(mps_pool_class_t pool_class, mps_arg_s args[],
 }
 
 
-int main(int argc, char *argv[])
+/* test -- run the stress test in an arena with gcThreads collector
+ * threads (see design.mps.trace.parallel) */
+
+static void test(size_t gcThreads)
 {
   int i;
   mps_thr_t thread;
   mps_fmt_t format;
   mps_chain_t chain;
 
-  testlib_init(argc, argv);
-
   MPS_ARGS_BEGIN(args) {
     MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
     MPS_ARGS_ADD(args, MPS_KEY_ARENA_GRAIN_SIZE, rnd_grain(testArenaSIZE));
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_GC_THREADS, gcThreads);
     die(mps_arena_create_k(&arena, mps_arena_class_vm(), args), "arena_create");
   } MPS_ARGS_END(args);
 
@@ -222,10 +224,12 @@ int main(int argc, char *argv[])
     int debug = i % 2;
     int ownChain = (i / 2) % 2;
     int ambig = (i / 4) % 2;
-    printf("\n\n*** AMS%s with %sCHAIN and %sSUPPORT_AMBIGUOUS\n",
+    printf("\n\n*** AMS%s with %sCHAIN and %sSUPPORT_AMBIGUOUS"
+           " and %lu GC threads\n",
            debug ? " Debug" : "",
            ownChain ? "" : "!",
-           ambig ? "" : "!");
+           ambig ? "" : "!",
+           (unsigned long)gcThreads);
     MPS_ARGS_BEGIN(args) {
       MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
       if (ownChain)
@@ -241,6 +245,15 @@ int main(int argc, char *argv[])
   mps_fmt_destroy(format);
   mps_thread_dereg(thread);
   mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  testlib_init(argc, argv);
+
+  test(0);
+  test(4);
 
   printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
   return 0;
@@ -249,7 +262,7 @@ int main(int argc, char *argv[])
 
 /* C. COPYRIGHT AND LICENSE
  *
- * Copyright (c) 2001-2014 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * Copyright (c) 2001-2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
  * All rights reserved.  This is an open source license.  Contact
  * Ravenbrook for commercial licensing options.
  * 
@@ -0,0 +1,259 @@
+/* apssth.c: ALLOCATION POINT FILL STRESS TEST WITH THREADS
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Several threads, each with its own allocation point, allocate small
+ * objects in a shared AMC or AMS pool, so that their buffers are
+ * refilled frequently and concurrently with each other and with
+ * collections.  Each thread keeps a window of recent objects on its
+ * stack and checks them as they are replaced.  The test reports the
+ * allocation rate, which exercises the pool generation reservation
+ * (see <design/strategy/#alloc.reserve>).
+ */
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "testthr.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpscams.h"
+#include "mpsavm.h"
+
+#include <stdio.h> /* fflush, printf */
+#include <time.h> /* clock, CLOCKS_PER_SEC */
+
+
+#define testArenaSIZE   ((size_t)16 << 20)
+#define avLEN           3
+#define windowCOUNT     64
+#define threadsCOUNT    4
+#define objectsCOUNT    50000
+#define genCOUNT        2
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 1024, 0.85 }, { 2048, 0.45 } };
+
+
+static mps_arena_t arena;
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(mps_ap_t ap, mps_addr_t *refs, size_t nr_refs)
+{
+  size_t length = rnd() % (2*avLEN);
+  size_t size = (length+2) * sizeof(mps_word_t);
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, refs, nr_refs);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+/* test_stepper -- stepping function for walk */
+
+static void test_stepper(mps_addr_t object, mps_fmt_t fmt, mps_pool_t pool,
+                         void *p, size_t s)
+{
+  testlib_unused(object); testlib_unused(fmt); testlib_unused(pool);
+  testlib_unused(s);
+  (*(unsigned long *)p)++;
+}
+
+
+/* churn -- allocate objects, keeping a window of them alive on the
+ * stack
+ *
+ * This is called from kid_thread so that the window is in a frame
+ * below the cold end of the thread's stack root.
+ */
+
+static void churn(mps_pool_t pool)
+{
+  mps_ap_t ap;
+  mps_addr_t window[windowCOUNT];
+  size_t i;
+
+  die(mps_ap_create_k(&ap, pool, mps_args_none), "ap_create");
+  for (i = 0; i < windowCOUNT; ++i)
+    window[i] = make(ap, NULL, 0);
+  for (i = 0; i < objectsCOUNT; ++i) {
+    size_t j = rnd() % windowCOUNT;
+    cdie(dylan_check(window[j]), "window check");
+    window[j] = make(ap, window, windowCOUNT);
+  }
+  for (i = 0; i < windowCOUNT; ++i)
+    cdie(dylan_check(window[i]), "final window check");
+  mps_ap_destroy(ap);
+}
+
+
+/* kid_thread -- register the thread and churn */
+
+static void *kid_thread(void *arg)
+{
+  void *marker = &marker;
+  mps_thr_t thread;
+  mps_root_t reg_root;
+
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  die(mps_root_create_thread(&reg_root, arena, thread, marker),
+      "root_create");
+  churn(arg);
+  mps_root_destroy(reg_root);
+  mps_thread_dereg(thread);
+
+  return NULL;
+}
+
+
+/* test_pool -- run the threads on a pool and report the rate
+ *
+ * If walk is true, then walk the formatted objects afterwards (AMS
+ * pools do not support walking, so this is only done before the AMS
+ * pool has any segments).
+ */
+
+static void test_pool(const char *name, mps_pool_t pool, mps_bool_t walk)
+{
+  testthr_t kids[threadsCOUNT];
+  clock_t start, finish;
+  double seconds;
+  unsigned long count = 0;
+  size_t i;
+
+  printf("\n------ pool: %s -------\n", name);
+
+  start = clock();
+  for (i = 0; i < NELEMS(kids); ++i)
+    testthr_create(&kids[i], kid_thread, pool);
+  for (i = 0; i < NELEMS(kids); ++i)
+    testthr_join(&kids[i], NULL);
+  finish = clock();
+
+  seconds = (double)(finish - start) / CLOCKS_PER_SEC;
+  printf("%d threads allocated %lu objects in %g seconds",
+         threadsCOUNT, (unsigned long)threadsCOUNT * objectsCOUNT, seconds);
+  if (seconds > 0)
+    printf(" (%g objects/second)",
+           (double)threadsCOUNT * objectsCOUNT / seconds);
+  printf("\ncollections %lu, committed %lu\n",
+         (unsigned long)mps_collections(arena),
+         (unsigned long)mps_arena_committed(arena));
+
+  if (walk) {
+    mps_arena_park(arena);
+    mps_arena_formatted_objects_walk(arena, test_stepper, &count, 0);
+    mps_arena_release(arena);
+    printf("stepped on %lu objects.\n", count);
+  }
+  (void)fflush(stdout);
+}
+
+
+/* test_arena -- create the arena and pools, and test each pool */
+
+static void test_arena(void)
+{
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_pool_t amc_pool, ams_pool;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_GRAIN_SIZE, rnd_grain(testArenaSIZE));
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain), "chain_create");
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&amc_pool, arena, mps_class_amc(), args),
+        "pool_create(amc)");
+  } MPS_ARGS_END(args);
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&ams_pool, arena, mps_class_ams(), args),
+        "pool_create(ams)");
+  } MPS_ARGS_END(args);
+
+  test_pool("AMC", amc_pool, TRUE);
+  test_pool("AMS", ams_pool, FALSE);
+
+  mps_arena_park(arena);
+  mps_pool_destroy(ams_pool);
+  mps_pool_destroy(amc_pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  testlib_init(argc, argv);
+  test_arena();
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -114,6 +114,7 @@ DEFINE_CLASS(Arena, AbstractArena, klass)
   klass->create = ArenaNoCreate;
   klass->destroy = ArenaNoDestroy;
   klass->purgeSpare = ArenaNoPurgeSpare;
+  klass->purgeAged = ArenaNoPurgeAged;
   klass->extend = ArenaNoExtend;
   klass->grow = ArenaNoGrow;
   klass->free = ArenaNoFree;
@@ -138,6 +139,7 @@ Bool ArenaClassCheck(ArenaClass klass)
   CHECKL(FUNCHECK(klass->create));
   CHECKL(FUNCHECK(klass->destroy));
   CHECKL(FUNCHECK(klass->purgeSpare));
+  CHECKL(FUNCHECK(klass->purgeAged));
   CHECKL(FUNCHECK(klass->extend));
   CHECKL(FUNCHECK(klass->grow));
   CHECKL(FUNCHECK(klass->free));
@@ -172,6 +174,9 @@ Bool ArenaCheck(Arena arena)
   CHECKL(arena->committed <= arena->commitLimit);
   CHECKL(arena->spareCommitted <= arena->committed);
   CHECKL(0.0 <= arena->pauseTime);
+  CHECKL(0.0 <= arena->spareAge);
+  CHECKL(1 <= arena->nodes);
+  CHECKL(arena->nodes <= ARENA_NODE_MAX);
 
   CHECKL(arena->zoneShift == ZoneShiftUNSET
          || ShiftCheck(arena->zoneShift));
@@ -195,6 +200,8 @@ Bool ArenaCheck(Arena arena)
   CHECKL(TreeCheck(ArenaChunkTree(arena)));
   /* TODO: check that the chunkRing and chunkTree have identical members */
   /* nothing to check for chunkSerial */
+  CHECKL(arena->chunkMapShift < MPS_WORD_WIDTH);
+  /* Can't check chunkMap entries without walking the whole map. */
   
   CHECKL(LocusCheck(arena));
 
@@ -203,6 +210,12 @@ Bool ArenaCheck(Arena arena)
     CHECKD(Land, ArenaFreeLand(arena));
 
   CHECKL(BoolCheck(arena->zoned));
+  CHECKL(BoolCheck(arena->background));
+  CHECKL(BoolCheck(arena->cardMarking));
+  CHECKL(BoolCheck(arena->userfaultfd));
+  CHECKL(BoolCheck(arena->safepoints));
+  if (arena->policy != NULL) /* <design/strategy/#policy.class> */
+    CHECKD(Policy, arena->policy);
 
   return TRUE;
 }
@@ -217,7 +230,15 @@ static Res ArenaAbsInit(Arena arena, Size grainSize, ArgList args)
   Size commitLimit = ARENA_DEFAULT_COMMIT_LIMIT;
   Size spareCommitLimit = ARENA_DEFAULT_SPARE_COMMIT_LIMIT;
   double pauseTime = ARENA_DEFAULT_PAUSE_TIME;
+  double spareAge = ARENA_DEFAULT_SPARE_AGE;
+  Count gcThreads = ARENA_DEFAULT_GC_THREADS;
+  Count nodes = ARENA_DEFAULT_NODES;
+  Bool background = ARENA_DEFAULT_BACKGROUND;
+  Bool cardMarking = ARENA_DEFAULT_CARD_MARKING;
+  Bool userfaultfd = ARENA_DEFAULT_USERFAULTFD;
+  Bool safepoints = ARENA_DEFAULT_SAFEPOINTS;
   mps_arg_s arg;
+  Index i;
 
   AVER(arena != NULL);
   AVERT(ArenaGrainSize, grainSize);
@@ -228,8 +249,24 @@ static Res ArenaAbsInit(Arena arena, Size grainSize, ArgList args)
     commitLimit = arg.val.size;
   if (ArgPick(&arg, args, MPS_KEY_SPARE_COMMIT_LIMIT))
     spareCommitLimit = arg.val.size;
+  if (ArgPick(&arg, args, MPS_KEY_SPARE_AGE))
+    spareAge = arg.val.d;
   if (ArgPick(&arg, args, MPS_KEY_PAUSE_TIME))
     pauseTime = arg.val.d;
+  if (ArgPick(&arg, args, MPS_KEY_ARENA_GC_THREADS))
+    gcThreads = arg.val.count;
+  if (ArgPick(&arg, args, MPS_KEY_ARENA_BACKGROUND))
+    background = arg.val.b;
+  if (ArgPick(&arg, args, MPS_KEY_ARENA_CARD_MARKING))
+    cardMarking = arg.val.b;
+  if (ArgPick(&arg, args, MPS_KEY_ARENA_USERFAULTFD))
+    userfaultfd = arg.val.b;
+  if (ArgPick(&arg, args, MPS_KEY_ARENA_SAFEPOINTS))
+    safepoints = arg.val.b;
+  if (ArgPick(&arg, args, MPS_KEY_ARENA_NODES))
+    nodes = arg.val.count;
+  if (nodes < 1 || nodes > ARENA_NODE_MAX)
+    return ResPARAM;
 
   /* Superclass init */
   InstInit(CouldBeA(Inst, arena));
@@ -240,6 +277,8 @@ static Res ArenaAbsInit(Arena arena, Size grainSize, ArgList args)
   arena->spareCommitted = (Size)0;
   arena->spareCommitLimit = spareCommitLimit;
   arena->pauseTime = pauseTime;
+  arena->spareAge = spareAge;
+  arena->nodes = nodes;
   arena->grainSize = grainSize;
   /* zoneShift must be overridden by arena class init */
   arena->zoneShift = ZoneShiftUNSET;
@@ -249,11 +288,20 @@ static Res ArenaAbsInit(Arena arena, Size grainSize, ArgList args)
   arena->hasFreeLand = FALSE;
   arena->freeZones = ZoneSetUNIV;
   arena->zoned = zoned;
+  arena->gcThreads = gcThreads;
+  arena->background = background;
+  arena->cardMarking = cardMarking;
+  arena->userfaultfd = userfaultfd;
+  arena->safepoints = safepoints;
+  arena->policy = NULL;
 
   arena->primary = NULL;
   RingInit(ArenaChunkRing(arena));
   arena->chunkTree = TreeEMPTY;
   arena->chunkSerial = (Serial)0;
+  arena->chunkMapShift = 0;
+  for (i = 0; i < ARENA_CHUNK_MAP_LENGTH; ++i)
+    arena->chunkMap[i] = NULL;
   
   LocusInit(arena);
   
@@ -300,6 +348,7 @@ failGlobalsInit:
  * exist on all platforms. */
 
 ARG_DEFINE_KEY(VMW3_TOP_DOWN, Bool);
+ARG_DEFINE_KEY(ARENA_HUGE_PAGES, Bool);
 
 
 /* ArenaCreate -- create the arena and call initializers */
@@ -309,7 +358,14 @@ ARG_DEFINE_KEY(ARENA_SIZE, Size);
 ARG_DEFINE_KEY(ARENA_ZONED, Bool);
 ARG_DEFINE_KEY(COMMIT_LIMIT, Size);
 ARG_DEFINE_KEY(SPARE_COMMIT_LIMIT, Size);
+ARG_DEFINE_KEY(SPARE_AGE, double);
 ARG_DEFINE_KEY(PAUSE_TIME, double);
+ARG_DEFINE_KEY(ARENA_GC_THREADS, Count);
+ARG_DEFINE_KEY(ARENA_BACKGROUND, Bool);
+ARG_DEFINE_KEY(ARENA_CARD_MARKING, Bool);
+ARG_DEFINE_KEY(ARENA_USERFAULTFD, Bool);
+ARG_DEFINE_KEY(ARENA_SAFEPOINTS, Bool);
+ARG_DEFINE_KEY(ARENA_NODES, Count);
 
 static Res arenaFreeLandInit(Arena arena)
 {
@@ -351,6 +407,7 @@ failLandInit:
 Res ArenaCreate(Arena *arenaReturn, ArenaClass klass, ArgList args)
 {
   Arena arena;
+  Policy policy;
   Res res;
 
   AVER(arenaReturn != NULL);
@@ -386,6 +443,10 @@ Res ArenaCreate(Arena *arenaReturn, ArenaClass klass, ArgList args)
   if (res != ResOK)
     goto failControlInit;
 
+  res = PolicyCreate(&arena->policy, arena, args);
+  if (res != ResOK)
+    goto failPolicyCreate;
+
   res = GlobalsCompleteCreate(ArenaGlobals(arena));
   if (res != ResOK)
     goto failGlobalsCompleteCreate;
@@ -395,6 +456,10 @@ Res ArenaCreate(Arena *arenaReturn, ArenaClass klass, ArgList args)
   return ResOK;
 
 failGlobalsCompleteCreate:
+  policy = arena->policy;
+  arena->policy = NULL;
+  PolicyDestroy(policy);
+failPolicyCreate:
   ControlFinish(arena);
 failControlInit:
   arenaFreeLandFinish(arena);
@@ -460,10 +525,18 @@ static void arenaFreeLandFinish(Arena arena)
 
 void ArenaDestroy(Arena arena)
 {
+  Policy policy;
+
   AVERT(Arena, arena);
 
   GlobalsPrepareToDestroy(ArenaGlobals(arena));
 
+  /* Detach the policy before destroying it, so that checking the
+     arena while the policy is being freed doesn't check the policy. */
+  policy = arena->policy;
+  arena->policy = NULL;
+  PolicyDestroy(policy);
+
   ControlFinish(arena);
 
   /* We must tear down the free land before the chunks, because pages
@@ -545,6 +618,7 @@ static Res ArenaAbsDescribe(Arena arena, mps_lib_FILE *stream, Count depth)
                "hasFreeLand      $S\n", WriteFYesNo(arena->hasFreeLand),
                "freeZones        $B\n", (WriteFB)arena->freeZones,
                "zoned            $S\n", WriteFYesNo(arena->zoned),
+               "nodes            $U\n", (WriteFU)arena->nodes,
                NULL);
   if (res != ResOK)
     return res;
@@ -560,6 +634,12 @@ static Res ArenaAbsDescribe(Arena arena, mps_lib_FILE *stream, Count depth)
   if (res != ResOK)
     return res;
 
+  if (arena->policy != NULL) {
+    res = PolicyDescribe(arena->policy, stream, depth + 2);
+    if (res != ResOK)
+      return res;
+  }
+
   return res;
 }
 
@@ -702,6 +782,32 @@ Res ControlDescribe(Arena arena, mps_lib_FILE *stream, Count depth)
 }
 
 
+/* chunkMapAdd -- add a chunk to the arena's chunk map
+ *
+ * Each entry of the map records the only chunk that overlaps any of
+ * the parts of the address space that share the entry, or NULL if
+ * there is none, or ArenaChunkMapMANY if there is more than one.  See
+ * <design/arena/#chunk.map>.
+ */
+
+static void chunkMapAdd(Arena arena, Chunk chunk)
+{
+  Word base, limit, i;
+
+  base = (Word)chunk->base >> arena->chunkMapShift;
+  limit = ((Word)chunk->limit - 1) >> arena->chunkMapShift;
+  if (limit - base >= ARENA_CHUNK_MAP_LENGTH)
+    limit = base + ARENA_CHUNK_MAP_LENGTH - 1;
+  for (i = base; i <= limit; ++i) {
+    Chunk *entry = &arena->chunkMap[i & (ARENA_CHUNK_MAP_LENGTH - 1)];
+    if (*entry == NULL)
+      *entry = chunk;
+    else if (*entry != chunk)
+      *entry = ArenaChunkMapMANY;
+  }
+}
+
+
 /* ArenaChunkInsert -- insert chunk into arena's chunk tree and ring,
  * update the total reserved address space, and set the primary chunk
  * if not already set.
@@ -723,6 +829,14 @@ void ArenaChunkInsert(Arena arena, Chunk chunk) {
   arena->chunkTree = updatedTree;
   RingAppend(ArenaChunkRing(arena), &chunk->arenaRing);
 
+  /* The first chunk sets the scale of the chunk map. */
+  if (arena->primary == NULL) {
+    Shift shift = SizeFloorLog2(ChunkSize(chunk));
+    arena->chunkMapShift = shift > ARENA_CHUNK_MAP_SPLIT
+                           ? shift - ARENA_CHUNK_MAP_SPLIT : 0;
+  }
+  chunkMapAdd(arena, chunk);
+
   arena->reserved += ChunkReserved(chunk);
 
   /* As part of the bootstrap, the first created chunk becomes the primary
@@ -733,13 +847,15 @@ void ArenaChunkInsert(Arena arena, Chunk chunk) {
 
 
 /* ArenaChunkRemoved -- chunk was removed from the arena and is being
- * finished, so update the total reserved address space, and unset the
- * primary chunk if necessary.
+ * finished, so update the total reserved address space, rebuild the
+ * chunk map without it, and unset the primary chunk if necessary.
  */
 
 void ArenaChunkRemoved(Arena arena, Chunk chunk)
 {
   Size size;
+  Ring node, next;
+  Index i;
 
   AVERT(Arena, arena);
   AVERT(Chunk, chunk);
@@ -748,6 +864,16 @@ void ArenaChunkRemoved(Arena arena, Chunk chunk)
   AVER(arena->reserved >= size);
   arena->reserved -= size;
 
+  /* Chunks are rarely removed, so rebuild the whole map rather than
+     work out which entries the chunk shared with others. */
+  for (i = 0; i < ARENA_CHUNK_MAP_LENGTH; ++i)
+    arena->chunkMap[i] = NULL;
+  RING_FOR(node, ArenaChunkRing(arena), next) {
+    Chunk other = RING_ELT(Chunk, arenaRing, node);
+    if (other != chunk)
+      chunkMapAdd(arena, other);
+  }
+
   if (chunk == arena->primary) {
     /* The primary chunk must be the last chunk to be removed. */
     AVER(RingIsSingle(ArenaChunkRing(arena)));
@@ -1112,6 +1238,11 @@ Res ArenaAlloc(Addr *baseReturn, LocusPref pref, Size size, Pool pool)
   AVER(SizeIsArenaGrains(size, arena));
 
   res = PolicyAlloc(&tract, arena, pref, size, pool);
+  if (res == ResCOMMIT_LIMIT && LocusReleaseReserves(arena) > 0) {
+    /* The pool generations' reservations are now spare, so try again.
+       See <design/strategy/#alloc.reserve.release>. */
+    res = PolicyAlloc(&tract, arena, pref, size, pool);
+  }
   if (res != ResOK)
     goto allocFail;
   
@@ -1226,6 +1357,55 @@ void ArenaSetPauseTime(Arena arena, double pauseTime)
   EVENT2(PauseTimeSet, arena, pauseTime);
 }
 
+/* ArenaSparePoll -- purge spare pages that have been idle too long
+ *
+ * Purges the pages that became spare more than the arena's spare age
+ * ago, oldest first, for at most ARENA_SPARE_PURGE_TIME seconds or
+ * the arena's pause time, whichever is smaller.  Pages that are left
+ * are purged by later polls.  See <design/arena/#spare.age>.
+ */
+
+void ArenaSparePoll(Arena arena)
+{
+  Clock now, age, budget;
+  double pauseTime;
+
+  AVERT(Arena, arena);
+
+  if (arena->spareAge == 0.0 || arena->spareCommitted == 0)
+    return;
+
+  now = ClockNow();
+  age = (Clock)(arena->spareAge * (double)ClocksPerSec());
+  if (now < age)
+    return;
+  pauseTime = arena->pauseTime;
+  if (pauseTime > ARENA_SPARE_PURGE_TIME)
+    pauseTime = ARENA_SPARE_PURGE_TIME;
+  budget = (Clock)(pauseTime * (double)ClocksPerSec());
+  (void)Method(Arena, arena, purgeAged)(arena, now - age, now + budget);
+}
+
+
+/* ArenaNodeZones -- the zones whose memory is on a NUMA node
+ *
+ * See <design/arena/#numa.map>.
+ */
+
+ZoneSet ArenaNodeZones(Arena arena, Index node)
+{
+  ZoneSet zones = ZoneSetEMPTY;
+  Index zone;
+
+  AVERT(Arena, arena);
+  AVER(node < arena->nodes);
+
+  for (zone = node; zone < MPS_WORD_WIDTH; zone += arena->nodes)
+    zones = BS_ADD(ZoneSet, zones, zone);
+  return zones;
+}
+
+
 /* Used by arenas which don't use spare committed memory */
 Size ArenaNoPurgeSpare(Arena arena, Size size)
 {
@@ -1234,6 +1414,14 @@ Size ArenaNoPurgeSpare(Arena arena, Size size)
   return 0;
 }
 
+Size ArenaNoPurgeAged(Arena arena, Clock before, Clock deadline)
+{
+  AVERT(Arena, arena);
+  UNUSED(before);
+  UNUSED(deadline);
+  return 0;
+}
+
 
 Res ArenaNoGrow(Arena arena, LocusPref pref, Size size)
 {
@@ -1258,6 +1446,11 @@ Res ArenaSetCommitLimit(Arena arena, Size limit)
   AVERT(Arena, arena);
   AVER(ArenaCommitted(arena) <= arena->commitLimit);
 
+  /* Make the pool generations' reservations spare, so that they can
+     be purged.  See <design/strategy/#alloc.reserve.release>. */
+  if (limit < ArenaCommitted(arena) - arena->spareCommitted)
+    (void)LocusReleaseReserves(arena);
+
   committed = ArenaCommitted(arena);
   if (limit < committed) {
     /* Attempt to set the limit below current committed */
@@ -87,6 +87,7 @@ typedef struct VMArenaStruct {  /* VM arena structure */
 /* Forward declarations */
 
 static Size VMPurgeSpare(Arena arena, Size size);
+static Size VMPurgeAged(Arena arena, Clock before, Clock deadline);
 static void chunkUnmapSpare(Chunk chunk);
 DECLARE_CLASS(Arena, VMArena, AbstractArena);
 static void VMCompact(Arena arena, Trace trace);
@@ -256,6 +257,25 @@ static void vmArenaUnmap(VMArena vmArena, VM vm, Addr base, Addr limit)
 }
 
 
+/* vmArenaBind -- bind newly mapped pages to the nodes of their zones
+ *
+ * See <design/arena/#numa.bind>.
+ */
+static void vmArenaBind(VMArena vmArena, VM vm, Addr base, Addr limit)
+{
+  Arena arena = MustBeA(AbstractArena, vmArena);
+  Size stripe = ArenaStripeSize(arena);
+
+  while (base < limit) {
+    Addr next = AddrAlignUp(AddrAdd(base, 1), stripe);
+    if (next > limit || next < base)
+      next = limit;
+    VMBind(vm, base, next, ArenaNodeOfAddr(arena, base));
+    base = next;
+  }
+}
+
+
 /* VMChunkCreate -- create a chunk
  *
  * chunkReturn, return parameter for the created chunk.
@@ -864,6 +884,9 @@ static Res pagesMarkAllocated(VMArena vmArena, VMChunk vmChunk,
                      PageIndexBase(chunk, j), PageIndexBase(chunk, k));
     if (res != ResOK)
       goto failVMMap;
+    if (ArenaNodes(MustBeA(AbstractArena, vmArena)) > 1)
+      vmArenaBind(vmArena, VMChunkVM(vmChunk),
+                  PageIndexBase(chunk, j), PageIndexBase(chunk, k));
     for (i = j; i < k; ++i) {
       PageInit(chunk, i);
       PageAlloc(chunk, i, pool);
@@ -1034,7 +1057,43 @@ static Size arenaUnmapSpare(Arena arena, Size size, Chunk filter)
 
 static Size VMPurgeSpare(Arena arena, Size size)
 {
-  return arenaUnmapSpare(arena, size, NULL);
+  Clock start = ClockNow();
+  Size purged = arenaUnmapSpare(arena, size, NULL);
+  EVENT4(SparePurge, arena, purged, FALSE,
+         ((double)(ClockNow() - start) / (double)ClocksPerSec()));
+  return purged;
+}
+
+
+/* VMPurgeAged -- purge pages that became spare before a given time
+ *
+ * The spare ring is in the order in which the pages became spare, so
+ * the aged pages are all at the start of it.  Each unmapping is
+ * limited to ARENA_SPARE_PURGE_QUANTUM so that the deadline can be
+ * checked often.  Spare pages next to an aged page may be purged with
+ * it, as in chunkUnmapAroundPage.  See <design/arena/#spare.age>.
+ */
+
+static Size VMPurgeAged(Arena arena, Clock before, Clock deadline)
+{
+  VMArena vmArena = MustBeA(VMArena, arena);
+  Ring ring = &vmArena->spareRing;
+  Clock start = ClockNow(), now = start;
+  Size purged = 0;
+
+  while (!RingIsSingle(ring)
+         && PageSpareTime(PageOfSpareRing(RingNext(ring))) <= before)
+  {
+    purged += arenaUnmapSpare(arena, ARENA_SPARE_PURGE_QUANTUM, NULL);
+    now = ClockNow();
+    if (now >= deadline)
+      break;
+  }
+
+  if (purged > 0)
+    EVENT4(SparePurge, arena, purged, TRUE,
+           ((double)(now - start) / (double)ClocksPerSec()));
+  return purged;
 }
 
 
@@ -1057,6 +1116,7 @@ static void VMFree(Addr base, Size size, Pool pool)
   Count pages;
   Index pi, piBase, piLimit;
   Bool foundChunk;
+  Clock now;
 
   AVER(base != NULL);
   AVER(size > (Size)0);
@@ -1080,6 +1140,7 @@ static void VMFree(Addr base, Size size, Pool pool)
 
   /* loop from pageBase to pageLimit-1 inclusive */
   /* Finish each Tract found, then convert them to spare pages. */
+  now = ClockNow();
   for(pi = piBase; pi < piLimit; ++pi) {
     Page page = ChunkPage(chunk, pi);
     Tract tract = PageTract(page);
@@ -1092,6 +1153,7 @@ static void VMFree(Addr base, Size size, Pool pool)
        tract and will contain junk. */
     RingInit(PageSpareRing(page));
     RingAppend(&vmArena->spareRing, PageSpareRing(page));
+    page->spare.time = now;
   }
   arena->spareCommitted += ChunkPagesToSize(chunk, piLimit - piBase);
   BTResRange(chunk->allocTable, piBase, piLimit);
@@ -1104,9 +1166,13 @@ static void VMFree(Addr base, Size size, Pool pool)
     /* Purge half of the spare memory, not just the extra sliver, so
        that we return a reasonable amount of memory in one go, and avoid
        lots of small unmappings, each of which has an overhead. */
-    /* TODO: Consider making this time-based. */
     /* TODO: Consider making this smarter about the overheads tradeoff. */
     Size toPurge = arena->spareCommitted - arena->spareCommitLimit / 2;
+    /* If spare pages are purged by age, the poll keeps the spare
+       memory below the limit, so only purge the excess here, to keep
+       the pause short.  See <design/arena/#spare.age>. */
+    if (arena->spareAge > 0.0)
+      toPurge = arena->spareCommitted - arena->spareCommitLimit;
     (void)VMPurgeSpare(arena, toPurge);
   }
 }
@@ -1200,6 +1266,7 @@ DEFINE_CLASS(Arena, VMArena, klass)
   klass->create = VMArenaCreate;
   klass->destroy = VMArenaDestroy;
   klass->purgeSpare = VMPurgeSpare;
+  klass->purgeAged = VMPurgeAged;
   klass->grow = VMArenaGrow;
   klass->free = VMFree;
   klass->chunkInit = VMChunkInit;
@@ -104,6 +104,11 @@ Bool ArgCheckPool(Arg arg) {
   return TRUE;
 }
 
+Bool ArgCheckPolicyClass(Arg arg) {
+  CHECKD(PolicyClass, arg->val.policy_class);
+  return TRUE;
+}
+
 
 ARG_DEFINE_KEY(ARGS_END, Shouldnt);
 
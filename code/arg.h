@@ -56,6 +56,7 @@ extern Bool ArgCheckRankSet(Arg arg);
 extern Bool ArgCheckRank(Arg arg);
 extern Bool ArgCheckdouble(Arg arg);
 extern Bool ArgCheckPool(Arg arg);
+extern Bool ArgCheckPolicyClass(Arg arg);
 
 
 #endif /* arg_h */
@@ -0,0 +1,343 @@
+/* bgcoll.c: BACKGROUND COLLECTOR TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .purpose: Check that an arena created with MPS_KEY_ARENA_BACKGROUND
+ * collects while the mutator allocates, and also while the mutator
+ * is idle and not calling into the MPS at all, and that the objects
+ * reachable from the roots survive.  See <design/arena/#background>.
+ */
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "testthr.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mps.h"
+
+#include <stdio.h> /* fflush, printf, putchar */
+#include <time.h> /* time */
+
+
+#define testArenaSIZE     ((size_t)64<<20)
+#define avLEN             3
+#define exactRootsCOUNT   200
+#define liveCOUNT         2000
+#define liveLEN           128
+#define genCOUNT          2
+#define collectionsCOUNT  4
+#define objectsLIMIT      ((unsigned long)50000000)
+#define idleSECONDS       60
+#define floodTHREADS      8
+#define floodOBJECTS      ((unsigned long)1000000)
+#define floodLEN          8
+#define floodCOMMITTED    ((size_t)32<<20)
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 100, 0.85 }, { 170, 0.45 } };
+
+
+/* objNULL needs to be odd so that it's ignored in exactRoots. */
+#define objNULL           ((mps_addr_t)MPS_WORD_CONST(0xDECEA5ED))
+
+
+static mps_arena_t arena;
+static mps_ap_t ap;
+static mps_addr_t exactRoots[exactRootsCOUNT];
+static mps_addr_t liveRoots[liveCOUNT];
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(size_t length)
+{
+  size_t size = (length+2) * sizeof(mps_word_t);
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, exactRoots, exactRootsCOUNT);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+/* check -- check that the objects reachable from the roots are OK */
+
+static void check(void)
+{
+  size_t i;
+
+  for (i = 0; i < exactRootsCOUNT; ++i)
+    cdie(exactRoots[i] == objNULL || dylan_check(exactRoots[i]),
+         "exact root check");
+  for (i = 0; i < liveCOUNT; ++i)
+    cdie(dylan_check(liveRoots[i]), "live root check");
+}
+
+
+/* busy -- allocate until the background collector has collected
+ *
+ * The mutator allocates and mutates, but never calls
+ * mps_arena_step or mps_arena_collect, and ArenaPoll does no
+ * collection work when there is a background collector.
+ */
+
+static void busy(void)
+{
+  mps_word_t start = mps_collections(arena);
+  unsigned long objs = 0;
+
+  while (mps_collections(arena) < start + collectionsCOUNT) {
+    size_t r = (size_t)rnd();
+    size_t i = (r >> 1) % exactRootsCOUNT;
+    if (exactRoots[i] != objNULL)
+      cdie(dylan_check(exactRoots[i]), "dying root check");
+    exactRoots[i] = make(r % avLEN);
+    if (exactRoots[(exactRootsCOUNT-1) - i] != objNULL)
+      dylan_write(exactRoots[(exactRootsCOUNT-1) - i],
+                  exactRoots, exactRootsCOUNT);
+    ++objs;
+    if (objs % 65536 == 0) {
+      putchar('.');
+      (void)fflush(stdout);
+    }
+    cdie(objs < objectsLIMIT, "no collections while busy");
+  }
+  printf("\n%lu objects allocated while busy\n", objs);
+}
+
+
+/* flood -- allocate garbage in tight loops on several threads
+ *
+ * The mutator threads allocate as fast as they can, so that the
+ * background collector gets a small share of the processor and may
+ * not keep up with them.  The mutator must then do the collection
+ * work itself, so that committed memory stays bounded.  See
+ * <design/arena/#background.lag>.
+ */
+
+typedef struct flood_s {
+  mps_pool_t pool;              /* pool to allocate in */
+  size_t committedMax;          /* most memory committed while flooding */
+} flood_s, *flood_t;
+
+static void *floodThread(void *arg)
+{
+  void *marker = &marker;
+  flood_t fl = arg;
+  mps_thr_t thread;
+  mps_root_t stackRoot;
+  mps_ap_t floodAp;
+  size_t size = (floodLEN + 2) * sizeof(mps_word_t);
+  unsigned long objs;
+
+  die(mps_thread_reg(&thread, arena), "thread_reg(flood)");
+  die(mps_root_create_thread(&stackRoot, arena, thread, marker),
+      "root_create_thread(flood)");
+  die(mps_ap_create(&floodAp, fl->pool, mps_rank_exact()), "ap_create(flood)");
+
+  fl->committedMax = 0;
+  for (objs = 0; objs < floodOBJECTS; ++objs) {
+    mps_addr_t p;
+    mps_res_t res;
+    do {
+      MPS_RESERVE_BLOCK(res, p, floodAp, size);
+      if (res)
+        die(res, "MPS_RESERVE_BLOCK(flood)");
+      die(dylan_init(p, size, NULL, 0), "dylan_init(flood)");
+    } while (!mps_commit(floodAp, p, size));
+    if (objs % 1024 == 0) {
+      size_t committed = mps_arena_committed(arena);
+      if (committed > fl->committedMax)
+        fl->committedMax = committed;
+    }
+  }
+
+  mps_ap_destroy(floodAp);
+  mps_root_destroy(stackRoot);
+  mps_thread_dereg(thread);
+  return NULL;
+}
+
+static void flood(mps_pool_t pool)
+{
+  testthr_t kids[floodTHREADS];
+  flood_s fl[floodTHREADS];
+  size_t i, committedMax = 0;
+
+  for (i = 0; i < NELEMS(kids); ++i) {
+    fl[i].pool = pool;
+    testthr_create(&kids[i], floodThread, &fl[i]);
+  }
+  for (i = 0; i < NELEMS(kids); ++i) {
+    testthr_join(&kids[i], NULL);
+    if (fl[i].committedMax > committedMax)
+      committedMax = fl[i].committedMax;
+  }
+  printf("%d threads flooded, committed at most %lukB\n",
+         floodTHREADS, (unsigned long)(committedMax >> 10));
+  cdie(committedMax <= floodCOMMITTED, "committed memory bounded");
+}
+
+
+/* idle -- wait for the background collector to collect
+ *
+ * The mutator makes some garbage, then calls no MPS functions except
+ * mps_collections until a collection of the world has happened (see
+ * <design/arena/#background.step>).
+ */
+
+static void idle(void)
+{
+  mps_word_t start;
+  time_t deadline;
+  unsigned long spins = 0;
+  size_t i;
+
+  for (i = 0; i < exactRootsCOUNT; ++i)
+    exactRoots[i] = objNULL;
+  start = mps_collections(arena);
+  deadline = time(NULL) + idleSECONDS;
+  while (mps_collections(arena) == start) {
+    cdie(time(NULL) < deadline, "no collections while idle");
+    /* Avoid hogging the arena lock. */
+    for (i = 0; i < 100000; ++i)
+      ++spins;
+  }
+  printf("collected after %lu spins while idle\n", spins);
+}
+
+
+int main(int argc, char *argv[])
+{
+  void *marker = &marker;
+  mps_res_t res;
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_pool_t pool;
+  mps_thr_t thread;
+  mps_root_t exactRoot, liveRoot, stackRoot;
+  size_t i;
+
+  testlib_init(argc, argv);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_BACKGROUND, TRUE);
+    res = mps_arena_create_k(&arena, mps_arena_class_vm(), args);
+  } MPS_ARGS_END(args);
+  if (res == MPS_RES_UNIMPL) {
+    printf("%s: No background collector on this platform.\n", argv[0]);
+    printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+    return 0;
+  }
+  die(res, "arena_create");
+
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain), "chain_create");
+  die(mps_pool_create(&pool, arena, mps_class_amc(), format, chain),
+      "pool_create(amc)");
+  die(mps_ap_create(&ap, pool, mps_rank_exact()), "ap_create");
+
+  /* The collector may flip at any time, so the stack must be a root. */
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  die(mps_root_create_thread(&stackRoot, arena, thread, marker),
+      "root_create_thread");
+
+  for (i = 0; i < exactRootsCOUNT; ++i)
+    exactRoots[i] = objNULL;
+  die(mps_root_create_table_masked(&exactRoot, arena,
+                                   mps_rank_exact(), (mps_rm_t)0,
+                                   &exactRoots[0], exactRootsCOUNT,
+                                   (mps_word_t)1),
+      "root_create_table(exact)");
+  for (i = 0; i < liveCOUNT; ++i)
+    liveRoots[i] = objNULL;
+  die(mps_root_create_table_masked(&liveRoot, arena,
+                                   mps_rank_exact(), (mps_rm_t)0,
+                                   &liveRoots[0], liveCOUNT,
+                                   (mps_word_t)1),
+      "root_create_table(live)");
+
+  /* Make enough live data for a collection of the world to be worth
+     it: see ARENA_MINIMUM_COLLECTABLE_SIZE. */
+  for (i = 0; i < liveCOUNT; ++i)
+    liveRoots[i] = make(liveLEN);
+
+  busy();
+  check();
+  idle();
+  check();
+  busy();
+  check();
+  flood(pool);
+  check();
+
+  mps_arena_park(arena);
+  mps_ap_destroy(ap);
+  mps_root_destroy(liveRoot);
+  mps_root_destroy(exactRoot);
+  mps_root_destroy(stackRoot);
+  mps_thread_dereg(thread);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
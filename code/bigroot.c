@@ -0,0 +1,274 @@
+/* bigroot.c: LARGE ROOT STRESS TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ *
+ * Keep objects in an AMC pool alive from two large protectable table
+ * roots, one tagged and one not, while the mutator reads and writes
+ * the roots and allocates garbage.  Some collections are driven a
+ * step at a time, with the roots updated between steps, so that the
+ * mutator runs while the roots are being scanned a chunk at a time
+ * after the flip.  Check that every object the roots refer to
+ * survives intact.  See <design/root/#incremental>.
+ *
+ * The RootDefer telemetry event records each root whose scanning is
+ * deferred.
+ */
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+#include <stdlib.h> /* malloc, free */
+
+
+#define testArenaSIZE   ((size_t)256 << 20)
+#define rootCOUNT       ((size_t)1 << 18) /* 2 MiB on 64-bit platforms */
+#define rootALIGN       ((size_t)1 << 16)
+#define objSLOTS        2
+#define garbagePER      8     /* garbage objects per root update */
+#define testUPDATES     ((size_t)1 << 20)
+#define stepCOLLECTIONS 4     /* collections driven by steps */
+#define stepUPDATES     16    /* root updates between steps */
+#define genCOUNT        2
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 1024, 0.9 }, { 4096, 0.5 } };
+
+
+/* objNULL needs to be odd so that it's ignored in roots. */
+#define objNULL           ((mps_addr_t)MPS_WORD_CONST(0xDECEA5ED))
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(mps_ap_t ap)
+{
+  size_t size = (objSLOTS + 2) * sizeof(mps_word_t);
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, NULL, 0);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+/* alignedTable -- allocate a table whose pages belong to it alone
+ *
+ * A protectable root is protected in whole pages, so it must not
+ * share a page with any other data.
+ */
+
+static mps_addr_t *alignedTable(void **blockReturn, size_t count)
+{
+  void *block = malloc(count * sizeof(mps_addr_t) + rootALIGN);
+  mps_word_t base;
+  if (block == NULL)
+    error("malloc failed");
+  base = ((mps_word_t)block + rootALIGN - 1) & ~(mps_word_t)(rootALIGN - 1);
+  *blockReturn = block;
+  return (mps_addr_t *)base;
+}
+
+
+/* update -- read one random root entry and replace another */
+
+static void update(mps_ap_t ap, mps_addr_t *table[2])
+{
+  mps_addr_t *t = table[rnd() % 2];
+  size_t k = rnd() % rootCOUNT, l = rnd() % rootCOUNT, j;
+
+  /* Read one reference, which may hit the read barrier. */
+  if (t[l] != objNULL)
+    cdie(dylan_check(t[l]), "root read check");
+  t[k] = make(ap);
+  for (j = 0; j < garbagePER; ++j)
+    (void)make(ap);
+}
+
+
+/* collected -- discard GC messages and return how many there were */
+
+static size_t collected(mps_arena_t arena)
+{
+  mps_message_t message;
+  size_t count = 0;
+
+  while (mps_message_get(&message, arena, mps_message_type_gc())) {
+    ++ count;
+    mps_message_discard(arena, message);
+  }
+  return count;
+}
+
+
+static void test(mps_arena_t arena)
+{
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_pool_t pool;
+  mps_ap_t ap;
+  mps_root_t root[2];
+  mps_addr_t *table[2];
+  void *block[2];
+  size_t i, j, collections = 0, steps = 0, stepUpdates = 0;
+
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, mps_class_amc(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_ap_create_k(&ap, pool, mps_args_none), "ap_create");
+
+  for (i = 0; i < NELEMS(table); ++i) {
+    table[i] = alignedTable(&block[i], rootCOUNT);
+    for (j = 0; j < rootCOUNT; ++j)
+      table[i][j] = objNULL;
+  }
+  die(mps_root_create_table(&root[0], arena, mps_rank_exact(),
+                            MPS_RM_PROT, table[0], rootCOUNT),
+      "root_create_table");
+  die(mps_root_create_table_masked(&root[1], arena, mps_rank_exact(),
+                                   MPS_RM_PROT, table[1], rootCOUNT,
+                                   (mps_word_t)1),
+      "root_create_table_masked");
+
+  /* Fill the untagged table, so that it refers to many objects. */
+  for (j = 0; j < rootCOUNT; ++j)
+    table[0][j] = make(ap);
+
+  /* Let the arena collect as it allocates. */
+  for (i = 0; i < testUPDATES; ++i) {
+    update(ap, table);
+    collections += collected(arena);
+  }
+
+  /* Collect the world a step at a time.  The roots are deferred at
+     the flip, in mps_arena_start_collect, and each step scans at most
+     one chunk of them, so the updates between steps hit the roots
+     while they are still being scanned. */
+  for (i = 0; i < stepCOLLECTIONS; ++i) {
+    size_t stepCollections;
+    mps_arena_park(arena);
+    collections += collected(arena);
+    die(mps_arena_start_collect(arena), "arena_start_collect");
+    mps_arena_clamp(arena);
+    do {
+      for (j = 0; j < stepUPDATES; ++j)
+        update(ap, table);
+      stepUpdates += stepUPDATES;
+      ++ steps;
+      (void)mps_arena_step(arena, 0.0, 0.0);
+      stepCollections = collected(arena);
+    } while (stepCollections == 0);
+    collections += stepCollections;
+    mps_arena_release(arena);
+  }
+
+  mps_arena_park(arena);
+  for (i = 0; i < NELEMS(table); ++i)
+    for (j = 0; j < rootCOUNT; ++j)
+      if (table[i][j] != objNULL) {
+        cdie(mps_arena_has_addr(arena, table[i][j]), "root in arena");
+        cdie(dylan_check(table[i][j]), "root check");
+      }
+
+  printf("%lu collections, %lu steps, %lu updates between steps\n",
+         (unsigned long)collections, (unsigned long)steps,
+         (unsigned long)stepUpdates);
+  Insist(collections >= stepCOLLECTIONS);
+
+  mps_ap_destroy(ap);
+  for (i = 0; i < NELEMS(table); ++i) {
+    mps_root_destroy(root[i]);
+    free(block[i]);
+  }
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_release(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  mps_arena_t arena;
+  mps_thr_t thread;
+
+  testlib_init(argc, argv);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  mps_message_type_enable(arena, mps_message_type_gc());
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  test(arena);
+  mps_thread_dereg(thread);
+  mps_arena_destroy(arena);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -876,6 +876,42 @@ Bool BTFindShortResRangeHigh(Index *baseReturn, Index *limitReturn,
 }
 
 
+/* BTFindFirstSet -- find the lowest set bit in a range
+ *
+ * See <design/bt/#fun.find-first>.
+ */
+
+Bool BTFindFirstSet(Index *indexReturn, BT bt, Index base, Index limit)
+{
+  Bool found;
+
+  AVER_CRITICAL(indexReturn != NULL);
+  AVERT_CRITICAL(BT, bt);
+  AVER_CRITICAL(base < limit);
+
+  BTFindSet(&found, indexReturn, bt, base, limit);
+  return found;
+}
+
+
+/* BTFindFirstRes -- find the lowest reset bit in a range
+ *
+ * See <design/bt/#fun.find-first>.
+ */
+
+Bool BTFindFirstRes(Index *indexReturn, BT bt, Index base, Index limit)
+{
+  Bool found;
+
+  AVER_CRITICAL(indexReturn != NULL);
+  AVERT_CRITICAL(BT, bt);
+  AVER_CRITICAL(base < limit);
+
+  BTFindRes(&found, indexReturn, bt, base, limit);
+  return found;
+}
+
+
 /* BTRangesSame -- check that a range of bits in two BTs are the same.
  *
  * See <design/bt/#if.ranges-same>
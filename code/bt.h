@@ -60,6 +60,10 @@ extern Bool BTFindLongResRange(Index *baseReturn, Index *limitReturn,
 extern Bool BTFindLongResRangeHigh(Index *baseReturn, Index *limitReturn,
                                    BT bt, Index searchBase, Index searchLimit,
                                    Count length);
+extern Bool BTFindFirstSet(Index *indexReturn, BT bt,
+                           Index base, Index limit);
+extern Bool BTFindFirstRes(Index *indexReturn, BT bt,
+                           Index base, Index limit);
 
 extern Bool BTRangesSame(BT BTx, BT BTy, Index base, Index limit);
 
@@ -5,8 +5,9 @@
  *
  * .readership: MPS developers
  *
- * .coverage: Direct coverage of BTFind*ResRange*, BTRangesSame,
- * BTISResRange, BTIsSetRange, BTCopyRange, BTCopyOffsetRange.
+ * .coverage: Direct coverage of BTFind*ResRange*, BTFindFirst*,
+ * BTRangesSame, BTISResRange, BTIsSetRange, BTCopyRange,
+ * BTCopyOffsetRange.
  * Reasonable coverage of BTCopyInvertRange, BTResRange,
  * BTSetRange, BTRes, BTSet, BTCreate, BTDestroy.
  */
@@ -507,6 +508,41 @@ static void btCopyTests(BT bt1, BT bt2, Count btSize,
 
 
 
+/* btFindFirstTests -- Test BTFindFirstSet & BTFindFirstRes
+ *
+ * Test ranges which are all reset (set) apart from a single set
+ * (reset) bit, at each position inside the range, with the bits
+ * just outside the range set (reset) to make sure they aren't found.
+ */
+
+static void btFindFirstTests(BT bt, Count btSize, Index base, Index limit)
+{
+  Index i, found;
+
+  /* Reset range with set bits outside it */
+  BTSetRange(bt, 0, btSize);
+  BTResRange(bt, base, limit);
+  cdie(!BTFindFirstSet(&found, bt, base, limit), "BTFindFirstSet");
+  for (i = base; i < limit; ++i) {
+    BTSet(bt, i);
+    cdie(BTFindFirstSet(&found, bt, base, limit) && found == i,
+         "BTFindFirstSet");
+    BTRes(bt, i);
+  }
+
+  /* Set range with reset bits outside it */
+  BTResRange(bt, 0, btSize);
+  BTSetRange(bt, base, limit);
+  cdie(!BTFindFirstRes(&found, bt, base, limit), "BTFindFirstRes");
+  for (i = base; i < limit; ++i) {
+    BTRes(bt, i);
+    cdie(BTFindFirstRes(&found, bt, base, limit) && found == i,
+         "BTFindFirstRes");
+    BTSet(bt, i);
+  }
+}
+
+
 /* btTests --  Do all the tests
  */
 
@@ -523,6 +559,9 @@ static void btTests(BT btlo, BT bthi, Count btSize)
       /* Perform Copy*Range tests over those subranges */
       btCopyTests(btlo, bthi, btSize, base, limit);
 
+      /* Perform FindFirst* tests over those subranges */
+      btFindFirstTests(btlo, btSize, base, limit);
+
       /* Perform FindResRange tests with different lengths */
       btFindRangeTests(btlo, bthi, btSize, base, limit, 1);
       btFindRangeTests(btlo, bthi, btSize, base, limit, 2);
@@ -0,0 +1,1189 @@
+/* btree.c: ADDRESS-ORDERED B-TREE OF RANGES
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .intro: This is a Land implementation that maintains a collection of
+ * disjoint ranges in a B-tree ordered by address.  Each entry of an
+ * interior node summarizes its subtree with the size of the largest
+ * range and the union of the zones of the ranges, so that first-fit,
+ * last-fit, largest-fit and zoned searches descend the tree without
+ * restructuring it.
+ *
+ * .purpose: To replace the splay tree of the CBS in places where
+ * searches outnumber updates and where splaying the tree on every
+ * search costs more than it saves.
+ *
+ * .source: <design/btree/>.
+ */
+
+#include "btree.h"
+#include "poolmfs.h"
+#include "mpm.h"
+
+SRCID(btree, "$Id$");
+
+
+#define btreeNodePool(btree) RVALUE((btree)->nodePool)
+
+
+/* BTreeDEPTH_MAX -- maximum height of the tree
+ *
+ * Adjacent siblings hold more than BTreeWIDTH/2 entries between them
+ * (see <design/btree/#node.merge>), so each level below the root
+ * multiplies the number of ranges by at least BTreeWIDTH/4, and a
+ * tree of this height has more ranges than fit in the address space.
+ */
+
+#define BTreeDEPTH_MAX (MPS_WORD_WIDTH / 2)
+
+
+/* BTreePathStruct -- path from the root to an entry in a leaf
+ *
+ * node[level] is the node at that level on the path, and
+ * index[level] is the entry of that node that the path passes
+ * through.  Level 0 is the leaf.
+ */
+
+typedef struct BTreePathStruct {
+  Count height;
+  BTreeNode node[BTreeDEPTH_MAX];
+  Index index[BTreeDEPTH_MAX];
+} BTreePathStruct, *BTreePath;
+
+
+/* BTreeCheck -- check consistency of B-tree structure */
+
+Bool BTreeCheck(BTree btree)
+{
+  Land land;
+  CHECKS(BTree, btree);
+  land = BTreeLand(btree);
+  CHECKD(Land, land);
+  CHECKD(Pool, btree->nodePool);
+  CHECKL(BoolCheck(btree->ownPool));
+  CHECKL(btree->height <= BTreeDEPTH_MAX);
+  CHECKL((btree->root == NULL) == (btree->height == 0));
+  CHECKL((btree->root == NULL) == (btree->size == 0));
+  CHECKL(btree->root == NULL || btree->root->level + 1 == btree->height);
+  CHECKL(SizeIsAligned(btree->size, LandAlignment(land)));
+
+  return TRUE;
+}
+
+
+/* btreeNodeAlloc, btreeNodeFree -- allocate and free nodes */
+
+static Res btreeNodeAlloc(BTreeNode *nodeReturn, BTree btree)
+{
+  Res res;
+  Addr p;
+
+  AVER(nodeReturn != NULL);
+
+  res = PoolAlloc(&p, btreeNodePool(btree), sizeof(BTreeNodeStruct));
+  if (res != ResOK)
+    return res;
+  *nodeReturn = (BTreeNode)p;
+  return ResOK;
+}
+
+static void btreeNodeFree(BTree btree, BTreeNode node)
+{
+  PoolFree(btreeNodePool(btree), (Addr)node, sizeof(BTreeNodeStruct));
+}
+
+
+/* btreeEntryCopy -- copy entry from one node to another */
+
+static void btreeEntryCopy(BTreeNode to, Index toIndex,
+                           BTreeNode from, Index fromIndex)
+{
+  to->base[toIndex] = from->base[fromIndex];
+  to->limit[toIndex] = from->limit[fromIndex];
+  to->maxSize[toIndex] = from->maxSize[fromIndex];
+  to->zones[toIndex] = from->zones[fromIndex];
+  to->child[toIndex] = from->child[fromIndex];
+}
+
+
+/* btreeEntryOpen -- make room for an entry at index in node */
+
+static void btreeEntryOpen(BTreeNode node, Index index)
+{
+  Index i;
+  AVER(node->entries < BTreeWIDTH);
+  AVER(index <= node->entries);
+  for (i = node->entries; i > index; --i)
+    btreeEntryCopy(node, i, node, i - 1);
+  ++node->entries;
+}
+
+
+/* btreeEntryClose -- remove the entry at index in node */
+
+static void btreeEntryClose(BTreeNode node, Index index)
+{
+  Index i;
+  AVER(index < node->entries);
+  for (i = index + 1; i < node->entries; ++i)
+    btreeEntryCopy(node, i - 1, node, i);
+  --node->entries;
+}
+
+
+/* btreeEntrySetRange -- make a leaf entry describe a range */
+
+static void btreeEntrySetRange(BTree btree, BTreeNode leaf, Index index,
+                               Addr base, Addr limit)
+{
+  AVER(leaf->level == 0);
+  AVER(base < limit);
+  leaf->base[index] = base;
+  leaf->limit[index] = limit;
+  leaf->maxSize[index] = AddrOffset(base, limit);
+  leaf->zones[index] = ZoneSetOfRange(LandArena(BTreeLand(btree)),
+                                      base, limit);
+  leaf->child[index] = NULL;
+}
+
+
+/* btreeEntrySummarize -- make an interior entry summarize its child
+ *
+ * Returns TRUE if the summary changed.
+ */
+
+static Bool btreeEntrySummarize(BTreeNode parent, Index index)
+{
+  BTreeNode node = parent->child[index];
+  Size maxSize = 0;
+  ZoneSet zones = ZoneSetEMPTY;
+  Addr base, limit;
+  Index i;
+
+  AVER(node != NULL);
+  AVER(node->level + 1 == parent->level);
+  AVER(node->entries > 0);
+
+  for (i = 0; i < node->entries; ++i) {
+    if (node->maxSize[i] > maxSize)
+      maxSize = node->maxSize[i];
+    zones = ZoneSetUnion(zones, node->zones[i]);
+  }
+  base = node->base[0];
+  limit = node->limit[node->entries - 1];
+
+  if (parent->base[index] == base && parent->limit[index] == limit
+      && parent->maxSize[index] == maxSize && parent->zones[index] == zones)
+    return FALSE;
+  parent->base[index] = base;
+  parent->limit[index] = limit;
+  parent->maxSize[index] = maxSize;
+  parent->zones[index] = zones;
+  return TRUE;
+}
+
+
+/* btreeEntrySetChild -- make an interior entry point to a child */
+
+static void btreeEntrySetChild(BTreeNode parent, Index index, BTreeNode child)
+{
+  parent->child[index] = child;
+  (void)btreeEntrySummarize(parent, index);
+}
+
+
+/* btreeRefresh -- bring summaries on path up to date above level
+ *
+ * Stops as soon as a summary doesn't change, because the summaries
+ * above it then can't change either.
+ */
+
+static void btreeRefresh(BTreePath path, Index level)
+{
+  Index l;
+  for (l = level + 1; l < path->height; ++l)
+    if (!btreeEntrySummarize(path->node[l], path->index[l]))
+      break;
+}
+
+
+/* btreeFirst -- make path lead to the first range in the tree */
+
+static void btreeFirst(BTreePath path, BTree btree)
+{
+  BTreeNode node = btree->root;
+  Index level = btree->height;
+
+  AVER(node != NULL);
+  path->height = btree->height;
+  while (level > 0) {
+    --level;
+    AVER(node->level == level);
+    path->node[level] = node;
+    path->index[level] = 0;
+    node = node->child[0];
+  }
+}
+
+
+/* btreeLocate -- find the last range whose base is not above addr
+ *
+ * If there is such a range, makes path lead to it and returns TRUE.
+ * Otherwise, makes path lead to the first range in the tree (which
+ * is therefore above addr) and returns FALSE.
+ *
+ * Each interior entry records the lowest base in its subtree, so at
+ * each level the path follows the last entry whose base is not above
+ * addr, and if there is one at the root there is one at every level.
+ */
+
+static Bool btreeLocate(BTreePath path, BTree btree, Addr addr)
+{
+  BTreeNode node = btree->root;
+  Index level = btree->height;
+  Bool found = TRUE;
+
+  AVER(node != NULL);
+  path->height = btree->height;
+  while (level > 0) {
+    Index i;
+    --level;
+    AVER(node->level == level);
+    for (i = 0; i < node->entries && node->base[i] <= addr; ++i)
+      NOOP;
+    if (i == 0) {
+      AVER(level + 1 == btree->height || !found);
+      found = FALSE;
+    } else {
+      --i;
+    }
+    path->node[level] = node;
+    path->index[level] = i;
+    node = node->child[i];
+  }
+  return found;
+}
+
+
+/* btreeNext -- advance path to the next range in the tree
+ *
+ * Returns FALSE (leaving path unchanged) if there is no next range.
+ */
+
+static Bool btreeNext(BTreePath path)
+{
+  Index level = 0;
+
+  while (path->index[level] + 1 >= path->node[level]->entries) {
+    ++level;
+    if (level >= path->height)
+      return FALSE;
+  }
+  ++path->index[level];
+  while (level > 0) {
+    BTreeNode child = path->node[level]->child[path->index[level]];
+    --level;
+    path->node[level] = child;
+    path->index[level] = 0;
+  }
+  return TRUE;
+}
+
+
+/* btreeSet -- change the range at the end of path */
+
+static void btreeSet(BTree btree, BTreePath path, Addr base, Addr limit)
+{
+  btreeEntrySetRange(btree, path->node[0], path->index[0], base, limit);
+  btreeRefresh(path, 0);
+}
+
+
+/* btreeReserve -- allocate the nodes needed to insert into a leaf
+ *
+ * Inserting an entry into a full node splits it, and inserts an entry
+ * for the new node into its parent, so a new node is needed for each
+ * full node on the path up from the leaf, plus a new root if they are
+ * all full.  These are allocated before the tree is changed, so that
+ * running out of memory leaves the tree as it was.
+ */
+
+static Res btreeReserve(BTreeNode *spare, Count *countReturn,
+                        BTree btree, BTreePath path)
+{
+  Count count, i;
+  Res res;
+
+  for (count = 0; count < path->height; ++count)
+    if (path->node[count]->entries < BTreeWIDTH)
+      break;
+  if (count == path->height) {
+    if (path->height == BTreeDEPTH_MAX)
+      return ResLIMIT;
+    ++count;
+  }
+
+  for (i = 0; i < count; ++i) {
+    res = btreeNodeAlloc(&spare[i], btree);
+    if (res != ResOK)
+      goto failAlloc;
+  }
+  *countReturn = count;
+  return ResOK;
+
+failAlloc:
+  while (i > 0) {
+    --i;
+    btreeNodeFree(btree, spare[i]);
+  }
+  return res;
+}
+
+
+/* btreeInsertAt -- insert a range into the leaf at the end of path
+ *
+ * The range goes in at entry index of the leaf.  The caller must have
+ * reserved the spare nodes with btreeReserve, and all of them are
+ * used.
+ */
+
+static void btreeInsertAt(BTree btree, BTreePath path, Index index,
+                          Addr base, Addr limit,
+                          BTreeNode *spare, Count count)
+{
+  Index level = 0;
+  BTreeNode newChild = NULL;
+  BTreeNode *spareLimit = spare + count;
+
+  for (;;) {
+    BTreeNode node = path->node[level], into, right;
+    Index half = BTreeWIDTH / 2, i;
+
+    if (node->entries < BTreeWIDTH) {
+      into = node;
+      right = NULL;
+    } else {
+      /* Split the node, moving its upper half to a new node. */
+      AVER(spare < spareLimit);
+      right = *spare++;
+      right->level = node->level;
+      right->entries = BTreeWIDTH - half;
+      for (i = half; i < BTreeWIDTH; ++i)
+        btreeEntryCopy(right, i - half, node, i);
+      node->entries = half;
+      if (index <= half) {
+        into = node;
+      } else {
+        into = right;
+        index -= half;
+      }
+    }
+
+    btreeEntryOpen(into, index);
+    if (level == 0)
+      btreeEntrySetRange(btree, into, index, base, limit);
+    else
+      btreeEntrySetChild(into, index, newChild);
+
+    if (right == NULL) {
+      AVER(spare == spareLimit);
+      btreeRefresh(path, level);
+      return;
+    }
+
+    if (level + 1 == path->height) {
+      /* The root split: grow a new root above it. */
+      BTreeNode root;
+      AVER(spare + 1 == spareLimit);
+      AVER(btree->height < BTreeDEPTH_MAX);
+      root = *spare++;
+      root->level = node->level + 1;
+      root->entries = 2;
+      btreeEntrySetChild(root, 0, node);
+      btreeEntrySetChild(root, 1, right);
+      btree->root = root;
+      ++btree->height;
+      return;
+    }
+
+    /* Insert the new node into the parent after the old one. */
+    ++level;
+    (void)btreeEntrySummarize(path->node[level], path->index[level]);
+    index = path->index[level] + 1;
+    newChild = right;
+  }
+}
+
+
+/* btreeRemove -- remove the range at the end of path
+ *
+ * Frees nodes that become empty, merges a node with a sibling when
+ * they fit together in half a node (see <design/btree/#node.merge>),
+ * and removes a root that has only one child.  Doesn't allocate, so
+ * can't fail.
+ */
+
+static void btreeRemove(BTree btree, BTreePath path)
+{
+  Index level = 0;
+
+  for (;;) {
+    BTreeNode node = path->node[level], parent, left, right;
+    Index index;
+
+    btreeEntryClose(node, path->index[level]);
+
+    if (level + 1 == path->height) {
+      /* The root. */
+      if (node->entries == 0) {
+        btreeNodeFree(btree, node);
+        btree->root = NULL;
+        btree->height = 0;
+        return;
+      }
+      while (btree->root->level > 0 && btree->root->entries == 1) {
+        BTreeNode root = btree->root;
+        btree->root = root->child[0];
+        --btree->height;
+        btreeNodeFree(btree, root);
+      }
+      return;
+    }
+
+    parent = path->node[level + 1];
+    index = path->index[level + 1];
+    if (node->entries == 0) {
+      btreeNodeFree(btree, node);
+      ++level;
+      continue;
+    }
+
+    /* Merge with the right sibling if they fit in half a node, or
+       else with the left sibling. */
+    left = right = NULL;
+    if (index + 1 < parent->entries
+        && node->entries + parent->child[index + 1]->entries
+           <= BTreeWIDTH / 2) {
+      left = node;
+      right = parent->child[index + 1];
+      ++index;
+    } else if (index > 0
+               && parent->child[index - 1]->entries + node->entries
+                  <= BTreeWIDTH / 2) {
+      left = parent->child[index - 1];
+      right = node;
+    }
+    if (left != NULL) {
+      Index i;
+      for (i = 0; i < right->entries; ++i)
+        btreeEntryCopy(left, left->entries + i, right, i);
+      left->entries += right->entries;
+      btreeNodeFree(btree, right);
+      (void)btreeEntrySummarize(parent, index - 1);
+      path->index[level + 1] = index;
+      ++level;
+      continue;
+    }
+
+    btreeRefresh(path, level);
+    return;
+  }
+}
+
+
+/* btreeInit -- Initialise a B-tree structure
+ *
+ * See <design/land/#function.init>.
+ */
+
+ARG_DEFINE_KEY(btree_node_pool, Pool);
+
+static Res btreeInit(Land land, Arena arena, Align alignment, ArgList args)
+{
+  BTree btree;
+  ArgStruct arg;
+  Res res;
+  Pool nodePool = NULL;
+
+  AVER(land != NULL);
+  res = NextMethod(Land, BTree, init)(land, arena, alignment, args);
+  if (res != ResOK)
+    return res;
+  btree = CouldBeA(BTree, land);
+
+  if (ArgPick(&arg, args, BTreeNodePool))
+    nodePool = arg.val.pool;
+
+  if (nodePool != NULL) {
+    btree->nodePool = nodePool;
+    btree->ownPool = FALSE;
+  } else {
+    MPS_ARGS_BEGIN(pcArgs) {
+      MPS_ARGS_ADD(pcArgs, MPS_KEY_MFS_UNIT_SIZE, sizeof(BTreeNodeStruct));
+      res = PoolCreate(&btree->nodePool, LandArena(land), PoolClassMFS(),
+                       pcArgs);
+    } MPS_ARGS_END(pcArgs);
+    if (res != ResOK)
+      return res;
+    btree->ownPool = TRUE;
+  }
+  btree->root = NULL;
+  btree->height = 0;
+  btree->size = 0;
+
+  SetClassOfPoly(land, CLASS(BTree));
+  btree->sig = BTreeSig;
+  AVERC(BTree, btree);
+
+  return ResOK;
+}
+
+
+/* btreeNodeFreeAll -- free a node and all the nodes below it */
+
+static void btreeNodeFreeAll(BTree btree, BTreeNode node)
+{
+  if (node->level > 0) {
+    Index i;
+    for (i = 0; i < node->entries; ++i)
+      btreeNodeFreeAll(btree, node->child[i]);
+  }
+  btreeNodeFree(btree, node);
+}
+
+
+/* btreeFinish -- Finish B-tree structure
+ *
+ * See <design/land/#function.finish>.
+ */
+
+static void btreeFinish(Land land)
+{
+  BTree btree = MustBeA(BTree, land);
+
+  btree->sig = SigInvalid;
+
+  if (btree->ownPool)
+    PoolDestroy(btreeNodePool(btree));
+  else if (btree->root != NULL)
+    btreeNodeFreeAll(btree, btree->root);
+
+  NextMethod(Land, BTree, finish)(land);
+}
+
+
+/* btreeSize -- total size of ranges in B-tree
+ *
+ * See <design/land/#function.size>.
+ */
+
+static Size btreeSize(Land land)
+{
+  BTree btree = MustBeA(BTree, land);
+  return btree->size;
+}
+
+
+/* btreeInsert -- Insert a range into the B-tree
+ *
+ * See <design/land/#function.insert>.
+ *
+ * .insert.alloc: Will only allocate a node if the range does not
+ * abut an existing range.
+ */
+
+static Res btreeInsert(Range rangeReturn, Land land, Range range)
+{
+  BTree btree = MustBeA(BTree, land);
+  BTreePathStruct pathStruct, nextStruct;
+  BTreePath path = &pathStruct, next = &nextStruct;
+  BTreeNode spare[BTreeDEPTH_MAX + 1];
+  Count count;
+  Addr base, limit, newBase, newLimit;
+  Bool found, hasNext, leftMerge = FALSE, rightMerge = FALSE;
+  Res res;
+
+  AVER(rangeReturn != NULL);
+  AVERT(Range, range);
+  AVER(!RangeIsEmpty(range));
+  AVER(RangeIsAligned(range, LandAlignment(land)));
+
+  base = RangeBase(range);
+  limit = RangeLimit(range);
+
+  if (btree->root == NULL) {
+    BTreeNode leaf;
+    res = btreeNodeAlloc(&leaf, btree);
+    if (res != ResOK)
+      return res;
+    leaf->level = 0;
+    leaf->entries = 1;
+    btreeEntrySetRange(btree, leaf, 0, base, limit);
+    btree->root = leaf;
+    btree->height = 1;
+    btree->size = RangeSize(range);
+    RangeCopy(rangeReturn, range);
+    return ResOK;
+  }
+
+  found = btreeLocate(path, btree, base);
+  *next = *path;
+  if (found) {
+    BTreeNode leaf = path->node[0];
+    Index i = path->index[0];
+    if (leaf->limit[i] > base)
+      return ResFAIL; /* range overlaps with left neighbour */
+    leftMerge = leaf->limit[i] == base;
+    hasNext = btreeNext(next);
+  } else {
+    hasNext = TRUE;
+  }
+  if (hasNext) {
+    Addr nextBase = next->node[0]->base[next->index[0]];
+    if (nextBase < limit)
+      return ResFAIL; /* range overlaps with right neighbour */
+    rightMerge = nextBase == limit;
+  }
+
+  if (leftMerge) {
+    newBase = path->node[0]->base[path->index[0]];
+    if (rightMerge) {
+      newLimit = next->node[0]->limit[next->index[0]];
+      btreeSet(btree, path, newBase, newLimit);
+      btreeRemove(btree, next);
+    } else {
+      newLimit = limit;
+      btreeSet(btree, path, newBase, newLimit);
+    }
+  } else if (rightMerge) {
+    newBase = base;
+    newLimit = next->node[0]->limit[next->index[0]];
+    btreeSet(btree, next, newBase, newLimit);
+  } else {
+    res = btreeReserve(spare, &count, btree, path);
+    if (res != ResOK)
+      return res;
+    newBase = base;
+    newLimit = limit;
+    btreeInsertAt(btree, path, found ? path->index[0] + 1 : 0,
+                  newBase, newLimit, spare, count);
+  }
+
+  btree->size += RangeSize(range);
+  RangeInit(rangeReturn, newBase, newLimit);
+  return ResOK;
+}
+
+
+/* btreeDelete -- Remove a range from the B-tree
+ *
+ * See <design/land/#function.delete>.
+ *
+ * .delete.alloc: Will only allocate a node if the range splits an
+ * existing range.
+ */
+
+static Res btreeDelete(Range rangeReturn, Land land, Range range)
+{
+  BTree btree = MustBeA(BTree, land);
+  BTreePathStruct pathStruct;
+  BTreePath path = &pathStruct;
+  BTreeNode spare[BTreeDEPTH_MAX + 1];
+  Count count;
+  Addr base, limit, oldBase, oldLimit;
+  Res res;
+
+  AVER(rangeReturn != NULL);
+  AVERT(Range, range);
+  AVER(!RangeIsEmpty(range));
+  AVER(RangeIsAligned(range, LandAlignment(land)));
+
+  base = RangeBase(range);
+  limit = RangeLimit(range);
+
+  if (btree->root == NULL || !btreeLocate(path, btree, base))
+    return ResFAIL;
+  oldBase = path->node[0]->base[path->index[0]];
+  oldLimit = path->node[0]->limit[path->index[0]];
+  if (limit > oldLimit)
+    return ResFAIL; /* range is not contained in a range in the tree */
+
+  /* <design/land/#function.delete.return> */
+  RangeInit(rangeReturn, oldBase, oldLimit);
+
+  if (base == oldBase) {
+    if (limit == oldLimit)
+      btreeRemove(btree, path);
+    else
+      btreeSet(btree, path, limit, oldLimit);
+  } else if (limit == oldLimit) {
+    btreeSet(btree, path, oldBase, base);
+  } else {
+    /* Range is in the middle of the old range: split it. */
+    res = btreeReserve(spare, &count, btree, path);
+    if (res != ResOK)
+      return res;
+    btreeSet(btree, path, oldBase, base);
+    btreeInsertAt(btree, path, path->index[0] + 1, limit, oldLimit,
+                  spare, count);
+  }
+
+  AVER(btree->size >= AddrOffset(base, limit));
+  btree->size -= AddrOffset(base, limit);
+  return ResOK;
+}
+
+
+/* btreeIterate -- iterate over all ranges in address order
+ *
+ * See <design/land/#function.iterate>.
+ */
+
+static Bool btreeIterate(Land land, LandVisitor visitor, void *visitorClosure)
+{
+  BTree btree = MustBeA(BTree, land);
+  BTreePathStruct pathStruct;
+  BTreePath path = &pathStruct;
+
+  AVER(FUNCHECK(visitor));
+
+  if (btree->root == NULL)
+    return TRUE;
+
+  btreeFirst(path, btree);
+  do {
+    RangeStruct range;
+    BTreeNode leaf = path->node[0];
+    RangeInit(&range, leaf->base[path->index[0]], leaf->limit[path->index[0]]);
+    if (!(*visitor)(land, &range, visitorClosure))
+      return FALSE;
+  } while (btreeNext(path));
+  return TRUE;
+}
+
+
+/* btreeIterateAndDelete -- iterate over all ranges, maybe deleting
+ *
+ * See <design/land/#function.iterate.and.delete>.
+ *
+ * After deleting a range, relocate the next range by address, because
+ * btreeRemove may have merged or freed the nodes on the path.
+ */
+
+static Bool btreeIterateAndDelete(Land land, LandDeleteVisitor visitor,
+                                  void *visitorClosure)
+{
+  BTree btree = MustBeA(BTree, land);
+  BTreePathStruct pathStruct;
+  BTreePath path = &pathStruct;
+  Bool cont = TRUE;
+
+  AVER(FUNCHECK(visitor));
+
+  if (btree->root == NULL)
+    return TRUE;
+
+  btreeFirst(path, btree);
+  for (;;) {
+    RangeStruct range;
+    BTreeNode leaf = path->node[0];
+    Bool deleteRange = FALSE;
+    RangeInit(&range, leaf->base[path->index[0]], leaf->limit[path->index[0]]);
+    cont = (*visitor)(&deleteRange, land, &range, visitorClosure);
+    if (deleteRange) {
+      btreeRemove(btree, path);
+      AVER(btree->size >= RangeSize(&range));
+      btree->size -= RangeSize(&range);
+      if (!cont || btree->root == NULL)
+        break;
+      if (btreeLocate(path, btree, RangeLimit(&range)) && !btreeNext(path))
+        break;
+    } else if (!cont || !btreeNext(path)) {
+      break;
+    }
+  }
+  return cont;
+}
+
+
+/* btreeFindDeleteRange -- delete appropriate range of block found */
+
+static void btreeFindDeleteRange(Range rangeReturn, Range oldRangeReturn,
+                                 Land land, Range range, Size size,
+                                 FindDelete findDelete)
+{
+  Bool callDelete = TRUE;
+  Addr base, limit;
+
+  AVER(rangeReturn != NULL);
+  AVER(oldRangeReturn != NULL);
+  AVERT(Range, range);
+  AVER(size > 0);
+  AVER(SizeIsAligned(size, LandAlignment(land)));
+  AVER(RangeSize(range) >= size);
+  AVERT(FindDelete, findDelete);
+
+  base = RangeBase(range);
+  limit = RangeLimit(range);
+
+  switch(findDelete) {
+
+  case FindDeleteNONE:
+    callDelete = FALSE;
+    break;
+
+  case FindDeleteLOW:
+    limit = AddrAdd(base, size);
+    break;
+
+  case FindDeleteHIGH:
+    base = AddrSub(limit, size);
+    break;
+
+  case FindDeleteENTIRE:
+    /* do nothing */
+    break;
+
+  default:
+    NOTREACHED;
+    break;
+  }
+
+  RangeInit(rangeReturn, base, limit);
+
+  if (callDelete) {
+    Res res;
+    res = btreeDelete(oldRangeReturn, land, rangeReturn);
+    /* Can't have run out of memory, because we only deleted from one
+       end of a range that was just found in the tree, so btreeDelete
+       did not need to allocate a node. */
+    AVER(res == ResOK);
+  } else {
+    RangeCopy(oldRangeReturn, rangeReturn);
+  }
+}
+
+
+/* btreeFindLeaf -- find the first or last range of at least size
+ *
+ * The maximum sizes are exact, so if the root has an entry that's big
+ * enough, there is a range under it that's big enough.
+ */
+
+static Bool btreeFindLeaf(BTreeNode *leafReturn, Index *indexReturn,
+                          BTree btree, Size size, Bool high)
+{
+  BTreeNode node = btree->root;
+
+  if (node == NULL)
+    return FALSE;
+
+  for (;;) {
+    Index i, j;
+    for (j = 0; j < node->entries; ++j) {
+      i = high ? node->entries - 1 - j : j;
+      if (node->maxSize[i] >= size)
+        break;
+    }
+    if (j == node->entries) {
+      AVER(node == btree->root); /* maximum sizes are exact */
+      return FALSE;
+    }
+    if (node->level == 0) {
+      *leafReturn = node;
+      *indexReturn = i;
+      return TRUE;
+    }
+    node = node->child[i];
+  }
+}
+
+
+/* btreeFind -- find the first or last range of at least size */
+
+static Bool btreeFind(Range rangeReturn, Range oldRangeReturn,
+                      Land land, Size size, FindDelete findDelete, Bool high)
+{
+  BTree btree = MustBeA(BTree, land);
+  BTreeNode leaf;
+  Index i;
+  RangeStruct range;
+
+  AVER(rangeReturn != NULL);
+  AVER(oldRangeReturn != NULL);
+  AVER(size > 0);
+  AVER(SizeIsAligned(size, LandAlignment(land)));
+  AVERT(FindDelete, findDelete);
+
+  if (!btreeFindLeaf(&leaf, &i, btree, size, high))
+    return FALSE;
+  RangeInit(&range, leaf->base[i], leaf->limit[i]);
+  AVER(RangeSize(&range) >= size);
+  btreeFindDeleteRange(rangeReturn, oldRangeReturn, land, &range,
+                       size, findDelete);
+  return TRUE;
+}
+
+
+/* btreeFindFirst, btreeFindLast -- find first or last range of at
+ * least size
+ *
+ * See <design/land/#function.find.first> and
+ * <design/land/#function.find.last>.
+ */
+
+static Bool btreeFindFirst(Range rangeReturn, Range oldRangeReturn,
+                           Land land, Size size, FindDelete findDelete)
+{
+  return btreeFind(rangeReturn, oldRangeReturn, land, size, findDelete,
+                   FALSE);
+}
+
+static Bool btreeFindLast(Range rangeReturn, Range oldRangeReturn,
+                          Land land, Size size, FindDelete findDelete)
+{
+  return btreeFind(rangeReturn, oldRangeReturn, land, size, findDelete,
+                   TRUE);
+}
+
+
+/* btreeFindLargest -- find the largest range
+ *
+ * See <design/land/#function.find.largest>.  Like the CBS, finds the
+ * first of the largest ranges.
+ */
+
+static Bool btreeFindLargest(Range rangeReturn, Range oldRangeReturn,
+                             Land land, Size size, FindDelete findDelete)
+{
+  BTree btree = MustBeA(BTree, land);
+  BTreeNode root = btree->root;
+  BTreeNode leaf = NULL;        /* suppress "may be used uninitialized" */
+  Index i = 0;
+  RangeStruct range;
+  Size maxSize = 0;
+  Bool found;
+
+  AVER(rangeReturn != NULL);
+  AVER(oldRangeReturn != NULL);
+  AVER(size > 0);
+  AVERT(FindDelete, findDelete);
+
+  if (root == NULL)
+    return FALSE;
+  for (i = 0; i < root->entries; ++i)
+    if (root->maxSize[i] > maxSize)
+      maxSize = root->maxSize[i];
+  if (maxSize < size)
+    return FALSE;
+  found = btreeFindLeaf(&leaf, &i, btree, maxSize, FALSE);
+  AVER(found); /* maxSize is exact, so we will find it. */
+  RangeInit(&range, leaf->base[i], leaf->limit[i]);
+  btreeFindDeleteRange(rangeReturn, oldRangeReturn, land, &range,
+                       size, findDelete);
+  return TRUE;
+}
+
+
+/* btreeFindInZonesNode -- search a subtree for a range in zones
+ *
+ * Skips subtrees whose largest range is too small or whose ranges
+ * are all outside the zones.  A subtree that passes both tests may
+ * still fail, because no part of a range that is big enough lies in
+ * the zones, so the search backtracks.
+ */
+
+static Bool btreeFindInZonesNode(Addr *baseReturn, Addr *limitReturn,
+                                 BTreeNode node, Arena arena, Size size,
+                                 ZoneSet zoneSet, Bool high)
+{
+  RangeInZoneSet search = high ? RangeInZoneSetLast : RangeInZoneSetFirst;
+  Index i, j;
+
+  for (j = 0; j < node->entries; ++j) {
+    i = high ? node->entries - 1 - j : j;
+    if (node->maxSize[i] < size
+        || ZoneSetInter(node->zones[i], zoneSet) == ZoneSetEMPTY)
+      continue;
+    if (node->level == 0) {
+      if ((*search)(baseReturn, limitReturn, node->base[i], node->limit[i],
+                    arena, zoneSet, size))
+        return TRUE;
+    } else {
+      if (btreeFindInZonesNode(baseReturn, limitReturn, node->child[i],
+                               arena, size, zoneSet, high))
+        return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+
+/* btreeFindInZones -- find a range of at least size in zones
+ *
+ * See <design/land/#function.find.zones>.
+ */
+
+static Res btreeFindInZones(Bool *foundReturn, Range rangeReturn,
+                            Range oldRangeReturn, Land land, Size size,
+                            ZoneSet zoneSet, Bool high)
+{
+  BTree btree = MustBeA(BTree, land);
+  Arena arena = LandArena(land);
+  RangeStruct rangeStruct, oldRangeStruct;
+  Addr base, limit;
+  Res res;
+
+  AVER(foundReturn != NULL);
+  AVER(rangeReturn != NULL);
+  AVER(oldRangeReturn != NULL);
+  /* AVERT(ZoneSet, zoneSet); */
+  AVERT(Bool, high);
+
+  if (zoneSet == ZoneSetEMPTY || btree->root == NULL)
+    goto fail;
+  if (zoneSet == ZoneSetUNIV) {
+    FindDelete fd = high ? FindDeleteHIGH : FindDeleteLOW;
+    *foundReturn = btreeFind(rangeReturn, oldRangeReturn, land, size, fd,
+                             high);
+    return ResOK;
+  }
+  if (ZoneSetIsSingle(zoneSet) && size > ArenaStripeSize(arena))
+    goto fail;
+
+  if (!btreeFindInZonesNode(&base, &limit, btree->root, arena, size,
+                            zoneSet, high))
+    goto fail;
+
+  AVER(AddrOffset(base, limit) >= size);
+  AVER(ZoneSetSub(ZoneSetOfRange(arena, base, limit), zoneSet));
+
+  if (!high)
+    RangeInit(&rangeStruct, base, AddrAdd(base, size));
+  else
+    RangeInit(&rangeStruct, AddrSub(limit, size), limit);
+  res = btreeDelete(&oldRangeStruct, land, &rangeStruct);
+  if (res != ResOK)
+    /* not enough memory to split range */
+    return res;
+  RangeCopy(rangeReturn, &rangeStruct);
+  RangeCopy(oldRangeReturn, &oldRangeStruct);
+  *foundReturn = TRUE;
+  return ResOK;
+
+fail:
+  *foundReturn = FALSE;
+  return ResOK;
+}
+
+
+/* btreeDescribe -- describe B-tree
+ *
+ * See <design/land/#function.describe>.
+ */
+
+static Res btreeDescribe(Land land, mps_lib_FILE *stream, Count depth)
+{
+  BTree btree = CouldBeA(BTree, land);
+  BTreePathStruct pathStruct;
+  BTreePath path = &pathStruct;
+  Res res;
+
+  if (!TESTC(BTree, btree))
+    return ResPARAM;
+  if (stream == NULL)
+    return ResPARAM;
+
+  res = NextMethod(Land, BTree, describe)(land, stream, depth);
+  if (res != ResOK)
+    return res;
+
+  res = WriteF(stream, depth + 2,
+               "nodePool $P\n", (WriteFP)btreeNodePool(btree),
+               "ownPool  $U\n", (WriteFU)btree->ownPool,
+               "height   $U\n", (WriteFU)btree->height,
+               "size     $U\n", (WriteFU)btree->size,
+               NULL);
+  if (res != ResOK)
+    return res;
+
+  if (btree->root == NULL)
+    return ResOK;
+
+  btreeFirst(path, btree);
+  do {
+    BTreeNode leaf = path->node[0];
+    Index i = path->index[0];
+    res = WriteF(stream, depth + 2,
+                 "[$P,$P) {$B}\n",
+                 (WriteFP)leaf->base[i], (WriteFP)leaf->limit[i],
+                 (WriteFB)leaf->zones[i],
+                 NULL);
+    if (res != ResOK)
+      return res;
+  } while (btreeNext(path));
+
+  return ResOK;
+}
+
+
+DEFINE_CLASS(Land, BTree, klass)
+{
+  INHERIT_CLASS(klass, BTree, Land);
+  klass->size = sizeof(BTreeStruct);
+  klass->init = btreeInit;
+  klass->finish = btreeFinish;
+  klass->sizeMethod = btreeSize;
+  klass->insert = btreeInsert;
+  klass->delete = btreeDelete;
+  klass->iterate = btreeIterate;
+  klass->iterateAndDelete = btreeIterateAndDelete;
+  klass->findFirst = btreeFindFirst;
+  klass->findLast = btreeFindLast;
+  klass->findLargest = btreeFindLargest;
+  klass->findInZones = btreeFindInZones;
+  klass->describe = btreeDescribe;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -0,0 +1,103 @@
+/* btree.h: BTREE -- ADDRESS-ORDERED B-TREE OF RANGES
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .source: <design/btree/>.
+ */
+
+#ifndef btree_h
+#define btree_h
+
+#include "arg.h"
+#include "mpmtypes.h"
+#include "mpm.h"
+#include "mpmst.h"
+#include "range.h"
+
+
+/* BTreeWIDTH -- maximum number of entries in a node
+ *
+ * See <design/btree/#node.width>.
+ */
+
+#define BTreeWIDTH 16
+
+
+/* BTreeNodeStruct -- node of a B-tree
+ *
+ * Entry i of a leaf is a range.  Entry i of an interior node
+ * summarizes the subtree child[i]: the base of its first range, the
+ * limit of its last range, the size of its largest range, and the
+ * union of the zones of its ranges.  See <design/btree/#node>.
+ */
+
+typedef struct BTreeNodeStruct {
+  Count entries;                /* number of entries in use */
+  Count level;                  /* 0 for a leaf, height - 1 for the root */
+  Addr base[BTreeWIDTH];        /* base of range or subtree */
+  Addr limit[BTreeWIDTH];       /* limit of range or subtree */
+  Size maxSize[BTreeWIDTH];     /* size of range, or largest in subtree */
+  ZoneSet zones[BTreeWIDTH];    /* zones of range or subtree */
+  BTreeNode child[BTreeWIDTH];  /* subtrees, if not a leaf */
+} BTreeNodeStruct;
+
+typedef struct BTreeStruct *BTree;
+
+extern Bool BTreeCheck(BTree btree);
+
+
+/* BTreeLand -- convert BTree to Land (compare CBSLand in cbs.h) */
+
+#define BTreeLand(btree) (&(btree)->landStruct)
+
+
+DECLARE_CLASS(Land, BTree, Land);
+
+extern const struct mps_key_s _mps_key_btree_node_pool;
+#define BTreeNodePool (&_mps_key_btree_node_pool)
+#define BTreeNodePool_FIELD pool
+
+#endif /* btree_h */
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -284,7 +284,9 @@ void BufferDetach(Buffer buffer, Pool pool)
     limit = buffer->poolLimit;
     /* Ask the owning pool to do whatever it needs to before the */
     /* buffer is detached (e.g. copy buffer state into pool state). */
+    PoolLockClaim(pool);
     Method(Pool, pool, bufferEmpty)(pool, buffer, init, limit);
+    PoolLockRelease(pool);
 
     /* run any class-specific detachment method */
     Method(Buffer, buffer, detach)(buffer);
@@ -602,7 +604,9 @@ Res BufferFill(Addr *pReturn, Buffer buffer, Size size)
   BufferDetach(buffer, pool);
 
   /* Ask the pool for some memory. */
+  PoolLockClaim(pool);
   res = Method(Pool, pool, bufferFill)(&base, &limit, pool, buffer, size);
+  PoolLockRelease(pool);
   if (res != ResOK)
     return res;
 
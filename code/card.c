@@ -0,0 +1,171 @@
+/* card.c: CARD MARKING WRITE BARRIER
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .purpose: When the arena is created with MPS_KEY_ARENA_CARD_MARKING,
+ * the client records its stores into the heap by marking cards in a
+ * table with MPS_WRITE_BARRIER, and the MPS maintains segment
+ * summaries by scanning the dirty cards instead of by protecting
+ * segments against writes.  See <design/write-barrier/#card>.
+ *
+ * .table: The card table is a single array of bytes shared by the
+ * whole arena, indexed by the address shifted down by CARD_SHIFT and
+ * masked to CARD_TABLE_SIZE.  So the client can mark a card without
+ * finding the segment, and can mark a card for any address, whether
+ * or not it's managed by the MPS.  Addresses that are a multiple of
+ * CARD_TABLE_SIZE cards apart share a card, which only costs extra
+ * scanning.
+ *
+ * .sync: Keep in sync with mps_cards_s and MPS_CARD_MARK in
+ * <code/mps.h#cards>.
+ */
+
+#include "mpm.h"
+
+SRCID(card, "$Id$");
+
+
+/* CardsCheck -- check the card table of an arena
+ *
+ * The table is allocated by GlobalsCompleteCreate, so it may be
+ * missing even if the arena uses card marking.
+ */
+
+Bool CardsCheck(Arena arena)
+{
+  mps_cards_t cards = ArenaCards(arena);
+
+  CHECKL(BoolCheck(ArenaCardMarking(arena)));
+  if (cards->_table != NULL) {
+    CHECKL(ArenaCardMarking(arena));
+    CHECKL(cards->_shift == CARD_SHIFT);
+    CHECKL(cards->_mask == CARD_TABLE_SIZE - 1);
+  }
+  return TRUE;
+}
+
+
+/* CardsInit -- allocate the card table of an arena
+ *
+ * All cards start clean: there's nothing in the heap yet.
+ */
+
+Res CardsInit(Arena arena)
+{
+  mps_cards_t cards = ArenaCards(arena);
+  void *p;
+  Res res;
+
+  AVER(ArenaCardMarking(arena));
+  AVER(cards->_table == NULL);
+  AVER(WordIsP2(CARD_TABLE_SIZE));
+
+  res = ControlAlloc(&p, arena, (Size)CARD_TABLE_SIZE);
+  if (res != ResOK)
+    return res;
+  (void)AddrSet((Addr)p, 0, (Size)CARD_TABLE_SIZE);
+  cards->_table = p;
+  cards->_shift = CARD_SHIFT;
+  cards->_mask = CARD_TABLE_SIZE - 1;
+
+  AVER(CardsCheck(arena));
+  return ResOK;
+}
+
+
+/* CardsFinish -- free the card table of an arena */
+
+void CardsFinish(Arena arena)
+{
+  mps_cards_t cards = ArenaCards(arena);
+
+  AVER(CardsCheck(arena));
+  AVER(cards->_table != NULL);
+
+  ControlFree(arena, cards->_table, (Size)CARD_TABLE_SIZE);
+  cards->_table = NULL;
+}
+
+
+/* CardsRangeDirty -- is any card in a range of addresses dirty? */
+
+Bool CardsRangeDirty(Arena arena, Addr base, Addr limit)
+{
+  mps_cards_t cards = ArenaCards(arena);
+  Word i, count;
+
+  AVER_CRITICAL(cards->_table != NULL);
+  AVER_CRITICAL(base < limit);
+
+  i = (Word)base >> cards->_shift;
+  count = ((Word)AddrSub(limit, 1) >> cards->_shift) - i + 1;
+  /* .table: No need to look at a card more than once. */
+  if (count > cards->_mask)
+    count = cards->_mask + 1;
+  for (; count > 0; --count, ++i)
+    if (cards->_table[i & cards->_mask] != 0)
+      return TRUE;
+  return FALSE;
+}
+
+
+/* CardsClear -- make all cards clean
+ *
+ * Called when the summaries of all segments with dirty cards have
+ * been brought up to date.  The mutator must be suspended, so that
+ * it can't be part of the way through MPS_WRITE_BARRIER.  See
+ * <design/write-barrier/#card.harvest>.
+ */
+
+void CardsClear(Arena arena)
+{
+  mps_cards_t cards = ArenaCards(arena);
+
+  AVER(CardsCheck(arena));
+  AVER(cards->_table != NULL);
+
+  (void)AddrSet((Addr)cards->_table, 0, (Size)CARD_TABLE_SIZE);
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -0,0 +1,363 @@
+/* cardss.c: CARD MARKING WRITE BARRIER STRESS TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Allocate objects in an arena created with MPS_KEY_ARENA_CARD_MARKING,
+ * and store young references into long-lived objects through
+ * MPS_WRITE_BARRIER, so that the only record of those references is
+ * the card table.  If a store were missed, the referent would be
+ * reclaimed while still reachable, and the check of the heap would
+ * fail.  AMC scans just the dirty cards; AMS has no method for that,
+ * so it falls back to universal summaries.  See
+ * <design/write-barrier/#card>.
+ *
+ * After each check the long-lived objects are emptied and left alone
+ * for a few collections, so that their segments' summaries shrink
+ * and, without card marking, their write barrier is raised (see
+ * design.mps.write-barrier.deferral).  The same AMC workload first
+ * runs in an arena without card marking, where the stores then
+ * usually cause write faults, and the test checks that with card
+ * marking there are none.  The faults are only counted in varieties
+ * with statistics.
+ *
+ * The faults without card marking are reported but not checked: each
+ * object's wrapper is a reference to memory outside the arena, and if
+ * that happens to be in a zone in the nursery, every scan of the
+ * long-lived objects is interesting and their write barrier is never
+ * raised.
+ */
+
+#include "mpm.h"
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpscams.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* fflush, printf, putchar */
+
+
+#define testArenaSIZE     ((size_t)16 << 20)
+#define avLEN             3
+#define exactRootsCOUNT   180
+#define oldRootsCOUNT     50
+#define oldSLOTS          64
+#define storesCOUNT       2
+#define genCOUNT          2
+#define emptyCOLLECTIONS  4
+#define protCOLLECTIONS   20
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 150, 0.85 }, { 170, 0.45 } };
+
+
+/* objNULL needs to be odd so that it's ignored in exactRoots. */
+#define objNULL           ((mps_addr_t)MPS_WORD_CONST(0xDECEA5ED))
+
+
+static mps_arena_t arena;
+static mps_cards_t cards;
+static mps_ap_t ap;
+static mps_addr_t exactRoots[exactRootsCOUNT];
+static mps_addr_t oldRoots[oldRootsCOUNT];
+static unsigned long storeCount;
+
+
+/* writeFaults -- number of write barrier hits in the arena so far
+ *
+ * Always zero in varieties without statistics.
+ */
+
+static Count writeFaults(void)
+{
+#if defined(STATISTICS)
+  return ((Arena)arena)->writeBarrierHitCount;
+#else
+  return 0;
+#endif
+}
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(size_t length)
+{
+  size_t size = (length+2) * sizeof(mps_word_t);
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, exactRoots, exactRootsCOUNT);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+/* writeWord -- write a word into a slot, marking its card if there is a
+ * card table */
+
+static void writeWord(mps_word_t *slot, mps_word_t word)
+{
+  if (cards == NULL)
+    *slot = word;
+  else
+    MPS_WRITE_BARRIER(cards, slot, word);
+}
+
+
+/* store -- store a reference into a random slot of a vector
+ *
+ * The slot is marked dirty in the card table, if there is one, and is
+ * the only record of the reference once the root that held it has
+ * been overwritten.
+ */
+
+static void store(mps_addr_t obj, mps_addr_t ref)
+{
+  mps_word_t *p = obj;
+  mps_word_t slots = p[1] >> 2;
+
+  if (slots > 0) {
+    writeWord(&p[2 + rnd() % slots], (mps_word_t)ref);
+    ++storeCount;
+  }
+}
+
+
+/* empty -- overwrite the slots of the long-lived objects with
+ * non-references */
+
+static void empty(void)
+{
+  size_t i, j;
+
+  for (i = 0; i < oldRootsCOUNT; ++i) {
+    mps_word_t *old = oldRoots[i];
+    for (j = 0; j < oldSLOTS; ++j)
+      writeWord(&old[2 + j], (mps_word_t)objNULL);
+  }
+}
+
+
+/* checkObject -- check an object and, to some depth, what it refers to
+ *
+ * Many objects are reachable only through stores into older objects,
+ * so if a store were missed the referent would have been reclaimed.
+ */
+
+static void checkObject(mps_addr_t object, unsigned depth)
+{
+  mps_word_t *obj = object;
+  mps_word_t i, slots;
+
+  cdie(mps_arena_has_addr(arena, object), "object in arena");
+  cdie(dylan_check(object), "object check");
+  slots = obj[1] >> 2;
+  for (i = 0; i < slots; ++i) {
+    mps_word_t ref = obj[2 + i];
+    if ((ref & 3) == 0 && depth > 0)
+      checkObject((mps_addr_t)ref, depth - 1);
+  }
+}
+
+
+/* check -- check the objects reachable from the roots */
+
+static void check(void)
+{
+  size_t i;
+
+  mps_arena_park(arena);
+  for (i = 0; i < exactRootsCOUNT; ++i)
+    if (exactRoots[i] != objNULL)
+      checkObject(exactRoots[i], 2);
+  for (i = 0; i < oldRootsCOUNT; ++i)
+    checkObject(oldRoots[i], 2);
+  mps_arena_release(arena);
+}
+
+
+/* test -- the body of the test */
+
+static void test(mps_pool_class_t pool_class, unsigned long collectionsCount)
+{
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_root_t exactRoot, oldRoot;
+  mps_pool_t pool;
+  mps_message_t message;
+  unsigned long objs, collections, quietCollections;
+  size_t i;
+
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, pool_class, args), "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_ap_create(&ap, pool, mps_rank_exact()), "BufferCreate");
+
+  for(i = 0; i < exactRootsCOUNT; ++i)
+    exactRoots[i] = objNULL;
+  for(i = 0; i < oldRootsCOUNT; ++i)
+    oldRoots[i] = objNULL;
+  die(mps_root_create_table_masked(&exactRoot, arena,
+                                   mps_rank_exact(), (mps_rm_t)0,
+                                   &exactRoots[0], exactRootsCOUNT,
+                                   (mps_word_t)1),
+      "root_create_table(exact)");
+  die(mps_root_create_table_masked(&oldRoot, arena,
+                                   mps_rank_exact(), (mps_rm_t)0,
+                                   &oldRoots[0], oldRootsCOUNT,
+                                   (mps_word_t)1),
+      "root_create_table(old)");
+  for(i = 0; i < oldRootsCOUNT; ++i)
+    oldRoots[i] = make(oldSLOTS);
+
+  collections = 0;
+  quietCollections = 0;
+  objs = 0;
+  storeCount = 0;
+  while (collections < collectionsCount) {
+    mps_addr_t obj;
+
+    while (mps_message_get(&message, arena, mps_message_type_gc())) {
+      mps_message_discard(arena, message);
+      ++collections;
+      putchar('.');
+      (void)fflush(stdout);
+      if (collections % 5 == 0) {
+        check();
+        empty();
+        quietCollections = collections + emptyCOLLECTIONS;
+      }
+    }
+
+    /* Make a young object and store it into some long-lived objects
+       (unless they are being left alone), and into a young one, then
+       forget it half the time, so that it's kept alive only by the
+       stores. */
+    obj = make(rnd() % (2 * avLEN));
+    if (collections >= quietCollections)
+      for (i = 0; i < storesCOUNT; ++i)
+        store(oldRoots[rnd() % oldRootsCOUNT], obj);
+    i = rnd() % exactRootsCOUNT;
+    if (exactRoots[i] != objNULL)
+      store(exactRoots[i], obj);
+    i = rnd() % exactRootsCOUNT;
+    if (exactRoots[i] == objNULL || rnd() % 2 == 0)
+      exactRoots[i] = obj;
+    ++objs;
+  }
+  printf("\n%lu objects, %lu stores\n", objs, storeCount);
+
+  check();
+  mps_arena_park(arena);
+  mps_ap_destroy(ap);
+  mps_root_destroy(exactRoot);
+  mps_root_destroy(oldRoot);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_release(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  mps_thr_t thread;
+
+  testlib_init(argc, argv);
+
+  /* Without the keyword there is no card table. */
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  cards = mps_arena_cards(arena);
+  Insist(cards == NULL);
+  mps_message_type_enable(arena, mps_message_type_gc());
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  test(mps_class_amc(), protCOLLECTIONS);
+  printf("%lu write faults without card marking\n",
+         (unsigned long)writeFaults());
+  mps_thread_dereg(thread);
+  mps_arena_destroy(arena);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_CARD_MARKING, TRUE);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  cards = mps_arena_cards(arena);
+  Insist(cards != NULL);
+  mps_message_type_enable(arena, mps_message_type_gc());
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  test(mps_class_amc(), 20);
+  Insist(writeFaults() == 0);
+  test(mps_class_ams(), 10);
+  Insist(writeFaults() == 0);
+  mps_thread_dereg(thread);
+  mps_arena_destroy(arena);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -0,0 +1,218 @@
+/* chunkfix.c: CHUNK MAP FIX BENCHMARK
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Measure the rate at which references are fixed in arenas that have
+ * grown to different numbers of chunks, and check that the arena's
+ * chunk map agrees with its tree of chunks as chunks are added and
+ * removed.  See <design/arena/#chunk.map>.
+ *
+ * The heap is the same size each time, but the initial arena size is
+ * smaller, so that the arena has to extend itself more often.  The
+ * objects refer to other objects at random, so that the references
+ * point into all of the chunks.
+ */
+
+#include "mpm.h"
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscams.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define heapSIZE        ((size_t)16 << 20)
+#define objCOUNT        100000
+#define objSLOTS        8
+#define roundCOUNT      3
+
+static mps_gen_param_s testChain[1] = { { 1 << 20, 0.5 } };
+static size_t chunkSplit[] = { 1, 16, 64 };
+
+
+static mps_addr_t refs[objCOUNT];
+
+
+/* checkChunkMap -- check ChunkOfAddr against the tree of chunks */
+
+static void checkOne(Arena arena, Addr addr)
+{
+  Chunk chunk;
+  Tree tree;
+  Bool found, inTree;
+
+  found = ChunkOfAddr(&chunk, arena, addr);
+  inTree = TreeFind(&tree, ArenaChunkTree(arena), TreeKeyOfAddrVar(addr),
+                    ChunkCompare) == CompareEQUAL;
+  Insist(found == inTree);
+  if (found) {
+    Insist(chunk == ChunkOfTree(tree));
+  }
+}
+
+static void checkChunkMap(mps_arena_t mpsArena)
+{
+  Arena arena = (Arena)mpsArena;
+  Ring node, next;
+  size_t i;
+
+  RING_FOR(node, ArenaChunkRing(arena), next) {
+    Chunk chunk = RING_ELT(Chunk, arenaRing, node);
+    checkOne(arena, chunk->base);
+    checkOne(arena, AddrAdd(chunk->base, ChunkSize(chunk) / 2));
+    checkOne(arena, AddrSub(chunk->limit, 1));
+    checkOne(arena, AddrSub(chunk->base, 1));
+    checkOne(arena, chunk->limit);
+  }
+  for (i = 0; i < objCOUNT; i += 97) {
+    checkOne(arena, (Addr)refs[i]);
+    checkOne(arena, (Addr)((Word)refs[i] ^ ((Word)rnd() << 12)));
+  }
+}
+
+
+/* make -- create an object that refers to earlier objects at random */
+
+static mps_word_t make(mps_ap_t ap, size_t i)
+{
+  mps_word_t obj;
+  size_t j;
+
+  die(make_dylan_vector(&obj, ap, objSLOTS), "make_dylan_vector");
+  for (j = 0; j < objSLOTS; ++j)
+    DYLAN_VECTOR_SLOT(obj, j) =
+      i == 0 ? DYLAN_INT(j) : (mps_word_t)refs[rnd() % i];
+  return obj;
+}
+
+
+/* test -- time collections of the heap in an arena of a given size */
+
+static void test(size_t arenaSize)
+{
+  mps_arena_t arena;
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_pool_t pool;
+  mps_ap_t ap;
+  mps_root_t root;
+  mps_clock_t start;
+  size_t i, chunks;
+  double t;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, arenaSize);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  checkChunkMap(arena);
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, 1, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, mps_class_ams(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_root_create_table(&root, arena, mps_rank_exact(), 0,
+                            refs, objCOUNT),
+      "root_create_table");
+  die(mps_ap_create_k(&ap, pool, mps_args_none), "ap_create");
+
+  mps_arena_park(arena);
+  for (i = 0; i < objCOUNT; ++i)
+    refs[i] = (mps_addr_t)make(ap, i);
+  chunks = RingLength(ArenaChunkRing((Arena)arena));
+  checkChunkMap(arena);
+
+  start = mps_clock();
+  for (i = 0; i < roundCOUNT; ++i)
+    die(mps_arena_collect(arena), "arena_collect");
+  t = (double)(mps_clock() - start) / (double)mps_clocks_per_sec();
+  printf("%3lu chunks: %.1f million references fixed per second\n",
+         (unsigned long)chunks,
+         (double)objCOUNT * (objSLOTS + 1) * roundCOUNT / t / 1e6);
+
+  for (i = 0; i < objCOUNT; i += 97)
+    cdie(dylan_check(refs[i]), "dylan_check");
+  checkChunkMap(arena);
+
+  /* Drop everything, so that the collection can return the empty
+   * chunks to the operating system. */
+  mps_ap_destroy(ap);
+  for (i = 0; i < objCOUNT; ++i)
+    refs[i] = NULL;
+  mps_arena_spare_commit_limit_set(arena, 0);
+  die(mps_arena_collect(arena), "arena_collect");
+  Insist(RingLength(ArenaChunkRing((Arena)arena)) <= chunks);
+  checkChunkMap(arena);
+
+  mps_arena_park(arena);
+  mps_root_destroy(root);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  size_t i;
+
+  testlib_init(argc, argv);
+
+  for (i = 0; i < NELEMS(chunkSplit); ++i)
+    test(heapSIZE / chunkSplit[i]);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -317,6 +317,20 @@
 #define LIKELY(exp) ((exp) != 0)
 #endif
 
+/* PREFETCH -- start fetching memory that will be read soon
+ *
+ * A hint only: addr need not be valid, and the fetch cannot fault.
+ * Used by <code/poolams.c> to fetch the next run of objects while it
+ * scans the current one.  See
+ * <https://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html>.
+ */
+
+#if defined(MPS_BUILD_GC) || defined(MPS_BUILD_LL)
+#define PREFETCH(addr) __builtin_prefetch((const void *)(addr))
+#else
+#define PREFETCH(addr) DISCARD(addr)
+#endif
+
 
 /* EPVMDefaultSubsequentSegSIZE is a default for the alignment of
  * subsequent segments (non-initial at each save level) in EPVM.  See
@@ -350,11 +364,21 @@
 #define AMC_LARGE_SIZE_DEFAULT ((Size)32768)
 #define AMC_EXTEND_BY_DEFAULT  ((Size)8192)
 
+/* A pretenuring AMC allocation point moves to an older generation
+ * when at least AMC_PRETENURE_PROMOTE of the bytes it allocated
+ * survive, and back towards the generation it asked for when fewer
+ * than AMC_PRETENURE_DEMOTE survive, judging by a sample of at least
+ * AMC_PRETENURE_SAMPLE condemned bytes. See <code/poolamc.c#pretenure>. */
+#define AMC_PRETENURE_SAMPLE   ((Size)256 * 1024)
+#define AMC_PRETENURE_PROMOTE  (0.9)
+#define AMC_PRETENURE_DEMOTE   (0.5)
+
 
 /* Pool AMS Configuration -- see <code/poolams.c> */
 
 #define AMS_SUPPORT_AMBIGUOUS_DEFAULT TRUE
 #define AMS_GEN_DEFAULT       0
+#define AMS_EVACUATE_DEFAULT  0.0 /* don't evacuate */
 
 
 /* Pool AWL Configuration -- see <code/poolawl.c> */
@@ -393,6 +417,21 @@
 #define MVFF_ARENA_HIGH_DEFAULT  FALSE
 #define MVFF_FIRST_FIT_DEFAULT   TRUE
 #define MVFF_SPARE_DEFAULT       0.75
+#define MVFF_CACHES_DEFAULT      0
+#define MVFF_CACHES_MAX          64
+
+/* The caches in front of an MVFF pool (see <design/poolmvff/#design.cache>)
+ * hold blocks up to MVFF_CACHE_SIZE_MAX bytes, with at most
+ * MVFF_CACHE_DEPTH blocks of each size in each cache.  Blocks move
+ * between a cache and the free land MVFF_CACHE_BATCH at a time, which
+ * must be no more than MVFF_CACHE_DEPTH.  Threads whose stack
+ * addresses differ only below bit MVFF_CACHE_STACK_SHIFT share a
+ * cache. */
+
+#define MVFF_CACHE_SIZE_MAX      ((Size)256)
+#define MVFF_CACHE_DEPTH         ((Count)32)
+#define MVFF_CACHE_BATCH         ((Count)16)
+#define MVFF_CACHE_STACK_SHIFT   20
 
 
 /* Pool MVT Configuration -- see <code/poolmv2.c> */
@@ -406,6 +445,48 @@
 #define MVT_FRAG_LIMIT_DEFAULT    30
 
 
+/* Pool Generation Configuration -- see <code/locus.c> */
+
+/* POOL_GEN_RESERVE_SIZE is the largest address range that a pool
+ * generation reserves from the arena at once, to be carved into
+ * segments by PoolGenAlloc.  The reservation is also limited to the
+ * arena's stripe size, so that it does not spread the generation
+ * over many zones.  Only segments no larger than the reservation
+ * divided by POOL_GEN_RESERVE_SEGS are carved from it.  See
+ * <design/strategy/#alloc.reserve>. */
+#define POOL_GEN_RESERVE_SIZE ((Size)256 * 1024)
+#define POOL_GEN_RESERVE_SEGS ((Count)4)
+
+
+/* Chain Configuration -- see <design/strategy/#chain.adapt> */
+
+/* CHAIN_ADAPT_WEIGHT is the weight given to the mortality observed
+ * in each collection of an adaptive chain when updating the
+ * generation's mortality, which is kept between
+ * CHAIN_ADAPT_MORTALITY_MIN and CHAIN_ADAPT_MORTALITY_MAX. */
+
+#define CHAIN_ADAPT_WEIGHT        (0.5)
+#define CHAIN_ADAPT_MORTALITY_MIN (0.01)
+#define CHAIN_ADAPT_MORTALITY_MAX (0.99)
+
+/* An adaptive chain grows the capacity of a generation by a factor
+ * of CHAIN_ADAPT_STEP when its mortality is below
+ * CHAIN_ADAPT_MORTALITY_LOW, and by the smaller factor
+ * CHAIN_ADAPT_STEP_HIGH when its mortality is above
+ * CHAIN_ADAPT_MORTALITY_HIGH.  It shrinks it by CHAIN_ADAPT_STEP only
+ * when the longest pause during the collection exceeded the arena's
+ * pause time by a factor of CHAIN_ADAPT_PAUSE_SLACK.  The capacity
+ * stays within a factor of CHAIN_ADAPT_RANGE of the capacity the
+ * client asked for. */
+
+#define CHAIN_ADAPT_MORTALITY_LOW  (0.75)
+#define CHAIN_ADAPT_MORTALITY_HIGH (0.95)
+#define CHAIN_ADAPT_STEP_HIGH      (1.05)
+#define CHAIN_ADAPT_STEP           (1.25)
+#define CHAIN_ADAPT_PAUSE_SLACK    (4.0)
+#define CHAIN_ADAPT_RANGE          ((Size)16)
+
+
 /* Arena Configuration -- see <code/arena.c> */
 
 #define ArenaPollALLOCTIME (65536.0)
@@ -416,6 +497,16 @@
 
 #define ARENA_CLIENT_GRAIN_SIZE          ((Size)8192)
 
+/* ARENA_CHUNK_MAP_LENGTH is the number of entries in the arena's
+ * chunk map, and ARENA_CHUNK_MAP_SPLIT is log2 of the number of
+ * entries that the first chunk covers.  So the map spans 64 times
+ * the size of the first chunk before its entries are shared by more
+ * than one part of the address space.  See <design/arena/#chunk.map>.
+ */
+
+#define ARENA_CHUNK_MAP_LENGTH  1024
+#define ARENA_CHUNK_MAP_SPLIT   4
+
 #define ARENA_DEFAULT_COMMIT_LIMIT ((Size)-1)
 
 /* TODO: This should be proportional to the memory usage of the MPS, not
@@ -423,6 +514,25 @@
  * documentation changes. */
 #define ARENA_DEFAULT_SPARE_COMMIT_LIMIT   ((Size)10uL*1024uL*1024uL)
 
+/* ARENA_DEFAULT_SPARE_AGE is the time (in seconds) that a page may
+ * stay spare before it is purged by the poll.  Zero means that spare
+ * pages are only purged when there are too many of them.  Purging
+ * aged pages takes at most ARENA_SPARE_PURGE_TIME seconds (or the
+ * arena's pause time, if smaller) per poll, and unmaps at most
+ * ARENA_SPARE_PURGE_QUANTUM bytes between checks of the clock.  See
+ * <design/arena/#spare.age>. */
+
+#define ARENA_DEFAULT_SPARE_AGE (0.0)
+#define ARENA_SPARE_PURGE_TIME (0.001)
+#define ARENA_SPARE_PURGE_QUANTUM ((Size)1 << 20)
+
+/* ARENA_DEFAULT_NODES is the number of NUMA nodes that the arena
+ * spreads its memory over, and ARENA_NODE_MAX is the largest number
+ * that the client may ask for.  See <design/arena/#numa>. */
+
+#define ARENA_DEFAULT_NODES ((Count)1)
+#define ARENA_NODE_MAX ((Count)8)
+
 /* ARENA_DEFAULT_PAUSE_TIME is the maximum time (in seconds) that
  * operations within the arena may pause the mutator for.  The default
  * is set for typical human interaction.  See mps_arena_pause_time_set
@@ -432,6 +542,58 @@
 
 #define ARENA_DEFAULT_ZONED     TRUE
 
+/* ARENA_DEFAULT_GC_THREADS is the number of collector threads that
+ * scan grey segments in parallel with the thread that holds the arena
+ * lock.  Zero means that all scanning is done by that thread.  See
+ * <design/trace/#parallel>. */
+
+#define ARENA_DEFAULT_GC_THREADS ((Count)0)
+
+/* TRACE_PARALLEL_BATCH is the maximum number of grey segments that
+ * TraceAdvance scans in one parallel batch, and of thread roots that
+ * traceFlip scans in one batch.  The scan states for a batch live on
+ * the stack of the thread that holds the arena lock. */
+
+#define TRACE_PARALLEL_BATCH    ((Count)32)
+
+/* ARENA_DEFAULT_BACKGROUND says whether the arena runs a background
+ * collector thread.  ARENA_BACKGROUND_INTERVAL is the longest time
+ * (in seconds) that the background collector sleeps when it has no
+ * work to do, and ARENA_BACKGROUND_MULTIPLIER is the multiplier it
+ * passes to ArenaStep when it wakes.  ARENA_BACKGROUND_LAG is how
+ * many bytes the mutator may allocate since the background collector
+ * last finished a step before the mutator does the collection work
+ * itself.  See <design/arena/#background>. */
+
+#define ARENA_DEFAULT_BACKGROUND FALSE
+#define ARENA_BACKGROUND_INTERVAL (0.1)
+#define ARENA_BACKGROUND_MULTIPLIER (10.0)
+#define ARENA_BACKGROUND_LAG (4 * ArenaPollALLOCTIME)
+
+/* ARENA_DEFAULT_CARD_MARKING says whether the arena's write barrier
+ * is a card table marked by the client instead of memory protection.
+ * CARD_SHIFT is the logarithm of the card size in bytes, and
+ * CARD_TABLE_SIZE is the number of cards in the table, which must be
+ * a power of two.  Addresses that are CARD_TABLE_SIZE cards apart
+ * share a card.  See <design/write-barrier/#card>. */
+
+#define ARENA_DEFAULT_CARD_MARKING FALSE
+#define CARD_SHIFT              ((Shift)9)
+#define CARD_TABLE_SIZE         ((Count)1 << 18)
+
+/* ARENA_DEFAULT_USERFAULTFD says whether the arena detects writes to
+ * write-protected segments using userfaultfd(2) instead of a signal
+ * handler.  Only supported on Linux.  See <design/prot/#uffd>. */
+
+#define ARENA_DEFAULT_USERFAULTFD FALSE
+
+/* ARENA_DEFAULT_SAFEPOINTS says whether the arena suspends threads
+ * cooperatively, by waiting for them to reach safepoints, instead of
+ * by signals.  Only supported with POSIX threads.  See
+ * <design/thread-manager/#safepoint>. */
+
+#define ARENA_DEFAULT_SAFEPOINTS FALSE
+
 /* ARENA_MINIMUM_COLLECTABLE_SIZE is the minimum size (in bytes) of
  * collectable memory that might be considered worthwhile to run a
  * full garbage collection. */
@@ -472,6 +634,7 @@
   FALSE,               /* high */ \
   ArenaDefaultZONESET, /* zoneSet */ \
   ZoneSetEMPTY,        /* avoid */ \
+  LocusNodeANY,        /* node */ \
 }
 
 #define LDHistoryLENGTH ((Size)4)
@@ -482,6 +645,31 @@
 #define VM_ARENA_SIZE_DEFAULT ((Size)1 << 28)
 
 
+/* Policy Configuration -- see <design/strategy/#policy.class> */
+
+/* POLICY_PAUSE_BUCKETS is the number of buckets in the histogram of
+ * pause times kept by every policy.  There are four buckets to each
+ * doubling of the pause in nanoseconds, so this covers pauses of up
+ * to about twenty minutes. */
+
+#define POLICY_PAUSE_BUCKETS    ((Count)160)
+
+/* POLICY_PAUSE_QUANTILE is the fraction of pauses that the
+ * pause-target policy tries to keep within the pause time, and
+ * POLICY_PAUSE_STEP is the least fraction by which it cuts its slice
+ * of the pause time after each pause that exceeds the pause time.
+ * See <code/policypt.c#slice>. */
+
+#define POLICY_PAUSE_QUANTILE   (0.99)
+#define POLICY_PAUSE_STEP       (0.1)
+
+/* POLICY_PAUSE_MIN_SLICE is the smallest fraction of the pause time
+ * to which the pause-target policy will cut the time it spends
+ * working in each poll. */
+
+#define POLICY_PAUSE_MIN_SLICE  (1.0 / 16.0)
+
+
 /* Stack configuration -- see <code/sp*.c> */
 
 /* Currently StackProbe has a useful implementation only on Windows. */
@@ -493,6 +681,15 @@
 #endif
 
 
+/* Root Configuration -- see <design/root/#incremental> */
+
+/* Exact protectable area roots at least RootIncrementalSIZE bytes
+ * long are scanned after the flip, RootIncrementalCHUNK bytes at a
+ * time. */
+#define RootIncrementalSIZE   ((Size)1 << 20)
+#define RootIncrementalCHUNK  ((Size)64 << 10)
+
+
 /* Shield Configuration -- see <code/shield.c> */
 
 #define ShieldQueueLENGTH  512  /* initial length of shield queue */
@@ -504,6 +701,7 @@
 #define VMAN_PAGE_SIZE ((Align)4096)
 #define VMJunkBYTE ((unsigned char)0xA9)
 #define VMParamSize (sizeof(Word))
+#define VMHugePageSIZE ((Align)2 << 20) /* see <code/vmix.c#huge> */
 
 
 /* .feature.li: Linux feature specification
@@ -518,8 +716,11 @@
  * prmci3li.c  REG_EAX etc.              <ucontext.h>  _GNU_SOURCE
  * prmci6li.c  REG_RAX etc.              <ucontext.h>  _GNU_SOURCE
  * prmcix.h    stack_t, siginfo_t        <signal.h>    _XOPEN_SOURCE
+ * protufli.c  syscall                   <unistd.h>    _GNU_SOURCE
  * pthrdext.c  sigaction etc.            <signal.h>    _XOPEN_SOURCE
+ * thix.c      getcontext                <ucontext.h>  _XOPEN_SOURCE
  * vmix.c      MAP_ANON                  <sys/mman.h>  _GNU_SOURCE
+ * vmix.c      syscall                   <unistd.h>    _GNU_SOURCE
  *
  * It is not possible to localize these feature specifications around
  * the individual headers: all headers share a common set of features
@@ -614,7 +815,9 @@
 
 /* Tracer Configuration -- see <code/trace.c> */
 
-#define TraceLIMIT ((size_t)1)
+/* Two traces, so that a chain can be collected while a collection of
+ * the world is in progress.  See <design/trace/#instance.limit>. */
+#define TraceLIMIT ((size_t)2)
 /* I count 4 function calls to scan, 10 to copy. */
 #define TraceCopyScanRATIO (1.5)
 
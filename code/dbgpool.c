@@ -779,6 +779,14 @@ void PoolClassMixInDebug(PoolClass klass)
   klass->finish = DebugPoolFinish;
   klass->alloc = DebugPoolAlloc;
   klass->free = DebugPoolFree;
+  /* Go through the debug alloc and free methods one block at a time. */
+  klass->bulkAlloc = PoolAbsBulkAlloc;
+  klass->bulkFree = PoolAbsBulkFree;
+  /* Fenceposts and free space checking need the arena lock. */
+  klass->tryAlloc = PoolTrivTryAlloc;
+  klass->tryFree = PoolTrivTryFree;
+  klass->cacheAlloc = PoolTrivTryAlloc;
+  klass->cacheFree = PoolTrivTryFree;
 }
 
 
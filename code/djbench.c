@@ -37,6 +37,8 @@
 
 static mps_arena_t arena;
 static mps_pool_t pool;
+static mps_bool_t sacked = FALSE; /* each thread allocates via a SAC */
+static mps_bool_t cached = FALSE; /* pool has caches in front of it */
 
 
 /* The benchmark behaviour is defined as a macro in order to give realistic
@@ -55,9 +57,34 @@ static unsigned rmax = 10;        /* maximum recursion depth */
 static mps_bool_t zoned = TRUE;   /* arena allocates using zones */
 static size_t arena_size = 256ul * 1024 * 1024; /* arena size */
 static size_t arena_grain_size = 1; /* arena grain size */
+static size_t ncaches = 16;       /* caches for MVFF with caches */
+
+
+/* sac_create -- create a segregated allocation cache on the pool
+ *
+ * The classes double in size from two alignment units, so that the
+ * smaller blocks allocated by the benchmark come from the cache and
+ * the larger ones go to the pool.
+ */
+
+static mps_sac_t sac_create(void)
+{
+  mps_sac_class_s classes[MPS_SAC_CLASS_LIMIT];
+  mps_sac_t sac;
+  size_t i;
+
+  for (i = 0; i < NELEMS(classes); ++i) {
+    classes[i].mps_block_size = (size_t)MPS_PF_ALIGN << (i + 1);
+    classes[i].mps_cached_count = 64 >> (i / 2);
+    classes[i].mps_frequency = 1;
+  }
+  DJMUST(mps_sac_create(&sac, pool, NELEMS(classes), classes));
+  return sac;
+}
 
 #define DJRUN(fname, alloc, free) \
-  static unsigned fname##_inner(mps_ap_t ap, unsigned depth, unsigned r) { \
+  static unsigned fname##_inner(mps_ap_t ap, mps_sac_t sac, \
+                                unsigned depth, unsigned r) { \
     struct {void *p; size_t s;} *blocks = alloca(sizeof(blocks[0]) * nblocks); \
     unsigned j, k; \
     \
@@ -84,7 +111,7 @@ static size_t arena_grain_size = 1; /* arena grain size */
       } \
       if (rinter > 0 && depth > 0 && ++r % rinter == 0) { \
         /* putchar('>'); fflush(stdout); */ \
-        r = fname##_inner(ap, depth - 1, r); \
+        r = fname##_inner(ap, sac, depth - 1, r); \
         /* putchar('<'); fflush(stdout); */ \
       } \
     } \
@@ -101,10 +128,15 @@ static size_t arena_grain_size = 1; /* arena grain size */
   static void *fname(void *p) { \
     unsigned i; \
     mps_ap_t ap = NULL; \
+    mps_sac_t sac = NULL; \
     if (pool != NULL) \
       DJMUST(mps_ap_create_k(&ap, pool, mps_args_none)); \
+    if (sacked) \
+      sac = sac_create(); \
     for (i = 0; i < niter; ++i) \
-      (void)fname##_inner(ap, rmax, 0); \
+      (void)fname##_inner(ap, sac, rmax, 0); \
+    if (sac != NULL) \
+      mps_sac_destroy(sac); \
     if (ap != NULL) \
       mps_ap_destroy(ap); \
     return p; \
@@ -140,6 +172,25 @@ DJRUN(dj_alloc, MPS_ALLOC, MPS_FREE)
 
 DJRUN(dj_reserve, RESERVE_ALLOC, RESERVE_FREE)
 
+
+/* mps_sac_alloc/mps_sac_free benchmark */
+
+#define SAC_ALLOC(p, s) \
+  do { \
+    size_t _s = ALIGN_UP(s, (size_t)MPS_PF_ALIGN); \
+    mps_res_t _res; \
+    MPS_SAC_ALLOC_FAST(_res, p, sac, _s, FALSE); \
+    if (_res != MPS_RES_OK) \
+      p = NULL; \
+  } while(0)
+#define SAC_FREE(p, s) \
+  do { \
+    size_t _s = ALIGN_UP(s, (size_t)MPS_PF_ALIGN); \
+    MPS_SAC_FREE_FAST(sac, p, _s); \
+  } while(0)
+
+DJRUN(dj_sac, SAC_ALLOC, SAC_FREE)
+
 typedef void *(*dj_t)(void *);
 
 static void weave(dj_t dj)
@@ -190,13 +241,38 @@ static void arena_wrap(dj_t dj, mps_pool_class_t pool_class, const char *name)
     MPS_ARGS_ADD(args, MPS_KEY_ARENA_ZONED, zoned);
     DJMUST(mps_arena_create_k(&arena, mps_arena_class_vm(), args));
   } MPS_ARGS_END(args);
-  DJMUST(mps_pool_create_k(&pool, arena, pool_class, mps_args_none));
+  MPS_ARGS_BEGIN(args) {
+    if (cached)
+      MPS_ARGS_ADD(args, MPS_KEY_MVFF_CACHES, ncaches);
+    DJMUST(mps_pool_create_k(&pool, arena, pool_class, args));
+  } MPS_ARGS_END(args);
   watch(dj, name);
   mps_pool_destroy(pool);
   mps_arena_destroy(arena);
 }
 
 
+/* Wrap a call to a dj benchmark that allocates via a SAC in each thread */
+
+static void sac_wrap(dj_t dj, mps_pool_class_t pool_class, const char *name)
+{
+  sacked = TRUE;
+  arena_wrap(dj, pool_class, name);
+  sacked = FALSE;
+}
+
+
+/* Wrap a call to a dj benchmark on an MVFF pool with caches, which
+   are shared by all the threads.  See <design/poolmvff/#design.cache>. */
+
+static void cache_wrap(dj_t dj, mps_pool_class_t pool_class, const char *name)
+{
+  cached = TRUE;
+  arena_wrap(dj, pool_class, name);
+  cached = FALSE;
+}
+
+
 /* Command-line options definitions.  See getopt_long(3). */
 
 static struct option longopts[] = {
@@ -213,6 +289,7 @@ static struct option longopts[] = {
   {"arena-size",       required_argument, NULL, 'm'},
   {"arena-grain-size", required_argument, NULL, 'a'},
   {"arena-unzoned",    no_argument,       NULL, 'z'},
+  {"caches",           required_argument, NULL, 'k'},
   {NULL,               0,                 NULL, 0  }
 };
 
@@ -232,6 +309,9 @@ static struct {
 } pools[] = {
   {"mvt",   arena_wrap, dj_reserve, mps_class_mvt},
   {"mvff",  arena_wrap, dj_reserve, mps_class_mvff},
+  {"mvffs", sac_wrap,   dj_sac,     mps_class_mvff}, /* mvff with SACs */
+  {"mvffa", arena_wrap, dj_alloc,   mps_class_mvff}, /* mvff with mps_alloc */
+  {"mvffc", cache_wrap, dj_alloc,   mps_class_mvff}, /* mvff with caches */
   {"mv",    arena_wrap, dj_alloc,   mps_class_mv},
   {"mvb",   arena_wrap, dj_reserve, mps_class_mv}, /* mv with buffers */
   {"an",    wrap,       dj_malloc,  dummy_class},
@@ -247,7 +327,7 @@ int main(int argc, char *argv[]) {
 
   seed = rnd_seed();
   
-  while ((ch = getopt_long(argc, argv, "ht:i:p:b:s:c:r:d:m:a:x:z", longopts, NULL)) != -1)
+  while ((ch = getopt_long(argc, argv, "ht:i:p:b:s:c:r:d:m:a:x:zk:", longopts, NULL)) != -1)
     switch (ch) {
     case 't':
       nthreads = (unsigned)strtoul(optarg, NULL, 10);
@@ -280,6 +360,9 @@ int main(int argc, char *argv[]) {
     case 'z':
       zoned = FALSE;
       break;
+    case 'k':
+      ncaches = (size_t)strtoul(optarg, NULL, 10);
+      break;
     case 'm': {
         char *p;
         arena_size = (unsigned)strtoul(optarg, &p, 10);
@@ -346,15 +429,22 @@ int main(int argc, char *argv[]) {
               "    Random number seed (default from entropy).\n"
               "  -z, --arena-unzoned\n"
               "    Disabled zoned allocation in the arena\n"
+              "  -k n, --caches=n\n"
+              "    Number of caches for test mvffc (default %lu).\n",
+              pact,
+              rinter,
+              rmax,
+              (unsigned long)ncaches);
+      fprintf(stderr,
               "Tests:\n"
               "  mvt   pool class MVT\n"
               "  mvff  pool class MVFF\n"
+              "  mvffs pool class MVFF with segregated allocation caches\n"
+              "  mvffa pool class MVFF with mps_alloc\n"
+              "  mvffc pool class MVFF with mps_alloc and caches\n"
               "  mv    pool class MV\n"
               "  mvb   pool class MV with buffers\n"
-              "  an    malloc\n",
-              pact,
-              rinter,
-              rmax);
+              "  an    malloc\n");
       return EXIT_FAILURE;
     }
   argc -= optind;
@@ -37,7 +37,7 @@
 
 #define EVENT_VERSION_MAJOR  ((unsigned)1)
 #define EVENT_VERSION_MEDIAN ((unsigned)6)
-#define EVENT_VERSION_MINOR  ((unsigned)0)
+#define EVENT_VERSION_MINOR  ((unsigned)7)
 
 
 /* EVENT_LIST -- list of event types and general properties
@@ -67,7 +67,7 @@
  */
  
 #define EventNameMAX ((size_t)19)
-#define EventCodeMAX ((EventCode)0x0087)
+#define EventCodeMAX ((EventCode)0x008F)
 
 #define EVENT_LIST(EVENT, X) \
   /*       0123456789012345678 <- don't exceed without changing EventNameMAX */ \
@@ -193,7 +193,15 @@
   EVENT(X, ArenaGenZoneAdd    , 0x0084,  TRUE, Arena) \
   EVENT(X, ArenaUseFreeZone   , 0x0085,  TRUE, Arena) \
   /* EVENT(X, ArenaBlacklistZone , 0x0086,  TRUE, Arena) */ \
-  EVENT(X, PauseTimeSet       , 0x0087,  TRUE, Arena)
+  EVENT(X, PauseTimeSet       , 0x0087,  TRUE, Arena) \
+  EVENT(X, ShieldFlush        , 0x0088,  TRUE, Arena) \
+  EVENT(X, ChainAdapt         , 0x0089,  TRUE, Trace) \
+  EVENT(X, AMCPretenure       , 0x008A,  TRUE, Pool) \
+  EVENT(X, ThreadSuspend      , 0x008B,  TRUE, Arena) \
+  EVENT(X, ThreadResume       , 0x008C,  TRUE, Arena) \
+  EVENT(X, TraceStatNailed    , 0x008D,  TRUE, Trace) \
+  EVENT(X, SparePurge         , 0x008E,  TRUE, Arena) \
+  EVENT(X, RootDefer          , 0x008F,  TRUE, Trace)
 
 
 /* Remember to update EventNameMAX and EventCodeMAX above! 
@@ -475,6 +483,11 @@
   PARAM(X,  1, W, reclaimCount) \
   PARAM(X,  2, W, reclaimSize)
 
+#define EVENT_TraceStatNailed_PARAMS(PARAM, X) \
+  PARAM(X,  0, P, trace) \
+  PARAM(X,  1, W, nailedSegSize)   /* bytes in nailed segs reclaimed */ \
+  PARAM(X,  2, W, nailedFreedSize) /* bytes of those freed */
+
 #define EVENT_PoolInitMVFF_PARAMS(PARAM, X) \
   PARAM(X,  0, P, pool) \
   PARAM(X,  1, P, arena) \
@@ -731,6 +744,49 @@
   PARAM(X,  0, P, arena)        /* the arena */ \
   PARAM(X,  1, D, pauseTime)    /* the new maximum pause time, in seconds */
 
+#define EVENT_ShieldFlush_PARAMS(PARAM, X) \
+  PARAM(X,  0, P, shield)       /* the shield */ \
+  PARAM(X,  1, W, segs)         /* segments whose protection was synced */ \
+  PARAM(X,  2, W, calls)        /* protection calls made to sync them */
+
+#define EVENT_ChainAdapt_PARAMS(PARAM, X) \
+  PARAM(X,  0, P, chain)        /* the adaptive chain */ \
+  PARAM(X,  1, W, gen)          /* index of the generation in the chain */ \
+  PARAM(X,  2, W, capacity)     /* new capacity of generation, in kB */ \
+  PARAM(X,  3, D, mortality)    /* new mortality of generation */ \
+  PARAM(X,  4, D, observed)     /* mortality observed in the collection */ \
+  PARAM(X,  5, D, pauseMax)     /* longest pause in collection, in seconds */
+
+#define EVENT_AMCPretenure_PARAMS(PARAM, X) \
+  PARAM(X,  0, P, pool)         /* the AMC pool */ \
+  PARAM(X,  1, P, buffer)       /* the allocation point's buffer */ \
+  PARAM(X,  2, W, gen)          /* generation it now allocates into */ \
+  PARAM(X,  3, D, survival)     /* fraction of its objects that survived */ \
+  PARAM(X,  4, W, copySaved)    /* estimated bytes not copied so far */
+
+#define EVENT_ThreadSuspend_PARAMS(PARAM, X) \
+  PARAM(X,  0, P, arena)        /* the arena */ \
+  PARAM(X,  1, W, threads)      /* threads suspended */ \
+  PARAM(X,  2, W, signalled)    /* threads sent a suspend signal */ \
+  PARAM(X,  3, D, signal)       /* time spent signalling, in seconds */ \
+  PARAM(X,  4, D, wait)         /* time spent awaiting handshakes */
+
+#define EVENT_ThreadResume_PARAMS(PARAM, X) \
+  PARAM(X,  0, P, arena)        /* the arena */ \
+  PARAM(X,  1, W, threads)      /* threads resumed */ \
+  PARAM(X,  2, D, resume)       /* time spent resuming, in seconds */
+
+#define EVENT_SparePurge_PARAMS(PARAM, X) \
+  PARAM(X,  0, P, arena)        /* the arena */ \
+  PARAM(X,  1, W, purged)       /* bytes of spare memory unmapped */ \
+  PARAM(X,  2, B, aged)         /* purged by age, not by limit? */ \
+  PARAM(X,  3, D, time)         /* time spent purging, in seconds */
+
+#define EVENT_RootDefer_PARAMS(PARAM, X) \
+  PARAM(X,  0, P, root)         /* the root */ \
+  PARAM(X,  1, P, trace)        /* the trace that flipped */ \
+  PARAM(X,  2, W, chunkCount)   /* chunks to scan after the flip */
+
 
 #endif /* eventdef_h */
 
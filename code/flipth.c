@@ -0,0 +1,237 @@
+/* flipth.c: MANY-THREAD FLIP TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Register hundreds of threads, each keeping objects alive from its
+ * stack, and time the flips of full collections with and without
+ * collector threads to scan the stacks in parallel.  Check that the
+ * objects survive.  See <design/trace/#parallel.flip>.  The flip
+ * suspends all the threads as one batch (see
+ * <design/pthreadext/#impl.batch>).
+ *
+ * The threads are created in a chain, each one waiting for the next
+ * to finish, and the last one measures the flips.  This keeps the
+ * others blocked without needing any synchronization primitives.
+ */
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "testthr.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define testArenaSIZE   ((size_t)64 << 20)
+#define threadCOUNT     300
+#define slotCOUNT       512   /* words in each thread's stack frame */
+#define refEVERY        8     /* one slot in refEVERY is a reference */
+#define objSLOTS        4
+#define flipCOUNT       8
+#define genCOUNT        2
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 1024, 0.9 }, { 2048, 0.5 } };
+
+
+static mps_arena_t arena;
+static mps_pool_t pool;
+static double flipMean, flipMax;
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(mps_ap_t ap)
+{
+  size_t size = (objSLOTS + 2) * sizeof(mps_word_t);
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, NULL, 0);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+/* measure -- time the flips of some full collections */
+
+static void measure(void)
+{
+  size_t i;
+  double total = 0.0;
+
+  flipMax = 0.0;
+  for (i = 0; i < flipCOUNT; ++i) {
+    mps_clock_t start;
+    double t;
+
+    mps_arena_park(arena);
+    start = mps_clock();
+    die(mps_arena_start_collect(arena), "start_collect");
+    t = (double)(mps_clock() - start) / (double)mps_clocks_per_sec();
+    total += t;
+    if (t > flipMax)
+      flipMax = t;
+  }
+  mps_arena_park(arena);
+  flipMean = total / flipCOUNT;
+}
+
+
+/* kid -- register a thread and fill its stack with references
+ *
+ * Every slot that isn't a reference holds an odd integer, so that it
+ * is rejected by the zone test (or fails to be in the arena).
+ */
+
+static void *kid(void *arg);
+
+ATTRIBUTE_NOINLINE
+static void kidBody(size_t i, void *marker)
+{
+  mps_thr_t thread;
+  mps_root_t root;
+  mps_ap_t ap;
+  volatile mps_word_t slots[slotCOUNT];
+  size_t j;
+
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  die(mps_root_create_thread(&root, arena, thread, marker),
+      "root_create_thread");
+  die(mps_ap_create_k(&ap, pool, mps_args_none), "ap_create");
+  for (j = 0; j < slotCOUNT; ++j)
+    if (j % refEVERY == 0)
+      slots[j] = (mps_word_t)make(ap);
+    else
+      slots[j] = (mps_word_t)(i * slotCOUNT + j) * 2 + 1;
+  mps_ap_destroy(ap);
+
+  if (i + 1 < threadCOUNT) {
+    testthr_t next;
+    testthr_create(&next, kid, (void *)(i + 1));
+    testthr_join(&next, NULL);
+  } else {
+    measure();
+  }
+
+  for (j = 0; j < slotCOUNT; j += refEVERY)
+    cdie(dylan_check((mps_addr_t)slots[j]), "stack check");
+
+  mps_root_destroy(root);
+  mps_thread_dereg(thread);
+}
+
+static void *kid(void *arg)
+{
+  void *marker = &marker;
+  kidBody((size_t)arg, marker);
+  return NULL;
+}
+
+
+/* test -- run the chain of threads in an arena with gcThreads
+ * collector threads */
+
+static void test(size_t gcThreads)
+{
+  mps_fmt_t format;
+  mps_chain_t chain;
+  testthr_t first;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_GC_THREADS, gcThreads);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, mps_class_amc(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+
+  testthr_create(&first, kid, (void *)0);
+  testthr_join(&first, NULL);
+
+  printf("%d threads, %lu collector threads: "
+         "flip mean %.3fms, max %.3fms\n",
+         threadCOUNT, (unsigned long)gcThreads,
+         flipMean * 1e3, flipMax * 1e3);
+
+  mps_arena_park(arena);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  testlib_init(argc, argv);
+
+  test(0);
+  test(4);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
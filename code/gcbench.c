@@ -56,6 +56,13 @@ static size_t arena_grain_size = 1; /* arena grain size */
 static unsigned pinleaf = FALSE;  /* are leaf objects pinned at start */
 static mps_bool_t zoned = TRUE;   /* arena allocates using zones */
 static double pause_time = ARENA_DEFAULT_PAUSE_TIME; /* maximum pause time */
+static size_t gc_threads = ARENA_DEFAULT_GC_THREADS; /* collector threads */
+static mps_bool_t background = ARENA_DEFAULT_BACKGROUND; /* background collector */
+static mps_bool_t huge_pages = FALSE; /* map arena with huge pages */
+static mps_bool_t userfaultfd = FALSE; /* write barrier using userfaultfd */
+static const char *policy = "heuristic"; /* collection policy */
+static size_t heap_max = 0;       /* maximum heap size for policy */
+static mps_bool_t pause_stats = FALSE; /* report pause distribution */
 
 typedef struct gcthread_s *gcthread_t;
 
@@ -211,6 +218,23 @@ static void weave1(gcthread_fn_t fn)
 }
 
 
+/* report_pauses -- report the distribution of pauses
+ *
+ * The pauses are measured by the arena's policy; see
+ * <design/strategy/#policy.pause>.
+ */
+
+static void report_pauses(const char *name)
+{
+  Policy p = ArenaPolicy((Arena)arena);
+  printf("%s: %s pauses %lu p50 %g p90 %g p99 %g p99.9 %g max %g\n",
+         name, policy, (unsigned long)PolicyPauseCount(p),
+         PolicyPauseQuantile(p, 0.5), PolicyPauseQuantile(p, 0.9),
+         PolicyPauseQuantile(p, 0.99), PolicyPauseQuantile(p, 0.999),
+         PolicyPauseQuantile(p, 1.0));
+}
+
+
 static void watch(gcthread_fn_t fn, const char *name)
 {
   clock_t begin, end;
@@ -223,6 +247,8 @@ static void watch(gcthread_fn_t fn, const char *name)
   end = clock();
   
   printf("%s: %g\n", name, (double)(end - begin) / CLOCKS_PER_SEC);
+  if (pause_stats)
+    report_pauses(name);
 }
 
 
@@ -237,6 +263,16 @@ static void arena_setup(gcthread_fn_t fn,
     MPS_ARGS_ADD(args, MPS_KEY_ARENA_GRAIN_SIZE, arena_grain_size);
     MPS_ARGS_ADD(args, MPS_KEY_ARENA_ZONED, zoned);
     MPS_ARGS_ADD(args, MPS_KEY_PAUSE_TIME, pause_time);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_GC_THREADS, gc_threads);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_BACKGROUND, background);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_HUGE_PAGES, huge_pages);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_USERFAULTFD, userfaultfd);
+    if (strcmp(policy, "pause") == 0)
+      MPS_ARGS_ADD(args, MPS_KEY_ARENA_POLICY, mps_policy_class_pause());
+    else
+      MPS_ARGS_ADD(args, MPS_KEY_ARENA_POLICY, mps_policy_class_heuristic());
+    if (heap_max > 0)
+      MPS_ARGS_ADD(args, MPS_KEY_POLICY_HEAP_MAX, heap_max);
     RESMUST(mps_arena_create_k(&arena, mps_arena_class_vm(), args));
   } MPS_ARGS_END(args);
   RESMUST(dylan_fmt(&format, arena));
@@ -279,6 +315,13 @@ static struct option longopts[] = {
   {"seed",             required_argument, NULL, 'x'},
   {"arena-unzoned",    no_argument,       NULL, 'z'},
   {"pause-time",       required_argument, NULL, 'P'},
+  {"gc-threads",       required_argument, NULL, 'T'},
+  {"background",       no_argument,       NULL, 'B'},
+  {"huge-pages",       no_argument,       NULL, 'H'},
+  {"userfaultfd",      no_argument,       NULL, 'U'},
+  {"policy",           required_argument, NULL, 'y'},
+  {"heap-max",         required_argument, NULL, 'X'},
+  {"pause-stats",      no_argument,       NULL, 's'},
   {NULL,               0,                 NULL, 0  }
 };
 
@@ -302,7 +345,7 @@ int main(int argc, char *argv[]) {
 
   seed = rnd_seed();
   
-  while ((ch = getopt_long(argc, argv, "ht:i:p:g:m:a:w:d:r:u:lx:zP:",
+  while ((ch = getopt_long(argc, argv, "ht:i:p:g:m:a:w:d:r:u:lx:zP:T:BHUy:X:s",
                            longopts, NULL)) != -1)
     switch (ch) {
     case 't':
@@ -396,6 +439,42 @@ int main(int argc, char *argv[]) {
     case 'P':
       pause_time = strtod(optarg, NULL);
       break;
+    case 'T':
+      gc_threads = (size_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'B':
+      background = TRUE;
+      break;
+    case 'H':
+      huge_pages = TRUE;
+      break;
+    case 'U':
+      userfaultfd = TRUE;
+      break;
+    case 'y':
+      if (strcmp(optarg, "heuristic") != 0 && strcmp(optarg, "pause") != 0) {
+        fprintf(stderr, "Bad policy %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      policy = optarg;
+      break;
+    case 'X': {
+        char *p;
+        heap_max = (size_t)strtoul(optarg, &p, 10);
+        switch(toupper(*p)) {
+        case 'G': heap_max <<= 30; break;
+        case 'M': heap_max <<= 20; break;
+        case 'K': heap_max <<= 10; break;
+        case '\0': break;
+        default:
+          fprintf(stderr, "Bad heap size %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+      }
+      break;
+    case 's':
+      pause_stats = TRUE;
+      break;
     default:
       /* This is printed in parts to keep within the 509 character
          limit for string literals in portable standard C. */
@@ -443,10 +522,26 @@ int main(int argc, char *argv[]) {
               "    Disable zoned allocation in the arena\n"
               "  -P t, --pause-time\n"
               "    Maximum pause time in seconds (default %f) \n"
+              "  -T n, --gc-threads=n\n"
+              "    Scan grey segments on n collector threads (default %lu)\n"
+              "  -B, --background\n"
+              "    Collect on a background thread\n",
+              pause_time,
+              (unsigned long)gc_threads);
+      fprintf(stderr,
+              "  -H, --huge-pages\n"
+              "    Map the arena using huge pages\n"
+              "  -U, --userfaultfd\n"
+              "    Detect write barrier hits using userfaultfd (Linux)\n"
+              "  -y p, --policy=p\n"
+              "    Collection policy: heuristic (default) or pause\n"
+              "  -X n, --heap-max=n[KMG]?\n"
+              "    Maximum heap size for the pause policy\n"
+              "  -s, --pause-stats\n"
+              "    Report the distribution of pauses\n"
               "Tests:\n"
               "  amc   pool class AMC\n"
-              "  ams   pool class AMS\n",
-              pause_time);
+              "  ams   pool class AMS\n");
       return EXIT_FAILURE;
     }
   argc -= optind;
@@ -38,6 +38,9 @@ static RingStruct arenaRing;       /* <design/arena/#static.ring> */
 static Serial arenaSerial;         /* <design/arena/#static.serial> */
 
 
+static Bool arenaBackgroundStep(void *closure);
+
+
 /* arenaClaimRingLock, arenaReleaseRingLock -- lock/release the arena ring
  *
  * See <design/arena/#static.ring.lock>.  */
@@ -133,6 +136,7 @@ Bool GlobalsCheck(Globals arenaGlobals)
   CHECKL(BoolCheck(arenaGlobals->bufferLogging));
   CHECKD_NOSIG(Ring, &arenaGlobals->poolRing);
   CHECKD_NOSIG(Ring, &arenaGlobals->rootRing);
+  CHECKD_NOSIG(Ring, &arenaGlobals->rootGreyRing);
   CHECKD_NOSIG(Ring, &arenaGlobals->rememberedSummaryRing);
   CHECKL(arenaGlobals->rememberedSummaryIndex < RememberedSummaryBLOCK);
   /* <code/global.c#remembered.summary> RingIsSingle imples index == 0 */
@@ -191,6 +195,25 @@ Bool GlobalsCheck(Globals arenaGlobals)
   /* .emergency.invariant: There can only be an emergency when a trace
    * is busy. */
   CHECKL(!arena->emergency || arena->busyTraces != TraceSetEMPTY);
+
+  /* <design/trace/#parallel> */
+  CHECKL((arena->workers == NULL) == (arena->fixLock == NULL));
+  if (arena->workers != NULL) {
+    CHECKL(arena->gcThreads > 0);
+    CHECKL(WorkersCheck(arena->workers));
+    CHECKL(LockCheck(arena->fixLock));
+  }
+  /* <design/arena/#background> */
+  if (arena->daemon != NULL) {
+    CHECKL(arena->background);
+    CHECKL(DaemonCheck(arena->daemon));
+  }
+  CHECKL(CardsCheck(arena));
+  /* <design/prot/#uffd> */
+  if (arena->uffd != NULL) {
+    CHECKL(arena->userfaultfd);
+    CHECKL(ProtUffdCheck(arena->uffd));
+  }
   
   if (arenaGlobals->defaultChain != NULL)
     CHECKD(Chain, arenaGlobals->defaultChain);
@@ -242,12 +265,14 @@ Res GlobalsInit(Globals arenaGlobals)
   arenaGlobals->allocMutatorSize = 0.0;
   arenaGlobals->fillInternalSize = 0.0;
   arenaGlobals->emptyInternalSize = 0.0;
+  arenaGlobals->backgroundFillSize = 0.0;
 
   arenaGlobals->mpsVersionString = MPSVersion();
   arenaGlobals->bufferLogging = FALSE;
   RingInit(&arenaGlobals->poolRing);
   arenaGlobals->poolSerial = (Serial)0;
   RingInit(&arenaGlobals->rootRing);
+  RingInit(&arenaGlobals->rootGreyRing);
   arenaGlobals->rootSerial = (Serial)0;
   RingInit(&arenaGlobals->rememberedSummaryRing);
   arenaGlobals->rememberedSummaryIndex = 0;
@@ -267,6 +292,13 @@ Res GlobalsInit(Globals arenaGlobals)
   arena->tracedWork = 0.0;
   arena->tracedTime = 0.0;
   arena->lastWorldCollect = ClockNow();
+  arena->workers = NULL;
+  arena->fixLock = NULL;
+  arena->daemon = NULL;
+  arena->uffd = NULL;
+  arena->cardsStruct._table = NULL;
+  arena->cardsStruct._shift = 0;
+  arena->cardsStruct._mask = 0;
   ShieldInit(ArenaShield(arena));
 
   for (ti = 0; ti < TraceLIMIT; ++ti) {
@@ -332,6 +364,13 @@ Res GlobalsCompleteCreate(Globals arenaGlobals)
       return res;
   TRACE_SET_ITER_END(ti, trace, TraceSetUNIV, arena);
 
+  /* <design/thread-manager/#safepoint> */
+  if (arena->safepoints) {
+    res = ThreadSafepointsEnable(arena);
+    if (res != ResOK)
+      return res;
+  }
+
   res = ControlAlloc(&p, arena, LockSize());
   if (res != ResOK)
     return res;
@@ -340,15 +379,96 @@ Res GlobalsCompleteCreate(Globals arenaGlobals)
 
   {
     GenParamStruct params[] = ChainDEFAULT;
-    res = ChainCreate(&arenaGlobals->defaultChain, arena, NELEMS(params), params);
+    res = ChainCreate(&arenaGlobals->defaultChain, arena, NELEMS(params),
+                      params, argsNone);
     if (res != ResOK)
       goto failChainCreate;
   }
 
+  /* <design/trace/#parallel> */
+  if (arena->gcThreads > 0) {
+    res = ControlAlloc(&p, arena, LockSize());
+    if (res != ResOK)
+      goto failFixLockAlloc;
+    arena->fixLock = (Lock)p;
+    LockInit(arena->fixLock);
+
+    res = ControlAlloc(&p, arena, WorkersSize(arena->gcThreads));
+    if (res != ResOK)
+      goto failWorkersAlloc;
+    res = WorkersInit((Workers)p, arena->gcThreads);
+    if (res != ResOK)
+      goto failWorkersInit;
+    arena->workers = (Workers)p;
+  }
+
+  /* <design/write-barrier/#card> */
+  if (arena->cardMarking) {
+    res = CardsInit(arena);
+    if (res != ResOK)
+      goto failCardsInit;
+  }
+
+  /* <design/prot/#uffd> */
+  if (arena->userfaultfd) {
+    res = ControlAlloc(&p, arena, ProtUffdSize());
+    if (res != ResOK)
+      goto failUffdAlloc;
+    res = ProtUffdInit((ProtUffd)p);
+    if (res != ResOK)
+      goto failUffdInit;
+    arena->uffd = (ProtUffd)p;
+  }
+
+  /* <design/arena/#background.start> */
+  if (arena->background) {
+#if defined(LOCK_NONE)
+    res = ResUNIMPL;
+    goto failDaemonAlloc;
+#else
+    res = ControlAlloc(&p, arena, DaemonSize());
+    if (res != ResOK)
+      goto failDaemonAlloc;
+    res = DaemonInit((Daemon)p, arenaBackgroundStep, arena,
+                     ARENA_BACKGROUND_INTERVAL);
+    if (res != ResOK)
+      goto failDaemonInit;
+    arena->daemon = (Daemon)p;
+#endif
+  }
+
   arenaAnnounce(arena);
 
   return ResOK;
 
+#if !defined(LOCK_NONE)
+failDaemonInit:
+  ControlFree(arena, p, DaemonSize());
+#endif
+failDaemonAlloc:
+  if (arena->uffd == NULL)
+    goto failUffdAlloc;
+  ProtUffdFinish(arena->uffd);
+  p = arena->uffd;
+  arena->uffd = NULL;
+failUffdInit:
+  ControlFree(arena, p, ProtUffdSize());
+failUffdAlloc:
+  if (arena->cardMarking)
+    CardsFinish(arena);
+failCardsInit:
+  if (arena->workers == NULL)
+    goto failFixLockAlloc;
+  WorkersFinish(arena->workers);
+  p = arena->workers;
+  arena->workers = NULL;
+failWorkersInit:
+  ControlFree(arena, p, WorkersSize(arena->gcThreads));
+failWorkersAlloc:
+  LockFinish(arena->fixLock);
+  ControlFree(arena, arena->fixLock, LockSize());
+  arena->fixLock = NULL;
+failFixLockAlloc:
 failChainCreate:
   return res;
 }
@@ -378,6 +498,7 @@ void GlobalsFinish(Globals arenaGlobals)
   for(rank = RankMIN; rank < RankLIMIT; ++rank)
     RingFinish(&arena->greyRing[rank]);
   RingFinish(&arenaGlobals->rootRing);
+  RingFinish(&arenaGlobals->rootGreyRing);
   RingFinish(&arenaGlobals->poolRing);
   RingFinish(&arenaGlobals->globalRing);
 }
@@ -396,19 +517,54 @@ void GlobalsPrepareToDestroy(Globals arenaGlobals)
   Rank rank;
 
   AVERT(Globals, arenaGlobals);
+  arena = GlobalsArena(arenaGlobals);
+
+  /* Stop the background collector.  It may be waiting for the arena
+   * lock, so release the lock while joining its thread.  See
+   * <design/arena/#background.destroy>. */
+  if (arena->daemon != NULL) {
+    Daemon daemon = arena->daemon;
+    arena->daemon = NULL;
+    ArenaLeave(arena);
+    DaemonFinish(daemon);
+    ArenaEnter(arena);
+    ControlFree(arena, daemon, DaemonSize());
+  }
+
+  /* Stop the userfaultfd handler.  Like the daemon, it may be waiting
+   * for the arena lock.  See <design/prot/#uffd.destroy>. */
+  if (arena->uffd != NULL) {
+    ProtUffd uffd = arena->uffd;
+    arena->uffd = NULL;
+    ArenaLeave(arena);
+    ProtUffdFinish(uffd);
+    ArenaEnter(arena);
+    ControlFree(arena, uffd, ProtUffdSize());
+  }
 
   /* Park the arena before destroying the default chain, to ensure
    * that there are no traces using that chain. */
   ArenaPark(arenaGlobals);
 
-  arena = GlobalsArena(arenaGlobals);
-
   arenaDenounce(arena);
 
   defaultChain = arenaGlobals->defaultChain;
   arenaGlobals->defaultChain = NULL;
   ChainDestroy(defaultChain);
 
+  /* The arena is parked, so the collector threads are idle. */
+  if (arena->workers != NULL) {
+    WorkersFinish(arena->workers);
+    ControlFree(arena, arena->workers, WorkersSize(arena->gcThreads));
+    arena->workers = NULL;
+    LockFinish(arena->fixLock);
+    ControlFree(arena, arena->fixLock, LockSize());
+    arena->fixLock = NULL;
+  }
+
+  if (arena->cardMarking)
+    CardsFinish(arena);
+
   LockRelease(arenaGlobals->lock);
   /* Theoretically, another thread could grab the lock here, but it's */
   /* not worth worrying about, since an attempt after the lock has been */
@@ -470,6 +626,7 @@ void GlobalsPrepareToDestroy(Globals arenaGlobals)
   AVER(RingIsSingle(&arena->threadRing));
   AVER(RingIsSingle(&arena->deadRing));
   AVER(RingIsSingle(&arenaGlobals->rootRing));
+  AVER(RingIsSingle(&arenaGlobals->rootGreyRing));
   for(rank = RankMIN; rank < RankLIMIT; ++rank)
     AVER(RingIsSingle(&arena->greyRing[rank]));
 
@@ -516,11 +673,15 @@ void ArenaEnterLock(Arena arena, Bool recursive)
    * the lock first then this would deadlock. */
   StackProbe(StackProbeDEPTH);
   lock = ArenaGlobals(arena)->lock;
+  /* While waiting for the lock, the thread counts as stopped at a
+   * safepoint. See <design/thread-manager/#safepoint.entry>. */
+  ThreadSafepointEnter();
   if(recursive) {
     LockClaimRecursive(lock);
   } else {
     LockClaim(lock);
   }
+  ThreadSafepointLeave();
   AVERT(Arena, arena); /* can't AVERT it until we've got the lock */
   if(recursive) {
     /* already in shield */
@@ -566,6 +727,10 @@ void ArenaLeaveLock(Arena arena, Bool recursive)
   } else {
     LockRelease(lock);
   }
+  /* Don't return to the client program while the collector is
+   * waiting for this thread. See <design/thread-manager/#safepoint.poll>. */
+  if(!recursive)
+    ThreadSafepoint();
   return;
 }
 
@@ -588,7 +753,8 @@ MutatorFaultContext mps_exception_info = NULL;
  *
  * This is called when a protected address is accessed.  The mode
  * corresponds to which mode flags need to be cleared in order for the
- * access to continue.  */
+ * access to continue.  The context is NULL if the fault was not
+ * delivered on the faulting thread (see <code/protufli.c#context>).  */
 
 Bool ArenaAccess(Addr addr, AccessSet mode, MutatorFaultContext context)
 {
@@ -637,7 +803,7 @@ Bool ArenaAccess(Addr addr, AccessSet mode, MutatorFaultContext context)
       arenaReleaseRingLock();
       mode &= RootPM(root);
       if (mode != AccessSetEMPTY)
-        RootAccess(root, mode);
+        RootAccess(root, addr, mode);
       EVENT4(ArenaAccess, arena, count, addr, mode);
       ArenaLeave(arena);
       return TRUE;
@@ -657,6 +823,50 @@ Bool ArenaAccess(Addr addr, AccessSet mode, MutatorFaultContext context)
 }
 
 
+/* arenaPollWork -- call TracePoll until the policy says to stop, then
+ * purge spare pages that have been idle too long
+ *
+ * Called by ArenaPoll and by the background collector.
+ */
+
+static void arenaPollWork(Globals globals)
+{
+  Arena arena = GlobalsArena(globals);
+  Clock start;
+  Bool worldCollected = FALSE;
+  Bool moreWork, workWasDone = FALSE;
+  Work tracedWork;
+
+  globals->insidePoll = TRUE;
+
+  /* fillMutatorSize has advanced; call TracePoll enough to catch up. */
+  start = ClockNow();
+
+  EVENT3(ArenaPoll, arena, start, FALSE);
+
+  do {
+    moreWork = TracePoll(&tracedWork, &worldCollected, globals,
+                         !worldCollected);
+    if (moreWork) {
+      workWasDone = TRUE;
+    }
+  } while (PolicyPollAgain(arena, start, moreWork, tracedWork));
+
+  ArenaSparePoll(arena);
+
+  /* Don't count time spent checking for work, if there was no work to do. */
+  if (workWasDone) {
+    Clock end = ClockNow();
+    ArenaAccumulateTime(arena, start, end);
+    PolicyPause(arena, start, end);
+  }
+
+  EVENT3(ArenaPoll, arena, start, BOOLOF(workWasDone));
+
+  globals->insidePoll = FALSE;
+}
+
+
 /* ArenaPoll -- trigger periodic actions
  *
  * Poll all background activities to see if they need to do anything.
@@ -676,10 +886,6 @@ Bool ArenaAccess(Addr addr, AccessSet mode, MutatorFaultContext context)
 void (ArenaPoll)(Globals globals)
 {
   Arena arena;
-  Clock start;
-  Bool worldCollected = FALSE;
-  Bool moreWork, workWasDone = FALSE;
-  Work tracedWork;
 
   AVERT(Globals, globals);
 
@@ -691,29 +897,18 @@ void (ArenaPoll)(Globals globals)
   if (!PolicyPoll(arena))
     return;
 
-  globals->insidePoll = TRUE;
-
-  /* fillMutatorSize has advanced; call TracePoll enough to catch up. */
-  start = ClockNow();
-
-  EVENT3(ArenaPoll, arena, start, FALSE);
-
-  do {
-    moreWork = TracePoll(&tracedWork, &worldCollected, globals,
-                         !worldCollected);
-    if (moreWork) {
-      workWasDone = TRUE;
-    }
-  } while (PolicyPollAgain(arena, start, moreWork, tracedWork));
-
-  /* Don't count time spent checking for work, if there was no work to do. */
-  if (workWasDone) {
-    ArenaAccumulateTime(arena, start, ClockNow());
+  /* Leave the work to the background collector, if there is one,
+   * unless it has fallen too far behind the mutator.  See
+   * <design/arena/#background.poll> and
+   * <design/arena/#background.lag>. */
+  if (arena->daemon != NULL) {
+    DaemonWake(arena->daemon);
+    if (globals->fillMutatorSize - globals->backgroundFillSize
+        <= ARENA_BACKGROUND_LAG)
+      return;
   }
 
-  EVENT3(ArenaPoll, arena, start, BOOLOF(workWasDone));
-
-  globals->insidePoll = FALSE;
+  arenaPollWork(globals);
 }
 
 
@@ -742,8 +937,12 @@ Bool ArenaStep(Globals globals, double interval, double multiplier)
   /* loop while there is work to do and time on the clock. */
   do {
     Trace trace;
+    TraceId ti;
     if (arena->busyTraces != TraceSetEMPTY) {
-      trace = ArenaTrace(arena, (TraceId)0);
+      /* Consider starting a chain collection alongside the running
+         traces. */
+      Bool worldCollected;
+      (void)PolicyStartTrace(&trace, &worldCollected, arena, FALSE);
     } else {
       /* No traces are running: consider collecting the world. */
       if (PolicyShouldCollectWorld(arena, (double)(availableEnd - now), now,
@@ -761,13 +960,17 @@ Bool ArenaStep(Globals globals, double interval, double multiplier)
           break;
       }
     }
-    TraceAdvance(trace);
-    if (trace->state == TraceFINISHED)
-      TraceDestroyFinished(trace);
+    TRACE_SET_ITER(ti, trace, arena->busyTraces, arena)
+      TraceAdvance(trace);
+      if (trace->state == TraceFINISHED)
+        TraceDestroyFinished(trace);
+    TRACE_SET_ITER_END(ti, trace, arena->busyTraces, arena);
     workWasDone = TRUE;
     now = ClockNow();
   } while (now < intervalEnd);
 
+  ArenaSparePoll(arena);
+
   if (workWasDone) {
     ArenaAccumulateTime(arena, start, now);
   }
@@ -775,6 +978,44 @@ Bool ArenaStep(Globals globals, double interval, double multiplier)
   return workWasDone;
 }
 
+
+/* arenaBackgroundStep -- one step of the background collector
+ *
+ * Called repeatedly on the daemon thread without the arena lock.
+ * Does at most a pause time's worth of collection work, and returns
+ * TRUE if a collection is still running.  See
+ * <design/arena/#background.step>.
+ */
+
+static Bool arenaBackgroundStep(void *closure)
+{
+  Arena arena = closure;
+  Globals globals;
+  Bool moreWork = FALSE;
+
+  ArenaEnter(arena);
+  globals = ArenaGlobals(arena);
+
+  /* The daemon is detached when the arena is being destroyed. */
+  if (arena->daemon != NULL && !globals->clamped) {
+    if (PolicyPoll(arena) || arena->busyTraces != TraceSetEMPTY) {
+      /* The mutator has allocated enough to warrant some work, or
+         there is a collection to advance. */
+      arenaPollWork(globals);
+    } else {
+      /* The mutator is idle: consider starting a collection of the
+         world, as if the client had called mps_arena_step. */
+      (void)ArenaStep(globals, ArenaPauseTime(arena),
+                      ARENA_BACKGROUND_MULTIPLIER);
+    }
+    moreWork = arena->busyTraces != TraceSetEMPTY;
+    globals->backgroundFillSize = globals->fillMutatorSize;
+  }
+
+  ArenaLeave(arena);
+  return moreWork;
+}
+
 /* ArenaFinalize -- registers an object for finalization
  *
  * See <design/finalize/>.  */
@@ -900,7 +1141,9 @@ Ref ArenaRead(Arena arena, Ref *p)
 {
   Bool b;
   Seg seg = NULL;       /* suppress "may be used uninitialized" */
-  Rank rank;
+  TraceSet ts;
+  TraceId ti;
+  Trace trace;
 
   AVERT(Arena, arena);
 
@@ -920,10 +1163,12 @@ Ref ArenaRead(Arena arena, Ref *p)
   /* If the segment isn't grey it doesn't need scanning, and in fact it
      would be wrong to even ask what rank to scan it at, since there might
      not be any traces running. */
-  if (TraceSetInter(SegGrey(seg), arena->flippedTraces) != TraceSetEMPTY) {
-    rank = TraceRankForAccess(arena, seg);
-    TraceScanSingleRef(arena->flippedTraces, rank, arena, seg, p);
-  }
+  /* Each trace is scanned for separately, at its own rank. */
+  ts = TraceSetInter(SegGrey(seg), arena->flippedTraces);
+  TRACE_SET_ITER(ti, trace, ts, arena)
+    TraceScanSingleRef(TraceSetSingle(trace),
+                       TraceRankForAccess(trace, seg), arena, seg, p);
+  TRACE_SET_ITER_END(ti, trace, ts, arena);
 
   /* We don't need to update the Seg Summary as in PoolSingleAccess
    * because we are not changing it after it has been scanned. */
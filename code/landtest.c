@@ -3,16 +3,18 @@
  * $Id$
  * Copyright (c) 2001-2014 Ravenbrook Limited.  See end of file for license.
  *
- * Test all three Land implementations against duplicate operations on
- * a bit-table.
+ * Test all four Land implementations against duplicate operations on
+ * a bit-table, and then compare the speed of their searches.
  */
 
+#include "btree.h"
 #include "cbs.h"
 #include "failover.h"
 #include "freelist.h"
 #include "mpm.h"
 #include "mps.h"
 #include "mpsavm.h"
+#include "mpslib.h"
 #include "mpstd.h"
 #include "poolmfs.h"
 #include "testlib.h"
@@ -24,9 +26,10 @@ SRCID(landtest, "$Id$");
 
 #define ArraySize ((Size)123456)
 
-/* CBS is much faster than Freelist, so we apply more operations to
- * the former. */
+/* CBS and BTree are much faster than Freelist, so we apply more
+ * operations to the former. */
 #define nCBSOperations ((Size)125000)
+#define nBTOperations ((Size)125000)
 #define nFLOperations ((Size)12500)
 #define nFOOperations ((Size)12500)
 
@@ -427,6 +430,174 @@ static void test(TestState state, unsigned n) {
   }
 }
 
+/* Benchmark
+ *
+ * Fill each land with the same fragmented pattern of free ranges and
+ * time first-fit, last-fit, largest-fit and zoned searches, checking
+ * that each land finds the same range as the CBS (or for largest-fit,
+ * a range of the same size, since lands may break ties differently).
+ * The zoned searches
+ * delete what they find, so they put it back again.  The Freelist is
+ * left out of the zoned searches, because its findInZones method is
+ * untested.
+ */
+
+#define nBenchSearches ((Count)10000)
+#define benchGapMAX 8           /* maximum grains between free ranges */
+#define benchRangeMAX 64        /* maximum grains in a free range */
+
+enum {
+  benchFIRST,
+  benchLAST,
+  benchLARGEST,
+  benchZONES,
+  benchLIMIT
+};
+
+static const char *benchName[benchLIMIT] = {
+  "first", "last", "largest", "zoned"
+};
+
+static Size benchSize[nBenchSearches];
+static ZoneSet benchZoneSet[nBenchSearches];
+static Word benchFound[benchLIMIT][nBenchSearches];
+
+
+/* benchPattern -- make a fragmented pattern in the alloc table */
+
+static void benchPattern(TestState state)
+{
+  Index i = 0;
+
+  BTSetRange(state->allocTable, 0, state->size);
+  for (;;) {
+    Index base = i + 1 + fbmRnd(benchGapMAX);
+    Index limit = base + 1 + fbmRnd(benchRangeMAX);
+    if (limit > state->size)
+      break;
+    BTResRange(state->allocTable, base, limit);
+    i = limit;
+  }
+}
+
+
+/* benchFill -- insert the free ranges of the alloc table into land */
+
+static void benchFill(Land land, TestState state)
+{
+  Index i = 0;
+
+  while (i < state->size) {
+    Index limit = nextEdge(state->allocTable, state->size, i);
+    if (!BTGet(state->allocTable, i)) {
+      RangeStruct range, newRange;
+      RangeInit(&range, addrOfIndex(state, i), addrOfIndex(state, limit));
+      die((mps_res_t)LandInsert(&newRange, land, &range), "LandInsert");
+      Insist(RangesEqual(&newRange, &range));
+    }
+    i = limit;
+  }
+}
+
+
+/* benchSearches -- choose the sizes and zones to search for */
+
+static void benchSearches(TestState state, Arena arena)
+{
+  ZoneSet blockZones;
+  Index i;
+
+  blockZones = ZoneSetOfRange(arena, state->block,
+                              addrOfIndex(state, state->size));
+  for (i = 0; i < nBenchSearches; ++i) {
+    Index zone;
+    benchSize[i] = (1 + fbmRnd(benchRangeMAX)) * state->align;
+    do {
+      zone = fbmRnd(MPS_WORD_WIDTH);
+    } while (!ZoneSetIsMember(blockZones, zone));
+    benchZoneSet[i] = BS_SINGLE(ZoneSet, zone);
+  }
+}
+
+
+/* bench -- time one kind of search, returning searches per second
+ *
+ * If record is TRUE, records what was found; otherwise checks that
+ * the same was found as when it was recorded.
+ */
+
+static double bench(Land land, unsigned kind, Bool record)
+{
+  mps_clock_t start;
+  Index i;
+  double t;
+
+  start = mps_clock();
+  for (i = 0; i < nBenchSearches; ++i) {
+    RangeStruct range, oldRange, newRange;
+    Bool found = FALSE;
+    Word result;
+    switch (kind) {
+    case benchFIRST:
+      found = LandFindFirst(&range, &oldRange, land, benchSize[i],
+                            FindDeleteNONE);
+      break;
+    case benchLAST:
+      found = LandFindLast(&range, &oldRange, land, benchSize[i],
+                           FindDeleteNONE);
+      break;
+    case benchLARGEST:
+      found = LandFindLargest(&range, &oldRange, land, benchSize[i],
+                              FindDeleteNONE);
+      break;
+    case benchZONES:
+      die((mps_res_t)LandFindInZones(&found, &range, &oldRange, land,
+                                     benchSize[i], benchZoneSet[i], FALSE),
+          "LandFindInZones");
+      if (found) {
+        die((mps_res_t)LandInsert(&newRange, land, &range), "LandInsert");
+        Insist(RangesEqual(&newRange, &oldRange));
+      }
+      break;
+    default:
+      cdie(0, "invalid kind");
+      break;
+    }
+    if (!found)
+      result = 0;
+    else if (kind == benchLARGEST)
+      result = (Word)RangeSize(&range);
+    else
+      result = (Word)RangeBase(&range);
+    if (record)
+      benchFound[kind][i] = result;
+    else
+      Insist(benchFound[kind][i] == result);
+  }
+  t = (double)(mps_clock() - start) / (double)mps_clocks_per_sec();
+  return (double)nBenchSearches / t;
+}
+
+
+/* benchLand -- time all kinds of search on a land and report */
+
+static void benchLand(Land land, const char *name, TestState state,
+                      Bool record, Bool zoned)
+{
+  unsigned kind;
+
+  benchFill(land, state);
+  printf("%-10s", name);
+  for (kind = 0; kind < benchLIMIT; ++kind) {
+    if (kind == benchZONES && !zoned)
+      printf(" %9s: %10s", benchName[kind], "-");
+    else
+      printf(" %9s: %10.0f", benchName[kind], bench(land, kind, record));
+  }
+  printf(" searches/s\n");
+}
+
+
 #define testArenaSIZE   (((size_t)4)<<20)
 
 extern int main(int argc, char *argv[])
@@ -437,9 +608,11 @@ extern int main(int argc, char *argv[])
   void *p;
   MFSStruct blockPool;
   CBSStruct cbsStruct;
+  BTreeStruct btStruct;
   FreelistStruct flStruct;
   FailoverStruct foStruct;
   Land cbs = CBSLand(&cbsStruct);
+  Land bt = BTreeLand(&btStruct);
   Land fl = FreelistLand(&flStruct);
   Land fo = FailoverLand(&foStruct);
   Pool mfs = MFSPool(&blockPool);
@@ -479,7 +652,16 @@ extern int main(int argc, char *argv[])
   test(&state, nCBSOperations);
   LandFinish(cbs);
 
-  /* 2. Test Freelist */
+  /* 2. Test BTree */
+
+  die((mps_res_t)LandInit(bt, CLASS(BTree), arena, state.align,
+                          NULL, mps_args_none),
+      "failed to initialise BTree");
+  state.land = bt;
+  test(&state, nBTOperations);
+  LandFinish(bt);
+
+  /* 3. Test Freelist */
 
   die((mps_res_t)LandInit(fl, CLASS(Freelist), arena, state.align,
                           NULL, mps_args_none),
@@ -488,31 +670,45 @@ extern int main(int argc, char *argv[])
   test(&state, nFLOperations);
   LandFinish(fl);
 
-  /* 3. Test CBS-failing-over-to-Freelist (always failing over on
-   * first iteration, never failing over on second; see fotest.c for a
-   * test case that randomly switches fail-over on and off)
+  /* 4. Test CBS-failing-over-to-Freelist and
+   * BTree-failing-over-to-Freelist (always failing over on first
+   * iteration for each primary, never failing over on second; see
+   * fotest.c for a test case that randomly switches fail-over on and
+   * off)
    */
 
-  for (i = 0; i < 2; ++i) {
+  for (i = 0; i < 4; ++i) {
+      Bool useBTree = i >= 2;
+      Land primary = useBTree ? bt : cbs;
+
       MPS_ARGS_BEGIN(piArgs) {
-        MPS_ARGS_ADD(piArgs, MPS_KEY_MFS_UNIT_SIZE, sizeof(CBSFastBlockStruct));
+        MPS_ARGS_ADD(piArgs, MPS_KEY_MFS_UNIT_SIZE,
+                     useBTree ? sizeof(BTreeNodeStruct)
+                              : sizeof(CBSFastBlockStruct));
         MPS_ARGS_ADD(piArgs, MPS_KEY_EXTEND_BY, ArenaGrainSize(arena));
-        MPS_ARGS_ADD(piArgs, MFSExtendSelf, i);
+        MPS_ARGS_ADD(piArgs, MFSExtendSelf, i % 2);
         die(PoolInit(mfs, arena, PoolClassMFS(), piArgs), "PoolInit");
       } MPS_ARGS_END(piArgs);
 
       MPS_ARGS_BEGIN(args) {
-        MPS_ARGS_ADD(args, CBSBlockPool, mfs);
-        die((mps_res_t)LandInit(cbs, CLASS(CBSFast), arena, state.align,
-                                NULL, args),
-            "failed to initialise CBS");
+        if (useBTree) {
+          MPS_ARGS_ADD(args, BTreeNodePool, mfs);
+          die((mps_res_t)LandInit(bt, CLASS(BTree), arena, state.align,
+                                  NULL, args),
+              "failed to initialise BTree");
+        } else {
+          MPS_ARGS_ADD(args, CBSBlockPool, mfs);
+          die((mps_res_t)LandInit(cbs, CLASS(CBSFast), arena, state.align,
+                                  NULL, args),
+              "failed to initialise CBS");
+        }
       } MPS_ARGS_END(args);
 
       die((mps_res_t)LandInit(fl, CLASS(Freelist), arena, state.align,
                               NULL, mps_args_none),
           "failed to initialise Freelist");
       MPS_ARGS_BEGIN(args) {
-        MPS_ARGS_ADD(args, FailoverPrimary, cbs);
+        MPS_ARGS_ADD(args, FailoverPrimary, primary);
         MPS_ARGS_ADD(args, FailoverSecondary, fl);
         die((mps_res_t)LandInit(fo, CLASS(Failover), arena, state.align,
                                 NULL, args),
@@ -523,10 +719,30 @@ extern int main(int argc, char *argv[])
       test(&state, nFOOperations);
       LandFinish(fo);
       LandFinish(fl);
-      LandFinish(cbs);
+      LandFinish(primary);
       PoolFinish(mfs);
   }
 
+  /* 5. Compare the speed of searches */
+
+  benchPattern(&state);
+  benchSearches(&state, arena);
+  die((mps_res_t)LandInit(cbs, CLASS(CBSZoned), arena, state.align,
+                          NULL, mps_args_none),
+      "failed to initialise CBS");
+  benchLand(cbs, "CBS", &state, TRUE, TRUE);
+  LandFinish(cbs);
+  die((mps_res_t)LandInit(bt, CLASS(BTree), arena, state.align,
+                          NULL, mps_args_none),
+      "failed to initialise BTree");
+  benchLand(bt, "BTree", &state, FALSE, TRUE);
+  LandFinish(bt);
+  die((mps_res_t)LandInit(fl, CLASS(Freelist), arena, state.align,
+                          NULL, mps_args_none),
+      "failed to initialise Freelist");
+  benchLand(fl, "Freelist", &state, FALSE, FALSE);
+  LandFinish(fl);
+
   ControlFree(arena, p, (state.size + 1) * state.align);
   mps_arena_destroy(arena);
 
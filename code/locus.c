@@ -27,6 +27,7 @@ Bool LocusPrefCheck(LocusPref pref)
   CHECKL(BoolCheck(pref->high));
   /* zones can't be checked because it's arbitrary. */
   /* avoid can't be checked because it's arbitrary. */
+  CHECKL(pref->node == LocusNodeANY || pref->node < ARENA_NODE_MAX);
   return TRUE;
 }
 
@@ -94,6 +95,7 @@ Res LocusPrefDescribe(LocusPref pref, mps_lib_FILE *stream, Count depth)
                "  high $S\n", WriteFYesNo(pref->high),
                "  zones $B\n", (WriteFB)pref->zones,
                "  avoid $B\n", (WriteFB)pref->avoid,
+               "  node $U\n", (WriteFU)pref->node,
                "} LocusPref $P\n", (WriteFP)pref,
                NULL);
   return res;
@@ -110,6 +112,8 @@ Bool GenDescCheck(GenDesc gen)
   /* nothing to check for capacity */
   CHECKL(gen->mortality >= 0.0);
   CHECKL(gen->mortality <= 1.0);
+  CHECKL(gen->minCapacity <= gen->maxCapacity);
+  /* nothing to check for condemnedNew or condemnedOld */
   CHECKD_NOSIG(Ring, &gen->locusRing);
   return TRUE;
 }
@@ -168,6 +172,8 @@ Res GenDescDescribe(GenDesc gen, mps_lib_FILE *stream, Count depth)
                "  zones $B\n", (WriteFB)gen->zones,
                "  capacity $W\n", (WriteFW)gen->capacity,
                "  mortality $D\n", (WriteFD)gen->mortality,
+               "  minCapacity $W\n", (WriteFW)gen->minCapacity,
+               "  maxCapacity $W\n", (WriteFW)gen->maxCapacity,
                NULL);
   if (res != ResOK)
     return res;
@@ -184,16 +190,36 @@ Res GenDescDescribe(GenDesc gen, mps_lib_FILE *stream, Count depth)
 }
 
 
+/* GenDescCondemned -- note what a chain collection condemned
+ *
+ * Called by the policy when it condemns a generation for a collection
+ * of its chain, with the generation's new and old sizes just before
+ * condemning it, or zero if the generation was not condemned.  The
+ * sizes are used by chainAdapt when the collection ends.
+ */
+
+void GenDescCondemned(GenDesc gen, Size newSize, Size oldSize)
+{
+  AVERT(GenDesc, gen);
+  gen->condemnedNew = newSize;
+  gen->condemnedOld = oldSize;
+}
+
+
 /* ChainCreate -- create a generation chain */
 
+ARG_DEFINE_KEY(CHAIN_ADAPTIVE, Bool);
+
 Res ChainCreate(Chain *chainReturn, Arena arena, size_t genCount,
-                GenParamStruct *params)
+                GenParamStruct *params, ArgList args)
 {
   size_t i;
   Chain chain;
   GenDescStruct *gens;
   Res res;
   void *p;
+  Bool adaptive = FALSE;
+  ArgStruct arg;
 
   AVER(chainReturn != NULL);
   AVERT(Arena, arena);
@@ -204,6 +230,11 @@ Res ChainCreate(Chain *chainReturn, Arena arena, size_t genCount,
     AVER(params[i].mortality > 0.0);
     AVER(params[i].mortality < 1.0);
   }
+  AVERT(ArgList, args);
+
+  if (ArgPick(&arg, args, MPS_KEY_CHAIN_ADAPTIVE))
+    adaptive = arg.val.b;
+  AVERT(Bool, adaptive);
 
   res = ControlAlloc(&p, arena, genCount * sizeof(GenDescStruct));
   if (res != ResOK)
@@ -214,6 +245,16 @@ Res ChainCreate(Chain *chainReturn, Arena arena, size_t genCount,
     gens[i].zones = ZoneSetEMPTY;
     gens[i].capacity = params[i].capacity;
     gens[i].mortality = params[i].mortality;
+    gens[i].minCapacity = params[i].capacity;
+    gens[i].maxCapacity = params[i].capacity;
+    if (adaptive) {
+      gens[i].minCapacity /= CHAIN_ADAPT_RANGE;
+      if (gens[i].minCapacity == 0)
+        gens[i].minCapacity = 1;
+      gens[i].maxCapacity *= CHAIN_ADAPT_RANGE;
+    }
+    gens[i].condemnedNew = 0;
+    gens[i].condemnedOld = 0;
     RingInit(&gens[i].locusRing);
     gens[i].sig = GenDescSig;
     AVERT(GenDesc, &gens[i]);
@@ -229,6 +270,7 @@ Res ChainCreate(Chain *chainReturn, Arena arena, size_t genCount,
   chain->activeTraces = TraceSetEMPTY;
   chain->genCount = genCount;
   chain->gens = gens;
+  chain->adaptive = adaptive;
   chain->sig = ChainSig;
 
   RingAppend(&arena->chainRing, &chain->chainRing);
@@ -255,7 +297,10 @@ Bool ChainCheck(Chain chain)
   CHECKL(chain->genCount > 0);
   for (i = 0; i < chain->genCount; ++i) {
     CHECKD(GenDesc, &chain->gens[i]);
+    CHECKL(chain->adaptive
+           || chain->gens[i].minCapacity == chain->gens[i].maxCapacity);
   }
+  CHECKL(BoolCheck(chain->adaptive));
   return TRUE;
 }
 
@@ -308,12 +353,107 @@ GenDesc ChainGen(Chain chain, Index gen)
 }
 
 
-/* PoolGenAlloc -- allocate a segment in a pool generation and update
- * accounting
+/* poolGenReserveRelease -- return unused reservation to the arena
+ *
+ * Returns the size returned.  See <design/strategy/#alloc.reserve.account>.
  */
 
-Res PoolGenAlloc(Seg *segReturn, PoolGen pgen, SegClass klass, Size size,
-                 ArgList args)
+static Size poolGenReserveRelease(PoolGen pgen)
+{
+  Size size = AddrOffset(pgen->reserveBase, pgen->reserveLimit);
+
+  if (size > 0) {
+    AVER(pgen->totalSize >= size);
+    pgen->totalSize -= size;
+    AVER(pgen->freeSize >= size);
+    pgen->freeSize -= size;
+    ArenaFree(pgen->reserveBase, size, pgen->pool);
+  }
+  pgen->reserveBase = (Addr)0;
+  pgen->reserveLimit = (Addr)0;
+  return size;
+}
+
+
+/* GenDescReleaseReserves -- return the reservations of the pool
+ * generations in a generation to the arena
+ *
+ * Returns the total size returned.  See
+ * <design/strategy/#alloc.reserve.release>.
+ */
+
+Size GenDescReleaseReserves(GenDesc gen)
+{
+  Size size = 0;
+  Ring node, nextNode;
+
+  AVERT(GenDesc, gen);
+
+  RING_FOR(node, &gen->locusRing, nextNode) {
+    PoolGen pgen = RING_ELT(PoolGen, genRing, node);
+    AVERT(PoolGen, pgen);
+    size += poolGenReserveRelease(pgen);
+  }
+  return size;
+}
+
+
+/* poolGenReserve -- carve address space for a segment from the
+ * pool generation's reservation, refilling it if necessary
+ *
+ * Returns FALSE if the segment is too large to come from the
+ * reservation, or if the reservation could not be refilled.  See
+ * <design/strategy/#alloc.reserve>.
+ */
+
+static Bool poolGenReserve(Addr *baseReturn, PoolGen pgen, LocusPref pref,
+                           Size size)
+{
+  Arena arena = PoolArena(pgen->pool);
+  Size reserveSize;
+  Addr base;
+  Res res;
+
+  reserveSize = ArenaStripeSize(arena);
+  if (reserveSize > POOL_GEN_RESERVE_SIZE)
+    reserveSize = POOL_GEN_RESERVE_SIZE;
+  reserveSize = SizeAlignDown(reserveSize, ArenaGrainSize(arena));
+  if (size > reserveSize / POOL_GEN_RESERVE_SEGS)
+    return FALSE;
+
+  if (AddrOffset(pgen->reserveBase, pgen->reserveLimit) < size) {
+    (void)poolGenReserveRelease(pgen);
+    /* Don't hold a reservation near the commit limit.  See
+       <design/strategy/#alloc.reserve.release>. */
+    if (ArenaCommitted(arena) - ArenaSpareCommitted(arena) + reserveSize
+        > ArenaCommitLimit(arena))
+      return FALSE;
+    res = ArenaAlloc(&base, pref, reserveSize, pgen->pool);
+    if (res != ResOK)
+      return FALSE;
+    pgen->reserveBase = base;
+    pgen->reserveLimit = AddrAdd(base, reserveSize);
+    /* <design/strategy/#alloc.reserve.account> */
+    pgen->totalSize += reserveSize;
+    pgen->freeSize += reserveSize;
+  }
+
+  *baseReturn = pgen->reserveBase;
+  return TRUE;
+}
+
+
+/* PoolGenAllocNode -- allocate a segment in a pool generation,
+ * preferably on a NUMA node, and update accounting
+ *
+ * node is LocusNodeANY if the caller doesn't mind where the segment
+ * is.  Segments for a particular node don't come from the pool
+ * generation's reservation, which could be on any node.  See
+ * <design/arena/#numa.alloc>.
+ */
+
+Res PoolGenAllocNode(Seg *segReturn, PoolGen pgen, SegClass klass,
+                     Size size, Index node, ArgList args)
 {
   LocusPrefStruct pref;
   Res res;
@@ -321,6 +461,7 @@ Res PoolGenAlloc(Seg *segReturn, PoolGen pgen, SegClass klass, Size size,
   ZoneSet zones, moreZones;
   Arena arena;
   GenDesc gen;
+  Addr base;
 
   AVER(segReturn != NULL);
   AVERT(PoolGen, pgen);
@@ -329,6 +470,7 @@ Res PoolGenAlloc(Seg *segReturn, PoolGen pgen, SegClass klass, Size size,
   AVERT(ArgList, args);
 
   arena = PoolArena(pgen->pool);
+  AVER(node == LocusNodeANY || node < ArenaNodes(arena));
   gen = pgen->gen;
   zones = gen->zones;
 
@@ -336,9 +478,25 @@ Res PoolGenAlloc(Seg *segReturn, PoolGen pgen, SegClass klass, Size size,
   pref.high = FALSE;
   pref.zones = zones;
   pref.avoid = ZoneSetBlacklist(arena);
-  res = SegAlloc(&seg, klass, &pref, size, pgen->pool, args);
-  if (res != ResOK)
-    return res;
+  pref.node = node;
+  if (node == LocusNodeANY && poolGenReserve(&base, pgen, &pref, size)) {
+    /* Take the tracts out of the reservation (and its accounting)
+       before allocating the segment descriptor, since that may
+       release the reservation.  See
+       <design/strategy/#alloc.reserve.account>. */
+    pgen->reserveBase = AddrAdd(base, size);
+    pgen->totalSize -= size;
+    pgen->freeSize -= size;
+    res = SegAllocTracts(&seg, klass, base, size, pgen->pool, args);
+    if (res != ResOK) {
+      ArenaFree(base, size, pgen->pool);
+      return res;
+    }
+  } else {
+    res = SegAlloc(&seg, klass, &pref, size, pgen->pool, args);
+    if (res != ResOK)
+      return res;
+  }
 
   moreZones = ZoneSetUnion(zones, ZoneSetOfSeg(arena, seg));
   gen->zones = moreZones;
@@ -359,16 +517,41 @@ Res PoolGenAlloc(Seg *segReturn, PoolGen pgen, SegClass klass, Size size,
 }
 
 
-/* ChainDeferral -- time until next ephemeral GC for this chain */
+/* PoolGenAlloc -- allocate a segment in a pool generation and update
+ * accounting
+ */
+
+Res PoolGenAlloc(Seg *segReturn, PoolGen pgen, SegClass klass, Size size,
+                 ArgList args)
+{
+  return PoolGenAllocNode(segReturn, pgen, klass, size, LocusNodeANY, args);
+}
+
+
+/* ChainDeferral -- time until next ephemeral GC for this chain
+ *
+ * A chain that is already being collected as a chain is not collected
+ * again until that trace finishes, but a collection of the world
+ * doesn't defer it: the nursery can be collected concurrently with a
+ * long collection of the world.  See <design/trace/#instance.start>.
+ */
 
 double ChainDeferral(Chain chain)
 {
   double time = DBL_MAX;
+  Bool collecting = FALSE;
   size_t i;
+  TraceId ti;
+  Trace trace;
 
   AVERT(Chain, chain);
 
-  if (chain->activeTraces == TraceSetEMPTY) {
+  TRACE_SET_ITER(ti, trace, chain->activeTraces, chain->arena)
+    if (trace->chain == chain)
+      collecting = TRUE;
+  TRACE_SET_ITER_END(ti, trace, chain->activeTraces, chain->arena);
+
+  if (!collecting) {
     for (i = 0; i < chain->genCount; ++i) {
       double genTime = chain->gens[i].capacity * 1024.0
         - (double)GenDescNewSize(&chain->gens[i]);
@@ -392,6 +575,89 @@ void ChainStartGC(Chain chain, Trace trace)
 }
 
 
+/* chainAdapt -- learn from a collection of an adaptive chain
+ *
+ * Compare the survivors of the collection with the number predicted
+ * from the mortalities of the condemned generations, and correct the
+ * mortalities accordingly.  Then resize each condemned generation
+ * according to its mortality and the longest pause during the
+ * collection.  See <design/strategy/#chain.adapt>.
+ */
+
+static void chainAdapt(Chain chain, Trace trace)
+{
+  Arena arena = chain->arena;
+  Size condemned = 0, oldSize = 0;
+  double predicted = 0.0, survivors, ratio, pause;
+  Bool pauseLong;
+  size_t i;
+
+  for (i = 0; i < chain->genCount; ++i) {
+    GenDesc gen = &chain->gens[i];
+    condemned += gen->condemnedNew + gen->condemnedOld;
+    oldSize += gen->condemnedOld;
+    predicted += (double)gen->condemnedNew * (1.0 - gen->mortality);
+  }
+  if (predicted <= 0.0)
+    return;
+
+  /* The condemned zones may also contain segments belonging to other
+   * chains, so take this chain's share of the survivors.  Objects
+   * that had survived a collection before are assumed to survive
+   * again, as in policyCondemnChain. */
+  survivors = (double)(trace->forwardedSize + trace->preservedInPlaceSize);
+  if (trace->condemned > condemned)
+    survivors = survivors * (double)condemned / (double)trace->condemned;
+  survivors -= (double)oldSize;
+  if (survivors < 0.0)
+    survivors = 0.0;
+  ratio = survivors / predicted;
+
+  pause = (double)trace->pauseMax / (double)ClocksPerSec();
+  pauseLong = pause > ArenaPauseTime(arena) * CHAIN_ADAPT_PAUSE_SLACK;
+
+  for (i = 0; i < chain->genCount; ++i) {
+    GenDesc gen = &chain->gens[i];
+    double survival, observed, capacity;
+    if (gen->condemnedNew == 0)
+      continue;
+
+    survival = (1.0 - gen->mortality) * ratio;
+    if (survival > 1.0)
+      survival = 1.0;
+    observed = 1.0 - survival;
+    gen->mortality += CHAIN_ADAPT_WEIGHT * (observed - gen->mortality);
+    if (gen->mortality < CHAIN_ADAPT_MORTALITY_MIN)
+      gen->mortality = CHAIN_ADAPT_MORTALITY_MIN;
+    if (gen->mortality > CHAIN_ADAPT_MORTALITY_MAX)
+      gen->mortality = CHAIN_ADAPT_MORTALITY_MAX;
+
+    /* Too many survivors means objects are promoted before they have
+       had time to die, so give them more time.  High mortality is
+       the ideal case, and shrinking the generation would only cause
+       more collections, so grow it slowly instead.  Only a long
+       pause shrinks it.  See <design/strategy/#chain.adapt.high>. */
+    capacity = (double)gen->capacity;
+    if (pauseLong)
+      capacity /= CHAIN_ADAPT_STEP;
+    else if (gen->mortality < CHAIN_ADAPT_MORTALITY_LOW)
+      capacity = capacity * CHAIN_ADAPT_STEP + 1.0;
+    else if (gen->mortality > CHAIN_ADAPT_MORTALITY_HIGH)
+      capacity = capacity * CHAIN_ADAPT_STEP_HIGH + 1.0;
+    if (capacity < (double)gen->minCapacity)
+      gen->capacity = gen->minCapacity;
+    else if (capacity > (double)gen->maxCapacity)
+      gen->capacity = gen->maxCapacity;
+    else
+      gen->capacity = (Size)capacity;
+
+    EVENT6(ChainAdapt, chain, i, gen->capacity, gen->mortality,
+           observed, pause);
+    GenDescCondemned(gen, 0, 0);
+  }
+}
+
+
 /* ChainEndGC -- called to notify end of GC for this chain */
 
 void ChainEndGC(Chain chain, Trace trace)
@@ -399,6 +665,8 @@ void ChainEndGC(Chain chain, Trace trace)
   AVERT(Chain, chain);
   AVERT(Trace, trace);
 
+  if (chain->adaptive && trace->chain == chain)
+    chainAdapt(chain, trace);
   chain->activeTraces = TraceSetDel(chain->activeTraces, trace);
 }
 
@@ -419,6 +687,7 @@ Res ChainDescribe(Chain chain, mps_lib_FILE *stream, Count depth)
                "Chain $P {\n", (WriteFP)chain,
                "  arena $P\n", (WriteFP)chain->arena,
                "  activeTraces $B\n", (WriteFB)chain->activeTraces,
+               "  adaptive $S\n", WriteFYesNo(chain->adaptive),
                NULL);
   if (res != ResOK)
     return res;
@@ -457,6 +726,8 @@ Res PoolGenInit(PoolGen pgen, GenDesc gen, Pool pool)
   pgen->oldSize = 0;
   pgen->newDeferredSize = 0;
   pgen->oldDeferredSize = 0;
+  pgen->reserveBase = (Addr)0;
+  pgen->reserveLimit = (Addr)0;
   pgen->sig = PoolGenSig;
   AVERT(PoolGen, pgen);
 
@@ -470,6 +741,7 @@ Res PoolGenInit(PoolGen pgen, GenDesc gen, Pool pool)
 void PoolGenFinish(PoolGen pgen)
 {
   AVERT(PoolGen, pgen);
+  (void)poolGenReserveRelease(pgen);
   AVER(pgen->segs == 0);
   AVER(pgen->totalSize == 0);
   AVER(pgen->freeSize == 0);
@@ -488,16 +760,24 @@ void PoolGenFinish(PoolGen pgen)
 
 Bool PoolGenCheck(PoolGen pgen)
 {
+  Size reserveSize;
+
   CHECKS(PoolGen, pgen);
   /* nothing to check about serial */
   CHECKU(Pool, pgen->pool);
   CHECKU(GenDesc, pgen->gen);
   CHECKD_NOSIG(Ring, &pgen->genRing);
-  CHECKL((pgen->totalSize == 0) == (pgen->segs == 0));
-  CHECKL(pgen->totalSize >= pgen->segs * ArenaGrainSize(PoolArena(pgen->pool)));
+  CHECKL(pgen->reserveBase <= pgen->reserveLimit);
+  reserveSize = AddrOffset(pgen->reserveBase, pgen->reserveLimit);
+  CHECKL((pgen->totalSize == reserveSize) == (pgen->segs == 0));
+  CHECKL(pgen->totalSize >= pgen->segs * ArenaGrainSize(PoolArena(pgen->pool))
+                            + reserveSize);
+  CHECKL(pgen->freeSize >= reserveSize);
   CHECKL(pgen->totalSize == pgen->freeSize + pgen->bufferedSize
          + pgen->newSize + pgen->oldSize
          + pgen->newDeferredSize + pgen->oldDeferredSize);
+  CHECKL(AddrIsArenaGrain(pgen->reserveBase, PoolArena(pgen->pool)));
+  CHECKL(AddrIsArenaGrain(pgen->reserveLimit, PoolArena(pgen->pool)));
   return TRUE;
 }
 
@@ -703,6 +983,8 @@ Res PoolGenDescribe(PoolGen pgen, mps_lib_FILE *stream, Count depth)
                "  oldDeferredSize $U\n", (WriteFU)pgen->oldDeferredSize,
                "  newSize $U\n", (WriteFU)pgen->newSize,
                "  newDeferredSize $U\n", (WriteFU)pgen->newDeferredSize,
+               "  reserve [$A,$A)\n",
+               (WriteFA)pgen->reserveBase, (WriteFA)pgen->reserveLimit,
                "} PoolGen $P\n", (WriteFP)pgen,
                NULL);
   return res;
@@ -722,6 +1004,10 @@ void LocusInit(Arena arena)
   gen->zones = ZoneSetEMPTY;
   gen->capacity = 0; /* unused */
   gen->mortality = 0.51;
+  gen->minCapacity = 0;
+  gen->maxCapacity = 0;
+  gen->condemnedNew = 0;
+  gen->condemnedOld = 0;
   RingInit(&gen->locusRing);
   gen->sig = GenDescSig;
   AVERT(GenDesc, gen);
@@ -741,6 +1027,31 @@ void LocusFinish(Arena arena)
 }
 
 
+/* LocusReleaseReserves -- return all pool generation reservations to
+ * the arena
+ *
+ * Returns the total size returned.  See
+ * <design/strategy/#alloc.reserve.release>.
+ */
+
+Size LocusReleaseReserves(Arena arena)
+{
+  Size size = 0;
+  Ring node, nextNode;
+
+  AVERT(Arena, arena);
+
+  RING_FOR(node, &arena->chainRing, nextNode) {
+    Chain chain = RING_ELT(Chain, chainRing, node);
+    Index i;
+    for (i = 0; i < chain->genCount; ++i)
+      size += GenDescReleaseReserves(&chain->gens[i]);
+  }
+  size += GenDescReleaseReserves(&arena->topGen);
+  return size;
+}
+
+
 /* LocusCheck -- check the locus module */
 
 Bool LocusCheck(Arena arena)
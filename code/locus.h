@@ -33,6 +33,10 @@ typedef struct GenDescStruct {
   ZoneSet zones; /* zoneset for this generation */
   Size capacity; /* capacity in kB */
   double mortality;
+  Size minCapacity; /* least capacity in kB when adaptive */
+  Size maxCapacity; /* greatest capacity in kB when adaptive */
+  Size condemnedNew; /* new size condemned by chain's trace */
+  Size condemnedOld; /* old size condemned by chain's trace */
   RingStruct locusRing; /* Ring of all PoolGen's in this GenDesc (locus) */
 } GenDescStruct;
 
@@ -59,6 +63,10 @@ typedef struct PoolGenStruct {
   Size oldSize;           /* allocated prior to last collection */
   Size newDeferredSize;   /* new (but deferred) */
   Size oldDeferredSize;   /* old (but deferred) */
+
+  /* Address space allocated to the pool but not yet in a segment */
+  Addr reserveBase;       /* base of reservation */
+  Addr reserveLimit;      /* limit of reservation */
 } PoolGenStruct;
 
 
@@ -73,6 +81,7 @@ typedef struct mps_chain_s {
   TraceSet activeTraces; /* set of traces collecting this chain */
   size_t genCount; /* number of generations */
   GenDesc gens; /* the array of generations */
+  Bool adaptive; /* adapt capacities and mortalities? */
 } ChainStruct;
 
 
@@ -80,9 +89,11 @@ extern Bool GenDescCheck(GenDesc gen);
 extern Size GenDescNewSize(GenDesc gen);
 extern Size GenDescTotalSize(GenDesc gen);
 extern Res GenDescDescribe(GenDesc gen, mps_lib_FILE *stream, Count depth);
+extern void GenDescCondemned(GenDesc gen, Size newSize, Size oldSize);
+extern Size GenDescReleaseReserves(GenDesc gen);
 
 extern Res ChainCreate(Chain *chainReturn, Arena arena, size_t genCount,
-                       GenParam params);
+                       GenParam params, ArgList args);
 extern void ChainDestroy(Chain chain);
 extern Bool ChainCheck(Chain chain);
 
@@ -98,6 +109,8 @@ extern Res PoolGenInit(PoolGen pgen, GenDesc gen, Pool pool);
 extern void PoolGenFinish(PoolGen pgen);
 extern Res PoolGenAlloc(Seg *segReturn, PoolGen pgen, SegClass klass,
                         Size size, ArgList args);
+extern Res PoolGenAllocNode(Seg *segReturn, PoolGen pgen, SegClass klass,
+                            Size size, Index node, ArgList args);
 extern void PoolGenFree(PoolGen pgen, Seg seg, Size freeSize, Size oldSize,
                         Size newSize, Bool deferred);
 extern void PoolGenAccountForFill(PoolGen pgen, Size size);
@@ -21,6 +21,7 @@
 #include "prot.h"
 #include "sp.h"
 #include "th.h"
+#include "worker.h"
 #include "ss.h"
 #include "mpslib.h"
 #include "ring.h"
@@ -219,6 +220,15 @@ extern void PoolDestroy(Pool pool);
 extern BufferClass PoolDefaultBufferClass(Pool pool);
 extern Res PoolAlloc(Addr *pReturn, Pool pool, Size size);
 extern void PoolFree(Pool pool, Addr old, Size size);
+extern Res PoolBulkAlloc(Count *countReturn, Addr *listIO, Pool pool,
+                         Size size, Count count);
+extern void PoolBulkFree(Pool pool, Addr *listIO, Size size, Count count);
+extern Bool PoolTryAlloc(Addr *pReturn, Pool pool, Size size);
+extern Bool PoolTryFree(Pool pool, Addr old, Size size);
+extern void PoolLockClaim(Pool pool);
+extern void PoolLockRelease(Pool pool);
+extern void PoolLocksClaimAll(Arena arena);
+extern void PoolLocksReleaseAll(Arena arena);
 extern Res PoolTraceBegin(Pool pool, Trace trace);
 extern Res PoolAccess(Pool pool, Seg seg, Addr addr,
                       AccessSet mode, MutatorFaultContext context);
@@ -226,6 +236,7 @@ extern Res PoolWhiten(Pool pool, Trace trace, Seg seg);
 extern void PoolGrey(Pool pool, Trace trace, Seg seg);
 extern void PoolBlacken(Pool pool, TraceSet traceSet, Seg seg);
 extern Res PoolScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg);
+extern Res PoolScanCards(ScanState ss, Pool pool, Seg seg);
 extern Res PoolFix(Pool pool, ScanState ss, Seg seg, Addr *refIO);
 extern Res PoolFixEmergency(Pool pool, ScanState ss, Seg seg, Addr *refIO);
 extern void PoolReclaim(Pool pool, Trace trace, Seg seg);
@@ -243,6 +254,11 @@ extern Res PoolNoAlloc(Addr *pReturn, Pool pool, Size size);
 extern Res PoolTrivAlloc(Addr *pReturn, Pool pool, Size size);
 extern void PoolNoFree(Pool pool, Addr old, Size size);
 extern void PoolTrivFree(Pool pool, Addr old, Size size);
+extern Res PoolAbsBulkAlloc(Count *countReturn, Addr *listIO, Pool pool,
+                            Size size, Count count);
+extern void PoolAbsBulkFree(Pool pool, Addr *listIO, Size size, Count count);
+extern Bool PoolTrivTryAlloc(Addr *pReturn, Pool pool, Size size);
+extern Bool PoolTrivTryFree(Pool pool, Addr old, Size size);
 extern Res PoolNoBufferFill(Addr *baseReturn, Addr *limitReturn,
                             Pool pool, Buffer buffer, Size size);
 extern Res PoolTrivBufferFill(Addr *baseReturn, Addr *limitReturn,
@@ -267,6 +283,7 @@ extern void PoolTrivGrey(Pool pool, Trace trace, Seg seg);
 extern void PoolNoBlacken(Pool pool, TraceSet traceSet, Seg seg);
 extern void PoolTrivBlacken(Pool pool, TraceSet traceSet, Seg seg);
 extern Res PoolNoScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg);
+extern Res PoolTrivScanCards(ScanState ss, Pool pool, Seg seg);
 extern Res PoolNoFix(Pool pool, ScanState ss, Seg seg, Ref *refIO);
 extern void PoolNoReclaim(Pool pool, Trace trace, Seg seg);
 extern void PoolTrivTraceEnd(Pool pool, Trace trace);
@@ -379,6 +396,13 @@ extern RefSet ScanStateSummary(ScanState ss);
 #define ScanStateSetWhite(ss, zs)          ((void)((ss)->ss_s._w = (zs)))
 #define ScanStateSetUnfixedSummary(ss, rs) ((void)((ss)->ss_s._ufs = (rs)))
 
+/* ScanStateFixClaim/Release -- exclude fixing on other threads during
+ * a parallel scan.  See <design/trace/#parallel.pool>. */
+#define ScanStateFixClaim(ss) \
+  BEGIN if ((ss)->fixLock != NULL) LockClaim((ss)->fixLock); END
+#define ScanStateFixRelease(ss) \
+  BEGIN if ((ss)->fixLock != NULL) LockRelease((ss)->fixLock); END
+
 extern Bool TraceIdCheck(TraceId id);
 extern Bool TraceSetCheck(TraceSet ts);
 extern Bool TraceCheck(Trace trace);
@@ -393,10 +417,11 @@ extern Res TraceStart(Trace trace, double mortality, double finishingTime);
 extern Bool TracePoll(Work *workReturn, Bool *collectWorldReturn,
                       Globals globals, Bool collectWorldAllowed);
 
-extern Rank TraceRankForAccess(Arena arena, Seg seg);
+extern Rank TraceRankForAccess(Trace trace, Seg seg);
 extern void TraceSegAccess(Arena arena, Seg seg, AccessSet mode);
 
 extern void TraceAdvance(Trace trace);
+extern Res TraceScanRootChunk(Trace trace, Root root, Index chunk);
 extern Res TraceStartCollectAll(Trace *traceReturn, Arena arena, int why);
 extern Res TraceDescribe(Trace trace, mps_lib_FILE *stream, Count depth);
 
@@ -510,8 +535,27 @@ extern Ring GlobalsRememberedSummaryRing(Globals);
 #define ArenaPoolRing(arena) (&ArenaGlobals(arena)->poolRing)
 #define ArenaChunkTree(arena) RVALUE((arena)->chunkTree)
 #define ArenaChunkRing(arena) RVALUE(&(arena)->chunkRing)
+#define ArenaNodes(arena) RVALUE((arena)->nodes)
+
+/* ArenaNodeOfAddr -- the NUMA node of an address
+ *
+ * The stripes of the address space are dealt out to the nodes in
+ * turn, so that each node owns a set of zones.  See
+ * <design/arena/#numa.map>.
+ */
+
+#define ArenaNodeOfAddr(arena, addr) \
+  ((Index)(AddrZone(arena, addr) % (arena)->nodes))
+
+extern ZoneSet ArenaNodeZones(Arena arena, Index node);
+#define ArenaChunkMapIndex(arena, addr) \
+  (((Word)(addr) >> (arena)->chunkMapShift) & (ARENA_CHUNK_MAP_LENGTH - 1))
+#define ArenaChunkMapMANY       ((Chunk)(Word)1)
 #define ArenaShield(arena)      (&(arena)->shieldStruct)
+#define ShieldArena(shield)     PARENT(ArenaStruct, shieldStruct, shield)
 #define ArenaHistory(arena)     (&(arena)->historyStruct)
+#define ArenaCardMarking(arena) RVALUE((arena)->cardMarking)
+#define ArenaCards(arena)       (&(arena)->cardsStruct)
 
 extern Bool ArenaGrainSizeCheck(Size size);
 #define AddrArenaGrainUp(addr, arena) AddrAlignUp(addr, ArenaGrainSize(arena))
@@ -607,6 +651,8 @@ extern void ArenaSetSpareCommitLimit(Arena arena, Size limit);
 extern double ArenaPauseTime(Arena arena);
 extern void ArenaSetPauseTime(Arena arena, double pauseTime);
 extern Size ArenaNoPurgeSpare(Arena arena, Size size);
+extern Size ArenaNoPurgeAged(Arena arena, Clock before, Clock deadline);
+extern void ArenaSparePoll(Arena arena);
 extern Res ArenaNoGrow(Arena arena, LocusPref pref, Size size);
 
 extern Size ArenaAvail(Arena arena);
@@ -638,6 +684,23 @@ extern Bool PolicyStartTrace(Trace *traceReturn, Bool *collectWorldReturn,
                              Arena arena, Bool collectWorldAllowed);
 extern Bool PolicyPoll(Arena arena);
 extern Bool PolicyPollAgain(Arena arena, Clock start, Bool moreWork, Work tracedWork);
+extern void PolicyPause(Arena arena, Clock start, Clock end);
+
+DECLARE_CLASS(Inst, PolicyClass, InstClass);
+DECLARE_CLASS(Policy, AbstractPolicy, Inst);
+DECLARE_CLASS(Policy, HeuristicPolicy, AbstractPolicy);
+#define AbstractPolicyCheck PolicyCheck
+#define HeuristicPolicyCheck PolicyCheck
+extern Bool PolicyClassCheck(PolicyClass klass);
+extern Bool PolicyCheck(Policy policy);
+extern Res PolicyCreate(Policy *policyReturn, Arena arena, ArgList args);
+extern void PolicyDestroy(Policy policy);
+extern Res PolicyDescribe(Policy policy, mps_lib_FILE *stream, Count depth);
+extern Count PolicyPauseCount(Policy policy);
+extern double PolicyPauseQuantile(Policy policy, double fraction);
+
+#define PolicyArena(policy)     RVALUE((policy)->arena)
+#define ArenaPolicy(arena)      RVALUE((arena)->policy)
 
 
 /* Locus interface */
@@ -651,6 +714,7 @@ extern Res LocusPrefDescribe(LocusPref pref, mps_lib_FILE *stream, Count depth);
 extern void LocusInit(Arena arena);
 extern void LocusFinish(Arena arena);
 extern Bool LocusCheck(Arena arena);
+extern Size LocusReleaseReserves(Arena arena);
 
 
 /* Segment interface */
@@ -658,6 +722,8 @@ extern Bool LocusCheck(Arena arena);
 extern Res SegAlloc(Seg *segReturn, SegClass klass, LocusPref pref,
                     Size size, Pool pool,
                     ArgList args);
+extern Res SegAllocTracts(Seg *segReturn, SegClass klass, Addr base,
+                          Size size, Pool pool, ArgList args);
 extern void SegFree(Seg seg);
 extern Bool SegOfAddr(Seg *segReturn, Arena arena, Addr addr);
 extern Bool SegFirst(Seg *segReturn, Arena arena);
@@ -904,6 +970,15 @@ extern void (ShieldFlush)(Arena arena);
 #endif  /* SHIELD */
 
 
+/* Card Marking -- see <code/card.c> */
+
+extern Res CardsInit(Arena arena);
+extern void CardsFinish(Arena arena);
+extern Bool CardsCheck(Arena arena);
+extern Bool CardsRangeDirty(Arena arena, Addr base, Addr limit);
+extern void CardsClear(Arena arena);
+
+
 /* Location Dependency -- see <code/ld.c> */
 
 extern void HistoryInit(History history);
@@ -957,9 +1032,16 @@ extern AccessSet RootPM(Root root);
 extern RefSet RootSummary(Root root);
 extern void RootGrey(Root root, Trace trace);
 extern Res RootScan(ScanState ss, Root root);
+extern void RootBlacken(ScanState ss, Root root);
+extern Bool RootParallelScan(Root root, TraceSet ts);
+extern Res RootScanParallel(ScanState ss, Root root);
 extern Arena RootArena(Root root);
 extern Bool RootOfAddr(Root *root, Arena arena, Addr addr);
-extern void RootAccess(Root root, AccessSet mode);
+extern void RootAccess(Root root, Addr addr, AccessSet mode);
+extern Bool RootDefer(Root root, Trace trace);
+extern Bool RootFindGrey(Root *rootReturn, Index *chunkReturn,
+                         Arena arena, Trace trace);
+extern Res RootScanChunk(ScanState ss, Root root, Index chunk);
 typedef Res (*RootIterateFn)(Root root, void *p);
 extern Res RootsIterate(Globals arena, RootIterateFn f, void *p);
 
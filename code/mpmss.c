@@ -177,6 +177,16 @@ static void testInArena(mps_arena_class_t arena_class, mps_arg_s *arena_args,
                mps_class_mvff(), args), "stress MVFF");
   } MPS_ARGS_END(args);
 
+  MPS_ARGS_BEGIN(args) {
+    mps_align_t align = sizeof(void *) << (rnd() % 4);
+    MPS_ARGS_ADD(args, MPS_KEY_ALIGN, align);
+    MPS_ARGS_ADD(args, MPS_KEY_MVFF_FIRST_FIT, rnd() % 2);
+    MPS_ARGS_ADD(args, MPS_KEY_MVFF_CACHES, 1 + rnd() % 4);
+    MPS_ARGS_ADD(args, MPS_KEY_SPARE, rnd_double());
+    die(stress(arena, NULL, randomSize8, align, "MVFF caches",
+               mps_class_mvff(), args), "stress MVFF caches");
+  } MPS_ARGS_END(args);
+
   MPS_ARGS_BEGIN(args) {
     mps_align_t align = sizeof(void *) << (rnd() % 4);
     MPS_ARGS_ADD(args, MPS_KEY_ALIGN, align);
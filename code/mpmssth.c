@@ -0,0 +1,290 @@
+/* mpmssth.c: MANUAL POOL STRESS TEST WITH THREADS
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Several threads allocate and free blocks in shared manual pools
+ * with mps_alloc and mps_free, while the main thread allocates in an
+ * AMC pool and runs collections.  MVFF and MFS pools allocate and
+ * free under their own locks without the arena lock when they can;
+ * see <design/thread-safety/#sol.pool-lock>.  An MVFF pool with
+ * caches allocates and frees small blocks under the cache locks; see
+ * <design/poolmvff/#design.cache>.  Each block is filled
+ * with a pattern identifying its owner, which is checked before the
+ * block is freed, so that blocks handed to two threads at once are
+ * detected.
+ */
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "mps.h"
+#include "mpsavm.h"
+#include "mpscamc.h"
+#include "mpscmfs.h"
+#include "mpscmvff.h"
+#include "mpslib.h"
+#include "testlib.h"
+#include "testthr.h"
+
+#include <stdio.h> /* printf */
+#include <time.h> /* clock, CLOCKS_PER_SEC */
+
+
+#define testArenaSIZE   ((size_t)64 << 20)
+#define threadsCOUNT    4
+#define blocksCOUNT     100
+#define opsCOUNT        50000
+#define unitSIZE        ((size_t)64)
+#define maxSIZE         ((size_t)1024)
+#define collectionsCOUNT 10
+#define bigSIZE         ((size_t)256 << 10)
+#define refsCOUNT       20000
+
+
+static mps_arena_t arena;
+static mps_addr_t refs[refsCOUNT]; /* keep some AMC objects alive */
+
+
+/* kid_s -- the state of a thread */
+
+typedef struct kid_s {
+  testthr_t thread;
+  mps_pool_t pool;
+  mps_bool_t fixed;     /* pool has fixed unit size */
+  mps_word_t id;        /* pattern for this thread's blocks */
+  mps_word_t *blocks[blocksCOUNT];
+  size_t sizes[blocksCOUNT];
+} kid_s, *kid_t;
+
+
+/* fill, check -- fill a block with a pattern, check it is still there */
+
+static void fill(mps_word_t *p, size_t size, mps_word_t pattern)
+{
+  size_t i;
+  for (i = 0; i < size / sizeof(mps_word_t); ++i)
+    p[i] = pattern + i;
+}
+
+static void check(mps_word_t *p, size_t size, mps_word_t pattern)
+{
+  size_t i;
+  for (i = 0; i < size / sizeof(mps_word_t); ++i)
+    Insist(p[i] == pattern + i);
+}
+
+
+/* kid_thread -- allocate and free blocks at random */
+
+static void *kid_thread(void *arg)
+{
+  kid_t kid = arg;
+  size_t i, j;
+  mps_thr_t thread;
+
+  /* Register the thread, so that the MPS suspends it during
+     collections, perhaps while it holds a pool lock. */
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+
+  for (j = 0; j < blocksCOUNT; ++j)
+    kid->blocks[j] = NULL;
+
+  for (i = 0; i < opsCOUNT; ++i) {
+    j = rnd() % blocksCOUNT;
+    if (kid->blocks[j] != NULL) {
+      check(kid->blocks[j], kid->sizes[j], kid->id + j);
+      mps_free(kid->pool, kid->blocks[j], kid->sizes[j]);
+      kid->blocks[j] = NULL;
+    } else {
+      mps_addr_t p;
+      size_t size = unitSIZE;
+      if (!kid->fixed)
+        size = (rnd() % (maxSIZE / sizeof(mps_word_t)) + 1)
+          * sizeof(mps_word_t);
+      die(mps_alloc(&p, kid->pool, size), "mps_alloc");
+      kid->blocks[j] = p;
+      kid->sizes[j] = size;
+      fill(kid->blocks[j], size, kid->id + j);
+    }
+  }
+
+  for (j = 0; j < blocksCOUNT; ++j)
+    if (kid->blocks[j] != NULL) {
+      check(kid->blocks[j], kid->sizes[j], kid->id + j);
+      mps_free(kid->pool, kid->blocks[j], kid->sizes[j]);
+    }
+
+  mps_thread_dereg(thread);
+  return NULL;
+}
+
+
+/* collect -- churn an AMC pool and collect while the threads run
+ *
+ * Unless the manual pool has a fixed unit size, also allocate large
+ * blocks in it while a collection is in progress.  These need the
+ * arena lock, and polling the arena may suspend the other threads,
+ * so the pool lock is claimed while they are suspended.
+ */
+
+static void collect(mps_ap_t ap, mps_pool_t pool, mps_bool_t fixed)
+{
+  size_t i;
+  for (i = 0; i < collectionsCOUNT; ++i) {
+    size_t j;
+    for (j = 0; j < refsCOUNT; ++j) {
+      mps_addr_t p;
+      size_t size = 4 * sizeof(mps_word_t);
+      do {
+        die(mps_reserve(&p, ap, size), "mps_reserve");
+        die(dylan_init(p, size, NULL, 0), "dylan_init");
+      } while (!mps_commit(ap, p, size));
+      refs[rnd() % refsCOUNT] = p;
+    }
+    die(mps_arena_start_collect(arena), "arena_start_collect");
+    for (j = 0; !fixed && j < 100; ++j) {
+      mps_addr_t p;
+      die(mps_alloc(&p, pool, bigSIZE), "mps_alloc(big)");
+      mps_free(pool, p, bigSIZE);
+    }
+    mps_arena_park(arena);
+    mps_arena_release(arena);
+  }
+}
+
+
+/* test -- run the threads on a pool */
+
+static void test(const char *name, mps_pool_t pool, mps_bool_t fixed,
+                 mps_ap_t ap)
+{
+  kid_s kids[threadsCOUNT];
+  clock_t start, finish;
+  size_t i;
+
+  printf("Pool class %s\n", name);
+
+  start = clock();
+  for (i = 0; i < NELEMS(kids); ++i) {
+    kids[i].pool = pool;
+    kids[i].fixed = fixed;
+    kids[i].id = (mps_word_t)(i + 1) << (MPS_WORD_WIDTH / 2);
+    testthr_create(&kids[i].thread, kid_thread, &kids[i]);
+  }
+  collect(ap, pool, fixed);
+  for (i = 0; i < NELEMS(kids); ++i)
+    testthr_join(&kids[i].thread, NULL);
+  finish = clock();
+
+  Insist(mps_pool_total_size(pool) == mps_pool_free_size(pool));
+  printf("%d threads did %lu operations in %g seconds\n",
+         threadsCOUNT, (unsigned long)threadsCOUNT * opsCOUNT,
+         (double)(finish - start) / CLOCKS_PER_SEC);
+}
+
+
+int main(int argc, char *argv[])
+{
+  mps_fmt_t format;
+  mps_pool_t amc, pool;
+  mps_ap_t ap;
+  mps_root_t root;
+
+  testlib_init(argc, argv);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+
+  die(dylan_fmt(&format, arena), "fmt_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    die(mps_pool_create_k(&amc, arena, mps_class_amc(), args),
+        "pool_create(amc)");
+  } MPS_ARGS_END(args);
+  die(mps_ap_create_k(&ap, amc, mps_args_none), "ap_create");
+  die(mps_root_create_table(&root, arena, mps_rank_exact(), 0,
+                            refs, refsCOUNT),
+      "root_create_table");
+
+  die(mps_pool_create_k(&pool, arena, mps_class_mvff(), mps_args_none),
+      "pool_create(mvff)");
+  test("MVFF", pool, FALSE, ap);
+  mps_pool_destroy(pool);
+
+  /* Fewer caches than threads, so that threads share them. */
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_MVFF_CACHES, threadsCOUNT / 2);
+    die(mps_pool_create_k(&pool, arena, mps_class_mvff(), args),
+        "pool_create(mvff caches)");
+  } MPS_ARGS_END(args);
+  test("MVFF with caches", pool, FALSE, ap);
+  mps_pool_destroy(pool);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_MFS_UNIT_SIZE, unitSIZE);
+    die(mps_pool_create_k(&pool, arena, mps_class_mfs(), args),
+        "pool_create(mfs)");
+  } MPS_ARGS_END(args);
+  test("MFS", pool, TRUE, ap);
+  mps_pool_destroy(pool);
+
+  die(mps_pool_create_k(&pool, arena, mps_class_mvff_debug(), mps_args_none),
+      "pool_create(mvff debug)");
+  test("MVFF debug", pool, FALSE, ap);
+  mps_pool_destroy(pool);
+
+  mps_arena_park(arena);
+  mps_root_destroy(root);
+  mps_ap_destroy(ap);
+  mps_pool_destroy(amc);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -57,6 +57,12 @@ typedef struct mps_pool_class_s {
   PoolFinishMethod finish;      /* finish the pool descriptor */
   PoolAllocMethod alloc;        /* allocate memory from pool */
   PoolFreeMethod free;          /* free memory to pool */
+  PoolBulkAllocMethod bulkAlloc; /* allocate a list of blocks */
+  PoolBulkFreeMethod bulkFree;  /* free a list of blocks */
+  PoolTryAllocMethod tryAlloc;  /* allocate without the arena lock */
+  PoolTryFreeMethod tryFree;    /* free without the arena lock */
+  PoolTryAllocMethod cacheAlloc; /* allocate without the pool lock */
+  PoolTryFreeMethod cacheFree;  /* free without the pool lock */
   PoolBufferFillMethod bufferFill;      /* out-of-line reserve */
   PoolBufferEmptyMethod bufferEmpty;    /* out-of-line commit */
   PoolAccessMethod access;      /* handles read/write accesses */
@@ -64,6 +70,7 @@ typedef struct mps_pool_class_s {
   PoolGreyMethod grey;          /* grey non-white objects */
   PoolBlackenMethod blacken;    /* blacken grey objects without scanning */
   PoolScanMethod scan;          /* find references during tracing */
+  PoolScanCardsMethod scanCards; /* find references in dirty cards */
   PoolFixMethod fix;            /* referent reachable during tracing */
   PoolFixEmergencyMethod fixEmergency;  /* as fix, no failure allowed */
   PoolReclaimMethod reclaim;    /* reclaim dead objects after tracing */
@@ -108,6 +115,7 @@ typedef struct mps_pool_s {     /* generic structure */
   Align alignment;              /* alignment for units */
   Format format;                /* format only if class->attr&AttrFMT */
   PoolFixMethod fix;            /* fix method */
+  Lock lock;                    /* pool lock, or NULL; see .lock */
 } PoolStruct;
 
 
@@ -291,6 +299,7 @@ typedef struct LocusPrefStruct { /* locus placement preferences */
   Bool high;                    /* high or low */
   ZoneSet zones;                /* preferred zones */
   ZoneSet avoid;                /* zones to avoid */
+  Index node;                   /* preferred node, or LocusNodeANY */
 } LocusPrefStruct;
 
 
@@ -428,6 +437,8 @@ typedef struct ScanStateStruct {
   Rank rank;                    /* reference rank of scanning */
   Bool wasMarked;               /* design.mps.fix.protocol.was-ready */
   RefSet fixedSummary;          /* accumulated summary of fixed references */
+  Lock fixLock;                 /* <design/trace/#parallel.fix> */
+  Index node;                   /* <design/arena/#numa.copy> */
   STATISTIC_DECL(Count fixRefCount) /* refs which pass zone check */
   STATISTIC_DECL(Count segRefCount) /* refs which refer to segs */
   STATISTIC_DECL(Count whiteSegRefCount) /* refs which refer to white segs */
@@ -464,6 +475,7 @@ typedef struct TraceStruct {
   Size notCondemned;            /* collectable but not condemned */
   Size foundation;              /* initial grey set size */
   Work quantumWork;             /* tracing work to be done in each poll */
+  Clock pauseMax;               /* longest pause while trace was busy */
   STATISTIC_DECL(Count greySegCount) /* number of grey segs */
   STATISTIC_DECL(Count greySegMax) /* max number of grey segs */
   STATISTIC_DECL(Count rootScanCount) /* number of roots scanned */
@@ -488,6 +500,8 @@ typedef struct TraceStruct {
   Size preservedInPlaceSize;    /* bytes preserved in place */
   STATISTIC_DECL(Count reclaimCount) /* segments reclaimed */
   STATISTIC_DECL(Count reclaimSize) /* bytes reclaimed */
+  STATISTIC_DECL(Size nailedSegSize) /* bytes in nailed segs reclaimed */
+  STATISTIC_DECL(Size nailedFreedSize) /* bytes of those freed */
 } TraceStruct;
 
 
@@ -504,6 +518,7 @@ typedef struct mps_arena_class_s {
   ArenaCreateMethod create;
   ArenaDestroyMethod destroy;
   ArenaPurgeSpareMethod purgeSpare;
+  ArenaPurgeAgedMethod purgeAged;
   ArenaExtendMethod extend;
   ArenaGrowMethod grow;
   ArenaFreeMethod free;
@@ -516,6 +531,45 @@ typedef struct mps_arena_class_s {
 } ArenaClassStruct;
 
 
+/* PolicyClassStruct -- collection policy class structure
+ *
+ * See <design/strategy/#policy.class>.
+ */
+
+#define PolicyClassSig  ((Sig)0x5190C1C1) /* SIGnature POLICy CLass */
+
+typedef struct mps_policy_class_s {
+  InstClassStruct protocol;
+  size_t size;                  /* size of outer structure */
+  PolicyInitMethod init;        /* initialize the policy */
+  PolicyFinishMethod finish;    /* finish the policy */
+  PolicyShouldCollectWorldMethod shouldCollectWorld; /* idle collection? */
+  PolicyStartTraceMethod startTrace; /* consider starting a trace */
+  PolicyPollMethod poll;        /* do some tracing work? */
+  PolicyPollAgainMethod pollAgain; /* do another unit of work? */
+  PolicyPauseMethod pause;      /* record a pause in the mutator */
+  PolicyDescribeMethod describe; /* describe the policy */
+  Sig sig;                      /* .class.end-sig */
+} PolicyClassStruct;
+
+
+/* PolicyStruct -- generic collection policy structure
+ *
+ * Every policy keeps a histogram of the pauses it has caused; see
+ * <design/strategy/#policy.pause>.
+ */
+
+#define PolicySig       ((Sig)0x5190C1C7) /* SIGnature POLICY */
+
+typedef struct PolicyStruct {
+  InstStruct instStruct;
+  Sig sig;                      /* <design/sig/> */
+  Arena arena;                  /* owning arena */
+  Count pauses;                 /* number of pauses recorded */
+  Count pauseHistogram[POLICY_PAUSE_BUCKETS]; /* pauses by duration */
+} PolicyStruct;
+
+
 /* GlobalsStruct -- the global state associated with an arena
  *
  * .space: The arena structure holds the entire state of the MPS, and as
@@ -541,6 +595,7 @@ typedef struct GlobalsStruct {
   double allocMutatorSize;      /* fill-empty, only asymptotically accurate */
   double fillInternalSize;      /* total bytes filled, internal buffers */
   double emptyInternalSize;     /* total bytes emptied, internal buffers */
+  double backgroundFillSize;    /* <design/arena/#background.lag> */
 
   /* version field (<code/version.c>) */
   const char *mpsVersionString; /* MPSVersion() */
@@ -554,6 +609,7 @@ typedef struct GlobalsStruct {
 
   /* root fields (<code/root.c>) */
   RingStruct rootRing;          /* ring of roots attached to arena */
+  RingStruct rootGreyRing;      /* roots being scanned incrementally */
   Serial rootSerial;            /* serial of next root */
 
   /* remember summary (<code/trace.c>) */
@@ -633,6 +689,30 @@ typedef struct CBSStruct {
 } CBSStruct;
 
 
+/* BTreeStruct -- address-ordered B-tree of ranges
+ *
+ * BTree is a Land implementation that maintains a collection of
+ * disjoint ranges in a B-tree whose nodes summarize the sizes and
+ * zones of the ranges below them.
+ *
+ * See <code/btree.c>.
+ */
+
+#define BTreeSig ((Sig)0x519B78EE) /* SIGnature BTREE */
+
+typedef struct BTreeNodeStruct *BTreeNode;
+
+typedef struct BTreeStruct {
+  LandStruct landStruct;        /* superclass fields come first */
+  BTreeNode root;               /* root node, or NULL if empty */
+  Count height;                 /* number of levels of nodes */
+  Pool nodePool;                /* pool that manages nodes */
+  Bool ownPool;                 /* did we create nodePool? */
+  Size size;                    /* total size of ranges in tree */
+  Sig sig;                      /* .class.end-sig */
+} BTreeStruct;
+
+
 /* FailoverStruct -- fail over from one land to another
  *
  * Failover is a Land implementation that combines two other Lands,
@@ -705,6 +785,8 @@ typedef struct ShieldStruct {
   Count depth;       /* sum of depths of all segs */
   Count unsynced;    /* number of unsynced segments */
   Count holds;       /* number of holds */
+  Count flushSegs;   /* segments synced by queue flushes */
+  Count flushCalls;  /* protection calls made by queue flushes */
   SortStruct sortStruct; /* workspace for queue sort */
 } ShieldStruct;
 
@@ -747,6 +829,8 @@ typedef struct mps_arena_s {
   Size spareCommitted;          /* Amount of memory in hysteresis fund */
   Size spareCommitLimit;        /* Limit on spareCommitted */
   double pauseTime;             /* Maximum pause time, in seconds. */
+  double spareAge;              /* <design/arena/#spare.age> */
+  Count nodes;                  /* <design/arena/#numa> */
 
   Shift zoneShift;              /* see also <code/ref.c> */
   Size grainSize;               /* <design/arena/#grain> */
@@ -758,6 +842,8 @@ typedef struct mps_arena_s {
   RingStruct chunkRing;         /* all the chunks, in a ring for iteration */
   Tree chunkTree;               /* all the chunks, in a tree for fast lookup */
   Serial chunkSerial;           /* next chunk number */
+  Shift chunkMapShift;          /* <design/arena/#chunk.map> */
+  Chunk chunkMap[ARENA_CHUNK_MAP_LENGTH]; /* <design/arena/#chunk.map> */
 
   Bool hasFreeLand;              /* Is freeLand available? */
   MFSStruct freeCBSBlockPoolStruct;
@@ -793,6 +879,17 @@ typedef struct mps_arena_s {
   TraceSet flippedTraces;       /* set of running and flipped traces */
   TraceStruct trace[TraceLIMIT]; /* trace structures.  See
                                    <design/trace/#intance.limit> */
+  Count gcThreads;              /* <design/trace/#parallel> */
+  Workers workers;              /* collector threads, or NULL */
+  Lock fixLock;                 /* serializes parallel fixing, or NULL */
+  Bool background;              /* <design/arena/#background> */
+  Daemon daemon;                /* background collector, or NULL */
+  Bool cardMarking;             /* <design/write-barrier/#card> */
+  mps_cards_s cardsStruct;      /* card table, if cardMarking */
+  Bool userfaultfd;             /* <design/prot/#uffd> */
+  ProtUffd uffd;                /* userfaultfd write barrier, or NULL */
+  Bool safepoints;              /* <design/thread-manager/#safepoint> */
+  Policy policy;                /* <design/strategy/#policy.class> */
 
   /* trace ancillary fields (<code/traceanc.c>) */
   TraceStartMessage tsMessage[TraceLIMIT];  /* <design/message-gc/> */
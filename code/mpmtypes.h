@@ -72,6 +72,9 @@ typedef struct BufferClassStruct *BufferClass; /* <design/buffer/> */
 typedef unsigned BufferMode;            /* <design/buffer/> */
 typedef struct mps_fmt_s *Format;       /* design.mps.format */
 typedef struct LockStruct *Lock;        /* <code/lock.c>* */
+typedef struct WorkersStruct *Workers;  /* <code/worker.h> */
+typedef struct DaemonStruct *Daemon;    /* <code/worker.h> */
+typedef struct ProtUffdStruct *ProtUffd; /* <code/prot.h> */
 typedef struct mps_pool_s *Pool;        /* <design/pool/> */
 typedef Pool AbstractPool;
 typedef struct mps_pool_class_s *PoolClass;  /* <code/poolclas.c> */
@@ -105,6 +108,10 @@ typedef struct LandStruct *Land;        /* <design/land/> */
 typedef struct LandClassStruct *LandClass; /* <design/land/> */
 typedef unsigned FindDelete;            /* <design/land/> */
 typedef struct ShieldStruct *Shield; /* design.mps.shield */
+typedef struct mps_policy_class_s *PolicyClass; /* <design/strategy/#policy.class> */
+typedef struct PolicyStruct *Policy;    /* <design/strategy/#policy.class> */
+typedef Policy AbstractPolicy;
+typedef Policy HeuristicPolicy;
 typedef struct HistoryStruct *History;  /* design.mps.arena.ld */
 
 
@@ -116,6 +123,8 @@ typedef void (*ArenaDestroyMethod)(Arena arena);
 typedef Res (*ArenaInitMethod)(Arena arena, Size grainSize, ArgList args);
 typedef void (*ArenaFinishMethod)(Arena arena);
 typedef Size (*ArenaPurgeSpareMethod)(Arena arena, Size size);
+typedef Size (*ArenaPurgeAgedMethod)(Arena arena, Clock before,
+                                     Clock deadline);
 typedef Res (*ArenaExtendMethod)(Arena arena, Addr base, Size size);
 typedef Res (*ArenaGrowMethod)(Arena arena, LocusPref pref, Size size);
 typedef void (*ArenaFreeMethod)(Addr base, Size size, Pool pool);
@@ -192,6 +201,12 @@ typedef Res (*PoolInitMethod)(Pool pool, Arena arena, PoolClass klass, ArgList a
 typedef void (*PoolFinishMethod)(Pool pool);
 typedef Res (*PoolAllocMethod)(Addr *pReturn, Pool pool, Size size);
 typedef void (*PoolFreeMethod)(Pool pool, Addr old, Size size);
+typedef Res (*PoolBulkAllocMethod)(Count *countReturn, Addr *listIO,
+                                   Pool pool, Size size, Count count);
+typedef void (*PoolBulkFreeMethod)(Pool pool, Addr *listIO, Size size,
+                                   Count count);
+typedef Bool (*PoolTryAllocMethod)(Addr *pReturn, Pool pool, Size size);
+typedef Bool (*PoolTryFreeMethod)(Pool pool, Addr old, Size size);
 typedef Res (*PoolBufferFillMethod)(Addr *baseReturn, Addr *limitReturn,
                                     Pool pool, Buffer buffer, Size size);
 typedef void (*PoolBufferEmptyMethod)(Pool pool, Buffer buffer,
@@ -204,6 +219,7 @@ typedef void (*PoolGreyMethod)(Pool pool, Trace trace, Seg seg);
 typedef void (*PoolBlackenMethod)(Pool pool, TraceSet traceSet, Seg seg);
 typedef Res (*PoolScanMethod)(Bool *totalReturn, ScanState ss,
                               Pool pool, Seg seg);
+typedef Res (*PoolScanCardsMethod)(ScanState ss, Pool pool, Seg seg);
 typedef Res (*PoolFixMethod)(Pool pool, ScanState ss, Seg seg,
                              Ref *refIO);
 typedef Res (*PoolFixEmergencyMethod)(Pool pool, ScanState ss,
@@ -268,6 +284,26 @@ typedef Res (*LandFindInZonesMethod)(Bool *foundReturn, Range rangeReturn, Range
 typedef Res (*LandDescribeMethod)(Land land, mps_lib_FILE *stream, Count depth);
 
 
+/* Policy*Method -- see <design/strategy/#policy.class> */
+
+typedef Res (*PolicyInitMethod)(Policy policy, Arena arena, ArgList args);
+typedef void (*PolicyFinishMethod)(Policy policy);
+typedef Bool (*PolicyShouldCollectWorldMethod)(Policy policy,
+                                               double availableTime,
+                                               Clock now,
+                                               Clock clocks_per_sec);
+typedef Bool (*PolicyStartTraceMethod)(Trace *traceReturn,
+                                       Bool *collectWorldReturn,
+                                       Policy policy,
+                                       Bool collectWorldAllowed);
+typedef Bool (*PolicyPollMethod)(Policy policy);
+typedef Bool (*PolicyPollAgainMethod)(Policy policy, Clock start,
+                                      Bool moreWork, Work tracedWork);
+typedef void (*PolicyPauseMethod)(Policy policy, Clock start, Clock end);
+typedef Res (*PolicyDescribeMethod)(Policy policy, mps_lib_FILE *stream,
+                                    Count depth);
+
+
 /* CONSTANTS */
 
 
@@ -291,7 +327,10 @@ typedef Res (*LandDescribeMethod)(Land land, mps_lib_FILE *stream, Count depth);
 #define AttrFMT         ((Attr)(1<<0))  /* <design/type/#attr> */
 #define AttrGC          ((Attr)(1<<1))
 #define AttrMOVINGGC    ((Attr)(1<<2))
-#define AttrMASK        (AttrFMT | AttrGC | AttrMOVINGGC)
+#define AttrPARSCAN     ((Attr)(1<<3))
+#define AttrLOCKED      ((Attr)(1<<4))
+#define AttrMASK        (AttrFMT | AttrGC | AttrMOVINGGC | AttrPARSCAN \
+                         | AttrLOCKED)
 
 
 /* Locus preferences */
@@ -302,6 +341,11 @@ enum {
   LocusPrefLIMIT
 };
 
+/* LocusNodeANY is the node of a locus preference that doesn't mind
+ * which NUMA node its memory comes from.  See <design/arena/#numa>. */
+
+#define LocusNodeANY ((Index)-1)
+
 
 /* Buffer modes */
 #define BufferModeATTACHED      ((BufferMode)(1<<0))
@@ -47,6 +47,7 @@
 #include "scan.c"
 #include "root.c"
 #include "seg.c"
+#include "card.c"
 #include "format.c"
 #include "buffer.c"
 #include "ref.c"
@@ -66,6 +67,7 @@
 #include "meter.c"
 #include "tree.c"
 #include "splay.c"
+#include "btree.c"
 #include "cbs.c"
 #include "ss.c"
 #include "version.c"
@@ -80,6 +82,7 @@
 #include "failover.c"
 #include "vm.c"
 #include "policy.c"
+#include "policypt.c"
 
 /* Additional pool classes */
 
@@ -103,6 +106,8 @@
 #if defined(PLATFORM_ANSI)
 
 #include "lockan.c"     /* generic locks */
+#include "workeran.c"   /* generic collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "than.c"       /* generic threads manager */
 #include "vman.c"       /* malloc-based pseudo memory mapping */
 #include "protan.c"     /* generic memory protection */
@@ -115,6 +120,8 @@
 #elif defined(MPS_PF_XCI3LL) || defined(MPS_PF_XCI3GC)
 
 #include "lockix.c"     /* Posix locks */
+#include "workerix.c"   /* Posix collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "thxc.c"       /* OS X Mach threading */
 #include "vmix.c"       /* Posix virtual memory */
 #include "protix.c"     /* Posix protection */
@@ -129,6 +136,8 @@
 #elif defined(MPS_PF_XCI6LL) || defined(MPS_PF_XCI6GC)
 
 #include "lockix.c"     /* Posix locks */
+#include "workerix.c"   /* Posix collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "thxc.c"       /* OS X Mach threading */
 #include "vmix.c"       /* Posix virtual memory */
 #include "protix.c"     /* Posix protection */
@@ -143,6 +152,8 @@
 #elif defined(MPS_PF_FRI3GC) || defined(MPS_PF_FRI3LL)
 
 #include "lockix.c"     /* Posix locks */
+#include "workerix.c"   /* Posix collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "thix.c"       /* Posix threading */
 #include "pthrdext.c"   /* Posix thread extensions */
 #include "vmix.c"       /* Posix virtual memory */
@@ -158,6 +169,8 @@
 #elif defined(MPS_PF_FRI6GC) || defined(MPS_PF_FRI6LL)
 
 #include "lockix.c"     /* Posix locks */
+#include "workerix.c"   /* Posix collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "thix.c"       /* Posix threading */
 #include "pthrdext.c"   /* Posix thread extensions */
 #include "vmix.c"       /* Posix virtual memory */
@@ -173,11 +186,13 @@
 #elif defined(MPS_PF_LII3GC)
 
 #include "lockli.c"     /* Linux locks */
+#include "workerix.c"   /* Posix collector workers */
 #include "thix.c"       /* Posix threading */
 #include "pthrdext.c"   /* Posix thread extensions */
 #include "vmix.c"       /* Posix virtual memory */
 #include "protix.c"     /* Posix protection */
 #include "protli.c"     /* Linux protection */
+#include "protufli.c"   /* Linux userfaultfd write barrier */
 #include "proti3.c"     /* 32-bit Intel mutator context */
 #include "prmci3li.c"   /* 32-bit Intel for Linux mutator context */
 #include "span.c"       /* generic stack probe */
@@ -188,11 +203,13 @@
 #elif defined(MPS_PF_LII6GC) || defined(MPS_PF_LII6LL)
 
 #include "lockli.c"     /* Linux locks */
+#include "workerix.c"   /* Posix collector workers */
 #include "thix.c"       /* Posix threading */
 #include "pthrdext.c"   /* Posix thread extensions */
 #include "vmix.c"       /* Posix virtual memory */
 #include "protix.c"     /* Posix protection */
 #include "protli.c"     /* Linux protection */
+#include "protufli.c"   /* Linux userfaultfd write barrier */
 #include "proti6.c"     /* 64-bit Intel mutator context */
 #include "prmci6li.c"   /* 64-bit Intel for Linux mutator context */
 #include "span.c"       /* generic stack probe */
@@ -203,6 +220,8 @@
 #elif defined(MPS_PF_W3I3MV)
 
 #include "lockw3.c"     /* Windows locks */
+#include "workeran.c"   /* generic collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "thw3.c"       /* Windows threading */
 #include "thw3i3.c"     /* Windows on 32-bit Intel thread stack scan */
 #include "vmw3.c"       /* Windows virtual memory */
@@ -218,6 +237,8 @@
 #elif defined(MPS_PF_W3I6MV)
 
 #include "lockw3.c"     /* Windows locks */
+#include "workeran.c"   /* generic collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "thw3.c"       /* Windows threading */
 #include "thw3i6.c"     /* Windows on 64-bit Intel thread stack scan */
 #include "vmw3.c"       /* Windows virtual memory */
@@ -233,6 +254,8 @@
 #elif defined(MPS_PF_W3I3PC)
 
 #include "lockw3.c"     /* Windows locks */
+#include "workeran.c"   /* generic collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "thw3.c"       /* Windows threading */
 #include "thw3i3.c"     /* Windows on 32-bit Intel thread stack scan */
 #include "vmw3.c"       /* Windows virtual memory */
@@ -248,6 +271,8 @@
 #elif defined(MPS_PF_W3I6PC)
 
 #include "lockw3.c"     /* Windows locks */
+#include "workeran.c"   /* generic collector workers */
+#include "protufan.c"   /* generic userfaultfd write barrier */
 #include "thw3.c"       /* Windows threading */
 #include "thw3i6.c"     /* Windows on 64-bit Intel thread stack scan */
 #include "vmw3.c"       /* Windows virtual memory */
@@ -52,11 +52,13 @@ typedef struct mps_chain_s  *mps_chain_t;  /* chain */
 typedef struct mps_fmt_s    *mps_fmt_t;    /* object format */
 typedef struct mps_root_s   *mps_root_t;   /* root */
 typedef struct mps_pool_class_s  *mps_pool_class_t;  /* pool class */
+typedef struct mps_policy_class_s *mps_policy_class_t; /* policy class */
 typedef mps_pool_class_t mps_class_t;      /* deprecated alias */
 typedef struct mps_thr_s    *mps_thr_t;    /* thread registration */
 typedef struct mps_ap_s     *mps_ap_t;     /* allocation point */
 typedef struct mps_ld_s     *mps_ld_t;     /* location dependency */
 typedef struct mps_ss_s     *mps_ss_t;     /* scan state */
+typedef struct mps_cards_s  *mps_cards_t;  /* card table */
 typedef struct mps_message_s
   *mps_message_t;                          /* message */
 typedef struct mps_alloc_pattern_s
@@ -155,6 +157,7 @@ typedef struct mps_arg_s {
     mps_fmt_pad_t fmt_pad;
     mps_fmt_class_t fmt_class;
     mps_pool_t pool;
+    mps_policy_class_t policy_class;
   } val;
 } mps_arg_s;
 
@@ -171,24 +174,60 @@ extern const struct mps_key_s _mps_key_ARENA_SIZE;
 extern const struct mps_key_s _mps_key_ARENA_ZONED;
 #define MPS_KEY_ARENA_ZONED     (&_mps_key_ARENA_ZONED)
 #define MPS_KEY_ARENA_ZONED_FIELD b
+extern const struct mps_key_s _mps_key_ARENA_GC_THREADS;
+#define MPS_KEY_ARENA_GC_THREADS (&_mps_key_ARENA_GC_THREADS)
+#define MPS_KEY_ARENA_GC_THREADS_FIELD count
+extern const struct mps_key_s _mps_key_ARENA_BACKGROUND;
+#define MPS_KEY_ARENA_BACKGROUND (&_mps_key_ARENA_BACKGROUND)
+#define MPS_KEY_ARENA_BACKGROUND_FIELD b
+extern const struct mps_key_s _mps_key_ARENA_CARD_MARKING;
+#define MPS_KEY_ARENA_CARD_MARKING (&_mps_key_ARENA_CARD_MARKING)
+#define MPS_KEY_ARENA_CARD_MARKING_FIELD b
+extern const struct mps_key_s _mps_key_ARENA_USERFAULTFD;
+#define MPS_KEY_ARENA_USERFAULTFD (&_mps_key_ARENA_USERFAULTFD)
+#define MPS_KEY_ARENA_USERFAULTFD_FIELD b
+extern const struct mps_key_s _mps_key_ARENA_SAFEPOINTS;
+#define MPS_KEY_ARENA_SAFEPOINTS (&_mps_key_ARENA_SAFEPOINTS)
+#define MPS_KEY_ARENA_SAFEPOINTS_FIELD b
+extern const struct mps_key_s _mps_key_ARENA_NODES;
+#define MPS_KEY_ARENA_NODES     (&_mps_key_ARENA_NODES)
+#define MPS_KEY_ARENA_NODES_FIELD count
+extern const struct mps_key_s _mps_key_ARENA_POLICY;
+#define MPS_KEY_ARENA_POLICY    (&_mps_key_ARENA_POLICY)
+#define MPS_KEY_ARENA_POLICY_FIELD policy_class
+extern const struct mps_key_s _mps_key_POLICY_HEAP_MAX;
+#define MPS_KEY_POLICY_HEAP_MAX (&_mps_key_POLICY_HEAP_MAX)
+#define MPS_KEY_POLICY_HEAP_MAX_FIELD size
 extern const struct mps_key_s _mps_key_FORMAT;
 #define MPS_KEY_FORMAT          (&_mps_key_FORMAT)
 #define MPS_KEY_FORMAT_FIELD    format
 extern const struct mps_key_s _mps_key_CHAIN;
 #define MPS_KEY_CHAIN           (&_mps_key_CHAIN)
 #define MPS_KEY_CHAIN_FIELD     chain
+extern const struct mps_key_s _mps_key_CHAIN_ADAPTIVE;
+#define MPS_KEY_CHAIN_ADAPTIVE  (&_mps_key_CHAIN_ADAPTIVE)
+#define MPS_KEY_CHAIN_ADAPTIVE_FIELD b
 extern const struct mps_key_s _mps_key_GEN;
 #define MPS_KEY_GEN             (&_mps_key_GEN)
 #define MPS_KEY_GEN_FIELD       u
 extern const struct mps_key_s _mps_key_RANK;
 #define MPS_KEY_RANK            (&_mps_key_RANK)
 #define MPS_KEY_RANK_FIELD      rank
+extern const struct mps_key_s _mps_key_AP_PRETENURE;
+#define MPS_KEY_AP_PRETENURE    (&_mps_key_AP_PRETENURE)
+#define MPS_KEY_AP_PRETENURE_FIELD b
+extern const struct mps_key_s _mps_key_AP_NODE;
+#define MPS_KEY_AP_NODE         (&_mps_key_AP_NODE)
+#define MPS_KEY_AP_NODE_FIELD   count
 extern const struct mps_key_s _mps_key_COMMIT_LIMIT;
 #define MPS_KEY_COMMIT_LIMIT (&_mps_key_COMMIT_LIMIT)
 #define MPS_KEY_COMMIT_LIMIT_FIELD size
 extern const struct mps_key_s _mps_key_SPARE_COMMIT_LIMIT;
 #define MPS_KEY_SPARE_COMMIT_LIMIT (&_mps_key_SPARE_COMMIT_LIMIT)
 #define MPS_KEY_SPARE_COMMIT_LIMIT_FIELD size
+extern const struct mps_key_s _mps_key_SPARE_AGE;
+#define MPS_KEY_SPARE_AGE       (&_mps_key_SPARE_AGE)
+#define MPS_KEY_SPARE_AGE_FIELD d
 extern const struct mps_key_s _mps_key_PAUSE_TIME;
 #define MPS_KEY_PAUSE_TIME      (&_mps_key_PAUSE_TIME)
 #define MPS_KEY_PAUSE_TIME_FIELD d
@@ -221,6 +260,9 @@ extern const struct mps_key_s _mps_key_INTERIOR;
 extern const struct mps_key_s _mps_key_VMW3_TOP_DOWN;
 #define MPS_KEY_VMW3_TOP_DOWN   (&_mps_key_VMW3_TOP_DOWN)
 #define MPS_KEY_VMW3_TOP_DOWN_FIELD b
+extern const struct mps_key_s _mps_key_ARENA_HUGE_PAGES;
+#define MPS_KEY_ARENA_HUGE_PAGES (&_mps_key_ARENA_HUGE_PAGES)
+#define MPS_KEY_ARENA_HUGE_PAGES_FIELD b
 
 extern const struct mps_key_s _mps_key_FMT_ALIGN;
 #define MPS_KEY_FMT_ALIGN   (&_mps_key_FMT_ALIGN)
@@ -460,6 +502,9 @@ extern size_t mps_arena_spare_commit_limit(mps_arena_t);
 extern double mps_arena_pause_time(mps_arena_t);
 extern void mps_arena_pause_time_set(mps_arena_t, double);
 
+extern mps_policy_class_t mps_policy_class_heuristic(void);
+extern mps_policy_class_t mps_policy_class_pause(void);
+
 extern mps_bool_t mps_arena_has_addr(mps_arena_t, mps_addr_t);
 extern mps_bool_t mps_addr_pool(mps_pool_t *, mps_arena_t, mps_addr_t);
 extern mps_bool_t mps_addr_fmt(mps_fmt_t *, mps_arena_t, mps_addr_t);
@@ -509,6 +554,9 @@ typedef struct mps_gen_param_s {
 
 extern mps_res_t mps_chain_create(mps_chain_t *, mps_arena_t,
                                   size_t, mps_gen_param_s *);
+extern mps_res_t mps_chain_create_k(mps_chain_t *, mps_arena_t,
+                                    size_t, mps_gen_param_s *,
+                                    mps_arg_s []);
 extern void mps_chain_destroy(mps_chain_t);
 
 
@@ -661,6 +709,29 @@ extern mps_res_t mps_reserve_with_reservoir_permit(mps_addr_t *,
    (_mps_ap)->limit != 0 || mps_ap_trip(_mps_ap, _p, _size))
 
 
+/* Card Marking */
+/* .cards: Keep in sync with <code/card.c>. */
+
+typedef struct mps_cards_s {    /* card table descriptor */
+  unsigned char *_table;        /* one byte per card, non-zero if dirty */
+  mps_word_t _shift;            /* log2 of the card size in bytes */
+  mps_word_t _mask;             /* number of cards in the table less one */
+} mps_cards_s;
+
+extern mps_cards_t mps_arena_cards(mps_arena_t);
+
+#define MPS_CARD_MARK(_cards, _p) \
+  ((_cards)->_table[((mps_word_t)(_p) >> (_cards)->_shift) \
+                    & (_cards)->_mask] = 1)
+
+#define MPS_WRITE_BARRIER(_cards, _p_io, _ref) \
+  MPS_BEGIN \
+    MPS_CARD_MARK(_cards, _p_io); \
+    *(_p_io) = (_ref); \
+    MPS_CARD_MARK(_cards, _p_io); \
+  MPS_END
+
+
 /* Root Creation and Destruction */
 
 extern mps_res_t mps_root_create(mps_root_t *, mps_arena_t, mps_rank_t,
@@ -714,6 +785,9 @@ extern void (mps_tramp)(void **, mps_tramp_t, void *, size_t);
 
 extern mps_res_t mps_thread_reg(mps_thr_t *, mps_arena_t);
 extern void mps_thread_dereg(mps_thr_t);
+extern void mps_thread_safepoint(mps_thr_t);
+extern void mps_thread_safepoint_begin(mps_thr_t);
+extern void mps_thread_safepoint_end(mps_thr_t);
 
 
 /* Location Dependency */
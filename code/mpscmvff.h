@@ -18,6 +18,9 @@ extern const struct mps_key_s _mps_key_MVFF_ARENA_HIGH;
 extern const struct mps_key_s _mps_key_MVFF_FIRST_FIT;
 #define MPS_KEY_MVFF_FIRST_FIT (&_mps_key_MVFF_FIRST_FIT)
 #define MPS_KEY_MVFF_FIRST_FIT_FIELD b
+extern const struct mps_key_s _mps_key_MVFF_CACHES;
+#define MPS_KEY_MVFF_CACHES (&_mps_key_MVFF_CACHES)
+#define MPS_KEY_MVFF_CACHES_FIELD count
 
 #define mps_mvff_free_size mps_pool_free_size
 #define mps_mvff_size mps_pool_total_size
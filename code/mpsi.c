@@ -391,6 +391,24 @@ mps_bool_t mps_arena_has_addr(mps_arena_t arena, mps_addr_t p)
 }
 
 
+/* mps_arena_cards -- return the card table of an arena
+ *
+ * Returns NULL unless the arena was created with
+ * MPS_KEY_ARENA_CARD_MARKING.  See <design/write-barrier/#card>.
+ */
+
+mps_cards_t mps_arena_cards(mps_arena_t arena)
+{
+  mps_cards_t cards;
+
+  ArenaEnter(arena);
+  AVERT(Arena, arena);
+  cards = ArenaCardMarking(arena) ? ArenaCards(arena) : NULL;
+  ArenaLeave(arena);
+  return cards;
+}
+
+
 /* mps_addr_pool -- return the pool containing the given address
  *
  * Wrapper for PoolOfAddr.  Note: may return an MPS-internal pool.
@@ -748,6 +766,15 @@ mps_res_t mps_alloc(mps_addr_t *p_o, mps_pool_t pool, size_t size)
   AVER(TESTT(Pool, pool));
   arena = PoolArena(pool);
 
+  /* .alloc.try: Allocate without the arena lock if the pool can.  See
+     <design/thread-safety/#sol.pool-lock>. */
+  AVER(p_o != NULL);
+  AVER(size > 0);
+  if (PoolTryAlloc(&p, pool, size)) {
+    *p_o = (mps_addr_t)p;
+    return MPS_RES_OK;
+  }
+
   ArenaEnter(arena);
 
   ArenaPoll(ArenaGlobals(arena)); /* .poll */
@@ -790,6 +817,11 @@ void mps_free(mps_pool_t pool, mps_addr_t p, size_t size)
   AVER(TESTT(Pool, pool));
   arena = PoolArena(pool);
 
+  /* See .alloc.try. */
+  AVER(size > 0);
+  if (PoolTryFree(pool, (Addr)p, size))
+    return;
+
   ArenaEnter(arena);
 
   AVERT(Pool, pool);
@@ -1622,6 +1654,39 @@ void mps_thread_dereg(mps_thr_t thread)
   ArenaLeave(arena);
 }
 
+
+/* mps_thread_safepoint -- stop the thread if the collector asks
+ *
+ * These functions must not claim the arena lock: the collector holds
+ * it while waiting for the thread. See
+ * <design/thread-manager/#safepoint>.
+ */
+
+void mps_thread_safepoint(mps_thr_t thread)
+{
+  AVER(ThreadCheckSimple(thread));
+  ThreadSafepointPoll(thread);
+}
+
+
+/* mps_thread_safepoint_begin, mps_thread_safepoint_end -- bracket a
+ * region in which the thread may be treated as stopped */
+
+void mps_thread_safepoint_begin(mps_thr_t thread)
+{
+  AVER(ThreadCheckSimple(thread));
+  UNUSED(thread);
+  ThreadSafepointEnter();
+}
+
+void mps_thread_safepoint_end(mps_thr_t thread)
+{
+  AVER(ThreadCheckSimple(thread));
+  UNUSED(thread);
+  ThreadSafepointLeave();
+  ThreadSafepoint();
+}
+
 void mps_ld_reset(mps_ld_t ld, mps_arena_t arena)
 {
   ArenaEnter(arena);
@@ -2089,6 +2154,16 @@ size_t mps_reservoir_available(mps_arena_t arena)
 
 mps_res_t mps_chain_create(mps_chain_t *chain_o, mps_arena_t arena,
                            size_t gen_count, mps_gen_param_s *params)
+{
+  return mps_chain_create_k(chain_o, arena, gen_count, params, mps_args_none);
+}
+
+
+/* mps_chain_create_k -- create a chain with keyword arguments */
+
+mps_res_t mps_chain_create_k(mps_chain_t *chain_o, mps_arena_t arena,
+                             size_t gen_count, mps_gen_param_s *params,
+                             mps_arg_s args[])
 {
   Chain chain;
   Res res;
@@ -2096,7 +2171,8 @@ mps_res_t mps_chain_create(mps_chain_t *chain_o, mps_arena_t arena,
   ArenaEnter(arena);
 
   AVER(gen_count > 0);
-  res = ChainCreate(&chain, arena, gen_count, (GenParamStruct *)params);
+  res = ChainCreate(&chain, arena, gen_count, (GenParamStruct *)params,
+                    args);
 
   ArenaLeave(arena);
   if (res != ResOK)
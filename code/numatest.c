@@ -0,0 +1,233 @@
+/* numatest.c: NUMA NODE TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Check that allocation points created with MPS_KEY_AP_NODE allocate
+ * on their node, and that AMC copies objects to the node of the
+ * object that refers to them.  See <design/arena/#numa>.
+ *
+ * The arena's node map is simulated (see
+ * <design/arena/#numa.simulate>), so the test checks the node of each
+ * address with ArenaNodeOfAddr rather than asking the operating
+ * system, and it works on a machine with only one node.
+ *
+ * Each holder object is allocated on one node, and refers to young
+ * objects that were allocated on another node.  After a collection,
+ * the holders must still be on their own nodes (they are referred to
+ * only by a root) and the young objects must be on their holder's
+ * node.
+ */
+
+#include "mpm.h"
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define testArenaSIZE   ((size_t)64 << 20)
+#define holderCOUNT     1000
+#define youngSLOTS      4
+#define collectCOUNT    3
+
+static mps_gen_param_s testChain[2] = {
+  { 1024, 0.5 }, { (size_t)1 << 20, 0.5 } };
+
+
+static mps_addr_t holders[holderCOUNT];
+
+
+/* nodeOf -- the node of an object */
+
+static Index nodeOf(mps_arena_t arena, mps_word_t obj)
+{
+  return ArenaNodeOfAddr((Arena)arena, (Addr)obj);
+}
+
+
+/* checkNodeZones -- check that the nodes partition the zones */
+
+static void checkNodeZones(mps_arena_t mpsArena, size_t nodes)
+{
+  Arena arena = (Arena)mpsArena;
+  ZoneSet all = ZoneSetEMPTY;
+  Index node;
+
+  Insist(ArenaNodes(arena) == nodes);
+  for (node = 0; node < nodes; ++node) {
+    ZoneSet zones = ArenaNodeZones(arena, node);
+    Insist(zones != ZoneSetEMPTY);
+    Insist(ZoneSetInter(all, zones) == ZoneSetEMPTY);
+    all = ZoneSetUnion(all, zones);
+  }
+  Insist(all == ZoneSetUNIV);
+}
+
+
+/* check -- check the nodes of the holders and their young objects */
+
+static void check(mps_arena_t arena, size_t nodes)
+{
+  size_t i, j;
+
+  for (i = 0; i < holderCOUNT; ++i) {
+    mps_word_t holder = (mps_word_t)holders[i];
+    Index node = i % nodes;
+    cdie(dylan_check(holders[i]), "dylan_check holder");
+    Insist(nodeOf(arena, holder) == node);
+    for (j = 0; j < youngSLOTS; ++j) {
+      mps_word_t young = DYLAN_VECTOR_SLOT(holder, j);
+      cdie(dylan_check((mps_addr_t)young), "dylan_check young");
+      Insist(nodeOf(arena, young) == node);
+    }
+  }
+}
+
+
+static void test(size_t nodes)
+{
+  mps_arena_t arena;
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_pool_t pool;
+  mps_ap_t ap[ARENA_NODE_MAX];
+  mps_root_t root;
+  mps_res_t res;
+  size_t i, j;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_NODES, nodes);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  checkNodeZones(arena, nodes);
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, 2, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, mps_class_amc(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_root_create_table(&root, arena, mps_rank_exact(), 0,
+                            holders, holderCOUNT),
+      "root_create_table");
+  for (i = 0; i < nodes; ++i) {
+    MPS_ARGS_BEGIN(args) {
+      MPS_ARGS_ADD(args, MPS_KEY_AP_NODE, i);
+      die(mps_ap_create_k(&ap[i], pool, args), "ap_create");
+    } MPS_ARGS_END(args);
+  }
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_AP_NODE, nodes);
+    res = mps_ap_create_k(&ap[nodes], pool, args);
+    cdie(res == MPS_RES_PARAM, "ap_create with bad node");
+  } MPS_ARGS_END(args);
+
+  /* Holder i is on node i % nodes, and its young objects are
+     allocated on the next node. */
+  mps_arena_park(arena);
+  for (i = 0; i < holderCOUNT; ++i) {
+    Index node = i % nodes;
+    mps_word_t holder;
+    die(make_dylan_vector(&holder, ap[node], youngSLOTS),
+        "make_dylan_vector holder");
+    Insist(nodeOf(arena, holder) == node);
+    holders[i] = (mps_addr_t)holder;
+    for (j = 0; j < youngSLOTS; ++j) {
+      Index other = (node + 1) % nodes;
+      mps_word_t young;
+      die(make_dylan_vector(&young, ap[other], 1 + rnd() % 4),
+          "make_dylan_vector young");
+      Insist(nodeOf(arena, young) == other);
+      DYLAN_VECTOR_SLOT(holder, j) = young;
+    }
+  }
+
+  for (i = 0; i < collectCOUNT; ++i) {
+    die(mps_arena_collect(arena), "arena_collect");
+    check(arena, nodes);
+  }
+  printf("%lu nodes: %d objects on their referrer's node\n",
+         (unsigned long)nodes, holderCOUNT * (1 + youngSLOTS));
+
+  mps_arena_park(arena);
+  for (i = 0; i < nodes; ++i)
+    mps_ap_destroy(ap[i]);
+  mps_root_destroy(root);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  mps_arena_t arena;
+
+  testlib_init(argc, argv);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_NODES, 0);
+    cdie(mps_arena_create_k(&arena, mps_arena_class_vm(), args)
+         == MPS_RES_PARAM, "arena_create with no nodes");
+  } MPS_ARGS_END(args);
+
+  test(1);
+  test(2);
+  test(3);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -0,0 +1,196 @@
+/* pausess.c: PAUSE-TARGET POLICY STRESS TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Run the same workload in an AMC pool under the heuristic policy and
+ * under the pause-target policy, and check that the 99th percentile
+ * of the pauses that the pause-target policy causes is within the
+ * arena's pause time, allowing pauseSLACK for the resolution of the
+ * histogram.  See <design/strategy/#policy.pause-target.test>.
+ */
+
+#include "mpm.h"
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define testArenaSIZE   ((size_t)64 << 20)
+#define objSLOTS        4
+#define testALLOC       ((size_t)128 << 20)
+#define tablesCOUNT     64
+#define tableSLOTS      256
+#define pauseTIME       0.005
+#define pauseSLACK      1.3
+#define genCOUNT        2
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 512, 0.9 }, { 2048, 0.5 } };
+
+/* tables -- the roots, which refer to tables of live objects
+ *
+ * There are few roots, so that the flip, which scans them all at
+ * once, is short: otherwise it would dominate the pauses whatever the
+ * policy did.
+ */
+
+static mps_addr_t tables[tablesCOUNT];
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(mps_ap_t ap, size_t size)
+{
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, NULL, 0);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+/* test -- run the workload under a policy and return its p99 pause */
+
+static double test(mps_policy_class_t policy, const char *name)
+{
+  mps_arena_t arena;
+  mps_thr_t thread;
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_root_t root;
+  mps_pool_t pool;
+  mps_ap_t ap;
+  size_t size = (objSLOTS + 2) * sizeof(mps_word_t);
+  size_t i, objs = testALLOC / size;
+  Policy p;
+  double p99;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_PAUSE_TIME, pauseTIME);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_POLICY, policy);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain),
+      "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, mps_class_amc(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_ap_create(&ap, pool, mps_rank_exact()), "ap_create");
+
+  for (i = 0; i < tablesCOUNT; ++i)
+    tables[i] = NULL;
+  die(mps_root_create_table(&root, arena, mps_rank_exact(), (mps_rm_t)0,
+                            tables, tablesCOUNT),
+      "root_create_table");
+  for (i = 0; i < tablesCOUNT; ++i) {
+    mps_word_t table;
+    die(make_dylan_vector(&table, ap, tableSLOTS), "make_dylan_vector");
+    tables[i] = (mps_addr_t)table;
+  }
+
+  /* Each new object replaces a random one in the tables, so that the
+     live set stays the same size. */
+  for (i = 0; i < objs; ++i) {
+    mps_addr_t obj = make(ap, size);
+    size_t t = rnd() % tablesCOUNT;
+    DYLAN_VECTOR_SLOT(tables[t], rnd() % tableSLOTS) = (mps_word_t)obj;
+  }
+
+  p = ArenaPolicy((Arena)arena);
+  p99 = PolicyPauseQuantile(p, 0.99);
+  printf("%s: %lu pauses, p50 %g, p99 %g, max %g\n", name,
+         (unsigned long)PolicyPauseCount(p), PolicyPauseQuantile(p, 0.5),
+         p99, PolicyPauseQuantile(p, 1.0));
+
+  mps_arena_park(arena);
+  mps_ap_destroy(ap);
+  mps_root_destroy(root);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_thread_dereg(thread);
+  mps_arena_destroy(arena);
+  return p99;
+}
+
+
+int main(int argc, char *argv[])
+{
+  double p99;
+
+  testlib_init(argc, argv);
+
+  (void)test(mps_policy_class_heuristic(), "heuristic");
+  p99 = test(mps_policy_class_pause(), "pause");
+  Insist(p99 <= pauseTIME * pauseSLACK);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
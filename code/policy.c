@@ -7,6 +7,12 @@
  * policy can be maintained and adjusted.
  *
  * .sources: <design/strategy/>.
+ *
+ * .class: The decisions about when to collect and how much work to do
+ * are made by the arena's policy, an instance of a PolicyClass chosen
+ * by the client.  This module defines the generic policy, and the
+ * heuristic policy that the MPS has always used.  See
+ * <design/strategy/#policy.class>.
  */
 
 #include "locus.h"
@@ -15,6 +21,34 @@
 SRCID(policy, "$Id$");
 
 
+/* policyAllocOnNode -- try to allocate in the zones of a NUMA node
+ *
+ * Tries the requested zones, then free zones, that belong to the node
+ * that pref prefers.  See <design/arena/#numa.alloc>.
+ */
+
+static Res policyAllocOnNode(Tract *tractReturn, Arena arena, LocusPref pref,
+                             Size size, Pool pool)
+{
+  Res res;
+  ZoneSet nodeZones, zones, moreZones;
+
+  nodeZones = ZoneSetDiff(ArenaNodeZones(arena, pref->node), pref->avoid);
+  zones = ZoneSetInter(pref->zones, nodeZones);
+  if (zones != ZoneSetEMPTY) {
+    res = ArenaFreeLandAlloc(tractReturn, arena, zones, pref->high,
+                             size, pool);
+    if (res == ResOK)
+      return res;
+  }
+  moreZones = ZoneSetUnion(zones, ZoneSetInter(arena->freeZones, nodeZones));
+  if (moreZones != zones)
+    return ArenaFreeLandAlloc(tractReturn, arena, moreZones, pref->high,
+                              size, pool);
+  return ResRESOURCE;
+}
+
+
 /* PolicyAlloc -- allocation policy
  *
  * This is the code responsible for making decisions about where to allocate
@@ -54,6 +88,20 @@ Res PolicyAlloc(Tract *tractReturn, Arena arena, LocusPref pref,
     }
   }
 
+  /* Plan N: if a NUMA node is preferred, allocate in its zones,
+   * extending the arena if necessary, before trying other nodes. */
+  if (pref->node != LocusNodeANY && ArenaNodes(arena) > 1) {
+    res = policyAllocOnNode(&tract, arena, pref, size, pool);
+    if (res == ResOK)
+      goto found;
+    res = Method(Arena, arena, grow)(arena, pref, size);
+    if (res == ResOK) {
+      res = policyAllocOnNode(&tract, arena, pref, size, pool);
+      if (res == ResOK)
+        goto found;
+    }
+  }
+
   /* Plan A: allocate from the free land in the requested zones */
   zones = ZoneSetDiff(pref->zones, pref->avoid);
   if (zones != ZoneSetEMPTY) {
@@ -155,7 +203,7 @@ static double policyCollectionTime(Arena arena)
 }
 
 
-/* PolicyShouldCollectWorld -- should we collect the world now?
+/* heuristicShouldCollectWorld -- should we collect the world now?
  *
  * Return TRUE if we should try collecting the world now, FALSE if
  * not.
@@ -166,13 +214,15 @@ static double policyCollectionTime(Arena arena)
  * opportunistically.
  */
 
-Bool PolicyShouldCollectWorld(Arena arena, double availableTime,
-                              Clock now, Clock clocks_per_sec)
+static Bool heuristicShouldCollectWorld(Policy policy, double availableTime,
+                                        Clock now, Clock clocks_per_sec)
 {
+  Arena arena;
   Size collectableSize;
   double collectionTime, sinceLastWorldCollect;
 
-  AVERT(Arena, arena);
+  AVERT(Policy, policy);
+  arena = PolicyArena(policy);
   /* Can't collect the world if we're already collecting. */
   AVER(arena->busyTraces == TraceSetEMPTY);
 
@@ -242,14 +292,20 @@ static Res policyCondemnChain(double *mortalityReturn, Chain chain, Trace trace)
     gen = &chain->gens[i];
     AVERT(GenDesc, gen);
     condemnedSet = ZoneSetUnion(condemnedSet, gen->zones);
+    /* <design/strategy/#alloc.reserve.release> */
+    (void)GenDescReleaseReserves(gen);
     genTotalSize = GenDescTotalSize(gen);
     genNewSize = GenDescNewSize(gen);
+    GenDescCondemned(gen, genNewSize, genTotalSize - genNewSize);
     condemnedSize += genTotalSize;
     survivorSize += (Size)(genNewSize * (1.0 - gen->mortality))
                     /* predict survivors will survive again */
                     + (genTotalSize - genNewSize);
   }
   
+  for (i = topCondemnedGen + 1; i < chain->genCount; ++i)
+    GenDescCondemned(&chain->gens[i], 0, 0);
+
   AVER(condemnedSet != ZoneSetEMPTY || condemnedSize == 0);
   EVENT3(ChainCondemnAuto, chain, topCondemnedGen, chain->genCount);
   
@@ -265,11 +321,14 @@ static Res policyCondemnChain(double *mortalityReturn, Chain chain, Trace trace)
 }
 
 
-/* PolicyStartTrace -- consider starting a trace
+/* heuristicStartTrace -- consider starting a trace
  *
  * If collectWorldAllowed is TRUE, consider starting a collection of
  * the world. Otherwise, consider only starting collections of individual
- * chains or generations.
+ * chains or generations.  A collection of the world condemns
+ * everything, so it can only be started when no other trace is busy;
+ * a chain collection may run alongside other traces if there is a free
+ * trace id.  See <design/trace/#instance.start>.
  *
  * If a collection of the world was started, set *collectWorldReturn
  * to TRUE. Otherwise leave it unchanged.
@@ -278,12 +337,17 @@ static Res policyCondemnChain(double *mortalityReturn, Chain chain, Trace trace)
  * Otherwise, leave *traceReturn unchanged and return FALSE.
  */
 
-Bool PolicyStartTrace(Trace *traceReturn, Bool *collectWorldReturn,
-                      Arena arena, Bool collectWorldAllowed)
+static Bool heuristicStartTrace(Trace *traceReturn, Bool *collectWorldReturn,
+                                Policy policy, Bool collectWorldAllowed)
 {
+  Arena arena;
   Res res;
   Trace trace;
 
+  AVERT(Policy, policy);
+  arena = PolicyArena(policy);
+  AVER(!collectWorldAllowed || arena->busyTraces == TraceSetEMPTY);
+
   if (collectWorldAllowed) {
     Size sFoundation, sCondemned, sSurvivors, sConsTrace;
     double tTracePerScan; /* tTrace/cScan */
@@ -334,7 +398,8 @@ Bool PolicyStartTrace(Trace *traceReturn, Bool *collectWorldReturn,
       double mortality;
 
       res = TraceCreate(&trace, arena, TraceStartWhyCHAIN_GEN0CAP);
-      AVER(res == ResOK);
+      if (res != ResOK) /* no free trace id */
+        goto failStart;
       res = policyCondemnChain(&mortality, firstChain, trace);
       if (res != ResOK) /* should try some other trace, really @@@@ */
         goto failCondemn;
@@ -359,22 +424,22 @@ failStart:
 }
 
 
-/* PolicyPoll -- do some tracing work?
+/* heuristicPoll -- do some tracing work?
  *
  * Return TRUE if the MPS should do some tracing work; FALSE if it
  * should return to the mutator.
  */
 
-Bool PolicyPoll(Arena arena)
+static Bool heuristicPoll(Policy policy)
 {
   Globals globals;
-  AVERT(Arena, arena);
-  globals = ArenaGlobals(arena);
+  AVERT(Policy, policy);
+  globals = ArenaGlobals(PolicyArena(policy));
   return globals->pollThreshold <= globals->fillMutatorSize;
 }
 
 
-/* PolicyPollAgain -- do another unit of work?
+/* heuristicPollAgain -- do another unit of work?
  *
  * Return TRUE if the MPS should do another unit of work; FALSE if it
  * should return to the mutator.
@@ -383,13 +448,16 @@ Bool PolicyPoll(Arena arena)
  * moreWork and tracedWork are the results of the last call to TracePoll.
  */
 
-Bool PolicyPollAgain(Arena arena, Clock start, Bool moreWork, Work tracedWork)
+static Bool heuristicPollAgain(Policy policy, Clock start, Bool moreWork,
+                               Work tracedWork)
 {
+  Arena arena;
   Bool moreTime;
   Globals globals;
   double nextPollThreshold;
 
-  AVERT(Arena, arena);
+  AVERT(Policy, policy);
+  arena = PolicyArena(policy);
   UNUSED(tracedWork);
 
   if (ArenaEmergency(arena))
@@ -420,6 +488,421 @@ Bool PolicyPollAgain(Arena arena, Clock start, Bool moreWork, Work tracedWork)
 }
 
 
+/* PolicyShouldCollectWorld, PolicyStartTrace, PolicyPoll,
+ * PolicyPollAgain -- ask the arena's policy
+ *
+ * See <design/strategy/#policy.world>, <design/strategy/#policy.start>
+ * and <design/strategy/#policy.poll>.
+ */
+
+Bool PolicyShouldCollectWorld(Arena arena, double availableTime,
+                              Clock now, Clock clocks_per_sec)
+{
+  AVERT(Arena, arena);
+  return Method(Policy, ArenaPolicy(arena), shouldCollectWorld)
+    (ArenaPolicy(arena), availableTime, now, clocks_per_sec);
+}
+
+Bool PolicyStartTrace(Trace *traceReturn, Bool *collectWorldReturn,
+                      Arena arena, Bool collectWorldAllowed)
+{
+  AVER(traceReturn != NULL);
+  AVER(collectWorldReturn != NULL);
+  AVERT(Arena, arena);
+  AVERT(Bool, collectWorldAllowed);
+  return Method(Policy, ArenaPolicy(arena), startTrace)
+    (traceReturn, collectWorldReturn, ArenaPolicy(arena),
+     collectWorldAllowed);
+}
+
+Bool PolicyPoll(Arena arena)
+{
+  AVERT(Arena, arena);
+  return Method(Policy, ArenaPolicy(arena), poll)(ArenaPolicy(arena));
+}
+
+Bool PolicyPollAgain(Arena arena, Clock start, Bool moreWork, Work tracedWork)
+{
+  AVERT(Arena, arena);
+  return Method(Policy, ArenaPolicy(arena), pollAgain)
+    (ArenaPolicy(arena), start, moreWork, tracedWork);
+}
+
+
+/* PolicyPause -- record a pause in the mutator
+ *
+ * Called at the end of each poll that did some tracing work.  start
+ * and end are the clock times at which the pause started and ended.
+ * See <design/strategy/#policy.pause>.
+ */
+
+void PolicyPause(Arena arena, Clock start, Clock end)
+{
+  TraceId ti;
+  Trace trace;
+
+  AVERT(Arena, arena);
+  AVER(start <= end);
+
+  TRACE_SET_ITER(ti, trace, arena->busyTraces, arena)
+    if (end - start > trace->pauseMax)
+      trace->pauseMax = end - start;
+  TRACE_SET_ITER_END(ti, trace, arena->busyTraces, arena);
+
+  Method(Policy, ArenaPolicy(arena), pause)(ArenaPolicy(arena), start, end);
+}
+
+
+/* policyPauseBucket -- histogram bucket for a pause
+ *
+ * There are four buckets to each doubling of the pause in
+ * nanoseconds: a pause of n nanoseconds, where 2^k <= n < 2^(k+1),
+ * goes in bucket 4*(k-1) plus the two bits of n after the top bit.
+ * Pauses of less than four nanoseconds get a bucket each.
+ */
+
+static Index policyPauseBucket(Word ns)
+{
+  Shift msb;
+  Index i;
+
+  if (ns < 4)
+    return (Index)ns;
+  msb = SizeFloorLog2((Size)ns);
+  i = 4 * (msb - 1) + ((ns >> (msb - 2)) & 3);
+  if (i >= POLICY_PAUSE_BUCKETS)
+    i = POLICY_PAUSE_BUCKETS - 1;
+  return i;
+}
+
+
+/* policyPauseBucketLimit -- upper limit of a bucket, in nanoseconds */
+
+static double policyPauseBucketLimit(Index i)
+{
+  AVER(i < POLICY_PAUSE_BUCKETS);
+  if (i < 4)
+    return (double)(i + 1);
+  return (double)(5 + i % 4) * (double)((Word)1 << (i / 4 - 1));
+}
+
+
+/* PolicyPauseCount -- number of pauses recorded */
+
+Count PolicyPauseCount(Policy policy)
+{
+  AVERT(Policy, policy);
+  return policy->pauses;
+}
+
+
+/* PolicyPauseQuantile -- estimate a quantile of the pause times
+ *
+ * Return an upper bound, in seconds, on the pause below which the
+ * given fraction of the recorded pauses fall, or zero if no pauses
+ * have been recorded.  The bound is at most 19% too high; see
+ * .policyPauseBucket.
+ */
+
+double PolicyPauseQuantile(Policy policy, double fraction)
+{
+  Count rank, seen;
+  Index i;
+
+  AVERT(Policy, policy);
+  AVER(0.0 <= fraction);
+  AVER(fraction <= 1.0);
+
+  if (policy->pauses == 0)
+    return 0.0;
+  rank = (Count)(fraction * (double)policy->pauses);
+  if ((double)rank < fraction * (double)policy->pauses)
+    ++ rank;
+  if (rank == 0)
+    rank = 1;
+  seen = 0;
+  for (i = 0; i < POLICY_PAUSE_BUCKETS; ++i) {
+    seen += policy->pauseHistogram[i];
+    if (seen >= rank)
+      break;
+  }
+  AVER(i < POLICY_PAUSE_BUCKETS);
+  return policyPauseBucketLimit(i) / 1e9;
+}
+
+
+/* PolicyClassCheck -- check a policy class */
+
+Bool PolicyClassCheck(PolicyClass klass)
+{
+  CHECKL(InstClassCheck(&klass->protocol));
+  CHECKL(klass->size >= sizeof(PolicyStruct));
+  CHECKL(FUNCHECK(klass->init));
+  CHECKL(FUNCHECK(klass->finish));
+  CHECKL(FUNCHECK(klass->shouldCollectWorld));
+  CHECKL(FUNCHECK(klass->startTrace));
+  CHECKL(FUNCHECK(klass->poll));
+  CHECKL(FUNCHECK(klass->pollAgain));
+  CHECKL(FUNCHECK(klass->pause));
+  CHECKL(FUNCHECK(klass->describe));
+  CHECKS(PolicyClass, klass);
+  return TRUE;
+}
+
+
+/* PolicyCheck -- check a policy */
+
+Bool PolicyCheck(Policy policy)
+{
+  PolicyClass klass;
+  CHECKS(Policy, policy);
+  CHECKC(AbstractPolicy, policy);
+  klass = ClassOfPoly(Policy, policy);
+  CHECKD(PolicyClass, klass);
+  CHECKU(Arena, policy->arena);
+  /* Checking that pauses is the sum of pauseHistogram would be too
+     expensive. */
+  return TRUE;
+}
+
+
+/* PolicyCreate -- create the arena's policy
+ *
+ * The class is given by MPS_KEY_ARENA_POLICY, defaulting to the
+ * heuristic policy, and the whole of the arena's argument list is
+ * passed on to the class, so that it can pick its own keyword
+ * arguments.
+ */
+
+ARG_DEFINE_KEY(ARENA_POLICY, PolicyClass);
+
+Res PolicyCreate(Policy *policyReturn, Arena arena, ArgList args)
+{
+  PolicyClass klass = CLASS(HeuristicPolicy);
+  ArgStruct arg;
+  Policy policy;
+  void *p;
+  Res res;
+
+  AVER(policyReturn != NULL);
+  AVERT(Arena, arena);
+  AVERT(ArgList, args);
+
+  if (ArgPick(&arg, args, MPS_KEY_ARENA_POLICY))
+    klass = arg.val.policy_class;
+  AVERT(PolicyClass, klass);
+
+  res = ControlAlloc(&p, arena, klass->size);
+  if (res != ResOK)
+    goto failAlloc;
+  policy = p;
+
+  res = klass->init(policy, arena, args);
+  if (res != ResOK)
+    goto failInit;
+
+  *policyReturn = policy;
+  return ResOK;
+
+failInit:
+  ControlFree(arena, p, klass->size);
+failAlloc:
+  return res;
+}
+
+
+/* PolicyDestroy -- finish and free the arena's policy */
+
+void PolicyDestroy(Policy policy)
+{
+  Arena arena;
+  Size size;
+
+  AVERT(Policy, policy);
+  arena = PolicyArena(policy);
+  size = ClassOfPoly(Policy, policy)->size;
+  Method(Policy, policy, finish)(policy);
+  ControlFree(arena, policy, size);
+}
+
+
+/* PolicyDescribe -- describe the policy */
+
+Res PolicyDescribe(Policy policy, mps_lib_FILE *stream, Count depth)
+{
+  return Method(Policy, policy, describe)(policy, stream, depth);
+}
+
+
+/* Abstract policy class: generic methods */
+
+static Res policyAbsInit(Policy policy, Arena arena, ArgList args)
+{
+  Index i;
+
+  AVER(policy != NULL);
+  AVERT(Arena, arena);
+  UNUSED(args);
+
+  /* Superclass init */
+  InstInit(CouldBeA(Inst, policy));
+
+  policy->arena = arena;
+  policy->pauses = 0;
+  for (i = 0; i < POLICY_PAUSE_BUCKETS; ++i)
+    policy->pauseHistogram[i] = 0;
+
+  SetClassOfPoly(policy, CLASS(AbstractPolicy));
+  policy->sig = PolicySig;
+  AVERC(Policy, policy);
+  return ResOK;
+}
+
+static void policyAbsFinish(Policy policy)
+{
+  AVERT(Policy, policy);
+  policy->sig = SigInvalid;
+  InstFinish(CouldBeA(Inst, policy));
+}
+
+static Bool policyNoShouldCollectWorld(Policy policy, double availableTime,
+                                       Clock now, Clock clocks_per_sec)
+{
+  AVERT(Policy, policy);
+  UNUSED(availableTime);
+  UNUSED(now);
+  UNUSED(clocks_per_sec);
+  NOTREACHED;
+  return FALSE;
+}
+
+static Bool policyNoStartTrace(Trace *traceReturn, Bool *collectWorldReturn,
+                               Policy policy, Bool collectWorldAllowed)
+{
+  AVER(traceReturn != NULL);
+  AVER(collectWorldReturn != NULL);
+  AVERT(Policy, policy);
+  UNUSED(collectWorldAllowed);
+  NOTREACHED;
+  return FALSE;
+}
+
+static Bool policyNoPoll(Policy policy)
+{
+  AVERT(Policy, policy);
+  NOTREACHED;
+  return FALSE;
+}
+
+static Bool policyNoPollAgain(Policy policy, Clock start, Bool moreWork,
+                              Work tracedWork)
+{
+  AVERT(Policy, policy);
+  UNUSED(start);
+  UNUSED(moreWork);
+  UNUSED(tracedWork);
+  NOTREACHED;
+  return FALSE;
+}
+
+/* policyAbsPause -- add a pause to the histogram */
+
+static void policyAbsPause(Policy policy, Clock start, Clock end)
+{
+  double ns;
+  Word bucketNs;
+  const Word wordMax = ~(Word)0;
+
+  AVERT(Policy, policy);
+  AVER(start <= end);
+
+  ns = (double)(end - start) * 1e9 / (double)ClocksPerSec();
+  bucketNs = ns < (double)wordMax ? (Word)ns : wordMax;
+  ++ policy->pauseHistogram[policyPauseBucket(bucketNs)];
+  ++ policy->pauses;
+}
+
+static Res policyAbsDescribe(Policy policy, mps_lib_FILE *stream, Count depth)
+{
+  PolicyClass klass;
+  Res res;
+
+  if (!TESTC(AbstractPolicy, policy))
+    return ResPARAM;
+  if (stream == NULL)
+    return ResPARAM;
+
+  res = InstDescribe(CouldBeA(Inst, policy), stream, depth);
+  if (res != ResOK)
+    return res;
+
+  klass = ClassOfPoly(Policy, policy);
+  return WriteF(stream, depth + 2,
+                "class  $P (\"$S\")\n",
+                (WriteFP)klass, (WriteFS)ClassName(klass),
+                "arena  $P\n", (WriteFP)policy->arena,
+                "pauses $U\n", (WriteFU)policy->pauses,
+                "p50    $D\n", (WriteFD)PolicyPauseQuantile(policy, 0.5),
+                "p99    $D\n", (WriteFD)PolicyPauseQuantile(policy, 0.99),
+                "max    $D\n", (WriteFD)PolicyPauseQuantile(policy, 1.0),
+                NULL);
+}
+
+
+/* Heuristic policy class */
+
+static Res heuristicInit(Policy policy, Arena arena, ArgList args)
+{
+  Res res;
+
+  res = NextMethod(Policy, HeuristicPolicy, init)(policy, arena, args);
+  if (res != ResOK)
+    return res;
+  SetClassOfPoly(policy, CLASS(HeuristicPolicy));
+  AVERC(HeuristicPolicy, policy);
+  return ResOK;
+}
+
+
+DEFINE_CLASS(Inst, PolicyClass, klass)
+{
+  INHERIT_CLASS(klass, PolicyClass, InstClass);
+}
+
+DEFINE_CLASS(Policy, AbstractPolicy, klass)
+{
+  INHERIT_CLASS(&klass->protocol, AbstractPolicy, Inst);
+  klass->size = sizeof(PolicyStruct);
+  klass->init = policyAbsInit;
+  klass->finish = policyAbsFinish;
+  klass->shouldCollectWorld = policyNoShouldCollectWorld;
+  klass->startTrace = policyNoStartTrace;
+  klass->poll = policyNoPoll;
+  klass->pollAgain = policyNoPollAgain;
+  klass->pause = policyAbsPause;
+  klass->describe = policyAbsDescribe;
+  klass->sig = PolicyClassSig;
+}
+
+DEFINE_CLASS(Policy, HeuristicPolicy, klass)
+{
+  INHERIT_CLASS(klass, HeuristicPolicy, AbstractPolicy);
+  klass->init = heuristicInit;
+  klass->shouldCollectWorld = heuristicShouldCollectWorld;
+  klass->startTrace = heuristicStartTrace;
+  klass->poll = heuristicPoll;
+  klass->pollAgain = heuristicPollAgain;
+}
+
+
+/* mps_policy_class_heuristic -- return the heuristic policy class */
+
+mps_policy_class_t mps_policy_class_heuristic(void)
+{
+  return (mps_policy_class_t)CLASS(HeuristicPolicy);
+}
+
+
 /* C. COPYRIGHT AND LICENSE
  *
  * Copyright (C) 2001-2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
@@ -0,0 +1,434 @@
+/* policypt.c: PAUSE-TARGET COLLECTION POLICY
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .purpose: A collection policy that tries to keep the 99th
+ * percentile pause within the arena's pause time, and the heap
+ * within a maximum size, by measuring what it achieves and adjusting
+ * its controls.  Otherwise it makes the same decisions as the
+ * heuristic policy, from which it inherits.  See
+ * <design/strategy/#policy.pause-target>.
+ *
+ * .slice: The first control is the slice: the fraction of the pause
+ * time that the policy is prepared to spend working in each poll.
+ * The heuristic policy works until the pause time is exceeded, so its
+ * pauses overshoot by up to one unit of tracing work.  This policy
+ * measures the last unit of work in each pause, which is the one
+ * that overshot.  After each pause that exceeds the pause time it
+ * cuts the slice by at least POLICY_PAUSE_STEP, and far enough that
+ * a unit as long as that one would have ended within the pause time.
+ * After each pause that doesn't exceed the pause time it grows the
+ * slice by a small fraction of POLICY_PAUSE_STEP, with the fractions
+ * balanced so that the slice settles where about
+ * POLICY_PAUSE_QUANTILE of the pauses are within the pause time.  To
+ * keep the collector doing the same share of the work, the policy
+ * polls proportionately more often when the slice is small.
+ *
+ * .slice.unit: If the last unit of work in a pause was itself longer
+ * than the pause time, no slice would have kept that pause within
+ * it, and cutting the slice would only make the policy poll more
+ * often, so the slice is left alone.  Units of work that long
+ * include the flip, which scans all the roots at once.
+ *
+ * .quantum: A unit of work is one call to TracePoll, which does a
+ * quantum of tracing work that TraceStart computes from the size of
+ * the trace and the allocation expected during it, regardless of the
+ * pause time.  So when this policy starts a trace, it cuts the
+ * quantum to the work it expects to do in its slice of the pause
+ * time at the measured collection rate.
+ *
+ * .heap: The second control is when to start a collection of the
+ * world.  The policy predicts how much the heap will grow during such
+ * a collection, from the measured collection rate (tracedWork over
+ * tracedTime, accumulated by ArenaAccumulateTime) and the measured
+ * allocation rate, and starts the collection when the prediction
+ * reaches the maximum heap size.  While the prediction is over the
+ * maximum, it also ignores the slice and works for the whole pause
+ * time in each poll.
+ */
+
+#include "mpm.h"
+
+SRCID(policypt, "$Id$");
+
+
+/* PausePolicyStruct -- pause-target policy structure */
+
+#define PausePolicySig  ((Sig)0x519BA05E) /* SIGnature PAuSE */
+
+typedef struct PausePolicyStruct *PausePolicy;
+
+typedef struct PausePolicyStruct {
+  PolicyStruct policyStruct;    /* generic policy structure */
+  Size heapMax;                 /* maximum heap size, see .heap */
+  double slice;                 /* fraction of pause time, see .slice */
+  Clock unitStart;              /* clock at start of last unit of work */
+  double lastFill;              /* fillMutatorSize at end of last pause */
+  Clock lastClock;              /* clock at end of last pause */
+  double allocRate;             /* smoothed allocation rate (bytes/s) */
+  Sig sig;                      /* <design/sig/> */
+} PausePolicyStruct;
+
+DECLARE_CLASS(Policy, PausePolicy, HeuristicPolicy);
+
+
+/* PausePolicyCheck -- check the pause-target policy */
+
+ATTRIBUTE_UNUSED
+static Bool PausePolicyCheck(PausePolicy pp)
+{
+  CHECKS(PausePolicy, pp);
+  CHECKC(PausePolicy, pp);
+  CHECKD(Policy, CouldBeA(Policy, pp));
+  CHECKL(pp->heapMax > 0);
+  CHECKL(POLICY_PAUSE_MIN_SLICE <= pp->slice);
+  CHECKL(pp->slice <= 1.0);
+  CHECKL(pp->allocRate >= 0.0);
+  return TRUE;
+}
+
+
+/* pausePolicyCollectionRate -- measured rate of tracing work
+ *
+ * As policyCollectionTime, but without the overhead, since this
+ * policy's collections are incremental rather than idle ones.
+ */
+
+static double pausePolicyCollectionRate(Arena arena)
+{
+  if (arena->tracedTime >= 1.0)
+    return arena->tracedWork / arena->tracedTime;
+  return ARENA_DEFAULT_COLLECTION_RATE;
+}
+
+
+/* pausePolicyOverHeap -- would a collection started now overrun?
+ *
+ * Return TRUE if the heap is predicted to grow beyond its maximum
+ * size during a collection of the world started now.  See .heap.
+ */
+
+static Bool pausePolicyOverHeap(PausePolicy pp)
+{
+  Arena arena = PolicyArena(CouldBeA(Policy, pp));
+  Size limit, inUse;
+  double collectionTime, pollTime, growth;
+
+  limit = ArenaCommitLimit(arena);
+  if (pp->heapMax < limit)
+    limit = pp->heapMax;
+  if (limit == SizeMAX)
+    return FALSE;
+
+  collectionTime = ArenaCollectable(arena)
+    / pausePolicyCollectionRate(arena);
+
+  /* The mutator keeps allocating while the collector works, and also
+     allocates a slice's worth of poll interval between each slice of
+     work.  If the pause time is zero, the MPS does one unit of work
+     in each poll, whose duration is unknown, so only the first term
+     counts. */
+  growth = pp->allocRate * collectionTime;
+  pollTime = ArenaPauseTime(arena) * pp->slice;
+  if (pollTime > 0.0)
+    growth += ArenaPollALLOCTIME * pp->slice * collectionTime / pollTime;
+
+  inUse = ArenaCommitted(arena) - ArenaSpareCommitted(arena);
+  return (double)inUse + growth >= (double)limit;
+}
+
+
+/* pausePolicyAdjust -- adjust the slice after a pause
+ *
+ * pause is the length of the pause and unit the length of the last
+ * unit of work in it, in seconds.  Each pause over the pause time
+ * costs at least POLICY_PAUSE_STEP of the slice, and enough that the
+ * unit would have fitted, unless the unit could not have fitted
+ * anyway.  Each pause within the pause time earns back the fraction
+ * of POLICY_PAUSE_STEP that makes the two balance when
+ * POLICY_PAUSE_QUANTILE of the pauses are within the pause time.  See
+ * .slice and .slice.unit.
+ */
+
+static void pausePolicyAdjust(PausePolicy pp, double pause, double unit)
+{
+  double target = ArenaPauseTime(PolicyArena(CouldBeA(Policy, pp)));
+
+  if (pause <= target) {
+    pp->slice *= 1.0 + POLICY_PAUSE_STEP * (1.0 - POLICY_PAUSE_QUANTILE)
+                       / POLICY_PAUSE_QUANTILE;
+  } else if (unit < target) {
+    double fit = (target - unit) / target;
+    pp->slice *= 1.0 - POLICY_PAUSE_STEP;
+    if (pp->slice > fit)
+      pp->slice = fit;
+  }
+  if (pp->slice < POLICY_PAUSE_MIN_SLICE)
+    pp->slice = POLICY_PAUSE_MIN_SLICE;
+  else if (pp->slice > 1.0)
+    pp->slice = 1.0;
+}
+
+
+/* pausePolicyInit -- initialize the pause-target policy */
+
+ARG_DEFINE_KEY(POLICY_HEAP_MAX, Size);
+
+static Res pausePolicyInit(Policy policy, Arena arena, ArgList args)
+{
+  PausePolicy pp;
+  Size heapMax = SizeMAX;
+  ArgStruct arg;
+  Res res;
+
+  res = NextMethod(Policy, PausePolicy, init)(policy, arena, args);
+  if (res != ResOK)
+    return res;
+  pp = CouldBeA(PausePolicy, policy);
+
+  if (ArgPick(&arg, args, MPS_KEY_POLICY_HEAP_MAX))
+    heapMax = arg.val.size;
+  AVER(heapMax > 0);
+
+  pp->heapMax = heapMax;
+  pp->slice = 1.0;
+  pp->unitStart = ClockNow();
+  pp->lastFill = ArenaGlobals(arena)->fillMutatorSize;
+  pp->lastClock = ClockNow();
+  pp->allocRate = 0.0;
+
+  SetClassOfPoly(policy, CLASS(PausePolicy));
+  pp->sig = PausePolicySig;
+  AVERC(PausePolicy, pp);
+  return ResOK;
+}
+
+
+/* pausePolicyFinish -- finish the pause-target policy */
+
+static void pausePolicyFinish(Policy policy)
+{
+  PausePolicy pp = MustBeA(PausePolicy, policy);
+  pp->sig = SigInvalid;
+  NextMethod(Policy, PausePolicy, finish)(policy);
+}
+
+
+/* pausePolicyQuantum -- cut a new trace's quantum to fit the slice
+ *
+ * See .quantum.
+ */
+
+static void pausePolicyQuantum(PausePolicy pp, Trace trace)
+{
+  Arena arena = PolicyArena(CouldBeA(Policy, pp));
+  double quantum;
+
+  quantum = pausePolicyCollectionRate(arena) * ArenaPauseTime(arena)
+    * pp->slice;
+  if (quantum < 1.0)
+    quantum = 1.0;
+  if ((double)trace->quantumWork > quantum)
+    trace->quantumWork = (Work)quantum;
+}
+
+
+/* pausePolicyStartTrace -- consider starting a trace
+ *
+ * Start a collection of the world if the heap would otherwise overrun
+ * its maximum size (see .heap); otherwise decide as the heuristic
+ * policy does.  Either way, cut the quantum of the new trace (see
+ * .quantum).
+ */
+
+static Bool pausePolicyStartTrace(Trace *traceReturn,
+                                  Bool *collectWorldReturn,
+                                  Policy policy, Bool collectWorldAllowed)
+{
+  PausePolicy pp = MustBeA(PausePolicy, policy);
+  Trace trace;
+
+  if (collectWorldAllowed && pausePolicyOverHeap(pp)) {
+    Res res = TraceStartCollectAll(&trace, PolicyArena(policy),
+                                   TraceStartWhyDYNAMICCRITERION);
+    if (res == ResOK) {
+      pausePolicyQuantum(pp, trace);
+      *collectWorldReturn = TRUE;
+      *traceReturn = trace;
+      return TRUE;
+    }
+  }
+  if (!NextMethod(Policy, PausePolicy, startTrace)
+      (&trace, collectWorldReturn, policy, collectWorldAllowed))
+    return FALSE;
+  pausePolicyQuantum(pp, trace);
+  *traceReturn = trace;
+  return TRUE;
+}
+
+
+/* pausePolicyPollAgain -- do another unit of work?
+ *
+ * As heuristicPollAgain, but working for a slice of the pause time,
+ * and polling proportionately more often.  Notes when each unit of
+ * work starts, for pausePolicyPause.  See .slice.
+ */
+
+static Bool pausePolicyPollAgain(Policy policy, Clock start, Bool moreWork,
+                                 Work tracedWork)
+{
+  PausePolicy pp = MustBeA(PausePolicy, policy);
+  Arena arena = PolicyArena(policy);
+  Globals globals;
+  double slice, nextPollThreshold;
+  Clock now;
+  Bool moreTime;
+
+  UNUSED(tracedWork);
+
+  now = ClockNow();
+  if (ArenaEmergency(arena)) {
+    pp->unitStart = now;
+    return TRUE;
+  }
+
+  slice = pausePolicyOverHeap(pp) ? 1.0 : pp->slice;
+  moreTime = (now - start) < ArenaPauseTime(arena) * slice * ClocksPerSec();
+  if (moreWork && moreTime) {
+    pp->unitStart = now;
+    return TRUE;
+  }
+
+  globals = ArenaGlobals(arena);
+  if (moreWork)
+    nextPollThreshold = globals->pollThreshold + ArenaPollALLOCTIME * slice;
+  else
+    nextPollThreshold = globals->fillMutatorSize + ArenaPollALLOCTIME;
+
+  AVER(nextPollThreshold > globals->pollThreshold);
+  globals->pollThreshold = nextPollThreshold;
+
+  return FALSE;
+}
+
+
+/* pausePolicyPause -- measure a pause and adjust the controls */
+
+static void pausePolicyPause(Policy policy, Clock start, Clock end)
+{
+  PausePolicy pp = MustBeA(PausePolicy, policy);
+  Globals globals = ArenaGlobals(PolicyArena(policy));
+  double clocksPerSec = (double)ClocksPerSec();
+  double interval, rate;
+  Clock unitStart;
+
+  NextMethod(Policy, PausePolicy, pause)(policy, start, end);
+
+  /* If pausePolicyPollAgain didn't note the start of a unit during
+     this pause, it was all one unit. */
+  unitStart = pp->unitStart > start ? pp->unitStart : start;
+  pausePolicyAdjust(pp, (double)(end - start) / clocksPerSec,
+                    (double)(end - unitStart) / clocksPerSec);
+
+  /* Measure the allocation rate since the last pause, and smooth it
+     so that a burst doesn't start a collection on its own. */
+  if (end > pp->lastClock) {
+    interval = (double)(end - pp->lastClock) / clocksPerSec;
+    rate = (globals->fillMutatorSize - pp->lastFill) / interval;
+    if (pp->allocRate == 0.0)
+      pp->allocRate = rate;
+    else
+      pp->allocRate = 0.75 * pp->allocRate + 0.25 * rate;
+  }
+  pp->lastFill = globals->fillMutatorSize;
+  pp->lastClock = end;
+}
+
+
+/* pausePolicyDescribe -- describe the pause-target policy */
+
+static Res pausePolicyDescribe(Policy policy, mps_lib_FILE *stream,
+                               Count depth)
+{
+  PausePolicy pp = CouldBeA(PausePolicy, policy);
+  Res res;
+
+  if (!TESTC(PausePolicy, pp))
+    return ResPARAM;
+  if (stream == NULL)
+    return ResPARAM;
+
+  res = NextMethod(Policy, PausePolicy, describe)(policy, stream, depth);
+  if (res != ResOK)
+    return res;
+
+  return WriteF(stream, depth + 2,
+                "heapMax   $W\n", (WriteFW)pp->heapMax,
+                "slice     $D\n", (WriteFD)pp->slice,
+                "allocRate $D\n", (WriteFD)pp->allocRate,
+                NULL);
+}
+
+
+DEFINE_CLASS(Policy, PausePolicy, klass)
+{
+  INHERIT_CLASS(klass, PausePolicy, HeuristicPolicy);
+  klass->size = sizeof(PausePolicyStruct);
+  klass->init = pausePolicyInit;
+  klass->finish = pausePolicyFinish;
+  klass->startTrace = pausePolicyStartTrace;
+  klass->pollAgain = pausePolicyPollAgain;
+  klass->pause = pausePolicyPause;
+  klass->describe = pausePolicyDescribe;
+}
+
+
+/* mps_policy_class_pause -- return the pause-target policy class */
+
+mps_policy_class_t mps_policy_class_pause(void)
+{
+  return (mps_policy_class_t)CLASS(PausePolicy);
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -41,11 +41,18 @@ Bool PoolClassCheck(PoolClass klass)
   CHECKL(klass->size >= sizeof(PoolStruct));
   CHECKL(AttrCheck(klass->attr));
   CHECKL(!(klass->attr & AttrMOVINGGC) || (klass->attr & AttrGC));
+  CHECKL(!(klass->attr & AttrPARSCAN) || (klass->attr & AttrGC));
   CHECKL(FUNCHECK(klass->varargs));
   CHECKL(FUNCHECK(klass->init));
   CHECKL(FUNCHECK(klass->finish));
   CHECKL(FUNCHECK(klass->alloc));
   CHECKL(FUNCHECK(klass->free));
+  CHECKL(FUNCHECK(klass->bulkAlloc));
+  CHECKL(FUNCHECK(klass->bulkFree));
+  CHECKL(FUNCHECK(klass->tryAlloc));
+  CHECKL(FUNCHECK(klass->tryFree));
+  CHECKL(FUNCHECK(klass->cacheAlloc));
+  CHECKL(FUNCHECK(klass->cacheFree));
   CHECKL(FUNCHECK(klass->bufferFill));
   CHECKL(FUNCHECK(klass->bufferEmpty));
   CHECKL(FUNCHECK(klass->access));
@@ -53,6 +60,7 @@ Bool PoolClassCheck(PoolClass klass)
   CHECKL(FUNCHECK(klass->grey));
   CHECKL(FUNCHECK(klass->blacken));
   CHECKL(FUNCHECK(klass->scan));
+  CHECKL(FUNCHECK(klass->scanCards));
   CHECKL(FUNCHECK(klass->fix));
   CHECKL(FUNCHECK(klass->fixEmergency));
   CHECKL(FUNCHECK(klass->reclaim));
@@ -115,6 +123,8 @@ Bool PoolCheck(Pool pool)
   /* Normally pool->format iff PoolHasAttr(pool, AttrFMT), but during
      pool initialization the class may not yet be set. */
   CHECKL(!PoolHasAttr(pool, AttrFMT) || pool->format != NULL);
+  CHECKL(pool->lock == NULL || PoolHasAttr(pool, AttrLOCKED));
+  CHECKL(pool->lock == NULL || LockCheck(pool->lock));
   return TRUE;
 }
 
@@ -181,10 +191,24 @@ Res PoolCreate(Pool *poolReturn, Arena arena,
   res = PoolInit(pool, arena, klass, args);
   if (res != ResOK)
     goto failPoolInit;
+
+  /* .lock: Pools created here (rather than initialized in place as
+     part of some other structure) get their own lock if their class
+     supports it.  See <design/thread-safety/#sol.pool-lock>. */
+  if (PoolHasAttr(pool, AttrLOCKED)) {
+    void *p;
+    res = ControlAlloc(&p, arena, LockSize());
+    if (res != ResOK)
+      goto failLockAlloc;
+    pool->lock = (Lock)p;
+    LockInit(pool->lock);
+  }
  
   *poolReturn = pool; 
   return ResOK;
 
+failLockAlloc:
+  PoolFinish(pool);
 failPoolInit:
   ControlFree(arena, base, klass->size);
 failControlAlloc:
@@ -207,12 +231,19 @@ void PoolDestroy(Pool pool)
 {
   Arena arena;
   Size size;
+  Lock lock;
 
   AVERT(Pool, pool); 
   arena = pool->arena;
   size = ClassOfPoly(Pool, pool)->size;
+  lock = pool->lock;
   PoolFinish(pool);
 
+  if (lock != NULL) {
+    LockFinish(lock);
+    ControlFree(arena, lock, LockSize());
+  }
+
   /* .space.free: Free the pool instance structure.  See .space.alloc */
   ControlFree(arena, pool, size);
 }
@@ -227,6 +258,63 @@ BufferClass PoolDefaultBufferClass(Pool pool)
 }
 
 
+/* PoolLockClaim, PoolLockRelease -- claim and release the pool lock
+ *
+ * Generic operations that use the state of a pool hold its lock, if
+ * it has one, as well as the arena lock, so that they exclude
+ * PoolTryAlloc and PoolTryFree in other threads.  The arena lock must
+ * be claimed first.  See <design/thread-safety/#sol.pool-lock>.
+ */
+
+void PoolLockClaim(Pool pool)
+{
+  AVERT(Pool, pool);
+  if (pool->lock != NULL)
+    LockClaimRecursive(pool->lock);
+}
+
+void PoolLockRelease(Pool pool)
+{
+  AVERT(Pool, pool);
+  if (pool->lock != NULL)
+    LockReleaseRecursive(pool->lock);
+}
+
+
+/* PoolLocksClaimAll, PoolLocksReleaseAll -- claim and release the
+ * locks of all the pools in an arena
+ *
+ * The shield claims them while it suspends the mutator threads with
+ * the arena lock held, so that no thread is suspended while it holds
+ * a pool lock, which the arena-locked code could then never claim.
+ * See <design/thread-safety/#sol.pool-lock.suspend>.
+ */
+
+void PoolLocksClaimAll(Arena arena)
+{
+  Ring node, next;
+
+  AVERT(Arena, arena);
+  RING_FOR(node, &ArenaGlobals(arena)->poolRing, next) {
+    Pool pool = RING_ELT(Pool, arenaRing, node);
+    if (pool->lock != NULL)
+      LockClaimRecursive(pool->lock);
+  }
+}
+
+void PoolLocksReleaseAll(Arena arena)
+{
+  Ring node, next;
+
+  AVERT(Arena, arena);
+  RING_FOR(node, &ArenaGlobals(arena)->poolRing, next) {
+    Pool pool = RING_ELT(Pool, arenaRing, node);
+    if (pool->lock != NULL)
+      LockReleaseRecursive(pool->lock);
+  }
+}
+
+
 /* PoolAlloc -- allocate a block of memory from a pool */
 
 Res PoolAlloc(Addr *pReturn, Pool pool, Size size)
@@ -237,7 +325,9 @@ Res PoolAlloc(Addr *pReturn, Pool pool, Size size)
   AVERT(Pool, pool);
   AVER(size > 0);
 
+  PoolLockClaim(pool);
   res = Method(Pool, pool, alloc)(pReturn, pool, size);
+  PoolLockRelease(pool);
   if (res != ResOK)
     return res;
   /* Make sure that the allocated address was in the pool's memory. */
@@ -268,12 +358,152 @@ void PoolFree(Pool pool, Addr old, Size size)
   AVER(AddrIsAligned(old, pool->alignment));
   AVER(PoolHasRange(pool, old, AddrAdd(old, size)));
 
+  PoolLockClaim(pool);
   Method(Pool, pool, free)(pool, old, size);
+  PoolLockRelease(pool);
  
   EVENT3(PoolFree, pool, old, size);
 }
 
 
+/* PoolTryAlloc -- allocate without the arena lock
+ *
+ * Tries to allocate a block using only memory that the pool already
+ * has, holding only the pool lock.  Returns FALSE if the pool has no
+ * lock, or if the allocation needs the arena, in which case the
+ * caller must claim the arena lock and use PoolAlloc.  Unlike
+ * PoolAlloc, this doesn't advance the allocation clock or emit
+ * events, just like allocation from a segregated allocation cache.
+ * The class may first try its own caches, without even the pool lock
+ * (see <design/thread-safety/#sol.pool-cache>).  See
+ * <design/thread-safety/#sol.pool-lock>.
+ */
+
+Bool PoolTryAlloc(Addr *pReturn, Pool pool, Size size)
+{
+  Bool b;
+
+  AVER(pReturn != NULL);
+  AVER(TESTT(Pool, pool));
+  AVER(size > 0);
+
+  if (pool->lock == NULL)
+    return FALSE;
+  if (Method(Pool, pool, cacheAlloc)(pReturn, pool, size)) {
+    AVER_CRITICAL(AddrIsAligned(*pReturn, pool->alignment));
+    return TRUE;
+  }
+  LockClaimRecursive(pool->lock);
+  b = Method(Pool, pool, tryAlloc)(pReturn, pool, size);
+  LockReleaseRecursive(pool->lock);
+  AVER_CRITICAL(!b || AddrIsAligned(*pReturn, pool->alignment));
+  return b;
+}
+
+
+/* PoolTryFree -- free without the arena lock
+ *
+ * As PoolTryAlloc.  Returns FALSE if the block was not freed, in
+ * which case the caller must claim the arena lock and use PoolFree.
+ */
+
+Bool PoolTryFree(Pool pool, Addr old, Size size)
+{
+  Bool b;
+
+  AVER(TESTT(Pool, pool));
+  AVER(old != NULL);
+  AVER(size > 0);
+  AVER(AddrIsAligned(old, pool->alignment));
+
+  if (pool->lock == NULL)
+    return FALSE;
+  if (Method(Pool, pool, cacheFree)(pool, old, size))
+    return TRUE;
+  LockClaimRecursive(pool->lock);
+  b = Method(Pool, pool, tryFree)(pool, old, size);
+  LockReleaseRecursive(pool->lock);
+  return b;
+}
+
+
+/* PoolBulkAlloc -- allocate a list of blocks
+ *
+ * Allocates between one and count blocks of the given size, and
+ * pushes them on the front of the list *listIO, linked through their
+ * first words.  The number of blocks allocated is returned in
+ * *countReturn.  This is for the segregated allocation caches: see
+ * <design/class-interface/#method.bulkAlloc>.
+ */
+
+Res PoolBulkAlloc(Count *countReturn, Addr *listIO, Pool pool,
+                  Size size, Count count)
+{
+  Res res;
+  Count i, n;
+  Addr p;
+
+  AVER(countReturn != NULL);
+  AVER(listIO != NULL);
+  AVERT(Pool, pool);
+  AVER(size >= sizeof(Addr));
+  AVER(SizeIsAligned(size, pool->alignment));
+  AVER(count > 0);
+
+  PoolLockClaim(pool);
+  res = Method(Pool, pool, bulkAlloc)(&n, listIO, pool, size, count);
+  PoolLockRelease(pool);
+  if (res != ResOK)
+    return res;
+  AVER(n > 0);
+  AVER(n <= count);
+
+  /* See PoolAlloc. */
+  ArenaGlobals(PoolArena(pool))->fillMutatorSize += size * n;
+
+  for (i = 0, p = *listIO; i < n; ++i) {
+    AVER_CRITICAL(PoolHasAddr(pool, p)); /* see .hasaddr.critical */
+    AVER_CRITICAL(AddrIsAligned(p, pool->alignment));
+    EVENT3(PoolAlloc, pool, p, size);
+    p = *ADDR_PTR(Addr, p);
+  }
+
+  *countReturn = n;
+  return ResOK;
+}
+
+
+/* PoolBulkFree -- free a list of blocks
+ *
+ * Frees the first count blocks on the list *listIO, linked through
+ * their first words, and updates *listIO to point to the rest.
+ */
+
+void PoolBulkFree(Pool pool, Addr *listIO, Size size, Count count)
+{
+  Count i;
+  Addr p;
+
+  AVERT(Pool, pool);
+  AVER(listIO != NULL);
+  AVER(size >= sizeof(Addr));
+  AVER(SizeIsAligned(size, pool->alignment));
+  AVER(count > 0);
+
+  for (i = 0, p = *listIO; i < count; ++i) {
+    AVER(p != NULL);
+    AVER_CRITICAL(PoolHasRange(pool, p, AddrAdd(p, size)));
+    EVENT3(PoolFree, pool, p, size);
+    p = *ADDR_PTR(Addr, p);
+  }
+
+  PoolLockClaim(pool);
+  Method(Pool, pool, bulkFree)(pool, listIO, size, count);
+  PoolLockRelease(pool);
+  AVER(*listIO == p);
+}
+
+
 Res PoolAccess(Pool pool, Seg seg, Addr addr,
                AccessSet mode, MutatorFaultContext context)
 {
@@ -339,13 +569,42 @@ Res PoolScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg)
    * See <code/trace.c#scan.conservative> */
   AVER(ss->rank == RankEXACT || RankSetIsMember(SegRankSet(seg), ss->rank));
 
-  /* Should only scan segments which contain grey objects. */
-  AVER(TraceSetInter(SegGrey(seg), ss->traces) != TraceSetEMPTY);
+  /* Should only scan segments which contain grey objects, except in a
+   * parallel scan, where the segment is made non-grey beforehand. See
+   * <design/trace/#parallel.grey>. */
+  AVER(ss->fixLock != NULL
+       || TraceSetInter(SegGrey(seg), ss->traces) != TraceSetEMPTY);
 
   return Method(Pool, pool, scan)(totalReturn, ss, pool, seg);
 }
 
 
+/* PoolScanCards -- scan the dirty cards of a segment in the pool
+ *
+ * Scans the objects in the segment that overlap dirty cards, to
+ * find the summary of the references that the client may have
+ * stored in them.  The scan state has an empty white set, so nothing
+ * is fixed, and the segment need not be grey.  Returns ResUNIMPL if
+ * the pool can't scan just the dirty cards, in which case the caller
+ * must assume the segment refers to anything.  See
+ * <design/write-barrier/#card.harvest>.
+ */
+
+Res PoolScanCards(ScanState ss, Pool pool, Seg seg)
+{
+  AVERT(ScanState, ss);
+  AVERT(Pool, pool);
+  AVERT(Seg, seg);
+  AVER(ss->arena == pool->arena);
+  AVER(pool == SegPool(seg));
+  AVER(ArenaCardMarking(pool->arena));
+  AVER(ScanStateWhite(ss) == ZoneSetEMPTY);
+  AVER(ss->rank == RankEXACT || RankSetIsMember(SegRankSet(seg), ss->rank));
+
+  return Method(Pool, pool, scanCards)(ss, pool, seg);
+}
+
+
 /* PoolFix* -- fix a reference to an object in this pool
  *
  * See <design/pool/#req.fix>.
@@ -462,7 +721,9 @@ void PoolFreeWalk(Pool pool, FreeBlockVisitor f, void *p)
   AVER(FUNCHECK(f));
   /* p is arbitrary, hence can't be checked. */
 
+  PoolLockClaim(pool);
   Method(Pool, pool, freewalk)(pool, f, p);
+  PoolLockRelease(pool);
 }
 
 
@@ -470,9 +731,14 @@ void PoolFreeWalk(Pool pool, FreeBlockVisitor f, void *p)
 
 Size PoolTotalSize(Pool pool)
 {
+  Size size;
+
   AVERT(Pool, pool);
 
-  return Method(Pool, pool, totalSize)(pool);
+  PoolLockClaim(pool);
+  size = Method(Pool, pool, totalSize)(pool);
+  PoolLockRelease(pool);
+  return size;
 }
 
 
@@ -480,9 +746,14 @@ Size PoolTotalSize(Pool pool)
 
 Size PoolFreeSize(Pool pool)
 {
+  Size size;
+
   AVERT(Pool, pool);
 
-  return Method(Pool, pool, freeSize)(pool);
+  PoolLockClaim(pool);
+  size = Method(Pool, pool, freeSize)(pool);
+  PoolLockRelease(pool);
+  return size;
 }
 
 
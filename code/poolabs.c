@@ -124,6 +124,7 @@ Res PoolAbsInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
   pool->alignment = MPS_PF_ALIGN;
   pool->format = NULL;
   pool->fix = PoolAutoSetFix;
+  pool->lock = NULL;
 
   if (ArgPick(&arg, args, MPS_KEY_FORMAT)) {
     Format format = arg.val.format;
@@ -192,6 +193,12 @@ DEFINE_CLASS(Pool, AbstractPool, klass)
   klass->finish = PoolAbsFinish;
   klass->alloc = PoolNoAlloc;
   klass->free = PoolNoFree;
+  klass->bulkAlloc = PoolAbsBulkAlloc;
+  klass->bulkFree = PoolAbsBulkFree;
+  klass->tryAlloc = PoolTrivTryAlloc;
+  klass->tryFree = PoolTrivTryFree;
+  klass->cacheAlloc = PoolTrivTryAlloc;
+  klass->cacheFree = PoolTrivTryFree;
   klass->bufferFill = PoolNoBufferFill;
   klass->bufferEmpty = PoolNoBufferEmpty;
   klass->access = PoolNoAccess;
@@ -199,6 +206,7 @@ DEFINE_CLASS(Pool, AbstractPool, klass)
   klass->grey = PoolNoGrey;
   klass->blacken = PoolNoBlacken;
   klass->scan = PoolNoScan;
+  klass->scanCards = PoolTrivScanCards;
   klass->fix = PoolNoFix;
   klass->fixEmergency = PoolNoFix;
   klass->reclaim = PoolNoReclaim;
@@ -297,6 +305,82 @@ void PoolTrivFree(Pool pool, Addr old, Size size)
   NOOP;                         /* trivial free has no effect */
 }
 
+Res PoolAbsBulkAlloc(Count *countReturn, Addr *listIO, Pool pool,
+                     Size size, Count count)
+{
+  PoolAllocMethod allocMethod;
+  Addr list, p;
+  Count n;
+  Res res = ResOK;
+
+  AVER(countReturn != NULL);
+  AVER(listIO != NULL);
+  AVERT(Pool, pool);
+  AVER(size >= sizeof(Addr));
+  AVER(count > 0);
+
+  allocMethod = Method(Pool, pool, alloc);
+  list = *listIO;
+  for (n = 0; n < count; ++n) {
+    res = (*allocMethod)(&p, pool, size);
+    if (res != ResOK)
+      break;
+    *ADDR_PTR(Addr, p) = list;
+    list = p;
+  }
+  if (n == 0)
+    return res;
+
+  *listIO = list;
+  *countReturn = n;
+  return ResOK;
+}
+
+void PoolAbsBulkFree(Pool pool, Addr *listIO, Size size, Count count)
+{
+  PoolFreeMethod freeMethod;
+  Addr list, p;
+  Count i;
+
+  AVERT(Pool, pool);
+  AVER(listIO != NULL);
+  AVER(size >= sizeof(Addr));
+  AVER(count > 0);
+
+  freeMethod = Method(Pool, pool, free);
+  list = *listIO;
+  for (i = 0; i < count; ++i) {
+    p = list;
+    list = *ADDR_PTR(Addr, p);
+    (*freeMethod)(pool, p, size);
+  }
+  *listIO = list;
+}
+
+
+/* PoolTrivTryAlloc, PoolTrivTryFree -- never succeed without the
+ * arena lock
+ *
+ * These are called with only the pool lock held, so they can't check
+ * the pool deeply.  See <design/thread-safety/#sol.pool-lock>.
+ */
+
+Bool PoolTrivTryAlloc(Addr *pReturn, Pool pool, Size size)
+{
+  AVER(pReturn != NULL);
+  AVER(TESTT(Pool, pool));
+  AVER(size > 0);
+  return FALSE;
+}
+
+Bool PoolTrivTryFree(Pool pool, Addr old, Size size)
+{
+  AVER(TESTT(Pool, pool));
+  AVER(old != NULL);
+  AVER(size > 0);
+  return FALSE;
+}
+
 
 Res PoolNoBufferFill(Addr *baseReturn, Addr *limitReturn,
                      Pool pool, Buffer buffer, Size size)
@@ -465,7 +549,8 @@ Res PoolSegAccess(Pool pool, Seg seg, Addr addr,
  * See also ArenaRead, and PoolSegAccess.
  *
  * Handles page faults by attempting emulation.  If the faulting
- * instruction cannot be emulated then this function returns ResFAIL.
+ * instruction cannot be emulated (or there is no mutator fault
+ * context, see ArenaAccess) then this function returns ResFAIL.
  *
  * Due to the assumptions made below, pool classes should only use
  * this function if all words in an object are tagged or traceable.
@@ -491,7 +576,7 @@ Res PoolSingleAccess(Pool pool, Seg seg, Addr addr,
 
   arena = PoolArena(pool);
 
-  if(ProtCanStepInstruction(context)) {
+  if(context != NULL && ProtCanStepInstruction(context)) {
     Ref ref;
     Res res;
 
@@ -505,13 +590,18 @@ Res PoolSingleAccess(Pool pool, Seg seg, Addr addr,
       /* .tagging: Check that the reference is aligned to a word boundary */
       /* (we assume it is not a reference otherwise). */
       if(WordIsAligned((Word)ref, sizeof(Word))) {
-        Rank rank;
+        TraceSet ts;
+        TraceId ti;
+        Trace trace;
         /* See the note in TraceRankForAccess */
         /* (<code/trace.c#scan.conservative>). */
         
-        rank = TraceRankForAccess(arena, seg);
-        TraceScanSingleRef(arena->flippedTraces, rank, arena,
-                           seg, (Ref *)addr);
+        ts = TraceSetInter(SegGrey(seg), arena->flippedTraces);
+        TRACE_SET_ITER(ti, trace, ts, arena)
+          TraceScanSingleRef(TraceSetSingle(trace),
+                             TraceRankForAccess(trace, seg),
+                             arena, seg, (Ref *)addr);
+        TRACE_SET_ITER_END(ti, trace, ts, arena);
       }
     }
     res = ProtStepInstruction(context);
@@ -574,8 +664,11 @@ void PoolTrivGrey(Pool pool, Trace trace, Seg seg)
   /* part of an already Whitened seg.  So we hereby exclude white */
   /* segs. */
   /* @@@@ This should not really be called 'trivial'! */
+  /* The segment may already be grey for another running trace, */
+  /* which must still scan it: see */
+  /* <design/trace/#instance.grey.union>. */
   if(!TraceSetIsMember(SegWhite(seg), trace))
-    SegSetGrey(seg, TraceSetSingle(trace));
+    SegSetGrey(seg, TraceSetAdd(SegGrey(seg), trace));
 }
 
 
@@ -609,6 +702,14 @@ Res PoolNoScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg)
   return ResUNIMPL;
 }
 
+Res PoolTrivScanCards(ScanState ss, Pool pool, Seg seg)
+{
+  AVERT(ScanState, ss);
+  AVERT(Pool, pool);
+  AVERT(Seg, seg);
+  return ResUNIMPL;
+}
+
 Res PoolNoFix(Pool pool, ScanState ss, Seg seg, Ref *refIO)
 {
   AVERT(Pool, pool);
@@ -17,6 +17,7 @@ SRCID(poolamc, "$Id$");
 
 typedef struct AMCStruct *AMC;
 typedef struct amcGenStruct *amcGen;
+typedef struct amcBufStruct *amcBuf;
 
 /* Function returning TRUE if block in nailboarded segment is pinned. */
 typedef Bool (*amcPinnedFunction)(AMC amc, Nailboard board, Addr base, Addr limit);
@@ -48,14 +49,16 @@ DECLARE_CLASS(Seg, amcSeg, GCSeg);
 typedef struct amcGenStruct {
   PoolGenStruct pgen;
   RingStruct amcRing;           /* link in list of gens in pool */
-  Buffer forward;               /* forwarding buffer */
+  Buffer forward[ARENA_NODE_MAX]; /* forwarding buffers, see .fix.node */
+  Index nr;                     /* index in the pool's array of gens */
   Sig sig;                      /* <code/misc.h#sig> */
 } amcGenStruct;
 
 #define amcGenAMC(amcgen) MustBeA(AMCZPool, (amcgen)->pgen.pool)
 #define amcGenPool(amcgen) ((amcgen)->pgen.pool)
 
-#define amcGenNr(amcgen) ((amcgen)->pgen.nr)
+#define amcGenNr(amcgen) ((amcgen)->nr)
+#define amcGenForwards(amcgen) ArenaNodes(PoolArena(amcGenPool(amcgen)))
 
 
 #define RAMP_RELATION(X)                        \
@@ -92,6 +95,18 @@ enum {
  * collection via TracePoll), and by hash array allocations (where we
  * don't want the allocation to provoke a collection that makes the
  * location dependency stale immediately).
+ *
+ * .seg.forwarded: The "forwarded" field is the set of traces that
+ * have copied objects into the segment, that is, the traces for which
+ * it is to-space.  Another trace must not condemn it while those
+ * traces are running, because their broken hearts in from-space point
+ * into it and are not visible to the other trace as references.  The
+ * set is cleared as each trace ends (see AMCTraceEnd).
+ *
+ * .seg.ap: The "ap" field is the mutator buffer that filled the
+ * segment, if that buffer keeps pretenuring statistics (see
+ * .pretenure), until the segment is first reclaimed.  It is NULL
+ * otherwise, and is reset when the buffer is destroyed.
  */
 
 typedef struct amcSegStruct *amcSeg;
@@ -105,6 +120,8 @@ typedef struct amcSegStruct {
   BOOLFIELD(accountedAsBuffered); /* .seg.accounted-as-buffered */
   BOOLFIELD(old);           /* .seg.old */
   BOOLFIELD(deferred);      /* .seg.deferred */
+  TraceSet forwarded : TraceLIMIT; /* .seg.forwarded */
+  amcBuf ap;                /* .seg.ap */
   Sig sig;                  /* <code/misc.h#sig> */
 } amcSegStruct;
 
@@ -122,6 +139,7 @@ static Bool amcSegCheck(amcSeg amcseg)
   /* CHECKL(BoolCheck(amcseg->accountedAsBuffered)); <design/type/#bool.bitfield.check> */
   /* CHECKL(BoolCheck(amcseg->old)); <design/type/#bool.bitfield.check> */
   /* CHECKL(BoolCheck(amcseg->deferred)); <design/type/#bool.bitfield.check> */
+  CHECKL(TraceSetCheck(amcseg->forwarded));
   return TRUE;
 }
 
@@ -152,6 +170,8 @@ static Res AMCSegInit(Seg seg, Pool pool, Addr base, Size size, ArgList args)
   amcseg->accountedAsBuffered = FALSE;
   amcseg->old = FALSE;
   amcseg->deferred = FALSE;
+  amcseg->forwarded = TraceSetEMPTY;
+  amcseg->ap = NULL;
 
   SetClassOfPoly(seg, CLASS(amcSeg));
   amcseg->sig = amcSegSig;
@@ -161,6 +181,51 @@ static Res AMCSegInit(Seg seg, Pool pool, Addr base, Size size, ArgList args)
 }
 
 
+/* amcSegSplit -- split an AMC segment
+ *
+ * AMC segments are only split by amcReclaimNailed, to free runs of
+ * dead objects from a nailed segment, so the segment has no
+ * nailboard, no buffer, and no pretenuring statistics to share. See
+ * <design/poolamc/#nailed.split>.
+ */
+
+static Res amcSegSplit(Seg seg, Seg segHi,
+                       Addr base, Addr mid, Addr limit)
+{
+  amcSeg amcseg, amcsegHi;
+  Res res;
+
+  AVERT(Seg, seg);
+  AVER(segHi != NULL);  /* can't check fully, it's not initialized */
+  amcseg = MustBeA(amcSeg, seg);
+  amcsegHi = CouldBeA(amcSeg, segHi);
+  AVER(!amcSegHasNailboard(seg));
+  AVER(SegBuffer(seg) == NULL);
+  AVER(!amcseg->accountedAsBuffered);
+  AVER(amcseg->ap == NULL);
+  /* other parameters are checked by next-method */
+
+  /* Split the superclass fields via next-method call */
+  res = NextMethod(Seg, amcSeg, split)(seg, segHi, base, mid, limit);
+  if (res != ResOK)
+    return res;
+
+  /* Full initialization for segHi. */
+  amcsegHi->gen = amcseg->gen;
+  amcsegHi->board = NULL;
+  amcsegHi->accountedAsBuffered = FALSE;
+  amcsegHi->old = amcseg->old;
+  amcsegHi->deferred = amcseg->deferred;
+  amcsegHi->forwarded = amcseg->forwarded;
+  amcsegHi->ap = NULL;
+  amcsegHi->sig = amcSegSig;
+  AVERC(amcSeg, amcseg);
+  AVERC(amcSeg, amcsegHi);
+  PoolGenAccountForSegSplit(&amcseg->gen->pgen);
+  return ResOK;
+}
+
+
 /* AMCSegSketch -- summarise the segment state for a human reader
  *
  * Write a short human-readable text representation of the segment 
@@ -330,9 +395,10 @@ static Res AMCSegDescribe(Seg seg, mps_lib_FILE *stream, Count depth)
 DEFINE_CLASS(Seg, amcSeg, klass)
 {
   INHERIT_CLASS(klass, amcSeg, GCSeg);
-  SegClassMixInNoSplitMerge(klass);  /* no support for this (yet) */
+  SegClassMixInNoSplitMerge(klass);  /* no support for merging (yet) */
   klass->size = sizeof(amcSegStruct);
   klass->init = AMCSegInit;
+  klass->split = amcSegSplit;
   klass->describe = AMCSegDescribe;
 }
 
@@ -400,12 +466,14 @@ ATTRIBUTE_UNUSED
 static Bool amcGenCheck(amcGen gen)
 {
   AMC amc;
+  Index i;
 
   CHECKS(amcGen, gen);
   CHECKD(PoolGen, &gen->pgen);
   amc = amcGenAMC(gen);
   CHECKU(AMC, amc);
-  CHECKD(Buffer, gen->forward);
+  for (i = 0; i < amcGenForwards(gen); ++i)
+    CHECKD(Buffer, gen->forward[i]);
   CHECKD_NOSIG(Ring, &gen->amcRing);
 
   return TRUE;
@@ -415,16 +483,36 @@ static Bool amcGenCheck(amcGen gen)
 /* amcBufStruct -- AMC Buffer subclass
  *
  * This subclass of SegBuf records a link to a generation.
+ *
+ * .pretenure: A mutator buffer created with MPS_KEY_GEN allocates
+ * into that generation of the chain rather than the nursery.  If it
+ * was created with MPS_KEY_AP_PRETENURE, or with a generation other
+ * than the nursery, it "tracks" its segments (see .seg.ap): it
+ * counts how much of what it allocated was condemned, how much of
+ * that survived, and an estimate of the bytes that would have been
+ * copied into its generation had they been allocated in the nursery.
+ * With MPS_KEY_AP_PRETENURE, amcBufPretenure uses these counts to
+ * move the buffer to older generations while its objects keep
+ * surviving, and back towards the requested generation when they
+ * don't.  See <design/poolamc/#pretenure>.
+ *
+ * .node: A buffer created with MPS_KEY_AP_NODE fills from segments
+ * on that NUMA node, if possible.  See <design/arena/#numa.ap>.
  */
 
 #define amcBufSig ((Sig)0x519A3CBF) /* SIGnature AMC BuFfer  */
 
-typedef struct amcBufStruct *amcBuf;
-
 typedef struct amcBufStruct {
   SegBufStruct segbufStruct;    /* superclass fields must come first */
   amcGen gen;                   /* The AMC generation */
   Bool forHashArrays;           /* allocates hash table arrays, see AMCBufferFill */
+  Bool track;                   /* keep pretenuring statistics? */
+  Bool pretenure;               /* move gen according to statistics? */
+  Index minNr;                  /* requested generation */
+  Index node;                   /* preferred node, or LocusNodeANY */
+  Size condemned;               /* tracked bytes condemned */
+  Size survived;                /* tracked bytes that survived */
+  Size copySaved;               /* estimated bytes not copied */
   Sig sig;                      /* <design/sig/> */
 } amcBufStruct;
 
@@ -441,6 +529,13 @@ static Bool amcBufCheck(amcBuf amcbuf)
   CHECKL(BoolCheck(amcbuf->forHashArrays));
   /* hash array buffers only created by mutator */
   CHECKL(BufferIsMutator(MustBeA(Buffer, amcbuf)) || !amcbuf->forHashArrays);
+  CHECKL(BoolCheck(amcbuf->track));
+  CHECKL(BoolCheck(amcbuf->pretenure));
+  CHECKL(amcbuf->track || !amcbuf->pretenure);
+  CHECKL(BufferIsMutator(MustBeA(Buffer, amcbuf)) || !amcbuf->track);
+  CHECKL(amcbuf->node == LocusNodeANY
+         || amcbuf->node < ArenaNodes(BufferArena(MustBeA(Buffer, amcbuf))));
+  /* nothing to check for condemned, survived, or copySaved */
   return TRUE;
 }
 
@@ -464,7 +559,41 @@ static void amcBufSetGen(Buffer buffer, amcGen gen)
 }
 
 
+/* amcGenSetForward -- set the generation a generation forwards into
+ *
+ * Detaches the generation's forwarding buffers (one per node: see
+ * .fix.node) and points them at gen, which may be NULL when the pool
+ * is being finished.
+ */
+
+static void amcGenSetForward(amcGen amcgen, amcGen gen)
+{
+  Pool pool = amcGenPool(amcgen);
+  Index i;
+
+  for (i = 0; i < amcGenForwards(amcgen); ++i) {
+    BufferDetach(amcgen->forward[i], pool);
+    amcBufSetGen(amcgen->forward[i], gen);
+  }
+}
+
+
+/* amcGenIsForward -- is a buffer one of a generation's forwarding buffers? */
+
+static Bool amcGenIsForward(amcGen amcgen, Buffer buffer)
+{
+  Index i;
+
+  for (i = 0; i < amcGenForwards(amcgen); ++i)
+    if (amcgen->forward[i] == buffer)
+      return TRUE;
+  return FALSE;
+}
+
+
 ARG_DEFINE_KEY(ap_hash_arrays, Bool);
+ARG_DEFINE_KEY(AP_PRETENURE, Bool);
+ARG_DEFINE_KEY(AP_NODE, Count);
 
 #define amcKeyAPHashArrays (&_mps_key_ap_hash_arrays)
 
@@ -476,10 +605,23 @@ static Res AMCBufInit(Buffer buffer, Pool pool, Bool isMutator, ArgList args)
   amcBuf amcbuf;
   Res res;
   Bool forHashArrays = FALSE;
+  Bool pretenure = FALSE;
+  Index genNr = 0;
+  Index node = LocusNodeANY;
   ArgStruct arg;
 
   if (ArgPick(&arg, args, amcKeyAPHashArrays))
     forHashArrays = arg.val.b;
+  if (ArgPick(&arg, args, MPS_KEY_GEN))
+    genNr = arg.val.u;
+  if (ArgPick(&arg, args, MPS_KEY_AP_PRETENURE))
+    pretenure = arg.val.b;
+  AVERT(Bool, pretenure);
+  if (ArgPick(&arg, args, MPS_KEY_AP_NODE)) {
+    node = arg.val.count;
+    if (node >= ArenaNodes(PoolArena(pool)))
+      return ResPARAM;
+  }
 
   /* call next method */
   res = NextMethod(Buffer, amcBuf, init)(buffer, pool, isMutator, args);
@@ -488,13 +630,24 @@ static Res AMCBufInit(Buffer buffer, Pool pool, Bool isMutator, ArgList args)
   amcbuf = CouldBeA(amcBuf, buffer);
 
   if (BufferIsMutator(buffer)) {
-    /* Set up the buffer to be allocating in the nursery. */
-    amcbuf->gen = amc->nursery;
+    /* Set up the buffer to be allocating in the nursery, or the
+       generation requested. See .pretenure. */
+    AVER(genNr <= amc->gens);
+    amcbuf->gen = amc->gen[genNr];
   } else {
     /* No gen yet -- see <design/poolamc/#gen.forward>. */
+    AVER(genNr == 0);
+    AVER(!pretenure);
     amcbuf->gen = NULL;
   }
   amcbuf->forHashArrays = forHashArrays;
+  amcbuf->track = pretenure || genNr > 0;
+  amcbuf->pretenure = pretenure;
+  amcbuf->minNr = genNr;
+  amcbuf->node = node;
+  amcbuf->condemned = 0;
+  amcbuf->survived = 0;
+  amcbuf->copySaved = 0;
 
   SetClassOfPoly(buffer, CLASS(amcBuf));
   amcbuf->sig = amcBufSig;
@@ -511,6 +664,24 @@ static Res AMCBufInit(Buffer buffer, Pool pool, Bool isMutator, ArgList args)
 static void AMCBufFinish(Buffer buffer)
 {
   amcBuf amcbuf = MustBeA(amcBuf, buffer);
+
+  if (amcbuf->track) {
+    Pool pool = BufferPool(buffer);
+    Ring node, nextNode;
+
+    EVENT5(AMCPretenure, pool, buffer, amcGenNr(amcbuf->gen),
+           (amcbuf->condemned == 0 ? 0.0
+            : (double)amcbuf->survived / (double)amcbuf->condemned),
+           amcbuf->copySaved);
+
+    /* Forget the segments this buffer filled. See .seg.ap. */
+    RING_FOR(node, PoolSegRing(pool), nextNode) {
+      amcSeg amcseg = MustBeA(amcSeg, SegOfPoolRing(node));
+      if (amcseg->ap == amcbuf)
+        amcseg->ap = NULL;
+    }
+  }
+
   amcbuf->sig = SigInvalid;
   NextMethod(Buffer, amcBuf, finish)(buffer);
 }
@@ -529,12 +700,12 @@ DEFINE_CLASS(Buffer, amcBuf, klass)
 
 /* amcGenCreate -- create a generation */
 
-static Res amcGenCreate(amcGen *genReturn, AMC amc, GenDesc gen)
+static Res amcGenCreate(amcGen *genReturn, AMC amc, GenDesc gen, Index nr)
 {
   Pool pool = MustBeA(AbstractPool, amc);
   Arena arena;
-  Buffer buffer;
   amcGen amcgen;
+  Index i;
   Res res;
   void *p;
 
@@ -545,15 +716,23 @@ static Res amcGenCreate(amcGen *genReturn, AMC amc, GenDesc gen)
     goto failControlAlloc;
   amcgen = (amcGen)p;
 
-  res = BufferCreate(&buffer, CLASS(amcBuf), pool, FALSE, argsNone);
-  if(res != ResOK)
-    goto failBufferCreate;
+  /* One forwarding buffer per node: see .fix.node. */
+  for (i = 0; i < ArenaNodes(arena); ++i) {
+    MPS_ARGS_BEGIN(args) {
+      if (ArenaNodes(arena) > 1)
+        MPS_ARGS_ADD(args, MPS_KEY_AP_NODE, i);
+      res = BufferCreate(&amcgen->forward[i], CLASS(amcBuf), pool, FALSE,
+                         args);
+    } MPS_ARGS_END(args);
+    if(res != ResOK)
+      goto failBufferCreate;
+  }
 
   res = PoolGenInit(&amcgen->pgen, gen, pool);
   if(res != ResOK)
     goto failGenInit;
   RingInit(&amcgen->amcRing);
-  amcgen->forward = buffer;
+  amcgen->nr = nr;
   amcgen->sig = amcGenSig;
 
   AVERT(amcGen, amcgen);
@@ -564,8 +743,11 @@ static Res amcGenCreate(amcGen *genReturn, AMC amc, GenDesc gen)
   return ResOK;
 
 failGenInit:
-  BufferDestroy(buffer);
 failBufferCreate:
+  while (i > 0) {
+    --i;
+    BufferDestroy(amcgen->forward[i]);
+  }
   ControlFree(arena, p, sizeof(amcGenStruct));
 failControlAlloc:
   return res;
@@ -577,6 +759,7 @@ failControlAlloc:
 static void amcGenDestroy(amcGen gen)
 {
   Arena arena;
+  Index i;
 
   AVERT(amcGen, gen);
 
@@ -586,7 +769,8 @@ static void amcGenDestroy(amcGen gen)
   RingRemove(&gen->amcRing);
   RingFinish(&gen->amcRing);
   PoolGenFinish(&gen->pgen);
-  BufferDestroy(gen->forward);
+  for (i = 0; i < amcGenForwards(gen); ++i)
+    BufferDestroy(gen->forward[i]);
   ControlFree(arena, gen, sizeof(amcGenStruct));
 }
 
@@ -596,6 +780,7 @@ static void amcGenDestroy(amcGen gen)
 static Res amcGenDescribe(amcGen gen, mps_lib_FILE *stream, Count depth)
 {
   Res res;
+  Index i;
 
   if(!TESTT(amcGen, gen))
     return ResFAIL;
@@ -604,10 +789,17 @@ static Res amcGenDescribe(amcGen gen, mps_lib_FILE *stream, Count depth)
 
   res = WriteF(stream, depth,
                "amcGen $P {\n", (WriteFP)gen,
-               "  buffer $P\n", (WriteFP)gen->forward, NULL);
+               "  nr $U\n", (WriteFU)gen->nr, NULL);
   if (res != ResOK)
     return res;
 
+  for (i = 0; i < amcGenForwards(gen); ++i) {
+    res = WriteF(stream, depth + 2,
+                 "buffer $P\n", (WriteFP)gen->forward[i], NULL);
+    if (res != ResOK)
+      return res;
+  }
+
   res = PoolGenDescribe(&gen->pgen, stream, depth + 2);
   if (res != ResOK)
     return res;
@@ -757,6 +949,7 @@ static Res amcInitComm(Pool pool, Arena arena, PoolClass klass,
 
   /* Init generations. */
   genCount = ChainGens(chain);
+  amc->gens = genCount;
   {
     void *p;
 
@@ -767,16 +960,16 @@ static Res amcInitComm(Pool pool, Arena arena, PoolClass klass,
       goto failGensAlloc;
     amc->gen = p;
     for (i = 0; i <= genCount; ++i) {
-      res = amcGenCreate(&amc->gen[i], amc, ChainGen(chain, i));
+      res = amcGenCreate(&amc->gen[i], amc, ChainGen(chain, i), i);
       if (res != ResOK)
         goto failGenAlloc;
     }
     /* Set up forwarding buffers. */
     for(i = 0; i < genCount; ++i) {
-      amcBufSetGen(amc->gen[i]->forward, amc->gen[i+1]);
+      amcGenSetForward(amc->gen[i], amc->gen[i+1]);
     }
     /* Dynamic gen forwards to itself. */
-    amcBufSetGen(amc->gen[genCount]->forward, amc->gen[genCount]);
+    amcGenSetForward(amc->gen[genCount], amc->gen[genCount]);
   }
   amc->nursery = amc->gen[0];
   amc->rampGen = amc->gen[genCount-1]; /* last ephemeral gen */
@@ -837,7 +1030,9 @@ static void AMCFinish(Pool pool)
   /* buffers by this time. */
   RING_FOR(node, &amc->genRing, nextNode) {
     amcGen gen = RING_ELT(amcGen, amcRing, node);
-    BufferDetach(gen->forward, pool);
+    Index i;
+    for (i = 0; i < amcGenForwards(gen); ++i)
+      BufferDetach(gen->forward[i], pool);
   }
 
   ring = PoolSegRing(pool);
@@ -859,7 +1054,7 @@ static void AMCFinish(Pool pool)
   ring = &amc->genRing;
   RING_FOR(node, ring, nextNode) {
     amcGen gen = RING_ELT(amcGen, amcRing, node);
-    amcBufSetGen(gen->forward, NULL);
+    amcGenSetForward(gen, NULL);
   }
   RING_FOR(node, ring, nextNode) {
     amcGen gen = RING_ELT(amcGen, amcRing, node);
@@ -871,6 +1066,38 @@ static void AMCFinish(Pool pool)
 }
 
 
+/* amcBufPretenure -- move a pretenuring buffer between generations
+ *
+ * Once enough of what the buffer allocated has been condemned to
+ * judge, move it one generation older if nearly all of it survived,
+ * or one generation younger (but no younger than it asked for) if
+ * much of it died.  The dynamic generation is collected only with the
+ * world, so the buffer never moves there by itself.  See .pretenure.
+ */
+
+static void amcBufPretenure(AMC amc, amcBuf amcbuf)
+{
+  Index nr = amcGenNr(amcbuf->gen);
+  double survival;
+
+  if (amcbuf->condemned < AMC_PRETENURE_SAMPLE)
+    return;
+  survival = (double)amcbuf->survived / (double)amcbuf->condemned;
+  if (survival >= AMC_PRETENURE_PROMOTE && nr + 1 < amc->gens)
+    ++ nr;
+  else if (survival < AMC_PRETENURE_DEMOTE && nr > amcbuf->minNr)
+    -- nr;
+  amcbuf->condemned = 0;
+  amcbuf->survived = 0;
+
+  if (nr != amcGenNr(amcbuf->gen)) {
+    amcbuf->gen = amc->gen[nr];
+    EVENT5(AMCPretenure, MustBeA(AbstractPool, amc), MustBeA(Buffer, amcbuf),
+           nr, survival, amcbuf->copySaved);
+  }
+}
+
+
 /* AMCBufferFill -- refill an allocation buffer
  *
  * See <design/poolamc/#fill>.
@@ -896,6 +1123,8 @@ static Res AMCBufferFill(Addr *baseReturn, Addr *limitReturn,
   AVER(SizeIsAligned(size, PoolAlignment(pool)));
 
   arena = PoolArena(pool);
+  if (amcbuf->pretenure)
+    amcBufPretenure(amc, amcbuf);
   gen = amcBufGen(buffer);
   AVERT(amcGen, gen);
   pgen = &gen->pgen;
@@ -910,7 +1139,8 @@ static Res AMCBufferFill(Addr *baseReturn, Addr *limitReturn,
   }
   MPS_ARGS_BEGIN(args) {
     MPS_ARGS_ADD_FIELD(args, amcKeySegGen, p, gen);
-    res = PoolGenAlloc(&seg, pgen, CLASS(amcSeg), grainsSize, args);
+    res = PoolGenAllocNode(&seg, pgen, CLASS(amcSeg), grainsSize,
+                           amcbuf->node, args);
   } MPS_ARGS_END(args);
   if(res != ResOK)
     return res;
@@ -925,7 +1155,7 @@ static Res AMCBufferFill(Addr *baseReturn, Addr *limitReturn,
   /* If ramping, or if the buffer is intended for allocating hash
    * table arrays, defer the size accounting. */
   if ((amc->rampMode == RampRAMPING
-       && buffer == amc->rampGen->forward
+       && amcGenIsForward(amc->rampGen, buffer)
        && gen == amc->rampGen)
       || amcbuf->forHashArrays) 
   {
@@ -957,6 +1187,8 @@ static Res AMCBufferFill(Addr *baseReturn, Addr *limitReturn,
 
   PoolGenAccountForFill(pgen, SegSize(seg));
   MustBeA(amcSeg, seg)->accountedAsBuffered = TRUE;
+  if (amcbuf->track)
+    MustBeA(amcSeg, seg)->ap = amcbuf;
 
   *baseReturn = base;
   *limitReturn = limit;
@@ -1100,6 +1332,13 @@ static Res AMCWhiten(Pool pool, Trace trace, Seg seg)
 
   AVERT(Trace, trace);
 
+  /* Don't condemn to-space of another running trace: see */
+  /* .seg.forwarded. */
+  if(TraceSetInter(amcseg->forwarded,
+                   TraceSetDel(PoolArena(pool)->busyTraces, trace))
+     != TraceSetEMPTY)
+    return ResOK;
+
   buffer = SegBuffer(seg);
   if(buffer != NULL) {
     AVERT(Buffer, buffer);
@@ -1159,8 +1398,10 @@ static Res AMCWhiten(Pool pool, Trace trace, Seg seg)
     }
   }
 
-  SegSetWhite(seg, TraceSetAdd(SegWhite(seg), trace));
   condemned += SegSize(seg);
+  if (amcseg->ap != NULL && SegWhite(seg) == TraceSetEMPTY)
+    amcseg->ap->condemned += condemned;
+  SegSetWhite(seg, TraceSetAdd(SegWhite(seg), trace));
   trace->condemned += condemned;
 
   gen = amcSegGen(seg);
@@ -1179,15 +1420,16 @@ static Res AMCWhiten(Pool pool, Trace trace, Seg seg)
   /* Ensure we are forwarding into the right generation. */
 
   /* see <design/poolamc/#gen.ramp> */
-  /* This switching needs to be more complex for multiple traces. */
-  AVER(TraceSetIsSingle(PoolArena(pool)->busyTraces));
-  if(amc->rampMode == RampBEGIN && gen == amc->rampGen) {
-    BufferDetach(gen->forward, pool);
-    amcBufSetGen(gen->forward, gen);
+  /* .ramp.single: The ramp state only changes when the trace is */
+  /* running on its own; otherwise the switch is postponed until a */
+  /* later trace, since another trace could reclaim under our feet. */
+  if(PoolArena(pool)->busyTraces != TraceSetSingle(trace)) {
+    NOOP;
+  } else if(amc->rampMode == RampBEGIN && gen == amc->rampGen) {
+    amcGenSetForward(gen, gen);
     amc->rampMode = RampRAMPING;
   } else if(amc->rampMode == RampFINISH && gen == amc->rampGen) {
-    BufferDetach(gen->forward, pool);
-    amcBufSetGen(gen->forward, amc->afterRampGen);
+    amcGenSetForward(gen, amc->afterRampGen);
     amc->rampMode = RampCOLLECTING;
   }
 
@@ -1350,7 +1592,9 @@ static Res AMCScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg)
 
   format = pool->format;
 
-  if(amcSegHasNailboard(seg)) {
+  /* The nailboard only says which objects are pinned for the traces */
+  /* that nailed them.  For any other trace, scan all the objects. */
+  if(amcSegHasNailboard(seg) && TraceSetSub(ss->traces, SegNailed(seg))) {
     return amcScanNailed(totalReturn, ss, pool, seg, amc);
   }
 
@@ -1395,6 +1639,59 @@ static Res AMCScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg)
 }
 
 
+/* AMCScanCards -- scan the objects in a segment that overlap dirty cards
+ *
+ * AMC has no record of where objects start, so this walks every
+ * object in the segment, but only scans runs of objects that overlap
+ * a dirty card.  See <design/write-barrier/#card.harvest>.
+ */
+
+static Res AMCScanCards(ScanState ss, Pool pool, Seg seg)
+{
+  Addr p, limit, run;
+  Format format;
+  Arena arena;
+  Size headerSize;
+  Res res;
+
+  AVERT(ScanState, ss);
+  AVERC(AMCZPool, pool);
+  AVERT(Seg, seg);
+
+  /* Nailed segments may contain objects that are not walkable. */
+  if (SegNailed(seg) != TraceSetEMPTY)
+    return ResUNIMPL;
+
+  arena = PoolArena(pool);
+  format = pool->format;
+  headerSize = format->headerSize;
+
+  limit = AddrAdd(SegBufferScanLimit(seg), headerSize);
+  p = AddrAdd(SegBase(seg), headerSize);
+  run = NULL;
+  while (p < limit) {
+    Addr q = (*format->skip)(p);
+    AVER(q > p);
+    if (CardsRangeDirty(arena, AddrSub(p, headerSize),
+                        AddrSub(q, headerSize))) {
+      if (run == NULL)
+        run = p;
+    } else if (run != NULL) {
+      res = FormatScan(format, ss, run, p);
+      if (res != ResOK)
+        return res;
+      run = NULL;
+    }
+    p = q;
+  }
+  AVER(p == limit);
+  if (run != NULL)
+    return FormatScan(format, ss, run, p);
+
+  return ResOK;
+}
+
+
 /* amcFixInPlace -- fix an reference without moving the object
  *
  * Usually this function is used for ambiguous references, but during
@@ -1496,6 +1793,9 @@ static Res AMCFix(Pool pool, ScanState ss, Seg seg, Ref *refIO)
   amcGen gen;          /* generation of old copy of object */
   TraceSet grey;       /* greyness of object being relocated */
   Seg toSeg;           /* segment to which object is being relocated */
+  amcSeg toAmcseg;     /* ditto, as an AMC segment */
+  amcBuf ap;           /* buffer that allocated the object, if tracked */
+  Index node;          /* node to copy the object to, see .fix.node */
 
   /* <design/trace/#fix.noaver> */
   AVERT_CRITICAL(Pool, pool);
@@ -1576,14 +1876,28 @@ static Res AMCFix(Pool pool, ScanState ss, Seg seg, Ref *refIO)
     /* <design/fix/#protocol.was-marked> */
     ss->wasMarked = FALSE;
 
-    /* Get the forwarding buffer from the object's generation. */
+    /* Get the forwarding buffer from the object's generation.
+     * .fix.node: Each generation has a forwarding buffer for each
+     * node, and the object is copied to the node of the segment that
+     * refers to it, or stays on its own node if it is referred to
+     * from a root.  See <design/arena/#numa.copy>. */
     gen = amcSegGen(seg);
-    buffer = gen->forward;
+    node = 0;
+    if (ArenaNodes(arena) > 1)
+      node = ss->node != LocusNodeANY ? ss->node
+        : ArenaNodeOfAddr(arena, ref);
+    buffer = gen->forward[node];
     AVER_CRITICAL(buffer != NULL);
 
     length = AddrOffset(ref, clientQ);  /* .exposed.seg */
     STATISTIC(++ss->forwardedCount);
     ss->forwardedSize += length;
+    ap = MustBeA_CRITICAL(amcSeg, seg)->ap;
+    if (ap != NULL) {
+      /* See .pretenure. */
+      ap->survived += length;
+      ap->copySaved += length * amcGenNr(gen);
+    }
     do {
       res = BUFFER_RESERVE(&newBase, buffer, length);
       if (res != ResOK)
@@ -1603,6 +1917,8 @@ static Res AMCFix(Pool pool, ScanState ss, Seg seg, Ref *refIO)
         AVER(SegRankSet(toSeg) == RankSetEMPTY);
       }
       SegSetGrey(toSeg, TraceSetUnion(SegGrey(toSeg), grey));
+      toAmcseg = MustBeA_CRITICAL(amcSeg, toSeg);
+      toAmcseg->forwarded = TraceSetUnion(toAmcseg->forwarded, ss->traces);
 
       /* <design/trace/#fix.copy> */
       (void)AddrCopy(newBase, base, length);  /* .exposed.seg */
@@ -1632,6 +1948,112 @@ returnRes:
 }
 
 
+/* amcNailedSplittable -- can runs of dead objects be freed from a
+ * nailed segment?
+ *
+ * Only if it has more than one grain and no buffer, and once this
+ * trace has finished with it, it is not white, grey or nailed for any
+ * other trace (so that its nailboard is destroyed and no other trace
+ * cares about its contents). See <design/poolamc/#nailed.split>.
+ */
+
+static Bool amcNailedSplittable(Seg seg, Trace trace)
+{
+  Arena arena = PoolArena(SegPool(seg));
+
+  return SegSize(seg) > ArenaGrainSize(arena)
+    && SegBuffer(seg) == NULL
+    && SegGrey(seg) == TraceSetEMPTY
+    && TraceSetDel(SegWhite(seg), trace) == TraceSetEMPTY
+    && TraceSetDel(SegNailed(seg), trace) == TraceSetEMPTY;
+}
+
+
+/* amcNailedPad -- pad a run of dead objects in a nailed segment
+ *
+ * If kept is not NULL, and the run covers any whole arena grains,
+ * pad those grains separately from the rest of the run and reset
+ * their bits in kept, so that amcNailedFree can free them.
+ */
+
+static void amcNailedPad(Seg seg, Format format, BT kept,
+                         Addr base, Size length)
+{
+  Addr limit = AddrAdd(base, length);
+
+  if (kept != NULL) {
+    Arena arena = PoolArena(SegPool(seg));
+    Size grainSize = ArenaGrainSize(arena);
+    Addr freeBase = AddrAlignUp(base, grainSize);
+    Addr freeLimit = AddrAlignDown(limit, grainSize);
+
+    if (freeBase < freeLimit) {
+      if (base < freeBase)
+        (*format->pad)(base, AddrOffset(base, freeBase));
+      (*format->pad)(freeBase, AddrOffset(freeBase, freeLimit));
+      if (freeLimit < limit)
+        (*format->pad)(freeLimit, AddrOffset(freeLimit, limit));
+      BTResRange(kept,
+                 AddrOffset(SegBase(seg), freeBase) / grainSize,
+                 AddrOffset(SegBase(seg), freeLimit) / grainSize);
+      return;
+    }
+  }
+
+  (*format->pad)(base, length);
+}
+
+
+/* amcNailedFree -- free the grains of a nailed segment not in kept
+ *
+ * Works down from the top of the segment, splitting off each run of
+ * reset grains in kept and freeing it, so that seg stays the lowest
+ * piece. If a split fails, the rest of the runs stay in the segment,
+ * still padded.
+ */
+
+static void amcNailedFree(Trace trace, Seg seg, BT kept, Count grains)
+{
+  Arena arena = PoolArena(SegPool(seg));
+  Size grainSize = ArenaGrainSize(arena);
+  amcGen gen = amcSegGen(seg);
+  Bool deferred = MustBeA(amcSeg, seg)->deferred;
+  Addr base = SegBase(seg);
+  Index runBase, runLimit, searchLimit = grains;
+
+  AVER(MustBeA(amcSeg, seg)->old);
+  UNUSED(trace); /* only used by STATISTIC */
+
+  while (BTFindLongResRangeHigh(&runBase, &runLimit, kept,
+                                0, searchLimit, 1)) {
+    Addr freeBase = AddrAdd(base, runBase * grainSize);
+    Addr freeLimit = AddrAdd(base, runLimit * grainSize);
+    Seg segLo, segHi;
+    Res res;
+
+    if (freeLimit < SegLimit(seg)) {
+      res = SegSplit(&segLo, &segHi, seg, freeLimit);
+      if (res != ResOK)
+        return;
+      AVER(segLo == seg);
+    }
+    if (freeBase == base) {
+      /* The lowest run includes the base, so there are no more. */
+      STATISTIC(trace->nailedFreedSize += SegSize(seg));
+      PoolGenFree(&gen->pgen, seg, 0, SegSize(seg), 0, deferred);
+      return;
+    }
+    res = SegSplit(&segLo, &segHi, seg, freeBase);
+    if (res != ResOK)
+      return;
+    AVER(segLo == seg);
+    STATISTIC(trace->nailedFreedSize += SegSize(segHi));
+    PoolGenFree(&gen->pgen, segHi, 0, SegSize(segHi), 0, deferred);
+    searchLimit = runBase;
+  }
+}
+
+
 /* amcReclaimNailed -- reclaim what you can from a nailed segment */
 
 static void amcReclaimNailed(Pool pool, Trace trace, Seg seg)
@@ -1646,6 +2068,9 @@ static void amcReclaimNailed(Pool pool, Trace trace, Seg seg)
   Size headerSize;
   Addr padBase;          /* base of next padding object */
   Size padLength;        /* length of next padding object */
+  amcSeg amcseg;
+  BT kept = NULL;        /* grains to keep, if splitting; .nailed.split */
+  Count grains = 0;      /* number of grains in the segment */
 
   /* All arguments AVERed by AMCReclaim */
 
@@ -1654,6 +2079,17 @@ static void amcReclaimNailed(Pool pool, Trace trace, Seg seg)
   arena = PoolArena(pool);
   AVERT(Arena, arena);
 
+  /* See <design/poolamc/#nailed.split>. If the table can't be
+   * allocated, the dead objects are padded but not freed. */
+  STATISTIC(trace->nailedSegSize += SegSize(seg));
+  if (amcNailedSplittable(seg, trace)) {
+    grains = SegSize(seg) / ArenaGrainSize(arena);
+    if (BTCreate(&kept, arena, grains) == ResOK)
+      BTSetRange(kept, 0, grains);
+    else
+      kept = NULL;
+  }
+
   /* see <design/poolamc/#nailboard.limitations> for improvements */
   headerSize = format->headerSize;
   ShieldExpose(arena, seg);
@@ -1683,7 +2119,7 @@ static void amcReclaimNailed(Pool pool, Trace trace, Seg seg)
       if (padLength > 0) {
         /* Replace run of forwarding pointers and unreachable objects
          * with a padding object. */
-        (*format->pad)(padBase, padLength);
+        amcNailedPad(seg, format, kept, padBase, padLength);
         STATISTIC(bytesReclaimed += padLength);
         padLength = 0;
       }
@@ -1700,7 +2136,7 @@ static void amcReclaimNailed(Pool pool, Trace trace, Seg seg)
   if (padLength > 0) {
     /* Replace final run of forwarding pointers and unreachable
      * objects with a padding object. */
-    (*format->pad)(padBase, padLength);
+    amcNailedPad(seg, format, kept, padBase, padLength);
     STATISTIC(bytesReclaimed += padLength);
   }
   ShieldCover(arena, seg);
@@ -1717,6 +2153,14 @@ static void amcReclaimNailed(Pool pool, Trace trace, Seg seg)
   STATISTIC(trace->preservedInPlaceCount += preservedInPlaceCount);
   trace->preservedInPlaceSize += preservedInPlaceSize;
 
+  amcseg = MustBeA(amcSeg, seg);
+  if (amcseg->ap != NULL) {
+    /* See .pretenure. */
+    amcseg->ap->survived += preservedInPlaceSize;
+    amcseg->ap->copySaved += preservedInPlaceSize * amcGenNr(amcSegGen(seg));
+    amcseg->ap = NULL;
+  }
+
   /* Free the seg if we can; fixes .nailboard.limitations.middle. */
   if(preservedInPlaceCount == 0
      && (SegBuffer(seg) == NULL)
@@ -1727,8 +2171,15 @@ static void amcReclaimNailed(Pool pool, Trace trace, Seg seg)
     /* We may not free a buffered seg. */
     AVER(SegBuffer(seg) == NULL);
 
+    STATISTIC(trace->nailedFreedSize += SegSize(seg));
     PoolGenFree(&gen->pgen, seg, 0, SegSize(seg), 0, MustBeA(amcSeg, seg)->deferred);
+  } else if (kept != NULL) {
+    /* Free the runs of dead objects instead. */
+    amcNailedFree(trace, seg, kept, grains);
   }
+
+  if (kept != NULL)
+    BTDestroy(kept, arena, grains);
 }
 
 
@@ -1749,9 +2200,9 @@ static void AMCReclaim(Pool pool, Trace trace, Seg seg)
 
   EVENT3(AMCReclaim, gen, trace, seg);
 
-  /* This switching needs to be more complex for multiple traces. */
-  AVER_CRITICAL(TraceSetIsSingle(PoolArena(pool)->busyTraces));
-  if(amc->rampMode == RampCOLLECTING) {
+  /* See .ramp.single. */
+  if(amc->rampMode == RampCOLLECTING
+     && PoolArena(pool)->busyTraces == TraceSetSingle(trace)) {
     if(amc->rampCount > 0) {
       /* Entered ramp mode before previous one was cleaned up */
       amc->rampMode = RampBEGIN;
@@ -1775,6 +2226,24 @@ static void AMCReclaim(Pool pool, Trace trace, Seg seg)
 }
 
 
+/* AMCTraceEnd -- forget to-space of a trace that has ended
+ *
+ * See .seg.forwarded.
+ */
+static void AMCTraceEnd(Pool pool, Trace trace)
+{
+  Ring node, nextNode;
+
+  AVERC(AMCZPool, pool);
+  AVERT(Trace, trace);
+
+  RING_FOR(node, PoolSegRing(pool), nextNode) {
+    amcSeg amcseg = MustBeA(amcSeg, SegOfPoolRing(node));
+    amcseg->forwarded = TraceSetDel(amcseg->forwarded, trace);
+  }
+}
+
+
 /* AMCWalk -- Apply function to (black) objects in segment */
 
 static void AMCWalk(Pool pool, Seg seg, FormattedObjectsVisitor f,
@@ -2031,6 +2500,7 @@ DEFINE_CLASS(Pool, AMCZPool, klass)
   klass->fix = AMCFix;
   klass->fixEmergency = AMCFixEmergency;
   klass->reclaim = AMCReclaim;
+  klass->traceEnd = AMCTraceEnd;
   klass->rampBegin = AMCRampBegin;
   klass->rampEnd = AMCRampEnd;
   klass->addrObject = AMCAddrObject;
@@ -2050,6 +2520,7 @@ DEFINE_CLASS(Pool, AMCPool, klass)
   PoolClassMixInScan(klass);
   klass->init = AMCInit;
   klass->scan = AMCScan;
+  klass->scanCards = AMCScanCards;
 }
 
 
@@ -71,6 +71,14 @@ Bool AMSSegCheck(AMSSeg amsseg)
 
   CHECKL(BoolCheck(amsseg->marksChanged));
   CHECKL(BoolCheck(amsseg->ambiguousFixes));
+  CHECKL(BoolCheck(amsseg->evacuating));
+  /* <design/poolams/#evacuate.cond> */
+  CHECKL(!amsseg->evacuating || SegWhite(seg) != TraceSetEMPTY);
+  CHECKL(!amsseg->evacuating || SegBuffer(seg) == NULL);
+  CHECKL(BoolCheck(amsseg->forwarded));
+  /* <design/poolams/#evacuate.snap> */
+  CHECKL(!amsseg->forwarded || SegWhite(seg) != TraceSetEMPTY);
+  CHECKL(TraceSetCheck(amsseg->toSpace));
   CHECKL(BoolCheck(amsseg->colourTablesInUse));
   CHECKD_NOSIG(BT, amsseg->nongreyTable);
   CHECKD_NOSIG(BT, amsseg->nonwhiteTable);
@@ -242,6 +250,9 @@ static Res AMSSegInit(Seg seg, Pool pool, Addr base, Size size, ArgList args)
   amsseg->oldGrains = (Count)0;
   amsseg->marksChanged = FALSE; /* <design/poolams/#marked.unused> */
   amsseg->ambiguousFixes = FALSE;
+  amsseg->evacuating = FALSE;
+  amsseg->forwarded = FALSE;
+  amsseg->toSpace = TraceSetEMPTY;
 
   res = amsCreateTables(ams, &amsseg->allocTable,
                         &amsseg->nongreyTable, &amsseg->nonwhiteTable,
@@ -387,6 +398,7 @@ static Res AMSSegMerge(Seg seg, Seg segHi,
   amsseg->bufferedGrains = amsseg->bufferedGrains + amssegHi->bufferedGrains;
   amsseg->newGrains = amsseg->newGrains + amssegHi->newGrains;
   amsseg->oldGrains = amsseg->oldGrains + amssegHi->oldGrains;
+  amsseg->toSpace = TraceSetUnion(amsseg->toSpace, amssegHi->toSpace);
   /* other fields in amsseg are unaffected */
 
   RingRemove(&amssegHi->segRing);
@@ -482,6 +494,9 @@ static Res AMSSegSplit(Seg seg, Seg segHi,
   amssegHi->oldGrains = (Count)0;
   amssegHi->marksChanged = FALSE; /* <design/poolams/#marked.unused> */
   amssegHi->ambiguousFixes = FALSE;
+  amssegHi->evacuating = FALSE; /* it's empty, see .empty */
+  amssegHi->forwarded = FALSE;
+  amssegHi->toSpace = amsseg->toSpace;
 
   /* start off using firstFree, see <design/poolams/#no-bit> */
   amssegHi->allocTableInUse = FALSE;
@@ -549,6 +564,9 @@ static Res AMSSegDescribe(Seg seg, mps_lib_FILE *stream, Count depth)
                "buffferedGrains $W\n", (WriteFW)amsseg->bufferedGrains,
                "newGrains $W\n", (WriteFW)amsseg->newGrains,
                "oldGrains $W\n", (WriteFW)amsseg->oldGrains,
+               "evacuating $S\n", WriteFYesNo(amsseg->evacuating),
+               "forwarded $S\n", WriteFYesNo(amsseg->forwarded),
+               "toSpace $B\n", (WriteFB)amsseg->toSpace,
                NULL);
   if (res != ResOK)
     return res;
@@ -773,12 +791,14 @@ static void AMSDebugVarargs(ArgStruct args[MPS_ARGS_MAX], va_list varargs)
  */
 
 ARG_DEFINE_KEY(AMS_SUPPORT_AMBIGUOUS, Bool);
+ARG_DEFINE_KEY(AMS_EVACUATE, double);
 
 static Res AMSInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
 {
   Res res;
   Chain chain;
   Bool supportAmbiguous = AMS_SUPPORT_AMBIGUOUS_DEFAULT;
+  double evacuateOccupancy = AMS_EVACUATE_DEFAULT;
   unsigned gen = AMS_GEN_DEFAULT;
   ArgStruct arg;
   AMS ams;
@@ -798,8 +818,12 @@ static Res AMSInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
     gen = arg.val.u;
   if (ArgPick(&arg, args, MPS_KEY_AMS_SUPPORT_AMBIGUOUS))
     supportAmbiguous = arg.val.b;
+  if (ArgPick(&arg, args, MPS_KEY_AMS_EVACUATE))
+    evacuateOccupancy = arg.val.d;
 
   AVERT(Chain, chain);
+  AVER(0.0 <= evacuateOccupancy);
+  AVER(evacuateOccupancy <= 1.0);
   AVER(gen <= ChainGens(chain));
   AVER(chain->arena == arena);
 
@@ -815,6 +839,8 @@ static Res AMSInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
   /* .ambiguous.noshare: If the pool is required to support ambiguous */
   /* references, the alloc and white tables cannot be shared. */
   ams->shareAllocTable = !supportAmbiguous;
+  ams->evacuateOccupancy = evacuateOccupancy;
+  ams->forward = NULL;
   ams->pgen = NULL;
 
   RingInit(&ams->segRing);
@@ -834,10 +860,19 @@ static Res AMSInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
     goto failGenInit;
   ams->pgen = &ams->pgenStruct;
 
+  if (evacuateOccupancy > 0.0) {
+    /* <design/poolams/#evacuate.buffer>: the default rank is exact. */
+    res = BufferCreate(&ams->forward, CLASS(RankBuf), pool, FALSE, argsNone);
+    if (res != ResOK)
+      goto failBufferCreate;
+  }
+
   EVENT3(PoolInitAMS, pool, PoolArena(pool), pool->format);
 
   return ResOK;
 
+failBufferCreate:
+  PoolGenFinish(ams->pgen);
 failGenInit:
   PoolAbsFinish(pool);
 failAbsInit:
@@ -858,6 +893,10 @@ void AMSFinish(Pool pool)
   ams = PoolAMS(pool);
   AVERT(AMS, ams);
 
+  if (ams->forward != NULL) {
+    BufferDestroy(ams->forward);
+    ams->forward = NULL;
+  }
   ams->segsDestroy(ams);
   /* can't invalidate the AMS until we've destroyed all the segs */
   ams->sig = SigInvalid;
@@ -952,8 +991,10 @@ static Res AMSBufferFill(Addr *baseReturn, Addr *limitReturn,
   AVER(SizeIsAligned(size, PoolAlignment(pool)));
 
   /* Check that we're not in the grey mutator phase (see */
-  /* <design/poolams/#fill.colour>). */
-  AVER(PoolArena(pool)->busyTraces == PoolArena(pool)->flippedTraces);
+  /* <design/poolams/#fill.colour>), unless this is the forwarding */
+  /* buffer (see <design/poolams/#evacuate.buffer>). */
+  AVER(PoolArena(pool)->busyTraces == PoolArena(pool)->flippedTraces
+       || buffer == ams->forward);
 
   rankSet = BufferRankSet(buffer);
   ring = (ams->allocRing)(ams, rankSet, size);
@@ -1094,6 +1135,25 @@ static void amsRangeWhiten(Seg seg, Index base, Index limit)
 }
 
 
+/* amsSegEvacuate -- should a segment being condemned be evacuated?
+ *
+ * See <design/poolams/#evacuate.cond>.
+ */
+static Bool amsSegEvacuate(AMS ams, Trace trace, Seg seg)
+{
+  AMSSeg amsseg = Seg2AMSSeg(seg);
+  Arena arena = PoolArena(AMSPool(ams));
+
+  return ams->forward != NULL
+    && SegBuffer(seg) == NULL
+    && SegRankSet(seg) == BufferRankSet(ams->forward)
+    && arena->busyTraces == TraceSetSingle(trace)
+    && arena->workers == NULL
+    && (double)amsseg->oldGrains
+       < ams->evacuateOccupancy * (double)amsseg->grains;
+}
+
+
 /* AMSWhiten -- the pool class segment condemning method */
 
 static Res AMSWhiten(Pool pool, Trace trace, Seg seg)
@@ -1117,6 +1177,19 @@ static Res AMSWhiten(Pool pool, Trace trace, Seg seg)
   AVER(SegWhite(seg) == TraceSetEMPTY);
   AVER(!amsseg->colourTablesInUse);
 
+  /* Don't condemn to-space of another running trace: see */
+  /* <design/poolams/#evacuate.to-space>. */
+  if (TraceSetInter(amsseg->toSpace,
+                    TraceSetDel(PoolArena(pool)->busyTraces, trace))
+      != TraceSetEMPTY)
+    return ResOK;
+
+  /* Condemn the objects in the forwarding buffer, if it's here, */
+  /* rather than leaving it black. */
+  buffer = SegBuffer(seg);
+  if (buffer != NULL && buffer == ams->forward)
+    BufferDetach(buffer, pool);
+
   amsseg->colourTablesInUse = TRUE;
 
   /* Init allocTable, if necessary. */
@@ -1171,6 +1244,14 @@ static Res AMSWhiten(Pool pool, Trace trace, Seg seg)
   if (amsseg->oldGrains > 0) {
     trace->condemned += AMSGrainsSize(ams, amsseg->oldGrains);
     SegSetWhite(seg, TraceSetAdd(SegWhite(seg), trace));
+    if (amsSegEvacuate(ams, trace, seg)) {
+      amsseg->evacuating = TRUE;
+      /* Objects in the segment may move, so location dependencies on */
+      /* its zones go stale at the flip. TraceAddWhite adds these */
+      /* zones to the white set when we return. */
+      trace->mayMove = ZoneSetUnion(trace->mayMove,
+                                    ZoneSetOfSeg(PoolArena(pool), seg));
+    }
   } else {
     amsseg->colourTablesInUse = FALSE;
   }
@@ -1277,22 +1358,60 @@ static Res amsIterate(Seg seg, AMSObjectFunction f, void *closure)
 }
 
 
-/* amsScanObject -- scan a single object
+/* amsScanClosureStruct -- closure for amsScanObject
  *
- * This is the object function passed to amsIterate by AMSScan.  */
+ * [base, limit) is a run of grey objects that amsScanObject has found
+ * but not yet scanned.  It is empty if base == limit.
+ */
 
 struct amsScanClosureStruct {
   ScanState ss;
-  Bool scanAllObjects;
+  Addr base;
+  Addr limit;
 };
 
-typedef struct amsScanClosureStruct *amsScanClosure;
+
+/* amsScanRun -- scan and blacken the run of grey objects found so far
+ *
+ * Called with the fix lock claimed, and returns with it claimed.
+ */
+
+static Res amsScanRun(Seg seg, struct amsScanClosureStruct *sc)
+{
+  Format format = AMSPool(Seg2AMSSeg(seg)->ams)->format;
+  Res res;
+
+  if (sc->base == sc->limit)
+    return ResOK;
+
+  ScanStateFixRelease(sc->ss);
+  res = FormatScan(format, sc->ss,
+                   AddrAdd(sc->base, format->headerSize),
+                   AddrAdd(sc->limit, format->headerSize));
+  ScanStateFixClaim(sc->ss);
+  if (res != ResOK)
+    return res;
+  AMS_RANGE_BLACKEN(seg, AMS_ADDR_INDEX(seg, sc->base),
+                    AMS_ADDR_INDEX(seg, sc->limit));
+  sc->base = sc->limit;
+  return ResOK;
+}
+
+
+/* amsScanObject -- add a single object to the run if it's grey
+ *
+ * This is the object function passed to amsIterate by AMSScan, when
+ * there have been ambiguous fixes to the segment.  It is called with
+ * the fix lock claimed, and scans each run of adjacent grey objects
+ * with a single call to amsScanRun, so the fix lock is only released
+ * and claimed again once for each run.  See
+ * <design/poolams/#scan.parallel>.
+ */
 
 static Res amsScanObject(Seg seg, Index i, Addr p, Addr next, void *clos)
 {
-  amsScanClosure closure;
+  struct amsScanClosureStruct *sc;
   AMSSeg amsseg;
-  Format format;
   Res res;
 
   amsseg = Seg2AMSSeg(seg);
@@ -1301,30 +1420,119 @@ static Res amsScanObject(Seg seg, Index i, Addr p, Addr next, void *clos)
   AVER(p != 0);
   AVER(p < next);
   AVER(clos != NULL);
-  closure = (amsScanClosure)clos;
-  AVERT(ScanState, closure->ss);
-  AVERT(Bool, closure->scanAllObjects);
+  sc = clos;
+  AVERT(ScanState, sc->ss);
+
+  if (AMS_IS_GREY(seg, i)) {
+    AVER(!AMS_IS_INVALID_COLOUR(seg, i));
+    if (p == sc->limit) {
+      /* Extend the run over this object. */
+      sc->limit = next;
+      return ResOK;
+    }
+  }
+
+  /* This object doesn't continue the run, so scan the run. */
+  res = amsScanRun(seg, sc);
+  if (res != ResOK)
+    return res;
+  if (AMS_IS_GREY(seg, i)) {
+    sc->base = p;
+    sc->limit = next;
+  }
+  return ResOK;
+}
+
+
+/* amsFindRun -- find the next run of objects in a segment
+ *
+ * Finds the lowest run of allocated grains in the segment at or above
+ * index from, stopping short of the buffer's unscannable part
+ * [bufferBase, bufferLimit).  The alloc table is searched a word at a
+ * time.  See <design/poolams/#scan.run>.  */
+
+static Bool amsFindRun(Index *baseReturn, Index *limitReturn, Seg seg,
+                       Index from, Index bufferBase, Index bufferLimit)
+{
+  AMSSeg amsseg = Seg2AMSSeg(seg);
+  Index base, limit;
+
+  while (from < amsseg->grains) {
+    if (amsseg->allocTableInUse) {
+      if (!BTFindFirstSet(&base, amsseg->allocTable, from, amsseg->grains))
+        return FALSE;
+      if (base + 1 == amsseg->grains
+          || !BTFindFirstRes(&limit, amsseg->allocTable,
+                             base + 1, amsseg->grains))
+        limit = amsseg->grains;
+    } else {
+      /* There's no alloc table: <design/poolams/#no-bit>. */
+      if (from >= amsseg->firstFree)
+        return FALSE;
+      base = from;
+      limit = amsseg->firstFree;
+    }
+    if (base < bufferBase && bufferBase < limit) {
+      limit = bufferBase;
+    } else if (bufferBase <= base && base < bufferLimit) {
+      if (limit <= bufferLimit) {
+        from = limit;
+        continue;
+      }
+      base = bufferLimit;
+    }
+    *baseReturn = base;
+    *limitReturn = limit;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+
+/* amsScanAll -- scan all the objects in a segment
+ *
+ * Scans each run of objects found by amsFindRun with a single call to
+ * the format's scan method, and fetches the next run while scanning
+ * the current one.  This is used when the segment is grey for some
+ * trace for which it isn't white, so the colour tables are irrelevant.
+ * See <design/poolams/#scan.run>.  */
+
+static Res amsScanAll(ScanState ss, Seg seg)
+{
+  AMSSeg amsseg = Seg2AMSSeg(seg);
+  AMS ams = amsseg->ams;
+  Format format = AMSPool(ams)->format;
+  Buffer buffer = SegBuffer(seg);
+  Index base, limit, nextBase, nextLimit, bufferBase, bufferLimit;
+  Bool more;
+  Res res;
 
-  format = AMSPool(amsseg->ams)->format;
   AVERT(Format, format);
+  /* If we're using the alloc table as a white table, we can't use it to */
+  /* determine where there are objects. */
+  AVER(!(ams->shareAllocTable && amsseg->colourTablesInUse));
 
-  /* @@@@ This isn't quite right for multiple traces. */
-  if (closure->scanAllObjects || AMS_IS_GREY(seg, i)) {
-    res = FormatScan(format,
-                     closure->ss,
-                     AddrAdd(p, format->headerSize),
-                     AddrAdd(next, format->headerSize));
+  if (buffer != NULL && BufferScanLimit(buffer) != BufferLimit(buffer)) {
+    bufferBase = AMS_ADDR_INDEX(seg, BufferScanLimit(buffer));
+    bufferLimit = AMS_ADDR_INDEX(seg, BufferLimit(buffer));
+  } else {
+    bufferBase = bufferLimit = amsseg->grains;
+  }
+
+  more = amsFindRun(&base, &limit, seg, 0, bufferBase, bufferLimit);
+  while (more) {
+    more = amsFindRun(&nextBase, &nextLimit, seg, limit,
+                      bufferBase, bufferLimit);
+    if (more)
+      PREFETCH(AMS_INDEX_ADDR(seg, nextBase));
+    res = FormatScan(format, ss,
+                     AddrAdd(AMS_INDEX_ADDR(seg, base), format->headerSize),
+                     AddrAdd(AMS_INDEX_ADDR(seg, limit), format->headerSize));
     if (res != ResOK)
       return res;
-    if (!closure->scanAllObjects) {
-      Index j = AMS_ADDR_INDEX(seg, next);
-      AVER(!AMS_IS_INVALID_COLOUR(seg, i));
-      AMS_GREY_BLACKEN(seg, i);
-      if (i+1 < j)
-        AMS_RANGE_WHITE_BLACKEN(seg, i+1, j);
-    }
+    base = nextBase;
+    limit = nextLimit;
   }
-
   return ResOK;
 }
 
@@ -1339,7 +1547,6 @@ Res AMSScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg)
   AMS ams;
   Arena arena;
   AMSSeg amsseg;
-  struct amsScanClosureStruct closureStruct;
   Format format;
   Align alignment;
 
@@ -1357,69 +1564,85 @@ Res AMSScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg)
   /* <design/poolams/#not-req.grey>). */
   AVER(TraceSetSub(ss->traces, arena->flippedTraces));
 
-  closureStruct.scanAllObjects =
-    (TraceSetDiff(ss->traces, SegWhite(seg)) != TraceSetEMPTY);
-  closureStruct.ss = ss;
   /* @@@@ This isn't quite right for multiple traces. */
-  if (closureStruct.scanAllObjects) {
+  if (TraceSetDiff(ss->traces, SegWhite(seg)) != TraceSetEMPTY) {
     /* The whole seg (except the buffer) is grey for some trace. */
-    res = amsIterate(seg, amsScanObject, &closureStruct);
+    res = amsScanAll(ss, seg);
     if (res != ResOK) {
       *totalReturn = FALSE;
       return res;
     }
     *totalReturn = TRUE;
   } else {
-    AVER(amsseg->marksChanged); /* something must have changed */
+    /* Something must have changed, unless a parallel scan already
+       blackened the objects greyed since the segment was last scanned:
+       see <design/poolams/#scan.parallel>. */
     AVER(amsseg->colourTablesInUse);
     format = pool->format;
     AVERT(Format, format);
     alignment = PoolAlignment(AMSPool(ams));
+    /* The colour tables and marksChanged are only read or written
+       with the fix lock claimed: see <design/poolams/#scan.parallel>. */
+    ScanStateFixClaim(ss);
     do { /* <design/poolams/#scan.iter> */
       amsseg->marksChanged = FALSE; /* <design/poolams/#marked.scan> */
       /* <design/poolams/#ambiguous.middle> */
       if (amsseg->ambiguousFixes) {
-        res = amsIterate(seg, amsScanObject, &closureStruct);
+        struct amsScanClosureStruct sc;
+        sc.ss = ss;
+        sc.base = sc.limit = SegBase(seg);
+        res = amsIterate(seg, amsScanObject, &sc);
+        if (res == ResOK)
+          res = amsScanRun(seg, &sc);
         if (res != ResOK) {
           /* <design/poolams/#marked.scan.fail> */
           amsseg->marksChanged = TRUE;
+          ScanStateFixRelease(ss);
           *totalReturn = FALSE;
           return res;
         }
       } else {
-        Index i, j = 0;
+        Index i, j = 0, k;
         Addr p, next;
 
         while(j < amsseg->grains
-              && AMSFindGrey(&i, &j, seg, j, amsseg->grains)) {
-          Addr clientP, clientNext;
-          AVER(!AMS_IS_INVALID_COLOUR(seg, i));
+              && AMSFindGrey(&i, seg, j, amsseg->grains)) {
+          /* Extend the run over the grey objects that follow: see
+             <design/poolams/#scan.run.grey>. */
           p = AMS_INDEX_ADDR(seg, i);
-          clientP = AddrAdd(p, format->headerSize);
-          if (format->skip != NULL) {
-            clientNext = (*format->skip)(clientP);
-            next = AddrSub(clientNext, format->headerSize);
-          } else {
-            clientNext = AddrAdd(clientP, alignment);
-            next = AddrAdd(p, alignment);
-          }
-          j = AMS_ADDR_INDEX(seg, next);
-          res = FormatScan(format, ss, clientP, clientNext);
+          next = p;
+          j = i;
+          do {
+            AVER_CRITICAL(!AMS_IS_INVALID_COLOUR(seg, j));
+            if (format->skip != NULL) {
+              next = (*format->skip)(AddrAdd(next, format->headerSize));
+              next = AddrSub(next, format->headerSize);
+            } else {
+              next = AddrAdd(next, alignment);
+            }
+            j = AMS_ADDR_INDEX(seg, next);
+          } while (j < amsseg->grains && AMS_IS_GREY(seg, j));
+          if (j < amsseg->grains && AMSFindGrey(&k, seg, j, amsseg->grains))
+            PREFETCH(AMS_INDEX_ADDR(seg, k));
+          ScanStateFixRelease(ss);
+          res = FormatScan(format, ss, AddrAdd(p, format->headerSize),
+                           AddrAdd(next, format->headerSize));
+          ScanStateFixClaim(ss);
           if (res != ResOK) {
             /* <design/poolams/#marked.scan.fail> */
             amsseg->marksChanged = TRUE;
+            ScanStateFixRelease(ss);
             *totalReturn = FALSE;
             return res;
           }
           /* Check that there haven't been any ambiguous fixes during the */
           /* scan, because AMSFindGrey won't work otherwise. */
           AVER_CRITICAL(!amsseg->ambiguousFixes);
-          AMS_GREY_BLACKEN(seg, i);
-          if (i+1 < j)
-            AMS_RANGE_WHITE_BLACKEN(seg, i+1, j);
+          AMS_RANGE_BLACKEN(seg, i, j);
         }
       }
     } while(amsseg->marksChanged);
+    ScanStateFixRelease(ss);
     *totalReturn = FALSE;
   }
 
@@ -1427,6 +1650,85 @@ Res AMSScan(Bool *totalReturn, ScanState ss, Pool pool, Seg seg)
 }
 
 
+/* amsFixForward -- fix a reference to a white object in a segment
+ * that is being evacuated or has forwarded objects
+ *
+ * Snaps out the reference if the object has been forwarded already,
+ * and otherwise copies the object into the forwarding buffer, unless
+ * the segment is no longer evacuating, or the reference is weak, or
+ * the arena is in emergency mode, or there's no memory to copy into.
+ * Returns TRUE if the reference has been fixed, or FALSE if the
+ * caller must preserve the object in place or splat the reference.
+ * See <design/poolams/#evacuate.fix>.
+ */
+static Bool amsFixForward(AMS ams, ScanState ss, Seg seg, Ref *refIO)
+{
+  AMSSeg amsseg = Seg2AMSSeg(seg);
+  Pool pool = AMSPool(ams);
+  Arena arena = PoolArena(pool);
+  Format format = pool->format;
+  Buffer buffer = ams->forward;
+  Ref ref = *refIO;
+  Ref newRef;
+  Addr base, newBase, clientNext;
+  Size length;
+  Seg toSeg;
+  Res res;
+
+  ShieldExpose(arena, seg);
+  newRef = (*format->isMoved)(ref);
+  if (newRef != (Ref)0) {
+    /* Already forwarded, so snap out the reference. */
+    ShieldCover(arena, seg);
+    STATISTIC(++ss->snapCount);
+    *refIO = newRef;
+    return TRUE;
+  }
+  /* <design/poolams/#evacuate.ambig> */
+  if (!amsseg->evacuating || ss->rank == RankWEAK
+      || ArenaEmergency(arena)) {
+    ShieldCover(arena, seg);
+    return FALSE;
+  }
+
+  base = AddrSub((Addr)ref, format->headerSize);
+  clientNext = (*format->skip)(ref);
+  length = AddrOffset(ref, clientNext);
+  do {
+    res = BUFFER_RESERVE(&newBase, buffer, length);
+    if (res != ResOK) {
+      ShieldCover(arena, seg);
+      return FALSE;
+    }
+    toSeg = BufferSeg(buffer);
+    AVER_CRITICAL(SegWhite(toSeg) == TraceSetEMPTY);
+    ShieldExpose(arena, toSeg);
+    /* The copy must be scanned, so the whole of its segment is grey. */
+    SegSetSummary(toSeg, RefSetUnion(SegSummary(toSeg), SegSummary(seg)));
+    SegSetGrey(toSeg, TraceSetUnion(SegGrey(toSeg),
+                                    TraceSetUnion(SegGrey(seg), ss->traces)));
+    /* <design/poolams/#evacuate.to-space> */
+    Seg2AMSSeg(toSeg)->toSpace = TraceSetUnion(Seg2AMSSeg(toSeg)->toSpace,
+                                               ss->traces);
+    /* <design/trace/#fix.copy> */
+    (void)AddrCopy(newBase, base, length);
+    ShieldCover(arena, toSeg);
+  } while (!BUFFER_COMMIT(buffer, newBase, length));
+
+  newRef = AddrAdd(newBase, format->headerSize);
+  (*format->move)(ref, newRef);
+  ShieldCover(arena, seg);
+  amsseg->forwarded = TRUE; /* <design/poolams/#evacuate.snap> */
+
+  ss->wasMarked = FALSE; /* <design/fix/#protocol.was-marked> */
+  STATISTIC(++ss->forwardedCount);
+  ss->forwardedSize += length;
+  STATISTIC(ss->copiedSize += length);
+  *refIO = newRef;
+  return TRUE;
+}
+
+
 /* AMSFix -- the pool class fixing method */
 
 static Res AMSFix(Pool pool, ScanState ss, Seg seg, Ref *refIO)
@@ -1486,6 +1788,8 @@ static Res AMSFix(Pool pool, ScanState ss, Seg seg, Ref *refIO)
       break;
     }
     amsseg->ambiguousFixes = TRUE;
+    /* <design/poolams/#evacuate.ambig> */
+    amsseg->evacuating = FALSE;
     /* falls through */
   case RankEXACT:
   case RankFINAL:
@@ -1493,6 +1797,11 @@ static Res AMSFix(Pool pool, ScanState ss, Seg seg, Ref *refIO)
     AVER_CRITICAL(AddrIsAligned(base, PoolAlignment(pool)));
     AVER_CRITICAL(AMS_ALLOCED(seg, i));
     if (AMS_IS_WHITE(seg, i)) {
+      /* <design/poolams/#evacuate.snap> */
+      if (ss->rank != RankAMBIG
+          && (amsseg->evacuating || amsseg->forwarded)
+          && amsFixForward(PoolAMS(pool), ss, seg, refIO))
+        break;
       ss->wasMarked = FALSE;
       if (ss->rank == RankWEAK) { /* then splat the reference */
         *refIO = (Ref)0;
@@ -1562,7 +1871,7 @@ static void AMSBlacken(Pool pool, TraceSet traceSet, Seg seg)
   if (TraceSetInter(traceSet, SegWhite(seg)) != TraceSetEMPTY) {
     AMSSeg amsseg = Seg2AMSSeg(seg);
     AVERT(AMSSeg, amsseg);
-    AVER(amsseg->marksChanged); /* there must be something grey */
+    /* There may be nothing grey: see <design/poolams/#scan.parallel>. */
     amsseg->marksChanged = FALSE;
     res = amsIterate(seg, amsBlackenObject, NULL);
     AVER(res == ResOK);
@@ -1632,6 +1941,8 @@ static void AMSReclaim(Pool pool, Trace trace, Seg seg)
 
   /* Ensure consistency of segment even if are just about to free it */
   amsseg->colourTablesInUse = FALSE;
+  amsseg->evacuating = FALSE;
+  amsseg->forwarded = FALSE;
   SegSetWhite(seg, TraceSetDel(SegWhite(seg), trace));
 
   if (amsseg->freeGrains == grains && SegBuffer(seg) == NULL) {
@@ -1646,6 +1957,29 @@ static void AMSReclaim(Pool pool, Trace trace, Seg seg)
 }
 
 
+/* AMSTraceEnd -- forget to-space of a trace that has ended
+ *
+ * See <design/poolams/#evacuate.to-space>.
+ */
+
+static void AMSTraceEnd(Pool pool, Trace trace)
+{
+  AMS ams;
+  Ring node, ring, nextNode;    /* for iterating over the segments */
+
+  AVERT(Pool, pool);
+  ams = PoolAMS(pool);
+  AVERT(AMS, ams);
+  AVERT(Trace, trace);
+
+  ring = &ams->segRing;
+  RING_FOR(node, ring, nextNode) {
+    AMSSeg amsseg = RING_ELT(AMSSeg, segRing, node);
+    amsseg->toSpace = TraceSetDel(amsseg->toSpace, trace);
+  }
+}
+
+
 /* AMSFreeWalk -- free block walking method of the pool class */
 
 static void AMSFreeWalk(Pool pool, FreeBlockVisitor f, void *p)
@@ -1714,6 +2048,7 @@ static Res AMSDescribe(Pool pool, mps_lib_FILE *stream, Count depth)
 
   res = WriteF(stream, depth + 2,
                "grain shift $U\n", (WriteFU)ams->grainShift,
+               "forwarding buffer $P\n", (WriteFP)ams->forward,
                NULL);
   if (res != ResOK)
     return res;
@@ -1745,6 +2080,7 @@ DEFINE_CLASS(Pool, AMSPool, klass)
 {
   INHERIT_CLASS(klass, AMSPool, AbstractCollectPool);
   PoolClassMixInFormat(klass);
+  klass->attr |= AttrPARSCAN; /* <design/poolams/#scan.parallel> */
   klass->size = sizeof(AMSStruct);
   klass->varargs = AMSVarargs;
   klass->init = AMSInit;
@@ -1758,6 +2094,7 @@ DEFINE_CLASS(Pool, AMSPool, klass)
   klass->fix = AMSFix;
   klass->fixEmergency = AMSFix;
   klass->reclaim = AMSReclaim;
+  klass->traceEnd = AMSTraceEnd;
   /* TODO: job003738. See also impl.c.pool.check.ams.walk. */
   klass->walk = PoolNoWalk;
   klass->freewalk = AMSFreeWalk;
@@ -1829,6 +2166,10 @@ Bool AMSCheck(AMS ams)
   CHECKL(FUNCHECK(ams->allocRing));
   CHECKL(FUNCHECK(ams->segsDestroy));
   CHECKL(FUNCHECK(ams->segClass));
+  CHECKL(0.0 <= ams->evacuateOccupancy);
+  CHECKL(ams->evacuateOccupancy <= 1.0);
+  if (ams->forward != NULL)
+    CHECKD(Buffer, ams->forward);
 
   return TRUE;
 }
@@ -51,6 +51,8 @@ typedef struct AMSStruct {
   AMSSegsDestroyFunction segsDestroy;
   AMSSegClassFunction segClass;/* fn to get the class for segments */
   Bool shareAllocTable;        /* the alloc table is also used as white table */
+  double evacuateOccupancy;    /* evacuate segs less occupied than this */
+  Buffer forward;              /* forwarding buffer, or NULL */
   Sig sig;                     /* <design/pool/#outer-structure.sig> */
 } AMSStruct;
 
@@ -70,6 +72,9 @@ typedef struct AMSSegStruct {
   /* <design/poolams/#colour.single> */
   Bool marksChanged;     /* seg has been marked since last scan */
   Bool ambiguousFixes;   /* seg has been ambiguously marked since last scan */
+  Bool evacuating;       /* <design/poolams/#evacuate> */
+  Bool forwarded;        /* <design/poolams/#evacuate.snap> */
+  TraceSet toSpace;      /* <design/poolams/#evacuate.to-space> */
   Bool colourTablesInUse;/* the colour tables are in use */
   BT nonwhiteTable;      /* set if grain not white */
   BT nongreyTable;       /* set if not first grain of grey object */
@@ -149,9 +154,8 @@ typedef struct AMSSegStruct {
     BTSetRange(Seg2AMSSeg(seg)->nongreyTable, base, limit); \
   END
 
-#define AMSFindGrey(pos, dummy, seg, base, limit) \
-  BTFindShortResRange(pos, dummy, Seg2AMSSeg(seg)->nongreyTable, \
-                      base, limit, 1)
+#define AMSFindGrey(pos, seg, base, limit) \
+  BTFindFirstRes(pos, Seg2AMSSeg(seg)->nongreyTable, base, limit)
 
 #define AMSFindWhite(pos, dummy, seg, base, limit) \
   BTFindShortResRange(pos, dummy, Seg2AMSSeg(seg)->nonwhiteTable, \
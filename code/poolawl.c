@@ -314,6 +314,9 @@ Bool AWLHaveTotalSALimit = AWL_HAVE_TOTAL_SA_LIMIT;
 static Bool AWLCanTrySingleAccess(Arena arena, AWL awl, Seg seg, Addr addr)
 {
   AWLSeg awlseg;
+  TraceSet grey;
+  TraceId ti;
+  Trace trace;
 
   AVERT(AWL, awl);
   AVERT(Seg, seg);
@@ -332,10 +335,18 @@ static Bool AWLCanTrySingleAccess(Arena arena, AWL awl, Seg seg, Addr addr)
     return FALSE;
   }
 
-  /* The trace is already in the weak band, so we can scan the whole
+  /* The traces are already in the weak band, so we can scan the whole
      segment without retention anyway.  Go for it. */
-  if (TraceRankForAccess(arena, seg) == RankWEAK)
-    return FALSE;
+  grey = TraceSetInter(SegGrey(seg), arena->flippedTraces);
+  if (grey != TraceSetEMPTY) {
+    Bool allWeak = TRUE;
+    TRACE_SET_ITER(ti, trace, grey, arena)
+      if (TraceRankForAccess(trace, seg) != RankWEAK)
+        allWeak = FALSE;
+    TRACE_SET_ITER_END(ti, trace, grey, arena);
+    if (allWeak)
+      return FALSE;
+  }
 
   awlseg = MustBeA(AWLSeg, seg);
 
@@ -790,7 +801,12 @@ static void AWLGrey(Pool pool, Trace trace, Seg seg)
     AWLSeg awlseg = MustBeA(AWLSeg, seg);
 
     SegSetGrey(seg, TraceSetAdd(SegGrey(seg), trace));
-    if (SegBuffer(seg) != NULL) {
+    if (SegWhite(seg) != TraceSetEMPTY) {
+      /* .colour.other: The colour tables belong to the trace for */
+      /* which the segment is white, so leave them alone; AWLScan */
+      /* scans all the objects for this trace. */
+      NOOP;
+    } else if (SegBuffer(seg) != NULL) {
       Addr base = SegBase(seg);
       Buffer buffer = SegBuffer(seg);
 
@@ -817,7 +833,9 @@ static void AWLBlacken(Pool pool, TraceSet traceSet, Seg seg)
 
   AVERT(TraceSet, traceSet);
 
-  BTSetRange(awlseg->scanned, 0, awlseg->grains);
+  /* See .colour.other. */
+  if (TraceSetSub(SegWhite(seg), traceSet))
+    BTSetRange(awlseg->scanned, 0, awlseg->grains);
 }
 
 
@@ -909,7 +927,9 @@ static Res awlScanSinglePass(Bool *anyScannedReturn,
       if (res != ResOK)
         return res;
       *anyScannedReturn = TRUE;
-      BTSet(awlseg->scanned, i);
+      /* See .colour.other. */
+      if (TraceSetSub(SegWhite(seg), ss->traces))
+        BTSet(awlseg->scanned, i);
     }
     objectLimit = AddrSub(objectLimit, format->headerSize);
     AVER(p < objectLimit);
@@ -217,38 +217,43 @@ void MFSExtend(Pool pool, Addr base, Size size)
  *  arena.
  */
 
-static Res MFSAlloc(Addr *pReturn, Pool pool, Size size)
+static Res mfsEnsureFree(Pool pool, MFS mfs)
 {
-  MFS mfs = MustBeA(MFSPool, pool);
-  Header f;
+  Addr base;
   Res res;
 
-  AVER(pReturn != NULL);
-  AVER(size == mfs->unroundedUnitSize);
+  if (mfs->freeList != NULL)
+    return ResOK;
 
-  f = mfs->freeList;
+  /* The free list is empty, so extend the pool with a new region. */
 
-  /* If the free list is empty then extend the pool with a new region. */
+  /* See design.mps.bootstrap.land.sol.pool. */
+  if (!mfs->extendSelf)
+    return ResLIMIT;
 
-  if(f == NULL)
-  {
-    Addr base;
+  /* Create a new region and attach it to the pool. */
+  res = ArenaAlloc(&base, LocusPrefDefault(), mfs->extendBy, pool);
+  if(res != ResOK)
+    return res;
 
-    /* See design.mps.bootstrap.land.sol.pool. */
-    if (!mfs->extendSelf)
-      return ResLIMIT;
+  MFSExtend(pool, base, mfs->extendBy);
+  return ResOK;
+}
 
-    /* Create a new region and attach it to the pool. */
-    res = ArenaAlloc(&base, LocusPrefDefault(), mfs->extendBy, pool);
-    if(res != ResOK)
-      return res;
+static Res MFSAlloc(Addr *pReturn, Pool pool, Size size)
+{
+  MFS mfs = MustBeA(MFSPool, pool);
+  Header f;
+  Res res;
 
-    MFSExtend(pool, base, mfs->extendBy);
+  AVER(pReturn != NULL);
+  AVER(size == mfs->unroundedUnitSize);
 
-    /* The first unit in the region is now the head of the new free list. */
-    f = mfs->freeList;
-  }
+  res = mfsEnsureFree(pool, mfs);
+  if (res != ResOK)
+    return res;
 
+  f = mfs->freeList;
   AVER(f != NULL);
 
   /* Detach the first free unit from the free list and return its address. */
@@ -284,6 +289,106 @@ static void MFSFree(Pool pool, Addr old, Size size)
 }
 
 
+/*  == Bulk allocate and free ==
+ *
+ *  The client's list of blocks is linked through the first word, just
+ *  like the freelist, so a run of units can be moved between the two
+ *  by splicing.  Bulk allocation extends the pool at most once, and
+ *  may return fewer units than requested.
+ */
+
+static Res MFSBulkAlloc(Count *countReturn, Addr *listIO, Pool pool,
+                        Size size, Count count)
+{
+  MFS mfs = MustBeA(MFSPool, pool);
+  Header first, last;
+  Count n;
+  Res res;
+
+  AVER(countReturn != NULL);
+  AVER(listIO != NULL);
+  AVER(size == mfs->unroundedUnitSize);
+  AVER(count > 0);
+
+  res = mfsEnsureFree(pool, mfs);
+  if (res != ResOK)
+    return res;
+
+  first = mfs->freeList;
+  AVER(first != NULL);
+  last = first;
+  for (n = 1; n < count && last->next != NULL; ++n)
+    last = last->next;
+
+  mfs->freeList = last->next;
+  AVER(mfs->free >= mfs->unitSize * n);
+  mfs->free -= mfs->unitSize * n;
+
+  last->next = (Header)*listIO;
+  *listIO = (Addr)first;
+  *countReturn = n;
+  return ResOK;
+}
+
+static void MFSBulkFree(Pool pool, Addr *listIO, Size size, Count count)
+{
+  MFS mfs = MustBeA(MFSPool, pool);
+  Header first, last, rest;
+  Count n;
+
+  AVER(listIO != NULL);
+  AVER(size == mfs->unroundedUnitSize);
+  AVER(count > 0);
+
+  /* .freelist.fragments */
+  first = (Header)*listIO;
+  AVER(first != NULL);
+  last = first;
+  for (n = 1; n < count; ++n)
+    last = last->next;
+  rest = last->next;
+
+  last->next = mfs->freeList;
+  mfs->freeList = first;
+  mfs->free += mfs->unitSize * count;
+  *listIO = (Addr)rest;
+}
+
+
+/*  == Allocate and free without the arena lock ==
+ *
+ *  These only use the freelist, so they need only the pool lock.
+ *  Allocation fails rather than extend the pool.  See
+ *  <design/thread-safety/#sol.pool-lock>.
+ */
+
+static Bool MFSTryAlloc(Addr *pReturn, Pool pool, Size size)
+{
+  MFS mfs = MustBeA(MFSPool, pool);
+  Header f;
+
+  AVER(pReturn != NULL);
+  AVER(size == mfs->unroundedUnitSize);
+
+  f = mfs->freeList;
+  if (f == NULL)
+    return FALSE;
+
+  mfs->freeList = f->next;
+  AVER(mfs->free >= mfs->unitSize);
+  mfs->free -= mfs->unitSize;
+
+  *pReturn = (Addr)f;
+  return TRUE;
+}
+
+static Bool MFSTryFree(Pool pool, Addr old, Size size)
+{
+  MFSFree(pool, old, size);
+  return TRUE;
+}
+
+
 /* MFSTotalSize -- total memory allocated from the arena */
 
 static Size MFSTotalSize(Pool pool)
@@ -332,12 +437,17 @@ static Res MFSDescribe(Pool pool, mps_lib_FILE *stream, Count depth)
 DEFINE_CLASS(Pool, MFSPool, klass)
 {
   INHERIT_CLASS(klass, MFSPool, AbstractPool);
+  klass->attr |= AttrLOCKED;
   klass->size = sizeof(MFSStruct);
   klass->varargs = MFSVarargs;
   klass->init = MFSInit;
   klass->finish = MFSFinish;
   klass->alloc = MFSAlloc;
   klass->free = MFSFree;
+  klass->bulkAlloc = MFSBulkAlloc;
+  klass->bulkFree = MFSBulkFree;
+  klass->tryAlloc = MFSTryAlloc;
+  klass->tryFree = MFSTryFree;
   klass->totalSize = MFSTotalSize;
   klass->freeSize = MFSFreeSize;  
   klass->describe = MFSDescribe;
@@ -34,6 +34,24 @@ SRCID(poolmvff, "$Id$");
 extern PoolClass PoolClassMVFF(void);
 
 
+/* MVFFCacheStruct -- cache of small free blocks
+ *
+ * Each cache has a list of free blocks for each size class, linked
+ * through their first words.  Class i holds blocks of (i + 1) times
+ * the pool alignment.  See <design/poolmvff/#design.cache>.
+ */
+
+#define MVFFCacheCLASSES (MVFF_CACHE_SIZE_MAX / sizeof(Addr))
+
+typedef struct MVFFCacheStruct *MVFFCache;
+typedef struct MVFFCacheStruct {
+  Lock lock;                    /* protects the lists */
+  Addr list[MVFFCacheCLASSES];  /* free blocks of each class */
+  Count count[MVFFCacheCLASSES]; /* length of each list */
+  Size size;                    /* total size of blocks, see mvffCachedSize */
+} MVFFCacheStruct;
+
+
 /* MVFFStruct -- MVFF (Manual Variable First Fit) pool outer structure
  *
  * The signature is placed at the end, see
@@ -56,6 +74,9 @@ typedef struct MVFFStruct {     /* MVFF pool outer structure */
   FailoverStruct foStruct;      /* free memory (fail-over mechanism) */
   Bool firstFit;                /* as opposed to last fit */
   Bool slotHigh;                /* prefers high part of large block */
+  Count caches;                 /* number of caches */
+  Size cacheSizeMax;            /* largest block size held in caches */
+  MVFFCache cache;              /* array of caches, or NULL */
   Sig sig;                      /* <design/sig/> */
 } MVFFStruct;
 
@@ -351,6 +372,466 @@ static void MVFFFree(Pool pool, Addr old, Size size)
 }
 
 
+/* MVFFTryAlloc -- allocate a block without the arena lock
+ *
+ * Like MVFFAlloc, but fails rather than extend the pool.  Finding in
+ * the free land flushes its secondary into its primary, which might
+ * extend the CBS block pool, so fail if the secondary is in use.  See
+ * <design/poolmvff/#design.lock>.
+ */
+
+static Bool MVFFTryAlloc(Addr *aReturn, Pool pool, Size size)
+{
+  MVFF mvff;
+  RangeStruct range, oldRange;
+  LandFindMethod findMethod;
+  FindDelete findDelete;
+
+  AVER(aReturn != NULL);
+  AVER(TESTT(Pool, pool));
+  mvff = PoolMVFF(pool);
+  AVERT(MVFF, mvff);
+  AVER(size > 0);
+
+  if (LandSize(MVFFFreeSecondary(mvff)) > 0)
+    return FALSE;
+
+  size = SizeAlignUp(size, PoolAlignment(pool));
+  findMethod = mvff->firstFit ? LandFindFirst : LandFindLast;
+  findDelete = mvff->slotHigh ? FindDeleteHIGH : FindDeleteLOW;
+  if (!(*findMethod)(&range, &oldRange, MVFFFreeLand(mvff), size, findDelete))
+    return FALSE;
+
+  AVER(RangeSize(&range) == size);
+  *aReturn = RangeBase(&range);
+  return TRUE;
+}
+
+
+/* mvffTryInsert -- insert a range into the free land without the
+ * arena lock
+ *
+ * Fails if the CBS might need to extend its block pool to record the
+ * range, or if MVFFReduce would return memory to the arena
+ * afterwards.  The pool lock must be held.  See
+ * <design/poolmvff/#design.lock>.
+ */
+
+static Bool mvffTryInsert(MVFF mvff, Range range)
+{
+  Res res;
+  RangeStruct coalescedRange;
+  Size freeLimit;
+
+  if (LandSize(MVFFFreeSecondary(mvff)) > 0
+      || PoolFreeSize(MVFFBlockPool(mvff)) == 0)
+    return FALSE;
+
+  freeLimit = (Size)(LandSize(MVFFTotalLand(mvff)) * mvff->spare);
+  if (LandSize(MVFFFreeLand(mvff)) + RangeSize(range) >= freeLimit)
+    return FALSE;
+
+  res = LandInsert(&coalescedRange, MVFFFreeLand(mvff), range);
+  AVER(res == ResOK);
+  return TRUE;
+}
+
+
+/* MVFFTryFree -- free a block without the arena lock
+ *
+ * Like MVFFFree, but fails rather than call the arena (see
+ * mvffTryInsert).
+ */
+
+static Bool MVFFTryFree(Pool pool, Addr old, Size size)
+{
+  RangeStruct range;
+  MVFF mvff;
+
+  AVER(TESTT(Pool, pool));
+  mvff = PoolMVFF(pool);
+  AVERT(MVFF, mvff);
+  AVER(old != (Addr)0);
+  AVER(AddrIsAligned(old, PoolAlignment(pool)));
+  AVER(size > 0);
+
+  RangeInitSize(&range, old, SizeAlignUp(size, PoolAlignment(pool)));
+  return mvffTryInsert(mvff, &range);
+}
+
+
+/* mvffBlocksLink -- carve a range into blocks and link them
+ *
+ * Links count blocks of the given size starting at base in address
+ * order, through their first words, in front of list, and returns the
+ * new list.
+ */
+
+static Addr mvffBlocksLink(Addr base, Size size, Count count, Addr list)
+{
+  Count i;
+
+  for (i = count; i > 0; --i) {
+    Addr p = AddrAdd(base, size * (i - 1));
+    *ADDR_PTR(Addr, p) = list;
+    list = p;
+  }
+  return list;
+}
+
+
+/* MVFFBulkAlloc -- allocate a list of blocks
+ *
+ * Find one free range large enough for the blocks, using the same
+ * policy as MVFFAlloc, and carve it up.  Try with fewer blocks rather
+ * than extend the pool, so as not to leave small free ranges unused.
+ * See <design/poolmvff/#design.bulk>.
+ */
+
+static Res MVFFBulkAlloc(Count *countReturn, Addr *listIO, Pool pool,
+                         Size size, Count count)
+{
+  MVFF mvff;
+  RangeStruct range, oldRange;
+  LandFindMethod findMethod;
+  FindDelete findDelete;
+  Count n;
+  Res res;
+
+  AVER(countReturn != NULL);
+  AVER(listIO != NULL);
+  AVERT(Pool, pool);
+  mvff = PoolMVFF(pool);
+  AVERT(MVFF, mvff);
+  AVER(size >= sizeof(Addr));
+  AVER(SizeIsAligned(size, PoolAlignment(pool)));
+  AVER(count > 0);
+
+  findMethod = mvff->firstFit ? LandFindFirst : LandFindLast;
+  findDelete = mvff->slotHigh ? FindDeleteHIGH : FindDeleteLOW;
+
+  for (n = count; n > 0; n /= 2)
+    if ((*findMethod)(&range, &oldRange, MVFFFreeLand(mvff), size * n,
+                      findDelete))
+      break;
+  if (n == 0) {
+    /* No free range is big enough even for one block, so extend. */
+    for (n = count; ; n /= 2) {
+      res = mvffFindFree(&range, mvff, size * n, findMethod, findDelete);
+      if (res == ResOK)
+        break;
+      if (n == 1)
+        return res;
+    }
+  }
+  AVER(RangeSize(&range) == size * n);
+
+  *listIO = mvffBlocksLink(RangeBase(&range), size, n, *listIO);
+  *countReturn = n;
+  return ResOK;
+}
+
+
+/* MVFFBulkFree -- free a list of blocks
+ *
+ * Blocks that are adjacent in the list and in memory are inserted
+ * into the free land as one range, and MVFFReduce is only called
+ * once.  See <design/poolmvff/#design.bulk>.
+ */
+
+static void MVFFBulkFree(Pool pool, Addr *listIO, Size size, Count count)
+{
+  MVFF mvff;
+  RangeStruct range, coalescedRange;
+  Addr p, next, base, limit;
+  Count i;
+  Res res;
+
+  AVERT(Pool, pool);
+  mvff = PoolMVFF(pool);
+  AVERT(MVFF, mvff);
+  AVER(listIO != NULL);
+  AVER(size >= sizeof(Addr));
+  AVER(SizeIsAligned(size, PoolAlignment(pool)));
+  AVER(count > 0);
+
+  p = *listIO;
+  base = p;
+  limit = AddrAdd(p, size);
+  for (i = 1; i <= count; ++i) {
+    /* Read the link before the block can be overwritten by the free
+       land (which may fail over to a freelist). */
+    next = *ADDR_PTR(Addr, p);
+    if (i < count && next == limit) {
+      limit = AddrAdd(next, size);
+    } else if (i < count && AddrAdd(next, size) == base) {
+      base = next;
+    } else {
+      RangeInit(&range, base, limit);
+      res = LandInsert(&coalescedRange, MVFFFreeLand(mvff), &range);
+      /* Insertion must succeed because it fails over to a Freelist. */
+      AVER(res == ResOK);
+      if (i < count) {
+        base = next;
+        limit = AddrAdd(next, size);
+      }
+    }
+    p = next;
+  }
+
+  *listIO = p;
+  MVFFReduce(mvff);
+}
+
+
+/*  == Caches ==
+ *
+ *  A pool created with MPS_KEY_MVFF_CACHES keeps that many caches of
+ *  small free blocks in front of its free land.  PoolTryAlloc and
+ *  PoolTryFree try the caches before they claim the pool lock.  Each
+ *  cache has its own lock, and a thread uses the cache picked by the
+ *  address of its stack, so threads that allocate and free blocks of
+ *  the same sizes contend only for their cache's lock.  A cache
+ *  exchanges blocks with the free land in batches, claiming the pool
+ *  lock only once for each batch.  The cache lock is never held while
+ *  claiming the pool lock.  See <design/poolmvff/#design.cache>.
+ */
+
+/* mvffCache -- the cache for the current thread */
+
+static MVFFCache mvffCache(MVFF mvff)
+{
+  /* The address of a parameter is somewhere on this thread's stack.
+     Mix the high bits in so that threads whose stacks are a power of
+     two apart don't all pick the same cache. */
+  Word w = (Word)&mvff >> MVFF_CACHE_STACK_SHIFT;
+  w *= (Word)0x9E3779B9;
+  w ^= w >> (MPS_WORD_WIDTH / 2);
+  return &mvff->cache[w % mvff->caches];
+}
+
+
+/* mvffCachePush -- push a list of blocks onto a cache
+ *
+ * The list has count blocks of class i and the given size, linked
+ * through their first words.  The cache lock must be held.
+ */
+
+static void mvffCachePush(MVFFCache cache, Index i, Size size,
+                          Addr list, Count count)
+{
+  Addr p = list;
+  Count n;
+
+  AVER(count > 0);
+  for (n = 1; n < count; ++n)
+    p = *ADDR_PTR(Addr, p);
+  *ADDR_PTR(Addr, p) = cache->list[i];
+  cache->list[i] = list;
+  cache->count[i] += count;
+  cache->size += size * count;
+}
+
+
+/* mvffCacheRefill -- allocate a batch of blocks for a cache
+ *
+ * Like MVFFBulkAlloc, but fails rather than extend the pool, or if
+ * finding in the free land might flush its secondary (see
+ * MVFFTryAlloc).  Returns the number of blocks found, which may be
+ * zero.  The pool lock must be held.
+ */
+
+static Count mvffCacheRefill(Addr *listReturn, MVFF mvff, Size size)
+{
+  RangeStruct range, oldRange;
+  LandFindMethod findMethod;
+  FindDelete findDelete;
+  Count n;
+
+  if (LandSize(MVFFFreeSecondary(mvff)) > 0)
+    return 0;
+
+  findMethod = mvff->firstFit ? LandFindFirst : LandFindLast;
+  findDelete = mvff->slotHigh ? FindDeleteHIGH : FindDeleteLOW;
+  for (n = MVFF_CACHE_BATCH; n > 0; n /= 2)
+    if ((*findMethod)(&range, &oldRange, MVFFFreeLand(mvff), size * n,
+                      findDelete))
+    {
+      AVER(RangeSize(&range) == size * n);
+      *listReturn = mvffBlocksLink(RangeBase(&range), size, n, NULL);
+      return n;
+    }
+  return 0;
+}
+
+
+/* mvffCacheFlush -- return a batch of blocks from a cache
+ *
+ * Inserts the first count blocks in *listIO into the free land,
+ * stopping early if a block can't be inserted without the arena (see
+ * mvffTryInsert).  Updates *listIO to the blocks that were not
+ * inserted, and returns the number that were.  The pool lock must be
+ * held.
+ */
+
+static Count mvffCacheFlush(Addr *listIO, MVFF mvff, Size size, Count count)
+{
+  RangeStruct range;
+  Addr p = *listIO;
+  Count n;
+
+  for (n = 0; n < count; ++n) {
+    /* Read the link before the block is overwritten by the land. */
+    Addr next = *ADDR_PTR(Addr, p);
+    RangeInitSize(&range, p, size);
+    if (!mvffTryInsert(mvff, &range))
+      break;
+    p = next;
+  }
+  *listIO = p;
+  return n;
+}
+
+
+/* MVFFCacheAlloc -- allocate a block from the thread's cache
+ *
+ * If the cache has no block of the right size, refill it with a batch
+ * from the free land.  Fails if the size is too large for the caches,
+ * or if the free land has no room for even one block without
+ * extending the pool.
+ */
+
+static Bool MVFFCacheAlloc(Addr *aReturn, Pool pool, Size size)
+{
+  MVFF mvff;
+  MVFFCache cache;
+  Addr p, list = NULL;
+  Index i;
+  Count n;
+
+  AVER(aReturn != NULL);
+  AVER(TESTT(Pool, pool));
+  mvff = PoolMVFF(pool);
+  AVER(TESTT(MVFF, mvff));
+  AVER(size > 0);
+
+  if (size > mvff->cacheSizeMax)
+    return FALSE;
+  size = SizeAlignUp(size, PoolAlignment(pool));
+  i = size / PoolAlignment(pool) - 1;
+  cache = mvffCache(mvff);
+
+  LockClaim(cache->lock);
+  p = cache->list[i];
+  if (p != NULL) {
+    cache->list[i] = *ADDR_PTR(Addr, p);
+    AVER(cache->count[i] > 0);
+    --cache->count[i];
+    cache->size -= size;
+    LockRelease(cache->lock);
+    *aReturn = p;
+    return TRUE;
+  }
+  LockRelease(cache->lock);
+
+  LockClaimRecursive(pool->lock);
+  n = mvffCacheRefill(&list, mvff, size);
+  LockReleaseRecursive(pool->lock);
+  if (n == 0)
+    return FALSE;
+
+  p = list;
+  if (n > 1) {
+    LockClaim(cache->lock);
+    mvffCachePush(cache, i, size, *ADDR_PTR(Addr, p), n - 1);
+    LockRelease(cache->lock);
+  }
+  *aReturn = p;
+  return TRUE;
+}
+
+
+/* MVFFCacheFree -- free a block to the thread's cache
+ *
+ * If the cache is full, return a batch of its blocks to the free
+ * land.  Any that can't be returned without the arena are pushed
+ * back, so the cache may briefly hold more than MVFF_CACHE_DEPTH
+ * blocks of a size.  Fails only if the size is too large for the
+ * caches.
+ */
+
+static Bool MVFFCacheFree(Pool pool, Addr old, Size size)
+{
+  MVFF mvff;
+  MVFFCache cache;
+  Addr p, list = NULL;
+  Index i;
+  Count n;
+
+  AVER(TESTT(Pool, pool));
+  mvff = PoolMVFF(pool);
+  AVER(TESTT(MVFF, mvff));
+  AVER(old != (Addr)0);
+  AVER(size > 0);
+
+  if (size > mvff->cacheSizeMax)
+    return FALSE;
+  size = SizeAlignUp(size, PoolAlignment(pool));
+  i = size / PoolAlignment(pool) - 1;
+  cache = mvffCache(mvff);
+
+  LockClaim(cache->lock);
+  if (cache->count[i] >= MVFF_CACHE_DEPTH) {
+    /* Detach a batch from the front of the list. */
+    list = cache->list[i];
+    p = list;
+    for (n = 1; n < MVFF_CACHE_BATCH; ++n)
+      p = *ADDR_PTR(Addr, p);
+    cache->list[i] = *ADDR_PTR(Addr, p);
+    cache->count[i] -= MVFF_CACHE_BATCH;
+    cache->size -= size * MVFF_CACHE_BATCH;
+  }
+  *ADDR_PTR(Addr, old) = cache->list[i];
+  cache->list[i] = old;
+  ++cache->count[i];
+  cache->size += size;
+  LockRelease(cache->lock);
+
+  if (list != NULL) {
+    LockClaimRecursive(pool->lock);
+    n = mvffCacheFlush(&list, mvff, size, MVFF_CACHE_BATCH);
+    LockReleaseRecursive(pool->lock);
+    if (n < MVFF_CACHE_BATCH) {
+      LockClaim(cache->lock);
+      mvffCachePush(cache, i, size, list, MVFF_CACHE_BATCH - n);
+      LockRelease(cache->lock);
+    }
+  }
+  return TRUE;
+}
+
+
+/* mvffCachedSize -- total size of the blocks in the caches
+ *
+ * This is called with the arena lock held, perhaps while a suspended
+ * thread holds a cache lock, so it must not claim the cache locks.
+ * It reads each cache's size without its lock instead.  The size is
+ * an aligned word, so each read gets a value it has recently had,
+ * and the total is exact if no thread is using the caches.  See
+ * <design/poolmvff/#design.cache.lock>.
+ */
+
+static Size mvffCachedSize(MVFF mvff)
+{
+  Size size = 0;
+  Index c;
+
+  for (c = 0; c < mvff->caches; ++c)
+    size += mvff->cache[c].size;
+  return size;
+}
+
+
 /* MVFFBufferFill -- Fill the buffer
  *
  * Fill it with the largest block we can find. This is worst-fit
@@ -441,6 +922,7 @@ static void MVFFDebugVarargs(ArgStruct args[MPS_ARGS_MAX], va_list varargs)
 ARG_DEFINE_KEY(MVFF_SLOT_HIGH, Bool);
 ARG_DEFINE_KEY(MVFF_ARENA_HIGH, Bool);
 ARG_DEFINE_KEY(MVFF_FIRST_FIT, Bool);
+ARG_DEFINE_KEY(MVFF_CACHES, Count);
 
 static Res MVFFInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
 {
@@ -451,9 +933,12 @@ static Res MVFFInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
   Bool arenaHigh = MVFF_ARENA_HIGH_DEFAULT;
   Bool firstFit = MVFF_FIRST_FIT_DEFAULT;
   double spare = MVFF_SPARE_DEFAULT;
+  Count caches = MVFF_CACHES_DEFAULT;
   MVFF mvff;
   Res res;
   ArgStruct arg;
+  Index c;
+  void *p;
 
   AVER(pool != NULL);
   AVERT(Arena, arena);
@@ -486,6 +971,9 @@ static Res MVFFInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
   if (ArgPick(&arg, args, MPS_KEY_MVFF_FIRST_FIT))
     firstFit = arg.val.b;
 
+  if (ArgPick(&arg, args, MPS_KEY_MVFF_CACHES))
+    caches = arg.val.count;
+
   AVER(extendBy > 0);           /* .arg.check */
   AVER(avgSize > 0);            /* .arg.check */
   AVER(avgSize <= extendBy);    /* .arg.check */
@@ -500,6 +988,7 @@ static Res MVFFInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
   AVERT(Bool, slotHigh);
   AVERT(Bool, arenaHigh);
   AVERT(Bool, firstFit);
+  AVER(caches <= MVFF_CACHES_MAX); /* .arg.check */
 
   res = PoolAbsInit(pool, arena, klass, args);
   if (res != ResOK)
@@ -560,6 +1049,31 @@ static Res MVFFInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
   if (res != ResOK)
     goto failFreeLandInit;
 
+  /* The locks follow the caches in a single control block.  See
+     <design/poolmvff/#design.cache>. */
+  mvff->caches = caches;
+  mvff->cacheSizeMax = 0;
+  mvff->cache = NULL;
+  if (caches > 0) {
+    res = ControlAlloc(&p, arena,
+                       caches * (sizeof(MVFFCacheStruct) + LockSize()));
+    if (res != ResOK)
+      goto failCacheAlloc;
+    mvff->cache = p;
+    mvff->cacheSizeMax = SizeAlignDown(MVFF_CACHE_SIZE_MAX, align);
+    for (c = 0; c < caches; ++c) {
+      MVFFCache cache = &mvff->cache[c];
+      Index i;
+      cache->lock = PointerAdd(&mvff->cache[caches], c * LockSize());
+      LockInit(cache->lock);
+      for (i = 0; i < MVFFCacheCLASSES; ++i) {
+        cache->list[i] = NULL;
+        cache->count[i] = 0;
+      }
+      cache->size = 0;
+    }
+  }
+
   SetClassOfPoly(pool, CLASS(MVFFPool));
   mvff->sig = MVFFSig;
   AVERC(MVFFPool, mvff);
@@ -569,6 +1083,8 @@ static Res MVFFInit(Pool pool, Arena arena, PoolClass klass, ArgList args)
 
   return ResOK;
 
+failCacheAlloc:
+  LandFinish(MVFFFreeLand(mvff));
 failFreeLandInit:
   LandFinish(MVFFFreeSecondary(mvff));
 failFreeSecondaryInit:
@@ -618,6 +1134,15 @@ static void MVFFFinish(Pool pool)
   AVER(b);
   AVER(LandSize(MVFFTotalLand(mvff)) == 0);
 
+  /* The blocks in the caches were in the ranges just freed. */
+  if (mvff->caches > 0) {
+    Index c;
+    for (c = 0; c < mvff->caches; ++c)
+      LockFinish(mvff->cache[c].lock);
+    ControlFree(PoolArena(pool), mvff->cache,
+                mvff->caches * (sizeof(MVFFCacheStruct) + LockSize()));
+  }
+
   LandFinish(MVFFFreeLand(mvff));
   LandFinish(MVFFFreeSecondary(mvff));
   LandFinish(MVFFFreePrimary(mvff));
@@ -655,7 +1180,12 @@ static Size MVFFTotalSize(Pool pool)
 }
 
 
-/* MVFFFreeSize -- free memory (unused by client program) */
+/* MVFFFreeSize -- free memory (unused by client program)
+ *
+ * This includes the blocks in the caches.  It is called with the arena
+ * lock held, so it reads the cached sizes without claiming the cache
+ * locks; see mvffCachedSize.
+ */
 
 static Size MVFFFreeSize(Pool pool)
 {
@@ -665,7 +1195,7 @@ static Size MVFFFreeSize(Pool pool)
   mvff = PoolMVFF(pool);
   AVERT(MVFF, mvff);
 
-  return LandSize(MVFFFreeLand(mvff));
+  return LandSize(MVFFFreeLand(mvff)) + mvffCachedSize(mvff);
 }
 
 
@@ -691,6 +1221,7 @@ static Res MVFFDescribe(Pool pool, mps_lib_FILE *stream, Count depth)
                "firstFit  $U\n",  (WriteFU)mvff->firstFit,
                "slotHigh  $U\n",  (WriteFU)mvff->slotHigh,
                "spare     $D\n",  (WriteFD)mvff->spare,
+               "caches    $U\n",  (WriteFU)mvff->caches,
                NULL);
   if (res != ResOK)
     return res;
@@ -722,12 +1253,19 @@ DEFINE_CLASS(Pool, MVFFPool, klass)
 {
   INHERIT_CLASS(klass, MVFFPool, AbstractPool);
   PoolClassMixInBuffer(klass);
+  klass->attr |= AttrLOCKED;
   klass->size = sizeof(MVFFStruct);
   klass->varargs = MVFFVarargs;
   klass->init = MVFFInit;
   klass->finish = MVFFFinish;
   klass->alloc = MVFFAlloc;
   klass->free = MVFFFree;
+  klass->bulkAlloc = MVFFBulkAlloc;
+  klass->bulkFree = MVFFBulkFree;
+  klass->tryAlloc = MVFFTryAlloc;
+  klass->tryFree = MVFFTryFree;
+  klass->cacheAlloc = MVFFCacheAlloc;
+  klass->cacheFree = MVFFCacheFree;
   klass->bufferFill = MVFFBufferFill;
   klass->bufferEmpty = MVFFBufferEmpty;
   klass->totalSize = MVFFTotalSize;
@@ -792,6 +1330,12 @@ static Bool MVFFCheck(MVFF mvff)
   CHECKL(SizeIsArenaGrains(LandSize(MVFFTotalLand(mvff)), PoolArena(MVFFPool(mvff))));
   CHECKL(BoolCheck(mvff->slotHigh));
   CHECKL(BoolCheck(mvff->firstFit));
+  CHECKL(mvff->caches <= MVFF_CACHES_MAX);       /* see .arg.check */
+  CHECKL((mvff->caches == 0) == (mvff->cache == NULL));
+  CHECKL(SizeIsAligned(mvff->cacheSizeMax, PoolAlignment(MVFFPool(mvff))));
+  CHECKL(mvff->cacheSizeMax <= MVFF_CACHE_SIZE_MAX);
+  CHECKL(mvff->caches > 0 || mvff->cacheSizeMax == 0);
+  CHECKL(MVFF_CACHE_BATCH <= MVFF_CACHE_DEPTH);
   return TRUE;
 }
 
@@ -0,0 +1,242 @@
+/* pretenss.c: PRETENURING STRESS TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Allocate a long-lived cache of objects interleaved with short-lived
+ * garbage in an AMC pool, first with both through the same allocation
+ * point, then with the cache allocated through an allocation point
+ * created with MPS_KEY_GEN, and then through one created with
+ * MPS_KEY_AP_PRETENURE.  Check that the cache survives intact, and
+ * that allocating it in an older generation, whether by request or
+ * by pretenuring, reduces the amount the collector preserves.  See
+ * <design/poolamc/#pretenure>.
+ */
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+
+#define testArenaSIZE   ((size_t)64 << 20)
+#define cacheCOUNT      40000
+#define cacheSLOTS      8
+#define garbagePER      8     /* garbage objects per cache object */
+#define garbageSLOTS    4
+#define genCOUNT        3
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 256, 0.9 }, { 512, 0.5 }, { 1024, 0.5 } };
+
+
+/* objNULL needs to be odd so that it's ignored in roots. */
+#define objNULL           ((mps_addr_t)MPS_WORD_CONST(0xDECEA5ED))
+
+static mps_addr_t cache[cacheCOUNT];
+static mps_addr_t garbage[1];
+
+
+/* make -- create one new object with the given number of slots */
+
+static mps_addr_t make(mps_ap_t ap, size_t slots)
+{
+  size_t size = (slots + 2) * sizeof(mps_word_t);
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, NULL, 0);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+enum {
+  modeNURSERY,
+  modeGEN,
+  modePRETENURE,
+  modeLIMIT
+};
+
+static const char *modeName[modeLIMIT] = {
+  "nursery", "MPS_KEY_GEN", "MPS_KEY_AP_PRETENURE"
+};
+
+
+/* test -- allocate the cache in the given mode
+ *
+ * Returns the total size preserved by the collections during the
+ * test.
+ */
+
+static size_t test(mps_arena_t arena, int mode)
+{
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_root_t cacheRoot, garbageRoot;
+  mps_pool_t pool;
+  mps_ap_t ap, cacheAp;
+  mps_message_t message;
+  size_t i, j, live = 0, collections = 0;
+
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, mps_class_amc(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_ap_create_k(&ap, pool, mps_args_none), "ap_create");
+  switch (mode) {
+  case modeNURSERY:
+    cacheAp = ap;
+    break;
+  case modeGEN:
+    MPS_ARGS_BEGIN(args) {
+      MPS_ARGS_ADD(args, MPS_KEY_GEN, genCOUNT - 1);
+      die(mps_ap_create_k(&cacheAp, pool, args), "ap_create(gen)");
+    } MPS_ARGS_END(args);
+    break;
+  case modePRETENURE:
+    MPS_ARGS_BEGIN(args) {
+      MPS_ARGS_ADD(args, MPS_KEY_AP_PRETENURE, TRUE);
+      die(mps_ap_create_k(&cacheAp, pool, args), "ap_create(pretenure)");
+    } MPS_ARGS_END(args);
+    break;
+  default:
+    error("unknown mode %d", mode);
+  }
+
+  for (i = 0; i < cacheCOUNT; ++i)
+    cache[i] = objNULL;
+  garbage[0] = objNULL;
+  die(mps_root_create_table_masked(&cacheRoot, arena, mps_rank_exact(),
+                                   (mps_rm_t)0, cache, cacheCOUNT,
+                                   (mps_word_t)1),
+      "root_create_table(cache)");
+  die(mps_root_create_table_masked(&garbageRoot, arena, mps_rank_exact(),
+                                   (mps_rm_t)0, garbage, NELEMS(garbage),
+                                   (mps_word_t)1),
+      "root_create_table(garbage)");
+
+  for (i = 0; i < cacheCOUNT; ++i) {
+    cache[i] = make(cacheAp, cacheSLOTS);
+    for (j = 0; j < garbagePER; ++j)
+      garbage[0] = make(ap, garbageSLOTS);
+    while (mps_message_get(&message, arena, mps_message_type_gc())) {
+      ++ collections;
+      live += mps_message_gc_live_size(arena, message);
+      mps_message_discard(arena, message);
+    }
+  }
+
+  mps_arena_park(arena);
+  for (i = 0; i < cacheCOUNT; ++i) {
+    cdie(mps_arena_has_addr(arena, cache[i]), "cache in arena");
+    cdie(dylan_check(cache[i]), "cache check");
+  }
+  printf("%-20s %4lu collections preserved %lu bytes\n", modeName[mode],
+         (unsigned long)collections, (unsigned long)live);
+
+  if (cacheAp != ap)
+    mps_ap_destroy(cacheAp);
+  mps_ap_destroy(ap);
+  mps_root_destroy(cacheRoot);
+  mps_root_destroy(garbageRoot);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_release(arena);
+
+  while (mps_message_get(&message, arena, mps_message_type_gc()))
+    mps_message_discard(arena, message);
+
+  return live;
+}
+
+
+int main(int argc, char *argv[])
+{
+  mps_arena_t arena;
+  mps_thr_t thread;
+  size_t live[modeLIMIT];
+  int mode;
+
+  testlib_init(argc, argv);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  mps_message_type_enable(arena, mps_message_type_gc());
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  for (mode = 0; mode < modeLIMIT; ++mode)
+    live[mode] = test(arena, mode);
+  mps_thread_dereg(thread);
+  mps_arena_destroy(arena);
+
+  Insist(live[modeGEN] < live[modeNURSERY]);
+  Insist(live[modePRETENURE] < live[modeNURSERY]);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -25,6 +25,18 @@ extern void ProtSet(Addr base, Addr limit, AccessSet mode);
 extern void ProtSync(Arena arena);
 
 
+/* Userfault Write Barrier -- see <design/prot/#uffd> */
+
+#define ProtUffdSig     ((Sig)0x5194077D) /* SIGnature PROT UFfD */
+
+extern size_t ProtUffdSize(void);
+extern Res ProtUffdInit(ProtUffd uffd);
+extern void ProtUffdFinish(ProtUffd uffd);
+extern Bool ProtUffdCheck(ProtUffd uffd);
+extern void ProtUffdSet(ProtUffd uffd, Addr base, Addr limit,
+                        AccessSet mode);
+
+
 /* Mutator Fault Context */
 
 extern Bool ProtCanStepInstruction(MutatorFaultContext context);
@@ -0,0 +1,378 @@
+/* protufli.c: USERFAULTFD WRITE BARRIER FOR LINUX
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .purpose: Detects writes to write-protected segments using the
+ * write-protect mode of userfaultfd(2), rather than by handling
+ * SIGSEGV.  A write to a protected page blocks the writing thread in
+ * the kernel and queues a message on the userfaultfd.  A handler
+ * thread reads the message, passes the fault to ArenaAccess, and
+ * wakes the writer.  See <design/prot/#uffd>.
+ *
+ * .read: Only write protection uses the userfaultfd.  Read
+ * protection (which forbids writes too) still uses mprotect, so
+ * read barrier hits are still handled by the signal handler in
+ * protli.c.
+ *
+ * .register: Memory must be registered with the userfaultfd before it
+ * can be write-protected.  The registration belongs to the mapping,
+ * and is lost when the VM module remaps the memory, so ranges are
+ * registered on demand, when write-protecting or unprotecting them
+ * fails.  Registration fails for memory that doesn't support
+ * userfaultfd (for example, file mappings in a client arena), and
+ * then ProtUffdSet falls back to mprotect.
+ *
+ * .unpopulated: Without UFFD_FEATURE_WP_UNPOPULATED, the kernel
+ * ignores write protection of pages that have never been touched, so
+ * the feature is required.
+ *
+ * .context: The handler thread is not the thread that faulted, so it
+ * has no mutator fault context to pass to ArenaAccess.
+ *
+ * .unregistered: The handler thread is not registered with the arena,
+ * so it is not suspended by the shield, and can lower the protection
+ * of a segment while the mutator is stopped.
+ */
+
+#include "mpm.h"
+#include "vm.h"
+
+#if !defined(MPS_OS_LI)
+#error "protufli.c is specific to MPS_OS_LI"
+#endif
+
+#include <errno.h>
+#include <fcntl.h> /* O_CLOEXEC, O_NONBLOCK */
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h> /* __NR_userfaultfd */
+#include <unistd.h> /* see .feature.li in config.h */
+#include <linux/userfaultfd.h>
+
+SRCID(protufli, "$Id$");
+
+
+/* UFFD_FEATURE_WP_UNPOPULATED was added in Linux 6.4, and may be
+ * missing from older headers.  See .unpopulated. */
+
+#if !defined(UFFD_FEATURE_WP_UNPOPULATED)
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+
+#define protUffdFEATURES \
+  (UFFD_FEATURE_PAGEFAULT_FLAG_WP | UFFD_FEATURE_WP_UNPOPULATED)
+
+
+/* protUffdMSGS -- number of messages read at once */
+
+#define protUffdMSGS 16
+
+
+/* ProtUffdStruct -- the userfaultfd write barrier */
+
+typedef struct ProtUffdStruct {
+  Sig sig;                      /* <design/sig/> */
+  int fd;                       /* the userfaultfd */
+  int stop;                     /* eventfd to stop the handler thread */
+  pthread_t thread;             /* the handler thread */
+} ProtUffdStruct;
+
+
+/* ProtUffdSize -- size of a ProtUffdStruct */
+
+size_t ProtUffdSize(void)
+{
+  return sizeof(ProtUffdStruct);
+}
+
+
+/* ProtUffdCheck -- check a userfaultfd write barrier */
+
+Bool ProtUffdCheck(ProtUffd uffd)
+{
+  CHECKS(ProtUffd, uffd);
+  CHECKL(uffd->fd >= 0);
+  CHECKL(uffd->stop >= 0);
+  return TRUE;
+}
+
+
+/* protUffdRange -- initialize a userfaultfd range */
+
+static void protUffdRange(struct uffdio_range *range, Addr base, Addr limit)
+{
+  range->start = (__u64)(Word)base;
+  range->len = (__u64)AddrOffset(base, limit);
+}
+
+
+/* protUffdWriteProtect -- set or clear write protection of a range
+ *
+ * Returns FALSE if any of the range is not registered.  Clearing
+ * write protection wakes any threads that were blocked writing to the
+ * range.
+ */
+
+static Bool protUffdWriteProtect(ProtUffd uffd, Addr base, Addr limit,
+                                 Bool protect)
+{
+  struct uffdio_writeprotect wp;
+
+  protUffdRange(&wp.range, base, limit);
+  wp.mode = protect ? UFFDIO_WRITEPROTECT_MODE_WP : 0;
+  while (ioctl(uffd->fd, UFFDIO_WRITEPROTECT, &wp) != 0) {
+    if (errno != EAGAIN)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* protUffdRegister -- register a range for write protection
+ *
+ * See .register.  Returns FALSE if the memory doesn't support it.
+ * Registering a range that is already registered has no effect.
+ */
+
+static Bool protUffdRegister(ProtUffd uffd, Addr base, Addr limit)
+{
+  struct uffdio_register reg;
+
+  protUffdRange(&reg.range, base, limit);
+  reg.mode = UFFDIO_REGISTER_MODE_WP;
+  return ioctl(uffd->fd, UFFDIO_REGISTER, &reg) == 0
+    && (reg.ioctls & ((__u64)1 << _UFFDIO_WRITEPROTECT)) != 0;
+}
+
+
+/* ProtUffdSet -- set protection
+ *
+ * Implements ProtSet <design/prot/#if.set> for an arena that has a
+ * userfaultfd write barrier.
+ */
+
+void ProtUffdSet(ProtUffd uffd, Addr base, Addr limit, AccessSet mode)
+{
+  AVERT(ProtUffd, uffd);
+  AVER(base < limit);
+  AVERT(AccessSet, mode);
+
+  switch (mode) {
+  case AccessWRITE:
+    /* Protect before allowing writes, so there's no window in which
+       a write could go unnoticed. */
+    if (protUffdWriteProtect(uffd, base, limit, TRUE)
+        || (protUffdRegister(uffd, base, limit)
+            && protUffdWriteProtect(uffd, base, limit, TRUE))) {
+      ProtSet(base, limit, AccessSetEMPTY);
+      return;
+    }
+    ProtSet(base, limit, mode); /* .register: fall back to mprotect */
+    break;
+
+  case AccessSetEMPTY:
+    /* Allow access before removing write protection, which wakes any
+       blocked writers. */
+    ProtSet(base, limit, mode);
+    if (!protUffdWriteProtect(uffd, base, limit, FALSE)
+        && protUffdRegister(uffd, base, limit))
+      (void)protUffdWriteProtect(uffd, base, limit, FALSE);
+    break;
+
+  default:
+    /* .read: mprotect forbids writes as well. */
+    ProtSet(base, limit, mode);
+    break;
+  }
+}
+
+
+/* protUffdFault -- handle a write fault
+ *
+ * Offer the fault to the arenas, then wake the writer.  If no arena
+ * claimed the fault, the segment must have gone away, so remove the
+ * protection from the page to let the writer continue.
+ */
+
+static void protUffdFault(ProtUffd uffd, Addr addr)
+{
+  Addr base = AddrAlignDown(addr, PageSize());
+  Addr limit = AddrAdd(base, PageSize());
+  struct uffdio_range range;
+
+  if (!ArenaAccess(addr, AccessWRITE, NULL)) { /* .context */
+    (void)protUffdWriteProtect(uffd, base, limit, FALSE);
+    return;
+  }
+
+  /* The protection may have been lowered before the message was read,
+     in which case the writer was woken then, and this is harmless. */
+  protUffdRange(&range, base, limit);
+  (void)ioctl(uffd->fd, UFFDIO_WAKE, &range);
+}
+
+
+/* protUffdThread -- the main function of the handler thread */
+
+static void *protUffdThread(void *p)
+{
+  ProtUffd uffd = p;
+  struct uffd_msg msg[protUffdMSGS];
+  struct pollfd fds[2];
+  ssize_t bytes;
+  Index i;
+
+  fds[0].fd = uffd->fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = uffd->stop;
+  fds[1].events = POLLIN;
+
+  for (;;) {
+    if (poll(fds, NELEMS(fds), -1) < 0) {
+      AVER(errno == EINTR);
+      continue;
+    }
+    if (fds[1].revents != 0)
+      break;
+    if ((fds[0].revents & POLLIN) == 0)
+      continue;
+    bytes = read(uffd->fd, msg, sizeof msg);
+    if (bytes < 0) {
+      AVER(errno == EAGAIN || errno == EINTR);
+      continue;
+    }
+    AVER((size_t)bytes % sizeof msg[0] == 0);
+    for (i = 0; i < (size_t)bytes / sizeof msg[0]; ++i) {
+      AVER(msg[i].event == UFFD_EVENT_PAGEFAULT);
+      AVER((msg[i].arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WP) != 0);
+      protUffdFault(uffd, (Addr)(Word)msg[i].arg.pagefault.address);
+    }
+  }
+  return NULL;
+}
+
+
+/* ProtUffdInit -- create the userfaultfd and start the handler
+ *
+ * Returns ResUNIMPL if the kernel doesn't support write protection
+ * with userfaultfd (or the process isn't allowed to use it), and
+ * ResRESOURCE if the handler thread couldn't be started.
+ */
+
+Res ProtUffdInit(ProtUffd uffd)
+{
+  struct uffdio_api api;
+  Res res;
+  int fd;
+
+  AVER(uffd != NULL);
+
+#if defined(__NR_userfaultfd)
+  fd = (int)syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+#else
+  fd = -1;
+#endif
+  if (fd < 0)
+    return ResUNIMPL;
+
+  api.api = UFFD_API;
+  api.features = protUffdFEATURES;
+  api.ioctls = 0;
+  if (ioctl(fd, UFFDIO_API, &api) != 0
+      || (api.features & protUffdFEATURES) != protUffdFEATURES) {
+    res = ResUNIMPL;
+    goto failApi;
+  }
+
+  uffd->fd = fd;
+  uffd->stop = eventfd(0, EFD_CLOEXEC);
+  if (uffd->stop < 0) {
+    res = ResRESOURCE;
+    goto failStop;
+  }
+
+  uffd->sig = ProtUffdSig;
+  if (pthread_create(&uffd->thread, NULL, protUffdThread, uffd) != 0) {
+    res = ResRESOURCE;
+    goto failThread;
+  }
+
+  AVERT(ProtUffd, uffd);
+  return ResOK;
+
+failThread:
+  uffd->sig = SigInvalid;
+  (void)close(uffd->stop);
+failStop:
+failApi:
+  (void)close(fd);
+  return res;
+}
+
+
+/* ProtUffdFinish -- stop the handler and close the userfaultfd
+ *
+ * Must not be called with the arena lock held, since the handler may
+ * be waiting for it.  Closing the userfaultfd removes any remaining
+ * write protection.
+ */
+
+void ProtUffdFinish(ProtUffd uffd)
+{
+  int res;
+
+  AVERT(ProtUffd, uffd);
+
+  res = eventfd_write(uffd->stop, 1);
+  AVER(res == 0);
+  res = pthread_join(uffd->thread, NULL);
+  AVER(res == 0);
+  (void)close(uffd->stop);
+  (void)close(uffd->fd);
+  uffd->sig = SigInvalid;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -44,6 +44,9 @@ SRCID(pthreadext, "$Id$");
 /* mutex */
 static pthread_mutex_t pthreadextMut = PTHREAD_MUTEX_INITIALIZER;
 
+/* mutex held for the duration of a batch of suspensions */
+static pthread_mutex_t pthreadextBatchMut = PTHREAD_MUTEX_INITIALIZER;
+
 /* semaphore */
 static sem_t pthreadextSem;
 
@@ -56,8 +59,9 @@ static Bool pthreadextModuleInitialized = FALSE;
  * See <design/pthreadext/#impl.global>.*
  */
 
-static PThreadext suspendingVictim = NULL;  /* current victim */
+static RingStruct victimRing;               /* PThreadext victim ring */
 static RingStruct suspendedRing;            /* PThreadext suspend ring */
+static Count victimsSignalled = 0;          /* victims awaiting handshake */
 
 
 /* suspendSignalHandler -- signal handler called when suspending a thread
@@ -67,7 +71,10 @@ static RingStruct suspendedRing;            /* PThreadext suspend ring */
  * The interface for determining the MFC might be platform specific.
  *
  * Handle PTHREADEXT_SIGSUSPEND in the target thread, to suspend it until
- * receiving PTHREADEXT_SIGRESUME (resume). Note that this is run with both
+ * receiving PTHREADEXT_SIGRESUME (resume). The handler finds its own
+ * PThreadext on the victim ring, which the controlling thread does not
+ * modify while any victim might be reading it (see
+ * <design/pthreadext/#impl.global.victim>). Note that this is run with both
  * PTHREADEXT_SIGSUSPEND and PTHREADEXT_SIGRESUME blocked. Having
  * PTHREADEXT_SIGRESUME blocked prevents a resume before we can finish the
  * suspend protocol.
@@ -82,17 +89,28 @@ static void suspendSignalHandler(int sig,
     sigset_t signal_set;
     ucontext_t ucontext;
     MutatorFaultContextStruct mfContext;
+    PThreadext victim = NULL;
+    pthread_t self;
+    Ring node, next;
 
     AVER(sig == PTHREADEXT_SIGSUSPEND);
     UNUSED(sig);
     UNUSED(info);
 
-    AVER(suspendingVictim != NULL);
+    self = pthread_self();
+    RING_FOR(node, &victimRing, next) {
+      PThreadext pt = RING_ELT(PThreadext, threadRing, node);
+      if (pthread_equal(pt->id, self)) {
+        victim = pt;
+        break;
+      }
+    }
+    AVER(victim != NULL);
     /* copy the ucontext structure so we definitely have it on our stack,
      * not (e.g.) shared with other threads. */
     ucontext = *(ucontext_t *)context;
     mfContext.ucontext = &ucontext;
-    suspendingVictim->suspendedMFC = &mfContext;
+    victim->suspendedMFC = &mfContext;
     /* Block all signals except PTHREADEXT_SIGRESUME while suspended. */
     sigfillset(&signal_set);
     sigdelset(&signal_set, PTHREADEXT_SIGRESUME);
@@ -131,8 +149,9 @@ static void PThreadextModuleInit(void)
   
     AVER(pthreadextModuleInitialized == FALSE);
 
-    /* Initialize the ring of suspended threads */
+    /* Initialize the rings of suspended threads and victims */
     RingInit(&suspendedRing);
+    RingInit(&victimRing);
 
     /* Initialize the semaphore */
     status = sem_init(&pthreadextSem, 0, 0);
@@ -180,7 +199,10 @@ extern Bool PThreadextCheck(PThreadext pthreadext)
   /* can't check ID */
   CHECKD_NOSIG(Ring, &pthreadext->threadRing);
   CHECKD_NOSIG(Ring, &pthreadext->idRing);
-  if (pthreadext->suspendedMFC == NULL) {
+  if (pthreadext->contextReturn != NULL) {
+    /* suspension pending in a batch: see .batch */
+    CHECKL(pthreadext->suspendedMFC == NULL);
+  } else if (pthreadext->suspendedMFC == NULL) {
     /* not suspended */
     CHECKL(RingIsSingle(&pthreadext->threadRing));
     CHECKL(RingIsSingle(&pthreadext->idRing));
@@ -213,6 +235,7 @@ extern void PThreadextInit(PThreadext pthreadext, pthread_t id)
 
   pthreadext->id = id;
   pthreadext->suspendedMFC = NULL;
+  pthreadext->contextReturn = NULL;
   RingInit(&pthreadext->threadRing);
   RingInit(&pthreadext->idRing);
   pthreadext->sig = PThreadextSig;
@@ -254,25 +277,49 @@ extern void PThreadextFinish(PThreadext pthreadext)
 }
 
 
-/* PThreadextSuspend -- suspend a thread
+/* PThreadextSuspendBegin -- start a batch of suspensions
  *
- * See <design/pthreadext/#impl.suspend>
+ * .batch: A batch of suspensions signals all its victims before
+ * waiting for any of them to acknowledge, so that the time taken to
+ * suspend n threads is not n times the signal round trip. See
+ * <design/pthreadext/#impl.batch>.
  */
 
-Res PThreadextSuspend(PThreadext target, MutatorFaultContext *contextReturn)
+void PThreadextSuspendBegin(void)
+{
+  int status;
+
+  /* Suspension may be attempted before any PThreadext is initialized. */
+  status = pthread_once(&pthreadextOnce, PThreadextModuleInit);
+  AVER(status == 0);
+
+  /* Serialize batches, makes life easier */
+  status = pthread_mutex_lock(&pthreadextBatchMut);
+  AVER(status == 0);
+  AVER(RingIsSingle(&victimRing));
+}
+
+
+/* PThreadextSuspendAdd -- add a pthreadext to the batch
+ *
+ * The context of the thread is stored in *contextReturn by
+ * PThreadextSuspendWait, or NULL if the thread could not be
+ * suspended.
+ */
+
+void PThreadextSuspendAdd(PThreadext target,
+                          MutatorFaultContext *contextReturn)
 {
   Ring node, next;
-  Res res;
   int status;
 
   AVERT(PThreadext, target);
   AVER(contextReturn != NULL);
   AVER(target->suspendedMFC == NULL); /* multiple suspends illegal */
+  AVER(target->contextReturn == NULL);
 
-  /* Serialize access to suspend, makes life easier */
   status = pthread_mutex_lock(&pthreadextMut);
   AVER(status == 0);
-  AVER(suspendingVictim == NULL);
 
   /* Threads are added to the suspended ring on suspension */
   /* If the same thread Id has already been suspended, then */
@@ -282,37 +329,130 @@ Res PThreadextSuspend(PThreadext target, MutatorFaultContext *contextReturn)
     if (alreadySusp->id == target->id) {
       RingAppend(&alreadySusp->idRing, &target->idRing);
       target->suspendedMFC = alreadySusp->suspendedMFC;
-      goto noteSuspended;
+      RingAppend(&suspendedRing, &target->threadRing);
+      *contextReturn = target->suspendedMFC;
+      goto unlock;
     }
   }
 
-  /* Ok, we really need to suspend this thread. */
-  suspendingVictim = target;
-  status = pthread_kill(target->id, PTHREADEXT_SIGSUSPEND);
-  if (status != 0) {
-    res = ResFAIL;
-    goto unlock;
-  }
-
-  /* Wait for the victim to acknowledge suspension. */
-  while (sem_wait(&pthreadextSem) != 0) {
-    if (errno != EINTR) {
-      res = ResFAIL;
+  /* Likewise if the same thread Id is already a victim in this */
+  /* batch: the target gets its context when the victim does. */
+  *contextReturn = NULL;
+  target->contextReturn = contextReturn;
+  RING_FOR(node, &victimRing, next) {
+    PThreadext victim = RING_ELT(PThreadext, threadRing, node);
+    if (victim->id == target->id) {
+      RingAppend(&victim->idRing, &target->idRing);
       goto unlock;
     }
   }
 
-noteSuspended:
-  AVER(target->suspendedMFC != NULL);
-  RingAppend(&suspendedRing, &target->threadRing);
-  *contextReturn = target->suspendedMFC;
-  res = ResOK;
+  RingAppend(&victimRing, &target->threadRing);
 
 unlock:
-  suspendingVictim = NULL;
   status = pthread_mutex_unlock(&pthreadextMut);
   AVER(status == 0);
-  return res;
+}
+
+
+/* PThreadextSuspendSignal -- signal all the victims in the batch
+ *
+ * Returns the number of threads signalled. Takes the mutex, which is
+ * released by PThreadextSuspendWait: the victim ring must not change
+ * while the victims' signal handlers are searching it.
+ */
+
+Count PThreadextSuspendSignal(void)
+{
+  Ring node, next;
+  int status;
+
+  status = pthread_mutex_lock(&pthreadextMut);
+  AVER(status == 0);
+  AVER(victimsSignalled == 0);
+
+  RING_FOR(node, &victimRing, next) {
+    PThreadext victim = RING_ELT(PThreadext, threadRing, node);
+    /* If this fails the thread has probably terminated: */
+    /* PThreadextSuspendWait reports it as not suspended. */
+    status = pthread_kill(victim->id, PTHREADEXT_SIGSUSPEND);
+    if (status == 0)
+      ++victimsSignalled;
+  }
+
+  return victimsSignalled;
+}
+
+
+/* suspendNote -- note the result of suspending a pthreadext */
+
+static void suspendNote(PThreadext target, MutatorFaultContext mfc)
+{
+  AVER(target->contextReturn != NULL);
+  *target->contextReturn = mfc;
+  target->contextReturn = NULL;
+  target->suspendedMFC = mfc;
+  if (mfc != NULL)
+    RingAppend(&suspendedRing, &target->threadRing);
+}
+
+
+/* PThreadextSuspendWait -- wait for the victims to be suspended
+ *
+ * Waits for every signalled victim to acknowledge suspension, then
+ * returns the contexts and finishes the batch.
+ */
+
+void PThreadextSuspendWait(void)
+{
+  Ring node, next;
+  int status;
+
+  /* Wait for the victims to acknowledge suspension. */
+  while (victimsSignalled > 0) {
+    if (sem_wait(&pthreadextSem) == 0)
+      --victimsSignalled;
+    else
+      AVER(errno == EINTR);
+  }
+
+  RING_FOR(node, &victimRing, next) {
+    PThreadext victim = RING_ELT(PThreadext, threadRing, node);
+    MutatorFaultContext mfc = victim->suspendedMFC;
+    Ring idNode, idNext;
+    RingRemove(&victim->threadRing);
+    RING_FOR(idNode, &victim->idRing, idNext) {
+      PThreadext other = RING_ELT(PThreadext, idRing, idNode);
+      if (mfc == NULL)
+        RingRemove(&other->idRing);
+      suspendNote(other, mfc);
+    }
+    suspendNote(victim, mfc);
+  }
+
+  status = pthread_mutex_unlock(&pthreadextMut);
+  AVER(status == 0);
+  status = pthread_mutex_unlock(&pthreadextBatchMut);
+  AVER(status == 0);
+}
+
+
+/* PThreadextSuspend -- suspend a thread
+ *
+ * See <design/pthreadext/#impl.suspend>
+ */
+
+Res PThreadextSuspend(PThreadext target, MutatorFaultContext *contextReturn)
+{
+  AVERT(PThreadext, target);
+  AVER(contextReturn != NULL);
+
+  PThreadextSuspendBegin();
+  PThreadextSuspendAdd(target, contextReturn);
+  (void)PThreadextSuspendSignal();
+  PThreadextSuspendWait();
+
+  return *contextReturn == NULL ? ResFAIL : ResOK;
 }
 
 
@@ -33,6 +33,7 @@ typedef struct PThreadextStruct {
   Sig sig;                         /* <design/sig/> */
   pthread_t id;                    /* Thread ID */
   MutatorFaultContext suspendedMFC; /* context if suspended */
+  MutatorFaultContext *contextReturn; /* where to return context, if pending */
   RingStruct threadRing;           /* ring of suspended threads */
   RingStruct idRing;               /* duplicate suspensions for id */
 } PThreadextStruct;
@@ -60,6 +61,16 @@ extern Res PThreadextSuspend(PThreadext pthreadext,
                              MutatorFaultContext *contextReturn);
 
 
+/*  PThreadextSuspendBegin/Add/Signal/Wait -- Suspend a batch of
+ *  pthreadexts, signalling them all before waiting for any. */
+
+extern void PThreadextSuspendBegin(void);
+extern void PThreadextSuspendAdd(PThreadext pthreadext,
+                                 MutatorFaultContext *contextReturn);
+extern Count PThreadextSuspendSignal(void);
+extern void PThreadextSuspendWait(void);
+
+
 /*  PThreadextResume --  Resume a suspended pthreadext */
 
 extern Res PThreadextResume(PThreadext pthreadext);
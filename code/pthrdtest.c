@@ -0,0 +1,185 @@
+/* pthrdtest.c: POSIX THREAD EXTENSIONS BATCH SUSPENSION TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Suspend a spinning thread in a batch that contains two descriptors
+ * for it, as when a thread is registered with two arenas and both
+ * are flipped at once.  Check that the thread is signalled only once,
+ * that both descriptors get its context, that it stays suspended
+ * until both have been resumed, and that a later suspension of one
+ * descriptor while the other is suspended shares the context without
+ * signalling.  See <design/pthreadext/#impl.batch.add>.
+ *
+ * The PThreadext module only exists on POSIX platforms; elsewhere the
+ * test does nothing.
+ */
+
+#include "mpm.h"
+#include "testlib.h"
+#include "testthr.h"
+
+#include <stdio.h> /* printf */
+
+#if defined(MPS_OS_FR) || defined(MPS_OS_LI)
+
+#include "pthrdext.h"
+
+#include <sched.h> /* sched_yield */
+
+
+#define yieldCOUNT      1000
+
+
+static volatile unsigned long spinCount = 0;
+static volatile Bool spinStop = FALSE;
+
+
+/* spin -- count until told to stop */
+
+static void *spin(void *arg)
+{
+  testlib_unused(arg);
+  while (!spinStop)
+    ++spinCount;
+  return NULL;
+}
+
+
+/* spinning -- is the spinning thread making progress?
+ *
+ * Yield repeatedly, so that on a single processor the spinning thread
+ * gets to run if it can.
+ */
+
+static Bool spinning(void)
+{
+  unsigned long before = spinCount;
+  unsigned i;
+  for (i = 0; i < yieldCOUNT; ++i) {
+    (void)sched_yield();
+    if (spinCount != before)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+
+static void test(void)
+{
+  testthr_t thread;
+  PThreadextStruct first, second;
+  MutatorFaultContext firstContext, secondContext;
+  Count signalled;
+  Res res;
+
+  testthr_create(&thread, spin, NULL);
+  while (!spinning())
+    NOOP;
+
+  PThreadextInit(&first, thread);
+  PThreadextInit(&second, thread);
+
+  /* Both descriptors in one batch: only the first is signalled. */
+  PThreadextSuspendBegin();
+  PThreadextSuspendAdd(&first, &firstContext);
+  PThreadextSuspendAdd(&second, &secondContext);
+  signalled = PThreadextSuspendSignal();
+  PThreadextSuspendWait();
+  Insist(signalled == 1);
+  Insist(firstContext != NULL);
+  Insist(secondContext == firstContext);
+  Insist(PThreadextCheck(&first));
+  Insist(PThreadextCheck(&second));
+  Insist(!spinning());
+
+  /* Resuming one descriptor leaves the thread suspended for the other. */
+  res = PThreadextResume(&first);
+  Insist(res == ResOK);
+  Insist(!spinning());
+  res = PThreadextResume(&second);
+  Insist(res == ResOK);
+  while (!spinning())
+    NOOP;
+
+  /* Suspending a thread that is already suspended doesn't signal it. */
+  res = PThreadextSuspend(&second, &secondContext);
+  Insist(res == ResOK);
+  res = PThreadextSuspend(&first, &firstContext);
+  Insist(res == ResOK);
+  Insist(firstContext == secondContext);
+  res = PThreadextResume(&second);
+  Insist(res == ResOK);
+  Insist(!spinning());
+  res = PThreadextResume(&first);
+  Insist(res == ResOK);
+  while (!spinning())
+    NOOP;
+
+  PThreadextFinish(&first);
+  PThreadextFinish(&second);
+  spinStop = TRUE;
+  testthr_join(&thread, NULL);
+}
+
+#else
+
+static void test(void)
+{
+  NOOP;
+}
+
+#endif
+
+
+int main(int argc, char *argv[])
+{
+  testlib_init(argc, argv);
+
+  test();
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -35,6 +35,15 @@ typedef struct RootStruct {
   Addr protBase;                /* base of protectable area */
   Addr protLimit;               /* limit of protectable area */
   AccessSet pm;                 /* Protection Mode */
+  BT chunkTable;                /* grey chunks, or NULL: .incremental */
+  Count chunkCount;             /* number of chunks */
+  Size chunkSize;               /* size of each chunk */
+  Trace chunkTrace;             /* trace scanning chunks, or NULL */
+  Index chunkNext;              /* no grey chunks below this one */
+  Count chunkGrey;              /* number of grey chunks */
+  RefSet chunkSummary;          /* summary of chunks scanned so far */
+  Bool chunkSummaryLost;        /* chunkSummary no longer valid? */
+  RingStruct greyRing;          /* attachment to rootGreyRing */
   RootVar var;                  /* union discriminator */
   union RootUnion {
     struct {
@@ -158,6 +167,23 @@ Bool RootCheck(Root root)
     CHECKL(root->protLimit == (Addr)0);
     CHECKL(root->pm == (AccessSet)0);
   }
+  if (root->chunkTable != NULL) {
+    CHECKL(root->protectable);
+    CHECKL(root->var == RootAREA || root->var == RootAREA_TAGGED);
+    CHECKL(root->rank == RankEXACT);
+    CHECKL(root->chunkCount > 0);
+    CHECKL(SizeIsArenaGrains(root->chunkSize, root->arena));
+    CHECKL(root->chunkNext <= root->chunkCount);
+    CHECKL(root->chunkGrey <= root->chunkCount);
+    CHECKL((root->chunkTrace == NULL) == (root->chunkGrey == 0));
+    CHECKL(BoolCheck(root->chunkSummaryLost));
+  } else {
+    CHECKL(root->chunkTrace == NULL);
+  }
+  if (root->chunkTrace != NULL)
+    CHECKU(Trace, root->chunkTrace);
+  CHECKD_NOSIG(Ring, &root->greyRing);
+  CHECKL(RingIsSingle(&root->greyRing) == (root->chunkTrace == NULL));
   return TRUE;
 }
 
@@ -201,6 +227,15 @@ static Res rootCreate(Root *rootReturn, Arena arena,
   root->protectable = FALSE;
   root->protBase = (Addr)0;
   root->protLimit = (Addr)0;
+  root->chunkTable = NULL;
+  root->chunkCount = 0;
+  root->chunkSize = 0;
+  root->chunkTrace = NULL;
+  root->chunkNext = 0;
+  root->chunkGrey = 0;
+  root->chunkSummary = RefSetEMPTY;
+  root->chunkSummaryLost = FALSE;
+  RingInit(&root->greyRing);
 
   /* See <design/arena/#root-ring> */
   RingInit(&root->arenaRing);
@@ -245,6 +280,25 @@ static Res rootCreateProtectable(Root *rootReturn, Arena arena,
     }
   }
 
+  /* .incremental: A large exact area root may be scanned after the
+     flip, a chunk at a time.  See <design/root/#incremental>. */
+  if ((var == RootAREA || var == RootAREA_TAGGED)
+      && rank == RankEXACT
+      && (root->mode & RootModePROTECTABLE)
+      && !(root->mode & RootModePROTECTABLE_INNER)
+      && AddrOffset(root->protBase, root->protLimit) >= RootIncrementalSIZE)
+  {
+    Size size = AddrOffset(root->protBase, root->protLimit);
+    root->chunkSize = SizeArenaGrains(RootIncrementalCHUNK, arena);
+    root->chunkCount = (size + root->chunkSize - 1) / root->chunkSize;
+    res = BTCreate(&root->chunkTable, arena, root->chunkCount);
+    if (res != ResOK) {
+      root->chunkTable = NULL;
+      RootDestroy(root);
+      return res;
+    }
+  }
+
   /* Check that this root doesn't intersect with any other root */
   RING_FOR(node, &ArenaGlobals(arena)->rootRing, next) {
     Root trial = RING_ELT(Root, arenaRing, node);
@@ -433,6 +487,15 @@ void RootDestroy(Root root)
 
   AVERT(Arena, arena);
 
+  /* <design/root/#incremental.destroy> */
+  if (RootPM(root) != AccessSetEMPTY)
+    ProtSet(root->protBase, root->protLimit, AccessSetEMPTY);
+  if (root->chunkTrace != NULL)
+    RingRemove(&root->greyRing);
+  RingFinish(&root->greyRing);
+  if (root->chunkTable != NULL)
+    BTDestroy(root->chunkTable, arena, root->chunkCount);
+
   RingRemove(&root->arenaRing);
   RingFinish(&root->arenaRing);
 
@@ -462,11 +525,17 @@ Rank RootRank(Root root)
 }
 
 
-/* RootPM -- return the protection mode of a root */
+/* RootPM -- return the protection mode of a root
+ *
+ * While a root is being scanned incrementally, some of it is
+ * protected against all access.  See <design/root/#incremental.prot>.
+ */
 
 AccessSet RootPM(Root root)
 {
   AVERT(Root, root);
+  if (root->chunkTrace != NULL)
+    return BS_UNION(root->pm, AccessREAD | AccessWRITE);
   return root->pm;
 }
 
@@ -495,6 +564,9 @@ static void rootSetSummary(Root root, RefSet summary)
 {
   AVERT(Root, root);
   /* Can't check summary */
+  /* <design/root/#incremental.summary> */
+  if (root->chunkTrace != NULL)
+    root->chunkSummaryLost = TRUE;
   if (root->protectable) {
     if (summary == RefSetUNIV) {
       root->summary = summary;
@@ -508,24 +580,73 @@ static void rootSetSummary(Root root, RefSet summary)
 }
 
 
-/* RootScan -- scan root */
+/* rootChunkBase, rootChunkLimit -- protected range of a chunk */
 
-Res RootScan(ScanState ss, Root root)
+static Addr rootChunkBase(Root root, Index chunk)
 {
-  Res res;
+  return AddrAdd(root->protBase, chunk * root->chunkSize);
+}
 
-  AVERT(Root, root);
-  AVERT(ScanState, ss);
-  AVER(root->rank == ss->rank);
+static Addr rootChunkLimit(Root root, Index chunk)
+{
+  Addr limit = AddrAdd(rootChunkBase(root, chunk), root->chunkSize);
+  return limit < root->protLimit ? limit : root->protLimit;
+}
 
-  if (TraceSetInter(root->grey, ss->traces) == TraceSetEMPTY)
-    return ResOK;
 
-  AVER(ScanStateSummary(ss) == RefSetEMPTY);
+/* rootChunkPM -- protection mode of a scanned chunk
+ *
+ * Until the mutator writes to the root, the scanned chunks are write
+ * protected so that their summary can be trusted when the last chunk
+ * has been scanned.  See <design/root/#incremental.summary>.
+ */
 
-  if (root->pm != AccessSetEMPTY) {
-    ProtSet(root->protBase, root->protLimit, AccessSetEMPTY);
+static AccessSet rootChunkPM(Root root)
+{
+  return root->chunkSummaryLost ? root->pm : AccessWRITE;
+}
+
+
+/* rootProtect -- set the protection of a root
+ *
+ * While the root is being scanned incrementally, grey chunks are
+ * protected against all access, and scanned chunks according to
+ * rootChunkPM.  Runs of chunks with the same protection are set
+ * together.
+ */
+
+static void rootProtect(Root root)
+{
+  Index i, j;
+
+  AVER(root->protectable);
+
+  if (root->chunkTrace == NULL) {
+    ProtSet(root->protBase, root->protLimit, root->pm);
+    return;
+  }
+
+  for (i = 0; i < root->chunkCount; i = j) {
+    Bool grey = BTGet(root->chunkTable, i);
+    for (j = i + 1; j < root->chunkCount; ++j)
+      if (BTGet(root->chunkTable, j) != grey)
+        break;
+    ProtSet(rootChunkBase(root, i), rootChunkLimit(root, j - 1),
+            grey ? AccessREAD | AccessWRITE : rootChunkPM(root));
   }
+}
+
+
+/* rootScanRefs -- scan the references in a root
+ *
+ * Changes nothing in the root, so that the roots of suspended threads
+ * can be scanned on collector threads.  See
+ * <design/trace/#parallel.flip>.
+ */
+
+static Res rootScanRefs(ScanState ss, Root root)
+{
+  Res res;
 
   switch(root->var) {
   case RootAREA:
@@ -534,8 +655,6 @@ Res RootScan(ScanState ss, Root root)
                         root->the.area.limit,
                         root->the.area.scan_area,
                         root->the.area.the.closure);
-    if (res != ResOK)
-      goto failScan;
     break;
 
   case RootAREA_TAGGED:
@@ -544,16 +663,12 @@ Res RootScan(ScanState ss, Root root)
                         root->the.area.limit,
                         root->the.area.scan_area,
                         &root->the.area.the.tag);
-    if (res != ResOK)
-      goto failScan;
     break;
 
   case RootFUN:
     res = root->the.fun.scan(&ss->ss_s,
                              root->the.fun.p,
                              root->the.fun.s);
-    if (res != ResOK)
-      goto failScan;
     break;
 
   case RootTHREAD:
@@ -561,8 +676,6 @@ Res RootScan(ScanState ss, Root root)
                      root->the.thread.stackCold,
                      root->the.thread.scan_area,
                      root->the.thread.the.closure);
-    if (res != ResOK)
-      goto failScan;
     break;
 
   case RootTHREAD_TAGGED:
@@ -570,37 +683,222 @@ Res RootScan(ScanState ss, Root root)
                      root->the.thread.stackCold,
                      root->the.thread.scan_area,
                      &root->the.thread.the.tag);
-    if (res != ResOK)
-      goto failScan;
     break;
     
   case RootFMT:
     res = (*root->the.fmt.scan)(&ss->ss_s, root->the.fmt.base, root->the.fmt.limit);
     ss->scannedSize += AddrOffset(root->the.fmt.base, root->the.fmt.limit);
-    if (res != ResOK)
-      goto failScan;
     break;
 
   default:
     NOTREACHED;
     res = ResUNIMPL;
-    goto failScan;
+    break;
   }
 
-  AVER(res == ResOK);
+  return res;
+}
+
+
+/* RootBlacken -- note that a root has been scanned */
+
+void RootBlacken(ScanState ss, Root root)
+{
+  AVERT(ScanState, ss);
+  AVERT(Root, root);
+
   root->grey = TraceSetDiff(root->grey, ss->traces);
   rootSetSummary(root, ScanStateSummary(ss));
   EVENT3(RootScan, root, ss->traces, ScanStateSummary(ss));
+}
 
-failScan:
-  if (root->pm != AccessSetEMPTY) {
-    ProtSet(root->protBase, root->protLimit, root->pm);
+
+/* RootScan -- scan root */
+
+Res RootScan(ScanState ss, Root root)
+{
+  Res res;
+
+  AVERT(Root, root);
+  AVERT(ScanState, ss);
+  AVER(root->rank == ss->rank);
+
+  if (TraceSetInter(root->grey, ss->traces) == TraceSetEMPTY)
+    return ResOK;
+
+  AVER(ScanStateSummary(ss) == RefSetEMPTY);
+
+  if (RootPM(root) != AccessSetEMPTY) {
+    ProtSet(root->protBase, root->protLimit, AccessSetEMPTY);
+  }
+
+  res = rootScanRefs(ss, root);
+  if (res == ResOK)
+    RootBlacken(ss, root);
+
+  if (RootPM(root) != AccessSetEMPTY) {
+    rootProtect(root);
   }
 
   return res;
 }
 
 
+/* RootParallelScan -- may a root be scanned on a collector thread?
+ *
+ * Returns TRUE if the root is grey for the traces and is the root of
+ * a thread other than the current one.  The caller must have
+ * suspended the other threads, and must call rootScanRefs (through
+ * RootScanParallel) and then RootBlacken.  See
+ * <design/trace/#parallel.flip>.
+ */
+
+Bool RootParallelScan(Root root, TraceSet ts)
+{
+  AVERT(Root, root);
+  AVERT(TraceSet, ts);
+
+  return (root->var == RootTHREAD || root->var == RootTHREAD_TAGGED)
+    && TraceSetInter(root->grey, ts) != TraceSetEMPTY
+    && !ThreadIsCurrent(root->the.thread.thread);
+}
+
+
+/* RootScanParallel -- scan a thread root on a collector thread */
+
+Res RootScanParallel(ScanState ss, Root root)
+{
+  AVER(root->var == RootTHREAD || root->var == RootTHREAD_TAGGED);
+  return rootScanRefs(ss, root);
+}
+
+
+/* RootDefer -- defer scanning a root until after the flip
+ *
+ * If the root can be scanned incrementally, and is grey for the
+ * trace, make all its chunks grey and protect them, and return TRUE.
+ * Otherwise return FALSE, and the caller must scan the root.  See
+ * <design/root/#incremental.flip>.
+ */
+
+Bool RootDefer(Root root, Trace trace)
+{
+  AVERT(Root, root);
+  AVERT(Trace, trace);
+
+  if (root->chunkTable == NULL || root->chunkTrace != NULL
+      || !TraceSetIsMember(root->grey, trace))
+    return FALSE;
+
+  root->grey = TraceSetDel(root->grey, trace);
+  root->chunkTrace = trace;
+  BTSetRange(root->chunkTable, 0, root->chunkCount);
+  root->chunkNext = 0;
+  root->chunkGrey = root->chunkCount;
+  root->chunkSummary = RefSetEMPTY;
+  root->chunkSummaryLost = FALSE;
+  RingAppend(&ArenaGlobals(root->arena)->rootGreyRing, &root->greyRing);
+  ProtSet(root->protBase, root->protLimit, AccessREAD | AccessWRITE);
+  EVENT3(RootDefer, root, trace, root->chunkCount);
+
+  AVERT(Root, root);
+  return TRUE;
+}
+
+
+/* RootFindGrey -- find a grey chunk of a root for a trace */
+
+Bool RootFindGrey(Root *rootReturn, Index *chunkReturn,
+                  Arena arena, Trace trace)
+{
+  Ring node, next;
+
+  AVER(rootReturn != NULL);
+  AVER(chunkReturn != NULL);
+  AVERT(Arena, arena);
+  AVERT(Trace, trace);
+
+  RING_FOR(node, &ArenaGlobals(arena)->rootGreyRing, next) {
+    Root root = RING_ELT(Root, greyRing, node);
+    if (root->chunkTrace == trace) {
+      while (!BTGet(root->chunkTable, root->chunkNext)) {
+        ++root->chunkNext;
+        AVER(root->chunkNext < root->chunkCount);
+      }
+      *rootReturn = root;
+      *chunkReturn = root->chunkNext;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+
+/* RootScanChunk -- scan one grey chunk of a root
+ *
+ * The caller must hold the shield, because the chunk is exposed while
+ * it is scanned.  See <design/root/#incremental.scan>.
+ */
+
+Res RootScanChunk(ScanState ss, Root root, Index chunk)
+{
+  Addr base, limit, scanBase, scanLimit;
+  Res res;
+
+  AVERT(ScanState, ss);
+  AVERT(Root, root);
+  AVER(root->chunkTrace != NULL);
+  AVER(ss->traces == TraceSetSingle(root->chunkTrace));
+  AVER(ss->rank == root->rank);
+  AVER(chunk < root->chunkCount);
+  AVER(BTGet(root->chunkTable, chunk));
+  AVER(ScanStateSummary(ss) == RefSetEMPTY);
+
+  base = rootChunkBase(root, chunk);
+  limit = rootChunkLimit(root, chunk);
+  scanBase = (Addr)root->the.area.base;
+  if (scanBase < base)
+    scanBase = base;
+  scanLimit = (Addr)root->the.area.limit;
+  if (scanLimit > limit)
+    scanLimit = limit;
+
+  ProtSet(base, limit, AccessSetEMPTY);
+  if (scanBase < scanLimit) {
+    res = TraceScanArea(ss, (Word *)scanBase, (Word *)scanLimit,
+                        root->the.area.scan_area,
+                        root->var == RootAREA_TAGGED
+                        ? (void *)&root->the.area.the.tag
+                        : root->the.area.the.closure);
+    if (res != ResOK) {
+      ProtSet(base, limit, AccessREAD | AccessWRITE);
+      return res;
+    }
+  }
+
+  BTRes(root->chunkTable, chunk);
+  --root->chunkGrey;
+  root->chunkSummary = RefSetUnion(root->chunkSummary,
+                                   ScanStateSummary(ss));
+  if (root->summary != RefSetUNIV)
+    root->summary = RefSetUnion(root->summary, ScanStateSummary(ss));
+
+  if (root->chunkGrey > 0) {
+    ProtSet(base, limit, rootChunkPM(root));
+  } else {
+    root->chunkTrace = NULL;
+    RingRemove(&root->greyRing);
+    if (!root->chunkSummaryLost)
+      rootSetSummary(root, root->chunkSummary);
+    rootProtect(root);
+    EVENT3(RootScan, root, ss->traces, root->summary);
+  }
+
+  return ResOK;
+}
+
+
 /* RootOfAddr -- return the root at addr
  *
  * Returns TRUE if the addr is in a root (and returns the root in
@@ -627,20 +925,40 @@ Bool RootOfAddr(Root *rootReturn, Arena arena, Addr addr)
 }
 
 
-/* RootAccess -- handle barrier hit on root */
+/* RootAccess -- handle barrier hit on root
+ *
+ * A hit on a grey chunk of a root that is being scanned incrementally
+ * scans the chunk; if the access was a write it will hit the write
+ * barrier next time.  Any other hit is on the write barrier.  See
+ * <design/root/#incremental.access>.
+ */
 
-void RootAccess(Root root, AccessSet mode)
+void RootAccess(Root root, Addr addr, AccessSet mode)
 {
   AVERT(Root, root);
+  AVER(root->protBase <= addr);
+  AVER(addr < root->protLimit);
   AVERT(AccessSet, mode);
-  AVER((root->pm & mode) != AccessSetEMPTY);
-  AVER(mode == AccessWRITE); /* only write protection supported */
+  AVER((RootPM(root) & mode) != AccessSetEMPTY);
+
+  if (root->chunkTrace != NULL) {
+    Index chunk = AddrOffset(root->protBase, addr) / root->chunkSize;
+    if (BTGet(root->chunkTable, chunk)) {
+      Res res = TraceScanRootChunk(root->chunkTrace, root, chunk);
+      /* Allocation failures should be handled by emergency mode. */
+      AVER(res == ResOK);
+      return;
+    }
+  }
+
+  /* only write protection supported */
+  AVER(BS_INTER(mode, AccessWRITE) != AccessSetEMPTY);
 
   rootSetSummary(root, RefSetUNIV);
 
   /* Access must now be allowed. */
-  AVER((root->pm & mode) == AccessSetEMPTY);
-  ProtSet(root->protBase, root->protLimit, root->pm);
+  AVER((root->pm & mode & AccessWRITE) == AccessSetEMPTY);
+  rootProtect(root);
 }
 
 
@@ -697,6 +1015,17 @@ Res RootDescribe(Root root, mps_lib_FILE *stream, Count depth)
   if (res != ResOK)
     return res;
 
+  if (root->chunkTable != NULL) {
+    res = WriteF(stream, depth + 2,
+                 "chunks $U size $W grey $U summary $B$S\n",
+                 (WriteFU)root->chunkCount, (WriteFW)root->chunkSize,
+                 (WriteFU)root->chunkGrey, (WriteFB)root->chunkSummary,
+                 root->chunkSummaryLost ? " lost" : "",
+                 NULL);
+    if (res != ResOK)
+      return res;
+  }
+
   switch(root->var) {
   case RootAREA:
     res = WriteF(stream, depth + 2,
@@ -249,8 +249,8 @@ Res SACFill(Addr *p_o, SAC sac, Size size)
   Index i;
   Count blockCount, j;
   Size blockSize;
-  Addr p, fl;
-  Res res = ResOK; /* stop compiler complaining */
+  Addr fl;
+  Res res;
   mps_sac_t esac;
 
   AVER(p_o != NULL);
@@ -268,21 +268,16 @@ Res SACFill(Addr *p_o, SAC sac, Size size)
   if (blockSize == SizeMAX)
     /* .align: align 'cause some classes don't accept unaligned. */
     blockSize = SizeAlignUp(size, PoolAlignment(sac->pool));
-  for (j = 0, fl = esac->_freelists[i]._blocks;
-       j <= blockCount; ++j) {
-    res = PoolAlloc(&p, sac->pool, blockSize);
-    if (res != ResOK)
-      break;
-    /* @@@@ ignoring shields for now */
-    *ADDR_PTR(Addr, p) = fl; fl = p;
-  }
+  /* Allocate them and the one to return in one go.  See
+     <design/class-interface/#method.bulkAlloc>. */
+  fl = esac->_freelists[i]._blocks;
+  /* @@@@ ignoring shields for now */
+  res = PoolBulkAlloc(&j, &fl, sac->pool, blockSize, blockCount + 1);
   /* If didn't get any, just return. */
-  if (j == 0) {
-    AVER(res != ResOK);
+  if (res != ResOK)
     return res;
-  }
 
-  /* Take the last one off, and return it. */
+  /* Take the first one off, and return it. */
   esac->_freelists[i]._count = j - 1;
   *p_o = fl;
   /* @@@@ ignoring shields for now */
@@ -299,17 +294,15 @@ Res SACFill(Addr *p_o, SAC sac, Size size)
 static void sacClassFlush(SAC sac, Index i, Size blockSize,
                           Count blockCount)
 {
-  Addr cb, fl;
-  Count j;
+  Addr fl;
   mps_sac_t esac;
   
+  if (blockCount == 0)
+    return;
   esac = ExternalSACOfSAC(sac);
-  for (j = 0, fl = esac->_freelists[i]._blocks;
-       j < blockCount; ++j) {
-    /* @@@@ ignoring shields for now */
-    cb = fl; fl = *ADDR_PTR(Addr, cb);
-    PoolFree(sac->pool, cb, blockSize);
-  }
+  fl = esac->_freelists[i]._blocks;
+  /* @@@@ ignoring shields for now */
+  PoolBulkFree(sac->pool, &fl, blockSize, blockCount);
   esac->_freelists[i]._count -= blockCount;
   esac->_freelists[i]._blocks = fl;
 }
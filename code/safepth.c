@@ -0,0 +1,304 @@
+/* safepth.c: SAFEPOINT THREAD TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Run several threads allocating in an AMC pool in an arena whose
+ * threads are suspended at safepoints, while the main thread runs
+ * collections.  See <design/thread-manager/#safepoint>.
+ *
+ * The mutator threads block all asynchronous signals, so if the MPS
+ * tried to suspend them by signalling, the test would hang.  Each
+ * thread keeps references on its stack and in a chain of objects,
+ * and checks that they survive (and move correctly).
+ */
+
+/* .feature.li: pthread_sigmask and sigset_t need _XOPEN_SOURCE on
+ * Linux.  This must come before any header.  See .feature.li in
+ * config.h. */
+#if defined(__linux__) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 500
+#endif
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "testthr.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+
+#if !defined(MPS_OS_W3)
+#include <signal.h> /* pthread_sigmask, sigfillset, sigdelset */
+#endif
+
+
+#define testArenaSIZE   ((size_t)64 << 20)
+#define threadCOUNT     8
+#define refCOUNT        64    /* references on each thread's stack */
+#define objSLOTS        2     /* tag and link */
+#define iterCOUNT       20000
+#define checkEVERY      64    /* iterations between checks */
+#define regionEVERY     512   /* iterations between safepoint regions */
+#define genCOUNT        2
+
+/* testChain -- generation parameters for the test */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 256, 0.9 }, { 1024, 0.5 } };
+
+
+static mps_arena_t arena;
+static mps_pool_t pool;
+static volatile int kidDone[threadCOUNT + 1];
+
+
+/* blockSignals -- block all the signals the MPS might use to suspend
+ * the current thread
+ *
+ * Protection faults are synchronous, so SIGSEGV and SIGBUS stay
+ * unblocked.
+ */
+
+static void blockSignals(void)
+{
+#if !defined(MPS_OS_W3)
+  sigset_t set;
+  sigfillset(&set);
+  sigdelset(&set, SIGSEGV);
+  sigdelset(&set, SIGBUS);
+  Insist(pthread_sigmask(SIG_BLOCK, &set, NULL) == 0);
+#endif
+}
+
+
+/* make -- create an object with a tag and a link */
+
+static mps_word_t make(mps_ap_t ap, mps_word_t tag, mps_word_t link)
+{
+  mps_word_t obj;
+
+  die(make_dylan_vector(&obj, ap, objSLOTS), "make_dylan_vector");
+  DYLAN_VECTOR_SLOT(obj, 0) = DYLAN_INT(tag);
+  DYLAN_VECTOR_SLOT(obj, 1) = link;
+  return obj;
+}
+
+
+/* check -- check an object and the one it links to */
+
+static void check(mps_word_t obj, mps_word_t tag)
+{
+  mps_word_t link;
+
+  cdie(dylan_check((mps_addr_t)obj), "dylan_check");
+  Insist(DYLAN_VECTOR_SLOT(obj, 0) == DYLAN_INT(tag));
+  link = DYLAN_VECTOR_SLOT(obj, 1);
+  if (link != DYLAN_INT(0)) {
+    cdie(dylan_check((mps_addr_t)link), "dylan_check link");
+    Insist(DYLAN_VECTOR_SLOT(link, 0) == DYLAN_INT(tag - 1));
+  }
+}
+
+
+/* kid -- allocate and check objects, polling for safepoints */
+
+static void *kid(void *arg);
+
+ATTRIBUTE_NOINLINE
+static void kidBody(size_t t, void *marker)
+{
+  mps_thr_t thread;
+  mps_root_t root;
+  mps_ap_t ap;
+  volatile mps_word_t refs[refCOUNT];
+  mps_word_t tags[refCOUNT];
+  size_t i, j;
+  volatile unsigned long spin = 0;
+
+  blockSignals();
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  die(mps_root_create_thread(&root, arena, thread, marker),
+      "root_create_thread");
+  die(mps_ap_create_k(&ap, pool, mps_args_none), "ap_create");
+
+  for (j = 0; j < refCOUNT; ++j) {
+    tags[j] = t << 24;
+    refs[j] = make(ap, tags[j], DYLAN_INT(0));
+  }
+
+  for (i = 0; i < iterCOUNT; ++i) {
+    j = rnd() % refCOUNT;
+    ++tags[j];
+    refs[j] = make(ap, tags[j], refs[j]);
+
+    mps_thread_safepoint(thread);
+
+    if (i % checkEVERY == 0)
+      for (j = 0; j < refCOUNT; ++j)
+        check(refs[j], tags[j]);
+
+    if (i % regionEVERY == 0) {
+      /* Do some work that doesn't touch references, inside a region
+       * where the collector needn't wait for this thread. */
+      mps_thread_safepoint_begin(thread);
+      for (j = 0; j < 100000; ++j)
+        ++spin;
+      mps_thread_safepoint_end(thread);
+    }
+  }
+
+  for (j = 0; j < refCOUNT; ++j)
+    check(refs[j], tags[j]);
+
+  mps_ap_destroy(ap);
+  mps_root_destroy(root);
+  mps_thread_dereg(thread);
+  kidDone[t] = 1;
+}
+
+static void *kid(void *arg)
+{
+  void *marker = &marker;
+  kidBody((size_t)arg, marker);
+  return NULL;
+}
+
+
+/* test -- run the threads while collecting */
+
+static void test(void *marker)
+{
+  mps_fmt_t format;
+  mps_chain_t chain;
+  mps_thr_t thread;
+  mps_root_t root;
+  mps_ap_t ap;
+  volatile mps_word_t obj;
+  testthr_t kids[threadCOUNT];
+  mps_res_t res;
+  size_t i, collections, running;
+  mps_clock_t start;
+  double t;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SAFEPOINTS, TRUE);
+    res = mps_arena_create_k(&arena, mps_arena_class_vm(), args);
+  } MPS_ARGS_END(args);
+  if (res == MPS_RES_UNIMPL) {
+    printf("Safepoints not supported on this platform.\n");
+    return;
+  }
+  die(res, "arena_create");
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain), "chain_create");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&pool, arena, mps_class_amc(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  die(mps_root_create_thread(&root, arena, thread, marker),
+      "root_create_thread");
+  die(mps_ap_create_k(&ap, pool, mps_args_none), "ap_create");
+
+  /* Make sure there's something to collect before the kids run. */
+  obj = make(ap, 0, DYLAN_INT(0));
+
+  for (i = 0; i < threadCOUNT; ++i)
+    testthr_create(&kids[i], kid, (void *)(i + 1));
+
+  /* Collect until all the kids have finished, so that the
+   * collections have to stop them. */
+  start = mps_clock();
+  collections = 0;
+  do {
+    die(mps_arena_collect(arena), "arena_collect");
+    mps_arena_release(arena);
+    ++collections;
+    running = 0;
+    for (i = 1; i <= threadCOUNT; ++i)
+      running += (size_t)!kidDone[i];
+  } while (running > 0);
+  t = (double)(mps_clock() - start) / (double)mps_clocks_per_sec();
+  printf("%d threads: %lu collections in %.3fs\n",
+         threadCOUNT, (unsigned long)collections, t);
+
+  /* Joining blocks this thread, so the collections run by the kids
+   * mustn't wait for it. */
+  mps_thread_safepoint_begin(thread);
+  for (i = 0; i < threadCOUNT; ++i)
+    testthr_join(&kids[i], NULL);
+  mps_thread_safepoint_end(thread);
+  check(obj, 0);
+
+  mps_arena_park(arena);
+  mps_ap_destroy(ap);
+  mps_root_destroy(root);
+  mps_thread_dereg(thread);
+  mps_pool_destroy(pool);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  void *marker = &marker;
+
+  testlib_init(argc, argv);
+
+  test(marker);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -47,9 +47,7 @@ Res SegAlloc(Seg *segReturn, SegClass klass, LocusPref pref,
 {
   Res res;
   Arena arena;
-  Seg seg;
   Addr base;
-  void *p;
 
   AVER(segReturn != NULL);
   AVERT(SegClass, klass);
@@ -66,27 +64,62 @@ Res SegAlloc(Seg *segReturn, SegClass klass, LocusPref pref,
   if (res != ResOK)
     goto failArena;
 
+  res = SegAllocTracts(segReturn, klass, base, size, pool, args);
+  if (res != ResOK)
+    goto failSeg;
+
+  return ResOK;
+
+failSeg:
+  ArenaFree(base, size, pool);
+failArena:
+  EVENT3(SegAllocFail, arena, size, pool);
+  return res;
+}
+
+
+/* SegAllocTracts -- make a segment from tracts allocated to the pool
+ *
+ * The tracts from base to base + size must already have been
+ * allocated to the pool by ArenaAlloc, and must not belong to a
+ * segment.  If this fails, the tracts remain allocated to the pool.
+ * SegFree returns the memory to the arena in the usual way.
+ */
+
+Res SegAllocTracts(Seg *segReturn, SegClass klass, Addr base,
+                   Size size, Pool pool, ArgList args)
+{
+  Res res;
+  Arena arena;
+  Seg seg;
+  void *p;
+
+  AVER(segReturn != NULL);
+  AVERT(SegClass, klass);
+  AVER(base != (Addr)0);
+  AVER(size > (Size)0);
+  AVERT(Pool, pool);
+
+  arena = PoolArena(pool);
+  AVERT(Arena, arena);
+  AVER(AddrIsArenaGrain(base, arena));
+  AVER(SizeIsArenaGrains(size, arena));
+
   /* allocate the segment object from the control pool */
   res = ControlAlloc(&p, arena, klass->size);
   if (res != ResOK)
-    goto failControl;
+    return res;
   seg = p;
 
   res = SegInit(seg, klass, pool, base, size, args);
-  if (res != ResOK)
-    goto failInit;
+  if (res != ResOK) {
+    ControlFree(arena, seg, klass->size);
+    return res;
+  }
 
   EVENT5(SegAlloc, arena, seg, SegBase(seg), size, pool);
   *segReturn = seg;
   return ResOK;
-
-failInit:
-  ControlFree(arena, seg, klass->size);
-failControl:
-  ArenaFree(base, size, pool);
-failArena:
-  EVENT3(SegAllocFail, arena, size, pool);
-  return res;
 }
 
 
@@ -1263,6 +1296,10 @@ static void gcSegSetRankSet(Seg seg, RankSet rankSet)
   oldRankSet = seg->rankSet;
   seg->rankSet = BS_BITFIELD(Rank, rankSet);
 
+  /* <design/write-barrier/#card.shield> */
+  if (ArenaCardMarking(arena))
+    return;
+
   if (oldRankSet == RankSetEMPTY) {
     if (rankSet != RankSetEMPTY) {
       AVER(gcseg->summary == RefSetEMPTY);
@@ -1277,10 +1314,20 @@ static void gcSegSetRankSet(Seg seg, RankSet rankSet)
 }
 
 
+/* gcSegSyncWriteBarrier -- raise or lower the write barrier to match
+ * the summary
+ *
+ * When the arena uses card marking, the client's stores are recorded
+ * in the card table instead, and segments are never write-protected.
+ * See <design/write-barrier/#card.shield>.
+ */
+
 static void gcSegSyncWriteBarrier(Seg seg, Arena arena)
 {
   /* Can't check seg -- this function enforces invariants tested by SegCheck. */
-  if (SegSummary(seg) == RefSetUNIV)
+  if (ArenaCardMarking(arena))
+    NOOP;
+  else if (SegSummary(seg) == RefSetUNIV)
     ShieldLower(arena, seg, AccessWRITE);
   else
     ShieldRaise(arena, seg, AccessWRITE);
@@ -1307,6 +1354,9 @@ static void gcSegSetSummary(Seg seg, RefSet summary)
   AVER_CRITICAL(&gcseg->segStruct == seg);
 
   arena = PoolArena(SegPool(seg));
+  /* <design/write-barrier/#card.buffer> */
+  if (ArenaCardMarking(arena) && gcseg->buffer != NULL)
+    summary = RefSetUNIV;
   gcseg->summary = summary;
 
   AVER(seg->rankSet != RankSetEMPTY);
@@ -1335,6 +1385,11 @@ static void gcSegSetRankSummary(Seg seg, RankSet rankSet, RefSet summary)
 
   arena = PoolArena(SegPool(seg));
 
+  /* <design/write-barrier/#card.buffer> */
+  if (ArenaCardMarking(arena) && gcseg->buffer != NULL
+      && rankSet != RankSetEMPTY)
+    summary = RefSetUNIV;
+
   seg->rankSet = BS_BITFIELD(Rank, rankSet);
   gcseg->summary = summary;
 
@@ -1372,6 +1427,13 @@ static void gcSegSetBuffer(Seg seg, Buffer buffer)
   AVER_CRITICAL(&gcseg->segStruct == seg);
 
   gcseg->buffer = buffer;
+
+  /* The client doesn't mark cards when it initializes objects in a
+     buffer, so the summary must cover anything it might store there.
+     See <design/write-barrier/#card.buffer>. */
+  if (buffer != NULL && seg->rankSet != RankSetEMPTY
+      && ArenaCardMarking(PoolArena(SegPool(seg))))
+    gcseg->summary = RefSetUNIV;
 }
 
 
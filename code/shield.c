@@ -27,6 +27,8 @@ void ShieldInit(Shield shield)
   shield->depth = 0;
   shield->unsynced = 0;
   shield->holds = 0;
+  shield->flushSegs = 0;
+  shield->flushCalls = 0;
   shield->sig = ShieldSig;
 }
 
@@ -126,6 +128,8 @@ Res ShieldDescribe(Shield shield, mps_lib_FILE *stream, Count depth)
                "  length    $U\n", (WriteFU)shield->length,
                "  unsynced  $U\n", (WriteFU)shield->unsynced,
                "  holds     $U\n", (WriteFU)shield->holds,
+               "  flushed   $U\n", (WriteFU)shield->flushSegs,
+               "  protSets  $U\n", (WriteFU)shield->flushCalls,
                "} Shield $P\n",    (WriteFP)shield,
                NULL);
   if (res != ResOK)
@@ -210,6 +214,24 @@ static Bool SegIsExposed(Seg seg)
 }
 
 
+/* shieldProtSet -- set the protection of a range of segments
+ *
+ * If the arena detects write faults with userfaultfd, write
+ * protection goes through that instead.  See <design/prot/#uffd>.
+ */
+
+static void shieldProtSet(Shield shield, Addr base, Addr limit,
+                          AccessSet mode)
+{
+  ProtUffd uffd = ShieldArena(shield)->uffd;
+
+  if (uffd != NULL)
+    ProtUffdSet(uffd, base, limit, mode);
+  else
+    ProtSet(base, limit, mode);
+}
+
+
 /* shieldSync -- synchronize a segment's protection
  *
  * See design.mps.shield.inv.prot.shield.
@@ -221,7 +243,7 @@ static void shieldSync(Shield shield, Seg seg)
 
   if (!SegIsSynced(seg)) {
     shieldSetPM(shield, seg, SegSM(seg));
-    ProtSet(SegBase(seg), SegLimit(seg), SegPM(seg));
+    shieldProtSet(shield, SegBase(seg), SegLimit(seg), SegPM(seg));
   }
 }
 
@@ -231,6 +253,14 @@ static void shieldSync(Shield shield, Seg seg)
  * Called from inside impl.c.shield when any segment is not synced, in
  * order to provide exclusive access to the segment by the MPS.  See
  * .inv.unsynced.suspended.
+ *
+ * .suspend.pool-locks: Threads are not resumed until ShieldLeave, and
+ * meanwhile the MPS may claim pool locks, so a thread must not be
+ * suspended while it holds one.  Holding all the pool locks while
+ * suspending the threads ensures this.  Threads suspended at
+ * safepoints never hold a pool lock, and a thread waiting for one
+ * would never reach a safepoint.  See
+ * <design/thread-safety/#sol.pool-lock.suspend>.
  */
 
 static void shieldSuspend(Arena arena)
@@ -242,7 +272,11 @@ static void shieldSuspend(Arena arena)
   AVER(shield->inside);
 
   if (!shield->suspended) {
+    if (!arena->safepoints)
+      PoolLocksClaimAll(arena); /* .suspend.pool-locks */
     ThreadRingSuspend(ArenaThreadRing(arena), ArenaDeadRing(arena));
+    if (!arena->safepoints)
+      PoolLocksReleaseAll(arena);
     shield->suspended = TRUE;
   }
 }
@@ -302,7 +336,7 @@ static void shieldProtLower(Shield shield, Seg seg, AccessSet mode)
 
   if (BS_INTER(SegPM(seg), mode) != AccessSetEMPTY) {
     shieldSetPM(shield, seg, BS_DIFF(SegPM(seg), mode));
-    ProtSet(SegBase(seg), SegLimit(seg), SegPM(seg));
+    shieldProtSet(shield, SegBase(seg), SegLimit(seg), SegPM(seg));
   }
 }
 
@@ -385,6 +419,10 @@ static Compare shieldQueueEntryCompare(void *left, void *right, void *closure)
  * protection calls are extremely inefficient, but has no net gain on
  * Windows.
  *
+ * .flush.count: The number of segments synced and the number of calls
+ * to ProtSet are accumulated in the shield and reported by the
+ * ShieldFlush event, so that the saving can be measured.
+ *
  * TODO: Could we keep extending the outstanding area over memory
  * that's *not* in the queue but has the same protection mode?  Might
  * require design.mps.shield.improve.noseg.
@@ -395,6 +433,7 @@ static void shieldFlushEntries(Shield shield)
   Addr base = NULL, limit;
   AccessSet mode;
   Index i;
+  Count segs = 0, calls = 0;
 
   if (shield->length == 0) {
     AVER(shield->queue == NULL);
@@ -411,10 +450,12 @@ static void shieldFlushEntries(Shield shield)
     Seg seg = shieldDequeue(shield, i);
     if (!SegIsSynced(seg)) {
       shieldSetPM(shield, seg, SegSM(seg));
+      ++segs;
       if (SegSM(seg) != mode || SegBase(seg) != limit) {
         if (base != NULL) {
           AVER(base < limit);
-          ProtSet(base, limit, mode);
+          shieldProtSet(shield, base, limit, mode);
+          ++calls;
         }
         base = SegBase(seg);
         mode = SegSM(seg);
@@ -424,9 +465,15 @@ static void shieldFlushEntries(Shield shield)
   }
   if (base != NULL) {
     AVER(base < limit);
-    ProtSet(base, limit, mode);
+    shieldProtSet(shield, base, limit, mode);
+    ++calls;
   }
 
+  shield->flushSegs += segs;
+  shield->flushCalls += calls;
+  if (segs > 0)
+    EVENT3(ShieldFlush, shield, segs, calls);
+
   shieldQueueReset(shield);
 }
 
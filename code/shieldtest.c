@@ -0,0 +1,197 @@
+/* shieldtest.c: SHIELD COALESCING TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Raise the shield on many segments with the mutator suspended, so
+ * that they are queued, then flush the queue and check that each
+ * segment's protection is in sync with its shield mode, and that runs
+ * of address-contiguous segments with the same mode were protected
+ * with a single call.  See <code/shield.c#flush.count>.
+ */
+
+#include "mpm.h"
+#include "poolmv.h"
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpsavm.h"
+
+#include <stdio.h> /* printf */
+
+
+#define segsCOUNT   500
+#define roundsCOUNT 10
+#define testArenaSIZE ((Size)16 << 20)
+
+
+/* segCompare -- comparison for sorting segments into address order */
+
+static Compare segCompare(void *left, void *right, void *closure)
+{
+  Seg segA = left, segB = right;
+  UNUSED(closure);
+  if (SegBase(segA) < SegBase(segB))
+    return CompareLESS;
+  else if (SegBase(segA) == SegBase(segB))
+    return CompareEQUAL;
+  else
+    return CompareGREATER;
+}
+
+
+/* test -- raise the shield on segments in runs, flush, and check */
+
+static void test(Arena arena, Seg *segs, Count nsegs)
+{
+  Shield shield = ArenaShield(arena);
+  AccessSet modes[segsCOUNT];
+  Count expected = 0, segsBefore, callsBefore;
+  AccessSet mode = AccessSetEMPTY;
+  Index i;
+
+  /* Choose a mode for each segment, in runs of random length.  Some
+     runs are left unprotected, so are not queued. */
+  i = 0;
+  while (i < nsegs) {
+    Count run = 1 + rnd() % 20;
+    switch (rnd() % 3) {
+    case 0: mode = AccessSetEMPTY; break;
+    case 1: mode = AccessWRITE; break;
+    default: mode = BS_UNION(AccessREAD, AccessWRITE); break;
+    }
+    for (; run > 0 && i < nsegs; --run, ++i)
+      modes[i] = mode;
+  }
+
+  /* Count the calls needed: one per maximal run of contiguous
+     segments with the same non-empty mode. */
+  for (i = 0; i < nsegs; ++i)
+    if (modes[i] != AccessSetEMPTY
+        && (i == 0 || modes[i] != modes[i - 1]
+            || SegBase(segs[i]) != SegLimit(segs[i - 1])))
+      ++expected;
+
+  segsBefore = shield->flushSegs;
+  callsBefore = shield->flushCalls;
+
+  ShieldHold(arena);
+  /* Raise in a scrambled order so that the flush has to sort. */
+  for (i = 0; i < nsegs; ++i) {
+    Index j = (i * 7919) % nsegs;
+    if (modes[j] != AccessSetEMPTY)
+      ShieldRaise(arena, segs[j], modes[j]);
+  }
+  ShieldFlush(arena);
+  ShieldRelease(arena);
+
+  for (i = 0; i < nsegs; ++i) {
+    Insist(SegSM(segs[i]) == modes[i]);
+    Insist(SegPM(segs[i]) == modes[i]);
+  }
+  Insist(shield->flushCalls - callsBefore == expected);
+  printf("%lu segments protected with %lu calls\n",
+         (unsigned long)(shield->flushSegs - segsBefore),
+         (unsigned long)expected);
+
+  for (i = 0; i < nsegs; ++i)
+    if (modes[i] != AccessSetEMPTY)
+      ShieldLower(arena, segs[i], modes[i]);
+  for (i = 0; i < nsegs; ++i)
+    Insist(SegPM(segs[i]) == AccessSetEMPTY);
+}
+
+
+int main(int argc, char *argv[])
+{
+  Arena arena;
+  Pool pool;
+  Seg segs[segsCOUNT];
+  SortStruct sortStruct;
+  Index i;
+
+  testlib_init(argc, argv);
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    die(ArenaCreate(&arena, (ArenaClass)mps_arena_class_vm(), args),
+        "ArenaCreate");
+  } MPS_ARGS_END(args);
+  die(PoolCreate(&pool, arena, PoolClassMV(), argsNone), "PoolCreate");
+
+  for (i = 0; i < segsCOUNT; ++i) {
+    Size size = (1 + rnd() % 4) * ArenaGrainSize(arena);
+    die(SegAlloc(&segs[i], CLASS(GCSeg), LocusPrefDefault(), size, pool,
+                 argsNone),
+        "SegAlloc");
+    /* Only segments containing references may be protected.  A
+       universal summary means there is no write barrier. */
+    SegSetRankAndSummary(segs[i], RankSetSingle(RankEXACT), RefSetUNIV);
+  }
+  /* Free some segments to leave gaps that break runs. */
+  for (i = 0; i < segsCOUNT; i += 1 + rnd() % 50) {
+    SegSetRankAndSummary(segs[i], RankSetEMPTY, RefSetEMPTY);
+    SegFree(segs[i]);
+    segs[i] = NULL;
+  }
+  {
+    Index j = 0;
+    for (i = 0; i < segsCOUNT; ++i)
+      if (segs[i] != NULL)
+        segs[j++] = segs[i];
+    QuickSort((void **)segs, j, segCompare, UNUSED_POINTER, &sortStruct);
+    for (i = 0; i < roundsCOUNT; ++i)
+      test(arena, segs, j);
+    for (i = 0; i < j; ++i) {
+      SegSetRankAndSummary(segs[i], RankSetEMPTY, RefSetEMPTY);
+      SegFree(segs[i]);
+    }
+  }
+
+  PoolDestroy(pool);
+  ArenaDestroy(arena);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
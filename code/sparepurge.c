@@ -0,0 +1,182 @@
+/* sparepurge.c: SPARE MEMORY PURGING TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Free a large amount of memory to the arena, first with the default
+ * spare commit limit, which purges spare memory synchronously when
+ * the memory is freed, and then with a spare age, which leaves the
+ * spare memory to be purged by the arena's polls once it has been
+ * idle for that long.  Reports the longest pause in mps_free and in
+ * mps_arena_step in each case.  See <design/arena/#spare.age>.
+ */
+
+#include "testlib.h"
+#include "mpslib.h"
+#include "mpscmvff.h"
+#include "mpsavm.h"
+#include "mps.h"
+
+#include <stdio.h> /* printf */
+#include <string.h> /* memset */
+
+
+#define blockSIZE       ((size_t)64 << 10)
+#define blockCOUNT      512
+#define spareAGE        0.2
+#define stepsLIMIT      100000
+
+static void *blocks[blockCOUNT];
+
+
+/* seconds -- the time since a clock reading, in seconds */
+
+static double seconds(mps_clock_t start)
+{
+  return (double)(mps_clock() - start) / (double)mps_clocks_per_sec();
+}
+
+
+/* spin -- use up some time
+ *
+ * The spare age is measured with mps_clock, which counts processor
+ * time, so sleeping wouldn't age the spare pages.
+ */
+
+static void spin(double s)
+{
+  mps_clock_t start = mps_clock();
+  while (seconds(start) < s)
+    NOOP;
+}
+
+
+static void test(double spareAge)
+{
+  mps_arena_t arena;
+  mps_pool_t pool;
+  mps_clock_t start, freed;
+  size_t i, steps, spare;
+  double t, freePause = 0.0, stepPause = 0.0;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, blockSIZE * blockCOUNT * 2);
+    if (spareAge > 0.0) {
+      /* Large enough that mps_free never has to purge. */
+      MPS_ARGS_ADD(args, MPS_KEY_SPARE_COMMIT_LIMIT,
+                   blockSIZE * blockCOUNT * 2);
+      MPS_ARGS_ADD(args, MPS_KEY_SPARE_AGE, spareAge);
+    }
+    die(mps_arena_create_k(&arena, mps_arena_class_vm(), args),
+        "arena_create");
+  } MPS_ARGS_END(args);
+  MPS_ARGS_BEGIN(args) {
+    /* Return free memory to the arena at once. */
+    MPS_ARGS_ADD(args, MPS_KEY_SPARE, 0.0);
+    die(mps_pool_create_k(&pool, arena, mps_class_mvff(), args),
+        "pool_create");
+  } MPS_ARGS_END(args);
+
+  /* Touch the blocks, so that the operating system has to do some
+   * work to take the memory back. */
+  for (i = 0; i < blockCOUNT; ++i) {
+    die(mps_alloc(&blocks[i], pool, blockSIZE), "mps_alloc");
+    (void)memset(blocks[i], (int)i, blockSIZE);
+  }
+
+  freed = mps_clock();
+  for (i = 0; i < blockCOUNT; ++i) {
+    start = mps_clock();
+    mps_free(pool, blocks[i], blockSIZE);
+    t = seconds(start);
+    if (t > freePause)
+      freePause = t;
+  }
+  spare = mps_arena_spare_committed(arena);
+
+  if (spareAge > 0.0) {
+    Insist(spare >= blockSIZE * blockCOUNT / 2);
+    /* Nothing is old enough to purge yet, unless freeing was slow. */
+    (void)mps_arena_step(arena, 0.0, 0.0);
+    if (seconds(freed) < spareAge) {
+      Insist(mps_arena_spare_committed(arena) == spare);
+    }
+    spin(spareAge);
+  }
+
+  /* Step until all the spare memory has been purged.  Without a spare
+   * age, the spare memory below the limit is kept. */
+  for (steps = 0;
+       spareAge > 0.0 && mps_arena_spare_committed(arena) > 0;
+       ++steps)
+  {
+    Insist(steps < stepsLIMIT);
+    start = mps_clock();
+    (void)mps_arena_step(arena, 0.0, 0.0);
+    t = seconds(start);
+    if (t > stepPause)
+      stepPause = t;
+  }
+
+  printf("spare age %.1fs: %lu KiB spare after freeing; "
+         "longest free %.3fms; purged in %lu steps, longest %.3fms\n",
+         spareAge, (unsigned long)(spare >> 10), freePause * 1e3,
+         (unsigned long)steps, stepPause * 1e3);
+
+  mps_pool_destroy(pool);
+  mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  testlib_init(argc, argv);
+
+  test(0.0);
+  test(spareAGE);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
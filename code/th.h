@@ -68,11 +68,54 @@ extern Thread ThreadRingThread(Ring threadRing);
 
 extern Arena ThreadArena(Thread thread);
 
+
+/*  ThreadIsCurrent
+ *
+ *  Return TRUE if the thread is the one calling this function.  The
+ *  stack of the current thread can only be scanned on that thread.
+ */
+
+extern Bool ThreadIsCurrent(Thread thread);
+
 extern Res ThreadScan(ScanState ss, Thread thread, Word *stackCold,
                       mps_area_scan_t scan_area,
                       void *closure);
 
 
+/*  ThreadSafepointsEnable
+ *
+ *  Return ResOK if the threads registered with the arena can be
+ *  suspended cooperatively, at safepoints, rather than by the
+ *  thread manager's usual means, or ResUNIMPL if not. See
+ *  <design/thread-manager/#safepoint>.
+ */
+
+extern Res ThreadSafepointsEnable(Arena arena);
+
+
+/*  ThreadSafepointEnter/Leave
+ *
+ *  Bracket a region in which the current thread counts as stopped
+ *  at a safepoint.  Regions nest.  Leaving doesn't wait for the
+ *  collector.
+ */
+
+extern void ThreadSafepointEnter(void);
+extern void ThreadSafepointLeave(void);
+
+
+/*  ThreadSafepoint, ThreadSafepointPoll
+ *
+ *  If the collector is waiting for the current thread to stop,
+ *  stop it until the collector resumes it.  ThreadSafepointPoll
+ *  is a cheaper test for a particular thread, which must be the
+ *  current thread.
+ */
+
+extern void ThreadSafepoint(void);
+extern void ThreadSafepointPoll(Thread thread);
+
+
 #endif /* th_h */
 
 
@@ -116,6 +116,50 @@ Arena ThreadArena(Thread thread)
 }
 
 
+/* ThreadIsCurrent -- there is only one thread */
+
+Bool ThreadIsCurrent(Thread thread)
+{
+  AVERT(Thread, thread);
+  return TRUE;
+}
+
+
+/* ThreadSafepointsEnable etc. -- there is only one thread
+ *
+ * No other thread can need stopping, so safepoints are trivially
+ * supported, and are no-ops.
+ */
+
+Res ThreadSafepointsEnable(Arena arena)
+{
+  AVER(arena != NULL);
+  UNUSED(arena);
+  return ResOK;
+}
+
+void ThreadSafepointEnter(void)
+{
+  NOOP;
+}
+
+void ThreadSafepointLeave(void)
+{
+  NOOP;
+}
+
+void ThreadSafepoint(void)
+{
+  NOOP;
+}
+
+void ThreadSafepointPoll(Thread thread)
+{
+  AVER(TESTT(Thread, thread));
+  UNUSED(thread);
+}
+
+
 Res ThreadScan(ScanState ss, Thread thread, Word *stackCold,
                mps_area_scan_t scan_area,
                void *closure)
@@ -30,6 +30,11 @@
  * .stack.align: assume roots on the stack are always word-aligned,
  * but don't assume that the stack pointer is necessarily
  * word-aligned at the time of reading the context of another thread.
+ *
+ * .safepoint: In an arena created with MPS_KEY_ARENA_SAFEPOINTS, the
+ * threads are not suspended by signals. Instead each thread records
+ * its context when it reaches a safepoint, and the collector waits
+ * until every thread is at one. See <design/thread-manager/#safepoint>.
  */
 
 #include "prmcix.h"
@@ -51,10 +56,28 @@ typedef struct mps_thr_s {       /* PThreads thread structure */
   Bool alive;                    /* thread believed to be alive? */
   PThreadextStruct thrextStruct; /* PThreads extension */
   pthread_t id;                  /* Pthread object of thread */
-  MutatorFaultContext mfc;       /* Context if suspended, NULL if not */
+  MutatorFaultContext mfc;       /* Context if suspended, or last safepoint */
+  Bool safepoint;                /* suspended cooperatively? .safepoint */
+  RingStruct safepointRing;      /* safepoint threads in all arenas */
+  Count safepointDepth;          /* nesting of safepoint regions */
+  Bool suspendRequested;         /* collector awaiting safepoint? */
+  MutatorFaultContextStruct safepointMFC; /* context at safepoint */
+  ucontext_t safepointUcontext;  /* registers at safepoint */
 } ThreadStruct;
 
 
+/* Static data for cooperative suspension (.safepoint)
+ *
+ * The mutex protects the safepoint ring and the safepoint fields of
+ * the threads on it. The condition is broadcast whenever a thread
+ * reaches a safepoint and whenever the collector resumes threads.
+ */
+
+static pthread_mutex_t safepointMut = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t safepointCond = PTHREAD_COND_INITIALIZER;
+static RingStruct safepointRing = {&safepointRing, &safepointRing};
+
+
 /* ThreadCheck -- check a thread */
 
 Bool ThreadCheck(Thread thread)
@@ -65,6 +88,11 @@ Bool ThreadCheck(Thread thread)
   CHECKD_NOSIG(Ring, &thread->arenaRing);
   CHECKL(BoolCheck(thread->alive));
   CHECKD(PThreadext, &thread->thrextStruct);
+  CHECKL(BoolCheck(thread->safepoint));
+  CHECKD_NOSIG(Ring, &thread->safepointRing);
+  CHECKL(thread->safepoint || RingIsSingle(&thread->safepointRing));
+  CHECKL(thread->safepoint || thread->safepointDepth == 0);
+  /* can't check suspendRequested without the mutex */
   return TRUE;
 }
 
@@ -101,6 +129,12 @@ Res ThreadRegister(Thread *threadReturn, Arena arena)
   thread->arena = arena;
   thread->alive = TRUE;
   thread->mfc = NULL;
+  thread->safepoint = arena->safepoints;
+  RingInit(&thread->safepointRing);
+  thread->safepointDepth = 0;
+  thread->suspendRequested = FALSE;
+  thread->safepointMFC.info = NULL;
+  thread->safepointMFC.ucontext = &thread->safepointUcontext;
 
   PThreadextInit(&thread->thrextStruct, thread->id);
 
@@ -108,6 +142,14 @@ Res ThreadRegister(Thread *threadReturn, Arena arena)
 
   RingAppend(ArenaThreadRing(arena), &thread->arenaRing);
 
+  if (thread->safepoint) {
+    int status = pthread_mutex_lock(&safepointMut);
+    AVER(status == 0);
+    RingAppend(&safepointRing, &thread->safepointRing);
+    status = pthread_mutex_unlock(&safepointMut);
+    AVER(status == 0);
+  }
+
   *threadReturn = thread;
   return ResOK;
 }
@@ -122,9 +164,18 @@ void ThreadDeregister(Thread thread, Arena arena)
 
   RingRemove(&thread->arenaRing);
 
+  if (thread->safepoint) {
+    int status = pthread_mutex_lock(&safepointMut);
+    AVER(status == 0);
+    RingRemove(&thread->safepointRing);
+    status = pthread_mutex_unlock(&safepointMut);
+    AVER(status == 0);
+  }
+
   thread->sig = SigInvalid;
 
   RingFinish(&thread->arenaRing);
+  RingFinish(&thread->safepointRing);
 
   PThreadextFinish(&thread->thrextStruct);
 
@@ -138,12 +189,15 @@ void ThreadDeregister(Thread thread, Arena arena)
  * Threads that are found to be dead (that is, if func returns FALSE)
  * are moved to deadRing, in order to implement
  * design.thread-manager.sol.thread.term.attempt.
+ *
+ * Returns the number of threads func was called on.
  */
 
-static void mapThreadRing(Ring threadRing, Ring deadRing, Bool (*func)(Thread))
+static Count mapThreadRing(Ring threadRing, Ring deadRing, Bool (*func)(Thread))
 {
   Ring node, next;
   pthread_t self;
+  Count count = 0;
 
   AVERT(Ring, threadRing);
   AVERT(Ring, deadRing);
@@ -154,44 +208,181 @@ static void mapThreadRing(Ring threadRing, Ring deadRing, Bool (*func)(Thread))
     Thread thread = RING_ELT(Thread, arenaRing, node);
     AVERT(Thread, thread);
     AVER(thread->alive);
-    if (!pthread_equal(self, thread->id) /* .thread.id */
-        && !(*func)(thread))
-    {
-      thread->alive = FALSE;
-      RingRemove(&thread->arenaRing);
-      RingAppend(deadRing, &thread->arenaRing);
+    if (!pthread_equal(self, thread->id)) { /* .thread.id */
+      ++count;
+      if (!(*func)(thread)) {
+        thread->alive = FALSE;
+        RingRemove(&thread->arenaRing);
+        RingAppend(deadRing, &thread->arenaRing);
+      }
     }
   }
+  return count;
 }
 
 
 /* ThreadRingSuspend -- suspend all threads on a ring, except the
  * current one.
+ *
+ * .suspend.batch: The threads are suspended as one batch: all of them
+ * are signalled before waiting for any to acknowledge, so the latency
+ * is roughly that of one handshake rather than one per thread. See
+ * <design/pthreadext/#impl.batch>.
  */
 
-static Bool threadSuspend(Thread thread)
+static Bool threadSuspendAdd(Thread thread)
 {
-  /* .error.suspend: if PThreadextSuspend fails, we assume the thread
-   * has been terminated. */
-  Res res;
+  if (thread->safepoint)
+    return TRUE;        /* see safepointSuspend */
   AVER(thread->mfc == NULL);
-  res = PThreadextSuspend(&thread->thrextStruct, &thread->mfc);
-  AVER(res == ResOK);
+  PThreadextSuspendAdd(&thread->thrextStruct, &thread->mfc);
+  return TRUE;
+}
+
+static Bool threadSuspended(Thread thread)
+{
+  /* .error.suspend: if PThreadextSuspendWait didn't return a context,
+   * we assume the thread has been terminated. */
   AVER(thread->mfc != NULL);
   /* design.thread-manager.sol.thread.term.attempt */
-  return res == ResOK;
+  return thread->mfc != NULL;
 }
 
 
+/* ringSafepoint -- are the threads on a ring suspended cooperatively?
+ *
+ * All the threads registered with an arena are suspended in the same
+ * way, so it's enough to look at the first.
+ */
 
-void ThreadRingSuspend(Ring threadRing, Ring deadRing)
+static Bool ringSafepoint(Ring threadRing)
 {
-  mapThreadRing(threadRing, deadRing, threadSuspend);
+  return !RingIsSingle(threadRing)
+    && ThreadRingThread(RingNext(threadRing))->safepoint;
 }
 
 
-/* ThreadRingResume -- resume all threads on a ring (expect the current one) */
+/* safepointSuspend -- stop the threads on a ring at safepoints
+ *
+ * Asks each thread on the ring (except the current one) to stop at
+ * its next safepoint, and waits until they are all at one. A thread
+ * that is already in a safepoint region (for example, because it is
+ * waiting for the arena lock) needn't do anything. See
+ * <design/thread-manager/#safepoint.suspend>.
+ */
+
+static Count safepointSuspend(Ring threadRing)
+{
+  Ring node, next;
+  pthread_t self;
+  Bool waiting;
+  Count count = 0;
+  int status;
+
+  /* Another arena's collector may be waiting for this thread: it
+   * counts as stopped while it waits. See
+   * <design/thread-manager/#safepoint.deadlock>. */
+  ThreadSafepointEnter();
+
+  self = pthread_self();
+  status = pthread_mutex_lock(&safepointMut);
+  AVER(status == 0);
 
+  RING_FOR(node, threadRing, next) {
+    Thread thread = RING_ELT(Thread, arenaRing, node);
+    AVER(thread->safepoint);
+    if (!pthread_equal(self, thread->id)) { /* .thread.id */
+      AVER(!thread->suspendRequested);
+      thread->suspendRequested = TRUE;
+      ++count;
+    }
+  }
+
+  do {
+    waiting = FALSE;
+    RING_FOR(node, threadRing, next) {
+      Thread thread = RING_ELT(Thread, arenaRing, node);
+      if (thread->suspendRequested && thread->safepointDepth == 0) {
+        waiting = TRUE;
+        status = pthread_cond_wait(&safepointCond, &safepointMut);
+        AVER(status == 0);
+        break;
+      }
+    }
+  } while (waiting);
+
+  status = pthread_mutex_unlock(&safepointMut);
+  AVER(status == 0);
+  ThreadSafepointLeave();
+  return count;
+}
+
+
+/* safepointResume -- let the threads on a ring leave their safepoints */
+
+static Count safepointResume(Ring threadRing)
+{
+  Ring node, next;
+  Count count = 0;
+  int status;
+
+  status = pthread_mutex_lock(&safepointMut);
+  AVER(status == 0);
+  RING_FOR(node, threadRing, next) {
+    Thread thread = RING_ELT(Thread, arenaRing, node);
+    if (thread->suspendRequested) {
+      thread->suspendRequested = FALSE;
+      ++count;
+    }
+  }
+  status = pthread_cond_broadcast(&safepointCond);
+  AVER(status == 0);
+  status = pthread_mutex_unlock(&safepointMut);
+  AVER(status == 0);
+  return count;
+}
+
+
+void ThreadRingSuspend(Ring threadRing, Ring deadRing)
+{
+  Count threads, signalled;
+  Clock start, sent;
+
+  start = ClockNow();
+  if (ringSafepoint(threadRing)) {
+    /* The threads may take a while to reach safepoints, so don't
+     * hold up other arenas' batches while waiting for them. */
+    threads = safepointSuspend(threadRing);
+    sent = ClockNow();
+    if (threads > 0) {
+      Thread thread = ThreadRingThread(RingNext(threadRing));
+      EVENT5(ThreadSuspend, thread->arena, threads, 0, 0.0,
+             ((double)(sent - start) / (double)ClocksPerSec()));
+    }
+    return;
+  }
+
+  PThreadextSuspendBegin();
+  threads = mapThreadRing(threadRing, deadRing, threadSuspendAdd);
+  signalled = PThreadextSuspendSignal();
+  sent = ClockNow();
+  PThreadextSuspendWait();
+  (void)mapThreadRing(threadRing, deadRing, threadSuspended);
+
+  if (threads > 0 && !RingIsSingle(threadRing)) {
+    Thread thread = ThreadRingThread(RingNext(threadRing));
+    EVENT5(ThreadSuspend, thread->arena, threads, signalled,
+           ((double)(sent - start) / (double)ClocksPerSec()),
+           ((double)(ClockNow() - sent) / (double)ClocksPerSec()));
+  }
+}
+
+
+/* ThreadRingResume -- resume all threads on a ring (expect the current one)
+ *
+ * Resumption needs no handshake, so the threads are resumed in a
+ * single pass over the ring.
+ */
 
 static Bool threadResume(Thread thread)
 {
@@ -208,7 +399,21 @@ static Bool threadResume(Thread thread)
 
 void ThreadRingResume(Ring threadRing, Ring deadRing)
 {
-  mapThreadRing(threadRing, deadRing, threadResume);
+  Count threads;
+  Clock start;
+
+  start = ClockNow();
+  if (ringSafepoint(threadRing)) {
+    threads = safepointResume(threadRing);
+  } else {
+    threads = mapThreadRing(threadRing, deadRing, threadResume);
+  }
+
+  if (threads > 0 && !RingIsSingle(threadRing)) {
+    Thread thread = ThreadRingThread(RingNext(threadRing));
+    EVENT3(ThreadResume, thread->arena, threads,
+           ((double)(ClockNow() - start) / (double)ClocksPerSec()));
+  }
 }
 
 
@@ -236,6 +441,198 @@ Arena ThreadArena(Thread thread)
 }
 
 
+/* ThreadIsCurrent -- is the thread the current thread? */
+
+Bool ThreadIsCurrent(Thread thread)
+{
+  AVERT(Thread, thread);
+  return pthread_equal(pthread_self(), thread->id) != 0;
+}
+
+
+/* safepointEnter, safepointLeave, safepointRequested -- safepoint
+ * state of the current thread
+ *
+ * These operate on each of the current thread's descriptors in
+ * arenas with safepoints, and must be called with the mutex held.
+ * safepointEnter records the context of the thread, so that the
+ * collector can scan it without stopping the thread.
+ *
+ * .safepoint.context: The context is kept after the thread leaves
+ * the region. Another arena's collector may still be scanning it,
+ * and the thread doesn't return to the client program without
+ * passing a safepoint (which records its context afresh).
+ */
+
+/* safepointSave -- record the context of the current thread
+ *
+ * getcontext may return twice, so it is kept out of functions with
+ * local variables that matter. (Compilers don't inline functions
+ * that call it.)
+ */
+
+static void safepointSave(Thread thread)
+{
+  int status = getcontext(&thread->safepointUcontext);
+  AVER(status == 0);
+  UNUSED(status);
+}
+
+static Bool safepointEnter(pthread_t self)
+{
+  Ring node, next;
+  Thread first = NULL;
+
+  RING_FOR(node, &safepointRing, next) {
+    Thread thread = RING_ELT(Thread, safepointRing, node);
+    if (pthread_equal(self, thread->id)) {
+      if (thread->safepointDepth == 0) {
+        if (first == NULL) {
+          safepointSave(thread);
+          first = thread;
+        } else {
+          thread->safepointUcontext = first->safepointUcontext;
+        }
+        thread->mfc = &thread->safepointMFC;
+      }
+      ++thread->safepointDepth;
+    }
+  }
+  return first != NULL;
+}
+
+static void safepointLeave(pthread_t self)
+{
+  Ring node, next;
+
+  RING_FOR(node, &safepointRing, next) {
+    Thread thread = RING_ELT(Thread, safepointRing, node);
+    if (pthread_equal(self, thread->id) && thread->safepointDepth > 0)
+      --thread->safepointDepth;
+  }
+}
+
+static Bool safepointRequested(pthread_t self)
+{
+  Ring node, next;
+
+  RING_FOR(node, &safepointRing, next) {
+    Thread thread = RING_ELT(Thread, safepointRing, node);
+    if (pthread_equal(self, thread->id) && thread->suspendRequested)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+
+/* ThreadSafepointEnter/Leave -- the current thread is in a safepoint
+ * region
+ *
+ * While in a safepoint region, the thread counts as stopped: it must
+ * not touch references, nor return to the client program. Regions
+ * nest. Leaving a region doesn't wait for the collector, so the
+ * thread must reach a safepoint (see ThreadSafepoint) before it
+ * returns to the client program. See
+ * <design/thread-manager/#safepoint.region>.
+ *
+ * .safepoint.fast: The safepoint ring is tested without the mutex. A
+ * thread's own descriptors are added and removed by the thread
+ * itself, or while it is in a safepoint region, so this can't miss
+ * one.
+ */
+
+void ThreadSafepointEnter(void)
+{
+  pthread_t self;
+  int status;
+
+  if (RingIsSingle(&safepointRing)) /* .safepoint.fast */
+    return;
+
+  self = pthread_self();
+  status = pthread_mutex_lock(&safepointMut);
+  AVER(status == 0);
+  if (safepointEnter(self)) {
+    status = pthread_cond_broadcast(&safepointCond);
+    AVER(status == 0);
+  }
+  status = pthread_mutex_unlock(&safepointMut);
+  AVER(status == 0);
+}
+
+void ThreadSafepointLeave(void)
+{
+  int status;
+
+  if (RingIsSingle(&safepointRing)) /* .safepoint.fast */
+    return;
+
+  status = pthread_mutex_lock(&safepointMut);
+  AVER(status == 0);
+  safepointLeave(pthread_self());
+  status = pthread_mutex_unlock(&safepointMut);
+  AVER(status == 0);
+}
+
+
+/* ThreadSafepoint -- stop the current thread if the collector asks
+ *
+ * If the collector has asked any of the current thread's descriptors
+ * to stop, record its context and wait until the collector resumes
+ * it. See <design/thread-manager/#safepoint.poll>.
+ */
+
+void ThreadSafepoint(void)
+{
+  pthread_t self;
+  int status;
+
+  if (RingIsSingle(&safepointRing)) /* .safepoint.fast */
+    return;
+
+  self = pthread_self();
+  status = pthread_mutex_lock(&safepointMut);
+  AVER(status == 0);
+  if (safepointRequested(self)) {
+    (void)safepointEnter(self);
+    status = pthread_cond_broadcast(&safepointCond);
+    AVER(status == 0);
+    do {
+      status = pthread_cond_wait(&safepointCond, &safepointMut);
+      AVER(status == 0);
+    } while (safepointRequested(self));
+    safepointLeave(self);
+  }
+  status = pthread_mutex_unlock(&safepointMut);
+  AVER(status == 0);
+}
+
+
+/* ThreadSafepointPoll -- stop at a safepoint if the collector asks
+ *
+ * Reads the request flag without the mutex, so that polling is cheap
+ * when there's no request. A late request is seen at the next poll.
+ */
+
+void ThreadSafepointPoll(Thread thread)
+{
+  AVER(TESTT(Thread, thread));
+  AVER(pthread_equal(pthread_self(), thread->id));
+  if (thread->safepoint && *(volatile Bool *)&thread->suspendRequested)
+    ThreadSafepoint();
+}
+
+
+/* ThreadSafepointsEnable -- can an arena use safepoints? */
+
+Res ThreadSafepointsEnable(Arena arena)
+{
+  AVER(arena != NULL);
+  UNUSED(arena);
+  return ResOK;
+}
+
+
 /* ThreadScan -- scan the state of a thread (stack and regs) */
 
 Res ThreadScan(ScanState ss, Thread thread, Word *stackCold,
@@ -298,6 +695,8 @@ Res ThreadDescribe(Thread thread, mps_lib_FILE *stream, Count depth)
                (WriteFP)thread->arena, (WriteFU)thread->arena->serial,
                "  alive $S\n", WriteFYesNo(thread->alive),
                "  id $U\n",          (WriteFU)thread->id,
+               "  safepoint $S\n", WriteFYesNo(thread->safepoint),
+               "  safepointDepth $U\n", (WriteFU)thread->safepointDepth,
                "} Thread $P ($U)\n", (WriteFP)thread, (WriteFU)thread->serial,
                NULL);
   if(res != ResOK)
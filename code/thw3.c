@@ -218,6 +218,50 @@ Arena ThreadArena(Thread thread)
   return thread->arena;
 }
 
+/* ThreadIsCurrent -- is the thread the current thread? */
+
+Bool ThreadIsCurrent(Thread thread)
+{
+  AVERT(Thread, thread);
+  return GetCurrentThreadId() == thread->id; /* .thread.id */
+}
+
+
+/* ThreadSafepointsEnable etc. -- safepoints are not implemented
+ *
+ * Threads are suspended by SuspendThread, so an arena can't be created with
+ * MPS_KEY_ARENA_SAFEPOINTS, and the other functions are no-ops. See
+ * <design/thread-manager/#safepoint>.
+ */
+
+Res ThreadSafepointsEnable(Arena arena)
+{
+  AVER(arena != NULL);
+  UNUSED(arena);
+  return ResUNIMPL;
+}
+
+void ThreadSafepointEnter(void)
+{
+  NOOP;
+}
+
+void ThreadSafepointLeave(void)
+{
+  NOOP;
+}
+
+void ThreadSafepoint(void)
+{
+  NOOP;
+}
+
+void ThreadSafepointPoll(Thread thread)
+{
+  AVER(TESTT(Thread, thread));
+  UNUSED(thread);
+}
+
 Res ThreadDescribe(Thread thread, mps_lib_FILE *stream, Count depth)
 {
   Res res;
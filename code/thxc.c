@@ -205,6 +205,55 @@ Arena ThreadArena(Thread thread)
 }
 
 
+/* ThreadIsCurrent -- is the thread the current thread? */
+
+Bool ThreadIsCurrent(Thread thread)
+{
+  mach_port_t self;
+
+  AVERT(Thread, thread);
+  self = mach_thread_self();
+  AVER(MACH_PORT_VALID(self));
+  return thread->port == self;
+}
+
+
+/* ThreadSafepointsEnable etc. -- safepoints are not implemented
+ *
+ * Threads are suspended by thread_suspend, so an arena can't be created with
+ * MPS_KEY_ARENA_SAFEPOINTS, and the other functions are no-ops. See
+ * <design/thread-manager/#safepoint>.
+ */
+
+Res ThreadSafepointsEnable(Arena arena)
+{
+  AVER(arena != NULL);
+  UNUSED(arena);
+  return ResUNIMPL;
+}
+
+void ThreadSafepointEnter(void)
+{
+  NOOP;
+}
+
+void ThreadSafepointLeave(void)
+{
+  NOOP;
+}
+
+void ThreadSafepoint(void)
+{
+  NOOP;
+}
+
+void ThreadSafepointPoll(Thread thread)
+{
+  AVER(TESTT(Thread, thread));
+  UNUSED(thread);
+}
+
+
 /* ThreadScan -- scan the state of a thread (stack and regs) */
 
 #include "prmcxc.h"
@@ -44,13 +44,19 @@ Bool ScanStateCheck(ScanState ss)
   TRACE_SET_ITER(ti, trace, ss->traces, ss->arena)
     white = ZoneSetUnion(white, ss->arena->trace[ti].white);
   TRACE_SET_ITER_END(ti, trace, ss->traces, ss->arena);
-  CHECKL(ScanStateWhite(ss) == white);
+  /* The white set is empty when scanning dirty cards only to find a
+     summary: see <design/write-barrier/#card.harvest>. */
+  CHECKL(ScanStateWhite(ss) == white
+         || ScanStateWhite(ss) == ZoneSetEMPTY);
   CHECKU(Arena, ss->arena);
   /* Summaries could be anything, and can't be checked. */
+  CHECKL(ss->node == LocusNodeANY || ss->node < ss->arena->nodes);
   CHECKL(TraceSetCheck(ss->traces));
   CHECKL(TraceSetSuper(ss->arena->busyTraces, ss->traces));
   CHECKL(RankCheck(ss->rank));
   CHECKL(BoolCheck(ss->wasMarked));
+  if (ss->fixLock != NULL)
+    CHECKL(LockCheck(ss->fixLock));
   /* @@@@ checks for counts missing */
   return TRUE;
 }
@@ -96,6 +102,8 @@ void ScanStateInit(ScanState ss, TraceSet ts, Arena arena,
   ScanStateSetZoneShift(ss, arena->zoneShift);
   ScanStateSetUnfixedSummary(ss, RefSetEMPTY);
   ss->fixedSummary = RefSetEMPTY;
+  ss->fixLock = NULL;
+  ss->node = LocusNodeANY;
   ss->arena = arena;
   ss->wasMarked = TRUE;
   ScanStateSetWhite(ss, white);
@@ -116,6 +124,21 @@ void ScanStateInit(ScanState ss, TraceSet ts, Arena arena,
 }
 
 
+/* scanStateSetSeg -- note the segment that a scan state will scan
+ *
+ * In an arena with more than one node, objects are copied to the node
+ * of the segment that refers to them.  See <design/arena/#numa.copy>.
+ */
+
+static void scanStateSetSeg(ScanState ss, Seg seg)
+{
+  Arena arena = ss->arena;
+
+  if (ArenaNodes(arena) > 1)
+    ss->node = ArenaNodeOfAddr(arena, SegBase(seg));
+}
+
+
 /* ScanStateFinish -- Finish a ScanState object */
 
 void ScanStateFinish(ScanState ss)
@@ -435,7 +458,12 @@ Res TraceCondemnZones(Trace trace, ZoneSet condemnedSet)
       /* the requested zone set.  Otherwise, we would bloat the */
       /* foundation to no gain.  Note that this doesn't exclude */
       /* any segments from which the condemned set was derived, */
+
+      /* Segments that are already white for another trace are left */
+      /* alone, so that the white sets of concurrent traces are */
+      /* disjoint.  See <design/trace/#instance.white.disjoint>. */
       if(PoolHasAttr(SegPool(seg), AttrGC)
+         && SegWhite(seg) == TraceSetEMPTY
          && ZoneSetSuper(condemnedSet, ZoneSetOfSeg(arena, seg)))
       {
         res = TraceAddWhite(trace, seg);
@@ -521,14 +549,141 @@ static Res traceScanRoot(TraceSet ts, Rank rank, Arena arena, Root root)
 }
 
 
+/* traceScanRootChunkRes -- scan a chunk of a root, with result code */
+
+static Res traceScanRootChunkRes(Trace trace, Root root, Index chunk)
+{
+  Arena arena = trace->arena;
+  TraceSet ts = TraceSetSingle(trace);
+  ScanStateStruct ss;
+  Res res;
+
+  ScanStateInit(&ss, ts, arena, RootRank(root),
+                traceSetWhiteUnion(ts, arena));
+  res = RootScanChunk(&ss, root, chunk);
+  traceSetUpdateCounts(ts, arena, &ss, traceAccountingPhaseRootScan);
+  ScanStateFinish(&ss);
+  return res;
+}
+
+
+/* TraceScanRootChunk -- scan a chunk of a root after the flip
+ *
+ * The mutator is suspended while the chunk is exposed.  Enters
+ * emergency mode on allocation failure.  See
+ * <design/root/#incremental.scan>.
+ */
+
+Res TraceScanRootChunk(Trace trace, Root root, Index chunk)
+{
+  Arena arena;
+  Res res;
+
+  AVERT(Trace, trace);
+  AVERT(Root, root);
+  AVER(trace->state == TraceFLIPPED);
+  arena = trace->arena;
+
+  ShieldHold(arena);
+  res = traceScanRootChunkRes(trace, root, chunk);
+  if (ResIsAllocFailure(res)) {
+    ArenaSetEmergency(arena, TRUE);
+    res = traceScanRootChunkRes(trace, root, chunk);
+    /* Should be OK in emergency mode */
+    AVER(!ResIsAllocFailure(res));
+  }
+  ShieldRelease(arena);
+
+  return res;
+}
+
+
+/* traceParallelRootStruct -- one thread root of a parallel batch
+ *
+ * See <design/trace/#parallel.flip>.
+ */
+
+typedef struct traceParallelRootStruct {
+  Root root;                    /* root to scan */
+  Res res;                      /* result of RootScanParallel */
+  ScanStateStruct ssStruct;     /* scan state private to this root */
+} traceParallelRootStruct, *traceParallelRoot;
+
+
 /* traceFlip -- blacken the mutator */
 
 struct rootFlipClosureStruct {
+  Trace trace;
   TraceSet ts;
   Arena arena;
   Rank rank;
+  traceParallelRoot batch;      /* thread roots to scan in parallel, or NULL */
+  Count count;                  /* number of roots in batch */
 };
 
+
+/* traceParallelRootJob -- scan one thread root of a batch on any thread */
+
+static void traceParallelRootJob(void *closure, Index i)
+{
+  traceParallelRoot scan = &((traceParallelRoot)closure)[i];
+
+  scan->res = RootScanParallel(&scan->ssStruct, scan->root);
+}
+
+
+/* traceScanRootsParallel -- scan the batch of thread roots in parallel
+ *
+ * The stacks and registers of the suspended threads are scanned on the
+ * collector threads, each with its own scan state.  Everything else is
+ * done on this thread, as in traceScanRootRes.  A root whose scan
+ * failed is scanned again serially, which switches to emergency mode
+ * if necessary.
+ */
+
+static Res traceScanRootsParallel(struct rootFlipClosureStruct *rf)
+{
+  Arena arena = rf->arena;
+  ZoneSet white;
+  Index i;
+  Res res = ResOK;
+
+  if (rf->count == 0)
+    return ResOK;
+
+  if (rf->count == 1) {
+    /* Not worth waking the collector threads. */
+    rf->count = 0;
+    return traceScanRoot(rf->ts, rf->rank, arena, rf->batch[0].root);
+  }
+
+  white = traceSetWhiteUnion(rf->ts, arena);
+  for (i = 0; i < rf->count; ++i) {
+    ScanState ss = &rf->batch[i].ssStruct;
+    ScanStateInit(ss, rf->ts, arena, rf->rank, white);
+    ss->fixLock = arena->fixLock;
+  }
+
+  WorkersRun(arena->workers, traceParallelRootJob, rf->batch, rf->count);
+
+  for (i = 0; i < rf->count; ++i) {
+    Root root = rf->batch[i].root;
+    ScanState ss = &rf->batch[i].ssStruct;
+    Res scanRes = rf->batch[i].res;
+
+    ss->fixLock = NULL;
+    if (scanRes == ResOK)
+      RootBlacken(ss, root);
+    traceSetUpdateCounts(rf->ts, arena, ss, traceAccountingPhaseRootScan);
+    ScanStateFinish(ss);
+    if (scanRes != ResOK && res == ResOK)
+      res = traceScanRoot(rf->ts, rf->rank, arena, root);
+  }
+
+  rf->count = 0;
+  return res;
+}
+
 static Res rootFlip(Root root, void *p)
 {
   struct rootFlipClosureStruct *rf = (struct rootFlipClosureStruct *)p;
@@ -543,6 +698,17 @@ static Res rootFlip(Root root, void *p)
   AVER(RootRank(root) <= RankEXACT); /* see .root.rank */
 
   if(RootRank(root) == rf->rank) {
+    /* <design/root/#incremental.flip> */
+    if (RootDefer(root, rf->trace))
+      return ResOK;
+    /* <design/trace/#parallel.flip> */
+    if (rf->batch != NULL && RootParallelScan(root, rf->ts)) {
+      rf->batch[rf->count].root = root;
+      ++rf->count;
+      if (rf->count == TRACE_PARALLEL_BATCH)
+        return traceScanRootsParallel(rf);
+      return ResOK;
+    }
     res = traceScanRoot(rf->ts, rf->rank, rf->arena, root);
     if (res != ResOK)
       return res;
@@ -560,12 +726,13 @@ static Res rootFlip(Root root, void *p)
  * is happening, and the mutator perceives an instantaneous change in all
  * the references, enforced by the shield (barrier) system.
  *
- * NOTE: We don't have a way to shield the roots, so they are all scanned
- * here.  This is a coincidence.  There is no theoretical reason that the
- * roots have to be scanned at flip time, provided we could protect them
- * from the mutator.  (The thread registers are unlikely ever to be
- * protectable on stock hardware, however, as they were -- kind of -- on
- * Lisp machines.)
+ * NOTE: Most roots can't be shielded, so they are scanned here.  There
+ * is no theoretical reason that the roots have to be scanned at flip
+ * time, provided we can protect them from the mutator, and large exact
+ * protectable area roots are protected and scanned afterwards: see
+ * <design/root/#incremental>.  (The thread registers are unlikely ever
+ * to be protectable on stock hardware, however, as they were -- kind
+ * of -- on Lisp machines.)
  *
  * NOTE: Ambiguous references may only exist in roots, because we can't
  * shield the exact roots and defer them for later scanning (after ambiguous
@@ -584,13 +751,17 @@ static Res traceFlip(Trace trace)
   Arena arena;
   Rank rank;
   struct rootFlipClosureStruct rfc;
+  traceParallelRootStruct batch[TRACE_PARALLEL_BATCH];
   Res res;
 
   AVERT(Trace, trace);
+  rfc.trace = trace;
   rfc.ts = TraceSetSingle(trace);
 
   arena = trace->arena;
   rfc.arena = arena;
+  rfc.batch = arena->workers != NULL ? batch : NULL;
+  rfc.count = 0;
   ShieldHold(arena);
 
   AVER(trace->state == TraceUNFLIPPED);
@@ -616,6 +787,8 @@ static Res traceFlip(Trace trace)
   for(rank = RankMIN; rank <= RankEXACT; ++rank) {
     rfc.rank = rank;
     res = RootsIterate(ArenaGlobals(arena), rootFlip, (void *)&rfc);
+    if (res == ResOK)
+      res = traceScanRootsParallel(&rfc);
     if (res != ResOK)
       goto failRootFlip;
   }
@@ -721,6 +894,7 @@ found:
   trace->notCondemned = (Size)0;
   trace->foundation = (Size)0;  /* nothing grey yet */
   trace->quantumWork = (Work)0; /* computed in TraceStart */
+  trace->pauseMax = (Clock)0;
   STATISTIC(trace->greySegCount = (Count)0);
   STATISTIC(trace->greySegMax = (Count)0);
   STATISTIC(trace->rootScanCount = (Count)0);
@@ -745,6 +919,8 @@ found:
   trace->preservedInPlaceSize = (Size)0;  /* see .message.data */
   STATISTIC(trace->reclaimCount = (Count)0);
   STATISTIC(trace->reclaimSize = (Size)0);
+  STATISTIC(trace->nailedSegSize = (Size)0);
+  STATISTIC(trace->nailedFreedSize = (Size)0);
   trace->sig = TraceSig;
   arena->busyTraces = TraceSetAdd(arena->busyTraces, trace);
   AVERT(Trace, trace);
@@ -793,8 +969,11 @@ void TraceDestroyInit(Trace trace)
   trace->sig = SigInvalid;
   trace->arena->busyTraces = TraceSetDel(trace->arena->busyTraces, trace);
 
-  /* Clear the emergency flag so the next trace starts normally. */
-  ArenaSetEmergency(trace->arena, FALSE);
+  /* Clear the emergency flag so the next trace starts normally, unless
+   * another trace is still running, in which case the emergency
+   * belongs to that trace. */
+  if (trace->arena->busyTraces == TraceSetEMPTY)
+    ArenaSetEmergency(trace->arena, FALSE);
 }
 
 
@@ -843,6 +1022,8 @@ void TraceDestroyFinished(Trace trace)
                     trace->preservedInPlaceSize));
   STATISTIC(EVENT3(TraceStatReclaim, trace,
                    trace->reclaimCount, trace->reclaimSize));
+  STATISTIC(EVENT3(TraceStatNailed, trace,
+                   trace->nailedSegSize, trace->nailedFreedSize));
 
   EVENT1(TraceDestroy, trace);
 
@@ -919,8 +1100,8 @@ static void traceReclaim(Trace trace)
 
 /* TraceRankForAccess -- Returns rank to scan at if we hit a barrier.
  * 
- * We assume a single trace as otherwise we need to implement rank
- * filters on scanning.
+ * Each trace is in its own band, so this is computed per trace and
+ * each trace is scanned separately when we hit a barrier.
  *
  * .scan.conservative: It's safe to scan at EXACT unless the band is
  * WEAK and in that case the segment should be weak.
@@ -944,28 +1125,22 @@ static void traceReclaim(Trace trace)
  * See the message <http://info.ravenbrook.com/mail/2012/08/30/16-46-42/0.txt>
  * for a description of these semantics.
  */
-Rank TraceRankForAccess(Arena arena, Seg seg)
+Rank TraceRankForAccess(Trace trace, Seg seg)
 {
-  TraceSet ts;
-  Trace trace;
-  TraceId ti;
   Rank band;
   RankSet rankSet;
 
-  AVERT(Arena, arena);
+  AVERT(Trace, trace);
   AVERT(Seg, seg);
+  AVER(TraceSetIsMember(trace->arena->flippedTraces, trace));
 
-  band = RankLIMIT; /* initialize with invalid rank */
-  ts = arena->flippedTraces;    
-  AVER(TraceSetIsSingle(ts));
-  TRACE_SET_ITER(ti, trace, ts, arena)
-    band = traceBand(trace);
-  TRACE_SET_ITER_END(ti, trace, ts, arena);
+  band = traceBand(trace);
   rankSet = SegRankSet(seg);
   switch(band) {
   case RankAMBIG:
-    NOTREACHED;
-    break;
+    /* The trace has flipped but hasn't yet looked for grey segments */
+    /* (see traceFindGrey), so it is about to enter the EXACT band. */
+    /* falls through */
   case RankEXACT:
     return RankEXACT;
   case RankFINAL:
@@ -1122,6 +1297,90 @@ RefSet ScanStateSummary(ScanState ss)
 }
 
 
+/* traceScanSegUpdate -- update a segment and traces after scanning it
+ *
+ * Accumulates the counts from the scan state into the traces, and
+ * updates the segment's summary and write barrier deferral.  Finishes
+ * the scan state.  The segment remains grey: see traceScanSegRes.
+ */
+
+static void traceScanSegUpdate(TraceSet ts, Arena arena, Seg seg,
+                               ScanState ss, Res res, Bool wasTotal)
+{
+  ZoneSet white = ScanStateWhite(ss);
+  RefSet summary;
+
+  traceSetUpdateCounts(ts, arena, ss, traceAccountingPhaseSegScan);
+  /* Count segments scanned pointlessly */
+  STATISTIC({
+    TraceId ti; Trace trace;
+    Count whiteSegRefCount = 0;
+
+    TRACE_SET_ITER(ti, trace, ts, arena)
+      whiteSegRefCount += trace->whiteSegRefCount;
+    TRACE_SET_ITER_END(ti, trace, ts, arena);
+    if(whiteSegRefCount == 0)
+      TRACE_SET_ITER(ti, trace, ts, arena)
+        ++trace->pointlessScanCount;
+      TRACE_SET_ITER_END(ti, trace, ts, arena);
+  });
+
+  /* Following is true whether or not scan was total. */
+  /* See <design/scan/#summary.subset>. */
+  /* .verify.segsummary: were the seg contents, as found by this 
+   * scan, consistent with the recorded SegSummary?
+   */
+  AVER(RefSetSub(ScanStateUnfixedSummary(ss), SegSummary(seg)));
+
+  /* Write barrier deferral -- see design.mps.write-barrier.deferral. */
+  /* Did the segment refer to the white set? */
+  if (ZoneSetInter(ScanStateUnfixedSummary(ss), white) == ZoneSetEMPTY) {
+    /* Boring scan.  One step closer to raising the write barrier. */
+    if (seg->defer > 0)
+      --seg->defer;
+  } else {
+    /* Interesting scan. Defer raising the write barrier. */
+    if (seg->defer < WB_DEFER_DELAY)
+      seg->defer = WB_DEFER_DELAY;
+  }
+
+  /* Only apply the write barrier if it is not deferred.  With card
+     marking, applying it costs nothing, so it is never deferred.  See
+     <design/write-barrier/#card.deferral>. */
+  if (seg->defer == 0 || ArenaCardMarking(arena)) {
+    /* If we scanned every reference in the segment then we have a
+       complete summary we can set. Otherwise, we just have
+       information about more zones that the segment refers to. */
+    if (res == ResOK && wasTotal)
+      summary = ScanStateSummary(ss);
+    else
+      summary = RefSetUnion(SegSummary(seg), ScanStateSummary(ss));
+  } else {
+    summary = RefSetUNIV;
+  }
+  SegSetSummary(seg, summary);
+
+  ScanStateFinish(ss);
+}
+
+
+/* traceScanSegCards -- prepare to scan a segment with dirty cards
+ *
+ * The client may have stored references in the segment since its
+ * summary was last brought up to date from the card table, so make
+ * the summary universal before scanning it.  The scan then computes
+ * a summary that includes those references.  The cards are left
+ * dirty for the next harvest.  See <design/write-barrier/#card.scan>.
+ */
+
+static void traceScanSegCards(Arena arena, Seg seg)
+{
+  if (ArenaCardMarking(arena)
+      && CardsRangeDirty(arena, SegBase(seg), SegLimit(seg)))
+    SegSetSummary(seg, RefSetUNIV);
+}
+
+
 /* traceScanSegRes -- scan a segment to remove greyness
  *
  * @@@@ During scanning, the segment should be write-shielded to prevent
@@ -1134,7 +1393,6 @@ static Res traceScanSegRes(TraceSet ts, Rank rank, Arena arena, Seg seg)
   Bool wasTotal;
   ZoneSet white;
   Res res;
-  RefSet summary;
 
   /* The reason for scanning a segment is that it's grey. */
   AVER(TraceSetInter(ts, SegGrey(seg)) != TraceSetEMPTY);
@@ -1150,7 +1408,9 @@ static Res traceScanSegRes(TraceSet ts, Rank rank, Arena arena, Seg seg)
   } else {      /* scan it */
     ScanStateStruct ssStruct;
     ScanState ss = &ssStruct;
+    traceScanSegCards(arena, seg);
     ScanStateInit(ss, ts, arena, rank, white);
+    scanStateSetSeg(ss, seg);
 
     /* Expose the segment to make sure we can scan it. */
     ShieldExpose(arena, seg);
@@ -1158,55 +1418,7 @@ static Res traceScanSegRes(TraceSet ts, Rank rank, Arena arena, Seg seg)
     /* Cover, regardless of result */
     ShieldCover(arena, seg);
 
-    traceSetUpdateCounts(ts, arena, ss, traceAccountingPhaseSegScan);
-    /* Count segments scanned pointlessly */
-    STATISTIC({
-      TraceId ti; Trace trace;
-      Count whiteSegRefCount = 0;
-
-      TRACE_SET_ITER(ti, trace, ts, arena)
-        whiteSegRefCount += trace->whiteSegRefCount;
-      TRACE_SET_ITER_END(ti, trace, ts, arena);
-      if(whiteSegRefCount == 0)
-        TRACE_SET_ITER(ti, trace, ts, arena)
-          ++trace->pointlessScanCount;
-        TRACE_SET_ITER_END(ti, trace, ts, arena);
-    });
-
-    /* Following is true whether or not scan was total. */
-    /* See <design/scan/#summary.subset>. */
-    /* .verify.segsummary: were the seg contents, as found by this 
-     * scan, consistent with the recorded SegSummary?
-     */
-    AVER(RefSetSub(ScanStateUnfixedSummary(ss), SegSummary(seg)));
-
-    /* Write barrier deferral -- see design.mps.write-barrier.deferral. */
-    /* Did the segment refer to the white set? */
-    if (ZoneSetInter(ScanStateUnfixedSummary(ss), white) == ZoneSetEMPTY) {
-      /* Boring scan.  One step closer to raising the write barrier. */
-      if (seg->defer > 0)
-        --seg->defer;
-    } else {
-      /* Interesting scan. Defer raising the write barrier. */
-      if (seg->defer < WB_DEFER_DELAY)
-        seg->defer = WB_DEFER_DELAY;
-    }
-
-    /* Only apply the write barrier if it is not deferred. */
-    if (seg->defer == 0) {
-      /* If we scanned every reference in the segment then we have a
-         complete summary we can set. Otherwise, we just have
-         information about more zones that the segment refers to. */
-      if (res == ResOK && wasTotal)
-        summary = ScanStateSummary(ss);
-      else
-        summary = RefSetUnion(SegSummary(seg), ScanStateSummary(ss));
-    } else {
-      summary = RefSetUNIV;
-    }
-    SegSetSummary(seg, summary);
-
-    ScanStateFinish(ss);
+    traceScanSegUpdate(ts, arena, seg, ss, res, wasTotal);
   }
 
   if(res == ResOK) {
@@ -1241,6 +1453,128 @@ static Res traceScanSeg(TraceSet ts, Rank rank, Arena arena, Seg seg)
 }
 
 
+/* traceParallelScanStruct -- one segment of a parallel batch
+ *
+ * See <design/trace/#parallel>.
+ */
+
+typedef struct traceParallelScanStruct {
+  Seg seg;                      /* segment to scan */
+  Bool wasTotal;                /* did the scan cover the whole segment? */
+  Res res;                      /* result of PoolScan */
+  ScanStateStruct ssStruct;     /* scan state private to this segment */
+} traceParallelScanStruct, *traceParallelScan;
+
+
+/* traceParallelScanSeg -- may a grey segment be scanned in parallel?
+ *
+ * The pool's scan method must be safe to run on a collector thread
+ * (see <design/trace/#parallel.pool>), and the segment must refer to
+ * the white set, since otherwise traceScanSegRes only blackens it.
+ */
+
+static Bool traceParallelScanSeg(Trace trace, Seg seg)
+{
+  return PoolHasAttr(SegPool(seg), AttrPARSCAN)
+    && ZoneSetInter(trace->white, SegSummary(seg)) != ZoneSetEMPTY;
+}
+
+
+/* traceParallelScanJob -- scan one segment of a batch on any thread */
+
+static void traceParallelScanJob(void *closure, Index i)
+{
+  traceParallelScan scan = &((traceParallelScan)closure)[i];
+
+  scan->res = PoolScan(&scan->wasTotal, &scan->ssStruct,
+                       SegPool(scan->seg), scan->seg);
+}
+
+
+/* traceScanSegsParallel -- scan a batch of grey segments in parallel
+ *
+ * Gathers up to TRACE_PARALLEL_BATCH grey segments of the rank being
+ * scanned, starting with first, and scans them on the collector
+ * threads, each with its own scan state.  Everything other than the
+ * scan itself (exposing, covering, summaries, greyness, and counts) is
+ * done on this thread, in the same way as traceScanSegRes.  Segments
+ * whose scan failed are made grey again and scanned serially, which
+ * switches to emergency mode if necessary.
+ */
+
+static void traceScanSegsParallel(Trace trace, Rank rank, Seg first)
+{
+  traceParallelScanStruct scans[TRACE_PARALLEL_BATCH];
+  Arena arena = trace->arena;
+  TraceSet ts = TraceSetSingle(trace);
+  ZoneSet white;
+  Count count;
+  Index i;
+  Ring node, nextNode;
+  Res res;
+
+  AVER(arena->workers != NULL);
+  AVER(traceParallelScanSeg(trace, first));
+
+  scans[0].seg = first;
+  count = 1;
+  RING_FOR(node, ArenaGreyRing(arena, rank), nextNode) {
+    Seg seg = SegOfGreyRing(node);
+    if (count == TRACE_PARALLEL_BATCH)
+      break;
+    if (seg != first && TraceSetIsMember(SegGrey(seg), trace)
+        && traceParallelScanSeg(trace, seg)) {
+      scans[count].seg = seg;
+      ++count;
+    }
+  }
+
+  if (count == 1) {
+    /* Not worth waking the collector threads. */
+    res = traceScanSeg(ts, rank, arena, first);
+    AVER(res == ResOK);
+    return;
+  }
+
+  /* Suspend the mutator now, so that a collector thread never has to:
+     see <design/trace/#parallel.shield>. */
+  ShieldHold(arena);
+
+  white = traceSetWhiteUnion(ts, arena);
+  for (i = 0; i < count; ++i) {
+    Seg seg = scans[i].seg;
+    ScanState ss = &scans[i].ssStruct;
+    EVENT4(TraceScanSeg, ts, rank, arena, seg);
+    traceScanSegCards(arena, seg);
+    ScanStateInit(ss, ts, arena, rank, white);
+    scanStateSetSeg(ss, seg);
+    ss->fixLock = arena->fixLock;
+    ShieldExpose(arena, seg);
+    /* <design/trace/#parallel.grey> */
+    SegSetGrey(seg, TraceSetDiff(SegGrey(seg), ts));
+  }
+
+  WorkersRun(arena->workers, traceParallelScanJob, scans, count);
+
+  for (i = 0; i < count; ++i) {
+    Seg seg = scans[i].seg;
+    ScanState ss = &scans[i].ssStruct;
+    Res scanRes = scans[i].res;
+
+    ShieldCover(arena, seg);
+    ss->fixLock = NULL;
+    traceScanSegUpdate(ts, arena, seg, ss, scanRes, scans[i].wasTotal);
+    if (scanRes != ResOK) {
+      SegSetGrey(seg, TraceSetUnion(SegGrey(seg), ts));
+      res = traceScanSeg(ts, rank, arena, seg);
+      AVER(res == ResOK);
+    }
+  }
+
+  ShieldRelease(arena);
+}
+
+
 /* TraceSegAccess -- handle barrier hit on a segment */
 
 void TraceSegAccess(Arena arena, Seg seg, AccessSet mode)
@@ -1274,20 +1608,25 @@ void TraceSegAccess(Arena arena, Seg seg, AccessSet mode)
     seg->defer = WB_DEFER_HIT;
 
   if (readHit) {
-    Rank rank;
     TraceSet traces;
+    TraceId ti;
+    Trace trace;
 
     AVER(SegRankSet(seg) != RankSetEMPTY);
     
     /* Pick set of traces to scan for: */
-    traces = arena->flippedTraces;
-    rank = TraceRankForAccess(arena, seg);
-    res = traceScanSeg(traces, rank, arena, seg);      
+    traces = TraceSetInter(SegGrey(seg), arena->flippedTraces);
 
-    /* Allocation failures should be handled my emergency mode, and we don't
-       expect any other kind of failure in a normal GC that causes access
-       faults. */
-    AVER(res == ResOK);
+    /* Scan for each trace separately, at its own rank. */
+    TRACE_SET_ITER(ti, trace, traces, arena)
+      res = traceScanSeg(TraceSetSingle(trace), TraceRankForAccess(trace, seg),
+                         arena, seg);
+
+      /* Allocation failures should be handled my emergency mode, and we
+         don't expect any other kind of failure in a normal GC that
+         causes access faults. */
+      AVER(res == ResOK);
+    TRACE_SET_ITER_END(ti, trace, traces, arena);
 
     /* The pool should've done the job of removing the greyness that */
     /* was causing the segment to be protected, so that the mutator */
@@ -1295,8 +1634,6 @@ void TraceSegAccess(Arena arena, Seg seg, AccessSet mode)
     AVER(TraceSetInter(SegGrey(seg), traces) == TraceSetEMPTY);
 
     STATISTIC({
-      Trace trace;
-      TraceId ti;
       TRACE_SET_ITER(ti, trace, traces, arena)
         ++trace->readBarrierHitCount;
       TRACE_SET_ITER_END(ti, trace, traces, arena);
@@ -1315,6 +1652,27 @@ void TraceSegAccess(Arena arena, Seg seg, AccessSet mode)
 }
 
 
+/* traceFixLocked -- fix a reference during a parallel scan
+ *
+ * See <design/trace/#parallel.fix>.  The fix lock is removed from the
+ * scan state while it is held, so that the nested call to _mps_fix2
+ * takes the ordinary path.
+ */
+
+static mps_res_t traceFixLocked(ScanState ss, mps_addr_t *mps_ref_io)
+{
+  Lock lock = ss->fixLock;
+  mps_res_t res;
+
+  LockClaim(lock);
+  ss->fixLock = NULL;
+  res = _mps_fix2(&ss->ss_s, mps_ref_io);
+  ss->fixLock = lock;
+  LockRelease(lock);
+  return res;
+}
+
+
 /* _mps_fix2 (a.k.a. "TraceFix") -- second stage of fixing a reference
  *
  * _mps_fix2 is on the [critical path](../design/critical-path.txt).  A
@@ -1344,6 +1702,9 @@ mps_res_t _mps_fix2(mps_ss_t mps_ss, mps_addr_t *mps_ref_io)
   AVERT_CRITICAL(ScanState, ss);
   AVER_CRITICAL(mps_ref_io != NULL);
 
+  if (ss->fixLock != NULL)
+    return traceFixLocked(ss, mps_ref_io);
+
   ref = (Ref)*mps_ref_io;
 
   /* The zone test should already have been passed by MPS_FIX1 in mps.h. */
@@ -1360,10 +1721,9 @@ mps_res_t _mps_fix2(mps_ss_t mps_ss, mps_addr_t *mps_ref_io)
    * check the rank in the latter case. See
    * <design/trace/#fix.tractofaddr.inline>
    *
-   * If compilers fail to do a good job of inlining ChunkOfAddr and
-   * TreeFind then it may become necessary to inline at least the
-   * comparison against the root of the tree. See
-   * <https://info.ravenbrook.com/mail/2014/06/11/13-32-08/0/>
+   * ChunkOfAddr usually finds the chunk in the arena's chunk map,
+   * without searching the tree of chunks: see
+   * <design/arena/#chunk.map>.
    */
   if (!ChunkOfAddr(&chunk, ss->arena, ref))
     /* Reference points outside MPS-managed address space: ignore. */
@@ -1443,6 +1803,7 @@ static Res traceScanSingleRefRes(TraceSet ts, Rank rank, Arena arena,
   }
 
   ScanStateInit(&ss, ts, arena, rank, white);
+  scanStateSetSeg(&ss, seg);
   ShieldExpose(arena, seg);
 
   TRACE_SCAN_BEGIN(&ss) {
@@ -1619,6 +1980,63 @@ static Res rootGrey(Root root, void *p)
 }
 
 
+/* traceHarvestCards -- bring segment summaries up to date from the
+ * card table
+ *
+ * For each segment with references and dirty cards, scan the objects
+ * that overlap the dirty cards (with an empty white set, so nothing
+ * is fixed) and add what they refer to to the segment's summary.
+ * Where that isn't possible, make the summary universal.  Then clean
+ * all the cards.  See <design/write-barrier/#card.harvest>.
+ */
+
+static void traceHarvestCards(Trace trace)
+{
+  Arena arena = trace->arena;
+  Seg seg;
+
+  AVER(ArenaCardMarking(arena));
+
+  /* .harvest.suspend: The mutator must not store into a segment
+     between the segment being scanned and the cards being cleaned.
+     It remains suspended until after the flip, so it also can't
+     store into a segment that the grey set has already passed over.
+     See <design/write-barrier/#card.suspend>. */
+  ShieldHold(arena);
+
+  if (SegFirst(&seg, arena)) {
+    do {
+      RefSet summary = SegSummary(seg);
+      if (SegRankSet(seg) != RankSetEMPTY && summary != RefSetUNIV
+          && CardsRangeDirty(arena, SegBase(seg), SegLimit(seg))) {
+        Res res = ResUNIMPL;
+        /* A segment that is white for a flipped trace may contain
+           forwarded objects, so it can't be scanned. */
+        if (TraceSetInter(SegWhite(seg), arena->flippedTraces)
+            == TraceSetEMPTY) {
+          ScanStateStruct ssStruct;
+          ScanState ss = &ssStruct;
+          ScanStateInit(ss, TraceSetSingle(trace), arena, RankEXACT,
+                        ZoneSetEMPTY);
+          ShieldExpose(arena, seg);
+          res = PoolScanCards(ss, SegPool(seg), seg);
+          ShieldCover(arena, seg);
+          if (res == ResOK)
+            summary = RefSetUnion(summary, ScanStateSummary(ss));
+          ScanStateFinish(ss);
+        }
+        if (res != ResOK)
+          summary = RefSetUNIV;
+        SegSetSummary(seg, summary);
+      }
+    } while (SegNext(&seg, arena, seg));
+  }
+
+  CardsClear(arena);
+  ShieldRelease(arena);
+}
+
+
 /* TraceStart -- start a trace whose white set has been established
  *
  * The main job of TraceStart is to set up the grey list for a trace.  The
@@ -1643,6 +2061,10 @@ Res TraceStart(Trace trace, double mortality, double finishingTime)
   AVER(trace->condemned > 0);
 
   arena = trace->arena;
+
+  /* <design/write-barrier/#card.harvest> */
+  if (ArenaCardMarking(arena))
+    traceHarvestCards(trace);
   
   /* From the already set up white set, derive a grey set. */
 
@@ -1749,13 +2171,25 @@ void TraceAdvance(Trace trace)
   case TraceFLIPPED: {
     Seg seg;
     Rank rank;
-
-    if (traceFindGrey(&seg, &rank, arena, trace->ti)) {
-      Res res;
-      res = traceScanSeg(TraceSetSingle(trace), rank, arena, seg);
-      /* Allocation failures should be handled by emergency mode, and we
-       * don't expect any other error in a normal GC trace. */
+    Root root;
+    Index chunk;
+
+    /* Roots deferred at the flip are scanned first, while the trace
+       is still in the exact band: see <design/root/#incremental.band>. */
+    if (RootFindGrey(&root, &chunk, arena, trace)) {
+      Res res = TraceScanRootChunk(trace, root, chunk);
+      /* Allocation failures should be handled by emergency mode. */
       AVER(res == ResOK);
+    } else if (traceFindGrey(&seg, &rank, arena, trace->ti)) {
+      if (arena->workers != NULL && traceParallelScanSeg(trace, seg)) {
+        traceScanSegsParallel(trace, rank, seg);
+      } else {
+        Res res;
+        res = traceScanSeg(TraceSetSingle(trace), rank, arena, seg);
+        /* Allocation failures should be handled by emergency mode, and
+         * we don't expect any other error in a normal GC trace. */
+        AVER(res == ResOK);
+      }
     } else {
       trace->state = TraceRECLAIM;
     }
@@ -1792,6 +2226,8 @@ Res TraceStartCollectAll(Trace *traceReturn, Arena arena, int why)
 
   res = TraceCreate(&trace, arena, why);
   AVER(res == ResOK); /* succeeds because no other trace is busy */
+  /* <design/strategy/#alloc.reserve.release> */
+  (void)LocusReleaseReserves(arena);
   res = traceCondemnAll(trace);
   if(res != ResOK) /* should try some other trace, really @@@@ */
     goto failCondemn;
@@ -1823,8 +2259,9 @@ failCondemn:
 
 /* TracePoll -- Check if there's any tracing work to be done
  *
- * Consider starting a trace if none is running; advance the running
- * trace (if any) by one quantum.
+ * Consider starting a trace if none is running, or a collection of a
+ * chain alongside the running traces if a trace id is free; advance
+ * each running trace by one quantum.
  *
  * The collectWorldReturn and collectWorldAllowed arguments are as for
  * PolicyStartTrace.
@@ -1837,32 +2274,40 @@ Bool TracePoll(Work *workReturn, Bool *collectWorldReturn, Globals globals,
                Bool collectWorldAllowed)
 {
   Trace trace;
+  TraceId ti;
   Arena arena;
-  Work oldWork, newWork, work, endWork;
+  Work work = 0;
 
   AVERT(Globals, globals);
   arena = GlobalsArena(globals);
 
-  if (arena->busyTraces != TraceSetEMPTY) {
-    trace = ArenaTrace(arena, (TraceId)0);
-  } else {
+  if (arena->busyTraces == TraceSetEMPTY) {
     /* No traces are running: consider starting one now. */
     if (!PolicyStartTrace(&trace, collectWorldReturn, arena,
                           collectWorldAllowed))
       return FALSE;
+  } else {
+    /* Traces are running: consider starting a collection of a chain
+     * alongside them, so that a long collection of the world doesn't
+     * hold up the collection of the nursery.  See
+     * <design/trace/#instance.start>. */
+    (void)PolicyStartTrace(&trace, collectWorldReturn, arena, FALSE);
   }
 
-  AVER(arena->busyTraces == TraceSetSingle(trace));
-  oldWork = traceWork(trace);
-  endWork = oldWork + trace->quantumWork;
-  do {
-    TraceAdvance(trace);
-  } while (trace->state != TraceFINISHED && traceWork(trace) < endWork);
-  newWork = traceWork(trace);
-  AVER(newWork >= oldWork);
-  work = newWork - oldWork;
-  if (trace->state == TraceFINISHED)
-    TraceDestroyFinished(trace);
+  TRACE_SET_ITER(ti, trace, arena->busyTraces, arena)
+    Work oldWork, newWork, endWork;
+    oldWork = traceWork(trace);
+    endWork = oldWork + trace->quantumWork;
+    do {
+      TraceAdvance(trace);
+    } while (trace->state != TraceFINISHED && traceWork(trace) < endWork);
+    newWork = traceWork(trace);
+    AVER(newWork >= oldWork);
+    work += newWork - oldWork;
+    if (trace->state == TraceFINISHED)
+      TraceDestroyFinished(trace);
+  TRACE_SET_ITER_END(ti, trace, arena->busyTraces, arena);
+
   *workReturn = work;
   return TRUE;
 }
@@ -1911,6 +2356,10 @@ Res TraceDescribe(Trace trace, mps_lib_FILE *stream, Count depth)
                                (WriteFU)trace->segCopiedSize)
                "  forwardedSize $U\n", (WriteFU)trace->forwardedSize,
                "  preservedInPlaceSize $U\n", (WriteFU)trace->preservedInPlaceSize,
+               STATISTIC_WRITE("  nailedSegSize $U\n",
+                               (WriteFU)trace->nailedSegSize)
+               STATISTIC_WRITE("  nailedFreedSize $U\n",
+                               (WriteFU)trace->nailedFreedSize)
                "} Trace $P\n", (WriteFP)trace,
                NULL);
   return res;
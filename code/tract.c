@@ -318,21 +318,38 @@ TreeKey ChunkKey(Tree tree)
 }
 
 
-/* ChunkOfAddr -- return the chunk which encloses an address */
+/* ChunkOfAddr -- return the chunk which encloses an address
+ *
+ * Looks in the arena's chunk map first, and only searches the tree of
+ * chunks if more than one chunk shares the map entry.  See
+ * <design/arena/#chunk.map>.
+ */
 
 Bool ChunkOfAddr(Chunk *chunkReturn, Arena arena, Addr addr)
 {
   Tree tree;
+  Chunk chunk;
 
   AVER_CRITICAL(chunkReturn != NULL);
   AVERT_CRITICAL(Arena, arena);
   /* addr is arbitrary */
 
+  chunk = arena->chunkMap[ArenaChunkMapIndex(arena, addr)];
+  if (chunk == NULL)
+    return FALSE;
+  if (chunk != ArenaChunkMapMANY) {
+    if (chunk->base <= addr && addr < chunk->limit) {
+      *chunkReturn = chunk;
+      return TRUE;
+    }
+    return FALSE;
+  }
+
   if (TreeFind(&tree, ArenaChunkTree(arena), TreeKeyOfAddrVar(addr),
                ChunkCompare)
       == CompareEQUAL)
   {
-    Chunk chunk = ChunkOfTree(tree);
+    chunk = ChunkOfTree(tree);
     AVER_CRITICAL(chunk->base <= addr);
     AVER_CRITICAL(addr < chunk->limit);
     *chunkReturn = chunk;
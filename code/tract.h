@@ -96,6 +96,7 @@ extern void TractFinish(Tract tract);
 typedef struct PageSpareStruct {
   PagePoolUnion pool;         /* spare tract, pool.state == PoolStateSPARE */
   RingStruct spareRing;       /* link in arena spare ring, LRU order */
+  Clock time;                 /* when the page became spare */
 } PageSpareStruct;
 
 typedef union PageUnion {     /* page structure */
@@ -111,6 +112,7 @@ typedef union PageUnion {     /* page structure */
 #define PageIsAllocated(page) RVALUE(PagePool(page) != NULL)
 #define PageState(page)       RVALUE((page)->pool.state)
 #define PageSpareRing(page)   RVALUE(&(page)->spare.spareRing)
+#define PageSpareTime(page)   RVALUE((page)->spare.time)
 #define PageOfSpareRing(node) PARENT(PageUnion, spare, RING_ELT(PageSpare, spareRing, node))
 
 #define PageSetPool(page, _pool) \
@@ -0,0 +1,402 @@
+/* uffdss.c: USERFAULTFD WRITE BARRIER STRESS TEST
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * Store references to young objects (in an AMC pool) into long-lived
+ * target objects (in an AMS pool in an older generation, so that
+ * they are neither moved nor condemned by nursery collections) with
+ * plain stores, so that the write barrier must notice them.  Each
+ * round empties the targets and runs nursery collections until their
+ * segments are write-protected, then parks the arena and stores into
+ * them.  There
+ * are no read barrier hits while the arena is parked, so the test
+ * checks that with MPS_KEY_ARENA_USERFAULTFD no barrier hit raised a
+ * protection signal, and that without it some did.  Then a second
+ * thread stores concurrently with incremental collection, so that
+ * threads are suspended while blocked in write faults.  See
+ * <design/prot/#uffd>.
+ *
+ * On platforms or kernels without write protection by userfaultfd,
+ * the arena can't be created and that half of the test is skipped.
+ */
+
+/* .feature.li: sigaction and siginfo_t need _XOPEN_SOURCE on Linux.
+ * This must come before any header.  See .feature.li in config.h. */
+#if defined(__linux__) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 500
+#endif
+
+#include "fmtdy.h"
+#include "fmtdytst.h"
+#include "testlib.h"
+#include "testthr.h"
+#include "mpslib.h"
+#include "mpscamc.h"
+#include "mpscams.h"
+#include "mpsavm.h"
+#include "mpstd.h"
+#include "mps.h"
+
+#include <stdio.h> /* fflush, printf, putchar */
+
+#if defined(MPS_OS_LI)
+#include <signal.h> /* see .feature.li */
+#endif
+
+
+#define testArenaSIZE     ((size_t)16 << 20)
+#define avLEN             3
+#define targetsCOUNT      200
+#define targetSLOTS       64
+#define storesCOUNT       2
+#define roundsCOUNT       10
+#define roundSTORES       500
+#define emptyCOLLECTIONS  4
+#define collectionsCOUNT  20
+#define genCOUNT          2
+
+/* testChain -- generation parameters for the young objects
+ * oldChain -- generation parameters for the targets, which are
+ * never collected except by check */
+
+static mps_gen_param_s testChain[genCOUNT] = {
+  { 150, 0.85 }, { 170, 0.45 } };
+static mps_gen_param_s oldChain[1] = {
+  { 1 << 20, 0.5 } };
+
+
+/* objNULL needs to be odd so that it's ignored in targets. */
+#define objNULL           ((mps_addr_t)MPS_WORD_CONST(0xDECEA5ED))
+
+
+static mps_arena_t arena;
+static mps_pool_t youngPool;
+static mps_addr_t targets[targetsCOUNT];
+static mps_word_t collectionsLimit;
+
+
+/* segvCount -- count protection signals
+ *
+ * The handler counts the signal and passes it on to the MPS.
+ */
+
+static unsigned long segvCount = 0;
+
+#if defined(MPS_OS_LI)
+
+static struct sigaction segvNext;
+
+static void segvHandle(int sig, siginfo_t *info, void *context)
+{
+  ++segvCount;
+  (*segvNext.sa_sigaction)(sig, info, context);
+}
+
+static void segvInstall(void)
+{
+  struct sigaction sa;
+  sa.sa_sigaction = segvHandle;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_SIGINFO;
+  Insist(sigaction(SIGSEGV, &sa, &segvNext) == 0);
+}
+
+static void segvRemove(void)
+{
+  Insist(sigaction(SIGSEGV, &segvNext, NULL) == 0);
+}
+
+#else
+
+static void segvInstall(void)
+{
+  NOOP;
+}
+
+static void segvRemove(void)
+{
+  NOOP;
+}
+
+#endif
+
+
+/* make -- create one new object */
+
+static mps_addr_t make(mps_ap_t ap, size_t length)
+{
+  size_t size = (length+2) * sizeof(mps_word_t);
+  mps_addr_t p;
+  mps_res_t res;
+
+  do {
+    MPS_RESERVE_BLOCK(res, p, ap, size);
+    if (res)
+      die(res, "MPS_RESERVE_BLOCK");
+    res = dylan_init(p, size, targets, targetsCOUNT);
+    if (res)
+      die(res, "dylan_init");
+  } while(!mps_commit(ap, p, size));
+
+  return p;
+}
+
+
+/* empty -- overwrite the slots of the targets with non-references
+ *
+ * Once a target's segment has been scanned a few times without
+ * finding any references, the MPS raises its write barrier.  See
+ * design.mps.write-barrier.deferral.
+ */
+
+static void empty(void)
+{
+  size_t i, j;
+
+  for (i = 0; i < targetsCOUNT; ++i) {
+    mps_word_t *target = targets[i];
+    for (j = 0; j < targetSLOTS; ++j)
+      target[2 + j] = (mps_word_t)objNULL;
+  }
+}
+
+
+/* churn -- make a young object and store it into some targets
+ *
+ * The stores are the only references to the young object.
+ */
+
+static void churn(mps_ap_t ap, size_t stores)
+{
+  mps_addr_t obj = make(ap, rnd() % (2 * avLEN));
+  size_t i;
+
+  for (i = 0; i < stores; ++i) {
+    mps_word_t *target = targets[rnd() % targetsCOUNT];
+    target[2 + rnd() % targetSLOTS] = (mps_word_t)obj;
+  }
+}
+
+
+/* checkObject -- check an object and, to some depth, what it refers to */
+
+static void checkObject(mps_addr_t object, unsigned depth)
+{
+  mps_word_t *obj = object;
+  mps_word_t i, slots;
+
+  cdie(mps_arena_has_addr(arena, object), "object in arena");
+  cdie(dylan_check(object), "object check");
+  slots = obj[1] >> 2;
+  for (i = 0; i < slots; ++i) {
+    mps_word_t ref = obj[2 + i];
+    if ((ref & 3) == 0 && depth > 0)
+      checkObject((mps_addr_t)ref, depth - 1);
+  }
+}
+
+
+/* check -- collect the world and check the objects reachable from
+ * the targets, leaving the arena parked */
+
+static void check(void)
+{
+  size_t i;
+
+  mps_arena_collect(arena);
+  for (i = 0; i < targetsCOUNT; ++i)
+    checkObject(targets[i], 2);
+}
+
+
+/* kid -- store concurrently with the main thread */
+
+static void *kid(void *arg)
+{
+  void *marker = &marker;
+  mps_thr_t thread;
+  mps_root_t root;
+  mps_ap_t ap;
+
+  UNUSED(arg);
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  die(mps_root_create_thread(&root, arena, thread, marker), "root_create");
+  die(mps_ap_create(&ap, youngPool, mps_rank_exact()), "BufferCreate(kid)");
+  while (mps_collections(arena) < collectionsLimit)
+    churn(ap, storesCOUNT);
+  mps_ap_destroy(ap);
+  mps_root_destroy(root);
+  mps_thread_dereg(thread);
+  return NULL;
+}
+
+
+/* test -- the body of the test
+ *
+ * If userfaultfd is true, write barrier hits must not raise signals;
+ * otherwise they must.
+ */
+
+static void test(mps_bool_t userfaultfd, void *marker)
+{
+  mps_fmt_t format;
+  mps_chain_t chain, targetChain;
+  mps_thr_t thread;
+  mps_root_t root, regRoot;
+  mps_pool_t targetPool;
+  mps_ap_t targetAp, ap;
+  testthr_t kidThread;
+  unsigned long segvBefore, parkedSegv;
+  size_t i, j;
+  mps_res_t res;
+
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_SIZE, testArenaSIZE);
+    MPS_ARGS_ADD(args, MPS_KEY_ARENA_USERFAULTFD, userfaultfd);
+    res = mps_arena_create_k(&arena, mps_arena_class_vm(), args);
+  } MPS_ARGS_END(args);
+  if (res == MPS_RES_UNIMPL) {
+    Insist(userfaultfd);
+    printf("userfaultfd write barrier not supported\n");
+    return;
+  }
+  die(res, "arena_create");
+  segvCount = 0;
+  segvInstall();
+
+  die(mps_thread_reg(&thread, arena), "thread_reg");
+  die(mps_root_create_thread(&regRoot, arena, thread, marker),
+      "root_create");
+  die(dylan_fmt(&format, arena), "fmt_create");
+  die(mps_chain_create(&chain, arena, genCOUNT, testChain), "chain_create");
+  die(mps_chain_create(&targetChain, arena, NELEMS(oldChain), oldChain),
+      "chain_create(targets)");
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, targetChain);
+    die(mps_pool_create_k(&targetPool, arena, mps_class_ams(), args),
+        "pool_create(targets)");
+  } MPS_ARGS_END(args);
+  MPS_ARGS_BEGIN(args) {
+    MPS_ARGS_ADD(args, MPS_KEY_FORMAT, format);
+    MPS_ARGS_ADD(args, MPS_KEY_CHAIN, chain);
+    die(mps_pool_create_k(&youngPool, arena, mps_class_amc(), args),
+        "pool_create(young)");
+  } MPS_ARGS_END(args);
+  die(mps_ap_create(&targetAp, targetPool, mps_rank_exact()),
+      "BufferCreate(targets)");
+  die(mps_ap_create(&ap, youngPool, mps_rank_exact()), "BufferCreate");
+
+  for(i = 0; i < targetsCOUNT; ++i)
+    targets[i] = objNULL;
+  die(mps_root_create_table_masked(&root, arena,
+                                   mps_rank_exact(), (mps_rm_t)0,
+                                   &targets[0], targetsCOUNT,
+                                   (mps_word_t)1),
+      "root_create_table");
+  for(i = 0; i < targetsCOUNT; ++i)
+    targets[i] = make(targetAp, targetSLOTS);
+  mps_ap_destroy(targetAp);
+
+  /* While the arena is parked, all barrier hits are write hits. */
+  parkedSegv = 0;
+  for (i = 0; i < roundsCOUNT; ++i) {
+    mps_word_t collections = mps_collections(arena) + emptyCOLLECTIONS;
+    empty();
+    mps_arena_release(arena);
+    while (mps_collections(arena) < collections)
+      churn(ap, 0);
+    mps_arena_park(arena);
+    segvBefore = segvCount;
+    for (j = 0; j < roundSTORES; ++j)
+      churn(ap, storesCOUNT);
+    parkedSegv += segvCount - segvBefore;
+    check();
+    putchar('.');
+    (void)fflush(stdout);
+  }
+  if (userfaultfd)
+    Insist(parkedSegv == 0);
+  else
+    Insist(parkedSegv > 0);
+
+  /* Store on two threads during incremental collection. */
+  collectionsLimit = mps_collections(arena) + collectionsCOUNT;
+  mps_arena_release(arena);
+  testthr_create(&kidThread, kid, NULL);
+  while (mps_collections(arena) < collectionsLimit)
+    churn(ap, storesCOUNT);
+  testthr_join(&kidThread, NULL);
+  check();
+  printf("\n%lu protection signals while parked, %lu in all\n",
+         parkedSegv, segvCount);
+
+  mps_ap_destroy(ap);
+  mps_root_destroy(root);
+  mps_pool_destroy(youngPool);
+  mps_pool_destroy(targetPool);
+  mps_chain_destroy(targetChain);
+  mps_chain_destroy(chain);
+  mps_fmt_destroy(format);
+  mps_root_destroy(regRoot);
+  mps_thread_dereg(thread);
+  segvRemove();
+  mps_arena_destroy(arena);
+}
+
+
+int main(int argc, char *argv[])
+{
+  void *marker = &marker;
+
+  testlib_init(argc, argv);
+
+  test(FALSE, marker);
+  test(TRUE, marker);
+
+  printf("%s: Conclusion: Failed to find any defects.\n", argv[0]);
+  return 0;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
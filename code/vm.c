@@ -26,6 +26,9 @@ Bool VMCheck(VM vm)
   CHECKL(vm->block != NULL);
   CHECKL((Addr)vm->block <= vm->base);
   CHECKL(vm->mapped <= vm->reserved);
+  CHECKL(BoolCheck(vm->hugePages));
+  CHECKL(BoolCheck(vm->hugeTLB));
+  CHECKL(!vm->hugeTLB || vm->hugePages);
   return TRUE;
 }
 
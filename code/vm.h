@@ -26,6 +26,8 @@ typedef struct VMStruct {
   Addr base, limit;             /* aligned boundaries of reserved space */
   Size reserved;                /* total reserved address space */
   Size mapped;                  /* total mapped memory */
+  Bool hugePages;               /* map using huge pages? */
+  Bool hugeTLB;                 /* map using reserved huge pages? */
 } VMStruct;
 
 
@@ -45,6 +47,7 @@ extern Addr (VMBase)(VM vm);
 extern Addr (VMLimit)(VM vm);
 extern Res VMMap(VM vm, Addr base, Addr limit);
 extern void VMUnmap(VM vm, Addr base, Addr limit);
+extern void VMBind(VM vm, Addr base, Addr limit, Index node);
 extern Size (VMReserved)(VM vm);
 extern Size (VMMapped)(VM vm);
 extern void VMCopy(VM dest, VM src);
@@ -36,6 +36,26 @@
  * .remap: Possibly this should use mremap to reduce the number of
  * distinct mappings.  According to our current testing, it doesn't
  * seem to be a problem.
+ *
+ * .huge: If the keyword argument MPS_KEY_ARENA_HUGE_PAGES is true,
+ * the reserved address space is aligned to VMHugePageSIZE so that
+ * the operating system can back it with huge pages, and each mapping
+ * is advised with MADV_HUGEPAGE.  .huge.tlb: If the arena grain size
+ * is a multiple of VMHugePageSIZE, we first try to map each range with
+ * MAP_HUGETLB, which only succeeds if the system has reserved huge
+ * pages, and fall back to an ordinary mapping.  A reserved huge page
+ * can't be partly unmapped or protected, so the VM's page size is
+ * then VMHugePageSIZE: the arena maps, unmaps and protects whole
+ * grains, and the sparse array of page descriptors maps and unmaps
+ * whole VM pages.  With a smaller grain size, MAP_HUGETLB is not used,
+ * because a range could be mapped in one piece and later unmapped or
+ * protected in part.  .huge.shield: Protecting part of a transparent
+ * huge page makes the kernel split it, which is correct but loses the
+ * benefit.  See <design/vm/#impl.ix.huge>.
+ *
+ * .bind: On Linux, VMBind uses the mbind(2) system call to prefer
+ * pages on a NUMA node.  The call is made via syscall(2) so that the
+ * MPS doesn't need libnuma.  See <design/vm/#impl.ix.bind>.
  */
 
 #include "mpm.h"
@@ -51,6 +71,10 @@
 /* for getpagesize(3) */
 #include <unistd.h>
 
+#if defined(MPS_OS_LI)
+#include <sys/syscall.h> /* __NR_mbind */
+#endif
+
 
 #if !defined(MPS_OS_FR) && !defined(MPS_OS_XC) && !defined(MPS_OS_LI)
 #error "vmix.c is Unix-like specific, currently MPS_OS_FR XC LI"
@@ -75,21 +99,58 @@ Size PageSize(void)
 }
 
 
+typedef struct VMParamsStruct {
+  Bool hugePages;
+} VMParamsStruct, *VMParams;
+
+static const VMParamsStruct vmParamsDefaults = {
+  /* .hugePages = */ FALSE,
+};
+
 Res VMParamFromArgs(void *params, size_t paramSize, ArgList args)
 {
+  VMParams vmParams;
+  ArgStruct arg;
   AVER(params != NULL);
   AVERT(ArgList, args);
+  AVER(paramSize >= sizeof(VMParamsStruct));
   UNUSED(paramSize);
+  vmParams = (VMParams)params;
+  (void)mps_lib_memcpy(vmParams, &vmParamsDefaults, sizeof(VMParamsStruct));
+  if (ArgPick(&arg, args, MPS_KEY_ARENA_HUGE_PAGES))
+    vmParams->hugePages = arg.val.b;
   return ResOK;
 }
 
 
+/* vmHuge -- advise the kernel to use huge pages for a mapping
+ *
+ * See .huge.
+ */
+
+static void vmHuge(VM vm, Addr base, Size size)
+{
+  AVERT(VM, vm);
+  AVER(vm->hugePages);
+#if defined(MADV_HUGEPAGE)
+  /* Failure means that the kernel doesn't support transparent huge
+     pages, which is not an error. */
+  (void)madvise((void *)base, (size_t)size, MADV_HUGEPAGE);
+#else
+  UNUSED(base);
+  UNUSED(size);
+#endif
+}
+
+
 /* VMInit -- reserve some virtual address space, and create a VM structure */
 
 Res VMInit(VM vm, Size size, Size grainSize, void *params)
 {
-  Size pageSize, reserved;
+  Size pageSize, reserved, align;
+  Bool hugeTLB;
   void *vbase;
+  VMParams vmParams = params;
 
   AVER(vm != NULL);
   AVERT(ArenaGrainSize, grainSize);
@@ -101,12 +162,25 @@ Res VMInit(VM vm, Size size, Size grainSize, void *params)
   /* Grains must consist of whole pages. */
   AVER(grainSize % pageSize == 0);
 
+  /* Align the base to a huge page if requested. See .huge. */
+  align = grainSize;
+  if (vmParams->hugePages && align < VMHugePageSIZE)
+    align = VMHugePageSIZE;
+
+  /* Use reserved huge pages only if they are whole grains. See
+     .huge.tlb. */
+  hugeTLB = FALSE;
+#if defined(MAP_HUGETLB)
+  if (vmParams->hugePages && grainSize % VMHugePageSIZE == 0)
+    hugeTLB = TRUE;
+#endif
+
   /* Check that the rounded-up sizes will fit in a Size. */
   size = SizeRoundUp(size, grainSize);
   if (size < grainSize || size > (Size)(size_t)-1)
     return ResRESOURCE;
-  reserved = size + grainSize - pageSize;
-  if (reserved < grainSize || reserved > (Size)(size_t)-1)
+  reserved = size + align - pageSize;
+  if (reserved < align || reserved > (Size)(size_t)-1)
     return ResRESOURCE;
 
   /* See .assume.not-last. */
@@ -122,14 +196,16 @@ Res VMInit(VM vm, Size size, Size grainSize, void *params)
     return ResRESOURCE;
   }
 
-  vm->pageSize = pageSize;
+  vm->pageSize = hugeTLB ? VMHugePageSIZE : pageSize;
   vm->block = vbase;
-  vm->base = AddrAlignUp(vbase, grainSize);
+  vm->base = AddrAlignUp(vbase, align);
   vm->limit = AddrAdd(vm->base, size);
   AVER(vm->base < vm->limit);  /* .assume.not-last */
   AVER(vm->limit <= AddrAdd((Addr)vm->block, reserved));
   vm->reserved = reserved;
   vm->mapped = 0;
+  vm->hugePages = vmParams->hugePages;
+  vm->hugeTLB = hugeTLB;
 
   vm->sig = VMSig;
   AVERT(VM, vm);
@@ -177,6 +253,17 @@ Res VMMap(VM vm, Addr base, Addr limit)
 
   size = AddrOffset(base, limit);
 
+#if defined(MAP_HUGETLB)
+  /* See .huge.tlb. The range is aligned to the VM's page size. */
+  if (vm->hugeTLB
+      && mmap((void *)base, (size_t)size,
+              PROT_READ | PROT_WRITE | PROT_EXEC,
+              MAP_ANON | MAP_PRIVATE | MAP_FIXED | MAP_HUGETLB,
+              -1, 0)
+         != MAP_FAILED)
+    goto mapped;
+#endif
+
   if(mmap((void *)base, (size_t)size,
           PROT_READ | PROT_WRITE | PROT_EXEC,
           MAP_ANON | MAP_PRIVATE | MAP_FIXED,
@@ -185,6 +272,12 @@ Res VMMap(VM vm, Addr base, Addr limit)
     AVER(errno == ENOMEM); /* .assume.mmap.err */
     return ResMEMORY;
   }
+  if (vm->hugePages)
+    vmHuge(vm, base, size);
+
+#if defined(MAP_HUGETLB)
+mapped:
+#endif
 
   vm->mapped += size;
   AVER(VMMapped(vm) <= VMReserved(vm));
@@ -223,6 +316,38 @@ void VMUnmap(VM vm, Addr base, Addr limit)
 }
 
 
+/* VMBind -- prefer memory on a NUMA node for a mapped range
+ *
+ * See .bind.  This is only a hint: if it fails (for example, because
+ * the node doesn't exist) the range stays where it is.  See
+ * <design/arena/#numa.simulate>.
+ */
+
+#define vmMPOL_PREFERRED 1      /* MPOL_PREFERRED in <linux/mempolicy.h> */
+
+void VMBind(VM vm, Addr base, Addr limit, Index node)
+{
+  AVERT(VM, vm);
+  AVER(base < limit);
+  AVER(base >= VMBase(vm));
+  AVER(limit <= VMLimit(vm));
+  AVER(AddrIsAligned(base, vm->pageSize));
+  AVER(AddrIsAligned(limit, vm->pageSize));
+
+#if defined(MPS_OS_LI) && defined(__NR_mbind)
+  if (node < MPS_WORD_WIDTH) {
+    unsigned long nodeMask = 1ul << node;
+    (void)syscall(__NR_mbind, (void *)base,
+                  (unsigned long)AddrOffset(base, limit),
+                  vmMPOL_PREFERRED, &nodeMask,
+                  (unsigned long)MPS_WORD_WIDTH + 1, 0);
+  }
+#else
+  UNUSED(node);
+#endif
+}
+
+
 /* C. COPYRIGHT AND LICENSE
  *
  * Copyright (C) 2001-2014 Ravenbrook Limited <http://www.ravenbrook.com/>.
@@ -139,6 +139,8 @@ Res VMInit(VM vm, Size size, Size grainSize, void *params)
   AVER(vm->limit <= AddrAdd((Addr)vm->block, reserved));
   vm->reserved = reserved;
   vm->mapped = 0;
+  vm->hugePages = FALSE;
+  vm->hugeTLB = FALSE;
 
   vm->sig = VMSig;
   AVERT(VM, vm);
@@ -227,6 +229,22 @@ void VMUnmap(VM vm, Addr base, Addr limit)
 }
 
 
+/* VMBind -- prefer memory on a NUMA node for a mapped range
+ *
+ * Does nothing: memory stays where the operating system put it.  See
+ * <design/arena/#numa.simulate>.
+ */
+
+void VMBind(VM vm, Addr base, Addr limit, Index node)
+{
+  AVERT(VM, vm);
+  AVER(base < limit);
+  AVER(base >= VMBase(vm));
+  AVER(limit <= VMLimit(vm));
+  UNUSED(node);
+}
+
+
 /* C. COPYRIGHT AND LICENSE
  *
  * Copyright (C) 2001-2014 Ravenbrook Limited <http://www.ravenbrook.com/>.
@@ -0,0 +1,156 @@
+/* worker.h: COLLECTOR WORKER THREADS
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .purpose: Provides a pool of threads on which the tracer can run
+ * independent pieces of work (such as scanning grey segments) in
+ * parallel.  See <design/trace/#parallel>.  Also provides a daemon
+ * thread which periodically runs a method in the background, for the
+ * background collector.  See <design/arena/#background>.
+ *
+ * .caller: The workers are only ever driven by the thread that holds
+ * the arena lock.  WorkersRun does not return until every job has
+ * finished, so jobs may use data on the caller's stack.
+ */
+
+#ifndef worker_h
+#define worker_h
+
+#include "mpmtypes.h"
+
+
+#define WorkersSig      ((Sig)0x5190C9E5) /* SIGnature WORKErS */
+#define DaemonSig       ((Sig)0x519DAE90) /* SIGnature DAEmON */
+
+
+/*  WorkersJob -- a piece of work
+ *
+ *  The job method is called once for each index from zero up to (but
+ *  not including) the number of jobs passed to WorkersRun.  Calls may
+ *  happen on any worker thread (including the caller of WorkersRun)
+ *  and in any order.
+ */
+
+typedef void (*WorkersJob)(void *closure, Index i);
+
+
+/*  WorkersSize -- Return the size of a WorkersStruct
+ *
+ *  Supports allocation of a set of workers with the given number of
+ *  threads.
+ */
+
+extern size_t WorkersSize(Count threads);
+
+
+/*  WorkersInit/Finish
+ *
+ *  WorkersInit starts the threads, which then wait for work.  It
+ *  returns ResRESOURCE if the threads could not be created.
+ *  WorkersFinish stops and joins them.
+ */
+
+extern Res WorkersInit(Workers workers, Count threads);
+extern void WorkersFinish(Workers workers);
+
+
+/*  WorkersRun -- run a batch of jobs
+ *
+ *  Runs job(closure, i) for each i in [0, jobs) across the threads,
+ *  and on the calling thread, returning when they have all finished.
+ */
+
+extern void WorkersRun(Workers workers, WorkersJob job, void *closure,
+                       Count jobs);
+
+
+/*  WorkersCheck -- Validation */
+
+extern Bool WorkersCheck(Workers workers);
+
+
+/*  DaemonMethod -- a step of background work
+ *
+ *  The method is called repeatedly on the daemon thread.  It returns
+ *  TRUE if there is more work to do immediately, or FALSE if the
+ *  daemon should sleep until the interval expires or DaemonWake is
+ *  called.
+ */
+
+typedef Bool (*DaemonMethod)(void *closure);
+
+
+/*  DaemonSize -- Return the size of a DaemonStruct */
+
+extern size_t DaemonSize(void);
+
+
+/*  DaemonInit/Finish
+ *
+ *  DaemonInit starts the daemon thread, which sleeps for interval
+ *  seconds before first calling the method.  It returns ResRESOURCE
+ *  if the thread could not be created, or ResUNIMPL if the platform
+ *  has no implementation.  DaemonFinish waits for the current step
+ *  (if any) to return, then stops and joins the thread: it must not
+ *  be called while holding any lock that the method claims.
+ */
+
+extern Res DaemonInit(Daemon daemon, DaemonMethod method, void *closure,
+                      double interval);
+extern void DaemonFinish(Daemon daemon);
+
+
+/*  DaemonWake -- ask the daemon to call its method soon */
+
+extern void DaemonWake(Daemon daemon);
+
+
+/*  DaemonCheck -- Validation */
+
+extern Bool DaemonCheck(Daemon daemon);
+
+
+#endif /* worker_h */
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -0,0 +1,149 @@
+/* workeran.c: GENERIC COLLECTOR WORKER THREADS
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .purpose: This is a trivial implementation of the workers that
+ * runs every job on the calling thread.  It is used on platforms
+ * without a threaded implementation, so that clients may pass
+ * MPS_KEY_ARENA_GC_THREADS portably and get serial scanning.
+ *
+ * .daemon: There is no way to run the daemon without a thread, so
+ * DaemonInit fails with ResUNIMPL.
+ */
+
+#include "mpm.h"
+
+SRCID(workeran, "$Id$");
+
+
+typedef struct WorkersStruct {  /* generic workers structure */
+  Sig sig;                      /* <design/sig/> */
+  Count threads;                /* number of threads requested */
+} WorkersStruct;
+
+
+size_t WorkersSize(Count threads)
+{
+  UNUSED(threads);
+  return sizeof(WorkersStruct);
+}
+
+Bool WorkersCheck(Workers workers)
+{
+  CHECKS(Workers, workers);
+  CHECKL(workers->threads > 0);
+  return TRUE;
+}
+
+
+Res WorkersInit(Workers workers, Count threads)
+{
+  AVER(workers != NULL);
+  AVER(threads > 0);
+  workers->threads = threads;
+  workers->sig = WorkersSig;
+  AVERT(Workers, workers);
+  return ResOK;
+}
+
+void WorkersFinish(Workers workers)
+{
+  AVERT(Workers, workers);
+  workers->sig = SigInvalid;
+}
+
+
+void WorkersRun(Workers workers, WorkersJob job, void *closure, Count jobs)
+{
+  Index i;
+
+  AVERT(Workers, workers);
+  AVER(FUNCHECK(job));
+  /* closure is arbitrary and can't be checked */
+
+  for (i = 0; i < jobs; ++i)
+    (*job)(closure, i);
+}
+
+
+typedef struct DaemonStruct {   /* generic daemon structure */
+  Sig sig;                      /* <design/sig/> */
+} DaemonStruct;
+
+
+size_t DaemonSize(void)
+{
+  return sizeof(DaemonStruct);
+}
+
+Bool DaemonCheck(Daemon daemon)
+{
+  CHECKS(Daemon, daemon);
+  return TRUE;
+}
+
+
+Res DaemonInit(Daemon daemon, DaemonMethod method, void *closure,
+               double interval)
+{
+  AVER(daemon != NULL);
+  AVER(FUNCHECK(method));
+  AVER(interval > 0.0);
+  UNUSED(closure);
+  return ResUNIMPL;
+}
+
+void DaemonFinish(Daemon daemon)
+{
+  AVERT(Daemon, daemon);
+  NOTREACHED;
+}
+
+void DaemonWake(Daemon daemon)
+{
+  AVERT(Daemon, daemon);
+  NOTREACHED;
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -0,0 +1,502 @@
+/* workerix.c: COLLECTOR WORKER THREADS FOR POSIX SYSTEMS
+ *
+ * $Id$
+ * Copyright (c) 2016 Ravenbrook Limited.  See end of file for license.
+ *
+ * .posix: The implementation uses POSIX threads, mutexes and
+ * condition variables, and supports Linux, FreeBSD and OS X
+ * (platforms MPS_OS_LI, MPS_OS_FR and MPS_OS_XC).
+ *
+ * .design: The workers share a single batch of jobs, described by
+ * the job method, its closure and the number of jobs.  Each thread
+ * (including the caller of WorkersRun) repeatedly claims the next
+ * unclaimed index and runs the job for it, until none are left.  The
+ * fields of the batch must only be read or modified while holding
+ * the mutex; the mutex is not held while a job runs.
+ *
+ * .batch: Each call to WorkersRun increments the batch serial, so
+ * that threads sleeping on the start condition can tell that there
+ * is new work rather than a spurious wakeup.
+ *
+ * .unregistered: The worker threads are not registered with the
+ * arena, so they are never suspended by the shield.  They must
+ * therefore only touch memory that the caller of WorkersRun has
+ * exposed, or that they expose themselves while holding a lock that
+ * excludes the rest of the MPS.  See <design/trace/#parallel.shield>.
+ *
+ * .daemon: The daemon is a single thread that calls its method, then
+ * sleeps on a condition variable with a timeout, for as long as the
+ * method reports that there is no more work.  The daemon's mutex is
+ * never held while the method runs, so the method may claim the arena
+ * lock, and DaemonWake may be called while holding it.
+ */
+
+#include "mpm.h"
+
+#include <pthread.h> /* see .feature.li in config.h */
+#include <sched.h> /* sched_yield */
+#include <sys/time.h> /* gettimeofday */
+#include <errno.h> /* ETIMEDOUT */
+
+#if !defined(MPS_OS_LI) && !defined(MPS_OS_FR) && !defined(MPS_OS_XC)
+#error "workerix.c is specific to MPS_OS_LI, MPS_OS_FR or MPS_OS_XC"
+#endif
+
+SRCID(workerix, "$Id$");
+
+
+/* WorkersStruct -- the collector worker threads
+ *
+ * The thread handles follow the structure in memory: see WorkersSize.
+ */
+
+typedef struct WorkersStruct {
+  Sig sig;                      /* <design/sig/> */
+  Count threads;                /* number of worker threads */
+  pthread_t *thread;            /* worker thread handles */
+  pthread_mutex_t mut;          /* protects the fields below */
+  pthread_cond_t start;         /* signalled when there is new work */
+  pthread_cond_t done;          /* signalled when the batch is done */
+  Bool finishing;               /* threads should exit? */
+  Serial batch;                 /* serial of current batch (.batch) */
+  WorkersJob job;               /* job method of current batch */
+  void *closure;                /* closure for job method */
+  Count jobs;                   /* number of jobs in current batch */
+  Index next;                   /* next unclaimed job */
+  Count pending;                /* number of jobs not yet finished */
+} WorkersStruct;
+
+
+/* WorkersSize -- size of a WorkersStruct and its thread handles */
+
+size_t WorkersSize(Count threads)
+{
+  return sizeof(WorkersStruct) + threads * sizeof(pthread_t);
+}
+
+
+/* WorkersCheck -- check a set of workers */
+
+Bool WorkersCheck(Workers workers)
+{
+  CHECKS(Workers, workers);
+  CHECKL(workers->threads > 0);
+  CHECKL(workers->thread != NULL);
+  CHECKL(BoolCheck(workers->finishing));
+  /* The batch fields can't be checked without claiming the mutex. */
+  return TRUE;
+}
+
+
+/* workersWork -- run jobs from the current batch until none are left
+ *
+ * Must be called with the mutex held, and returns with it held.
+ */
+
+static void workersWork(Workers workers)
+{
+  int res;
+
+  while (workers->next < workers->jobs) {
+    Index i = workers->next;
+    WorkersJob job = workers->job;
+    void *closure = workers->closure;
+
+    ++workers->next;
+    res = pthread_mutex_unlock(&workers->mut);
+    AVER(res == 0);
+    (*job)(closure, i);
+    res = pthread_mutex_lock(&workers->mut);
+    AVER(res == 0);
+    AVER(workers->pending > 0);
+    --workers->pending;
+    if (workers->pending == 0) {
+      res = pthread_cond_signal(&workers->done);
+      AVER(res == 0);
+    }
+  }
+}
+
+
+/* workersThread -- the main function of each worker thread */
+
+static void *workersThread(void *p)
+{
+  Workers workers = p;
+  Serial seen = 0;
+  int res;
+
+  res = pthread_mutex_lock(&workers->mut);
+  AVER(res == 0);
+  for (;;) {
+    while (!workers->finishing && workers->batch == seen) {
+      res = pthread_cond_wait(&workers->start, &workers->mut);
+      AVER(res == 0);
+    }
+    if (workers->finishing)
+      break;
+    seen = workers->batch;
+    workersWork(workers);
+  }
+  res = pthread_mutex_unlock(&workers->mut);
+  AVER(res == 0);
+  return NULL;
+}
+
+
+/* workersStop -- stop and join the first count threads */
+
+static void workersStop(Workers workers, Count count)
+{
+  Index i;
+  int res;
+
+  res = pthread_mutex_lock(&workers->mut);
+  AVER(res == 0);
+  workers->finishing = TRUE;
+  res = pthread_cond_broadcast(&workers->start);
+  AVER(res == 0);
+  res = pthread_mutex_unlock(&workers->mut);
+  AVER(res == 0);
+
+  for (i = 0; i < count; ++i) {
+    res = pthread_join(workers->thread[i], NULL);
+    AVER(res == 0);
+  }
+}
+
+
+/* WorkersInit -- initialize the workers and start their threads */
+
+Res WorkersInit(Workers workers, Count threads)
+{
+  Index i;
+  int res;
+
+  AVER(workers != NULL);
+  AVER(threads > 0);
+
+  workers->threads = threads;
+  workers->thread = PointerAdd(workers, sizeof(WorkersStruct));
+  workers->finishing = FALSE;
+  workers->batch = 0;
+  workers->job = NULL;
+  workers->closure = NULL;
+  workers->jobs = 0;
+  workers->next = 0;
+  workers->pending = 0;
+
+  res = pthread_mutex_init(&workers->mut, NULL);
+  if (res != 0)
+    goto failMutex;
+  res = pthread_cond_init(&workers->start, NULL);
+  if (res != 0)
+    goto failStart;
+  res = pthread_cond_init(&workers->done, NULL);
+  if (res != 0)
+    goto failDone;
+
+  for (i = 0; i < threads; ++i) {
+    res = pthread_create(&workers->thread[i], NULL, workersThread, workers);
+    if (res != 0)
+      goto failCreate;
+  }
+
+  workers->sig = WorkersSig;
+  AVERT(Workers, workers);
+  return ResOK;
+
+failCreate:
+  workersStop(workers, i);
+  (void)pthread_cond_destroy(&workers->done);
+failDone:
+  (void)pthread_cond_destroy(&workers->start);
+failStart:
+  (void)pthread_mutex_destroy(&workers->mut);
+failMutex:
+  return ResRESOURCE;
+}
+
+
+/* WorkersFinish -- stop the threads and finish the workers */
+
+void WorkersFinish(Workers workers)
+{
+  int res;
+
+  AVERT(Workers, workers);
+  AVER(workers->pending == 0);
+
+  workersStop(workers, workers->threads);
+  res = pthread_cond_destroy(&workers->done);
+  AVER(res == 0);
+  res = pthread_cond_destroy(&workers->start);
+  AVER(res == 0);
+  res = pthread_mutex_destroy(&workers->mut);
+  AVER(res == 0);
+  workers->sig = SigInvalid;
+}
+
+
+/* WorkersRun -- run a batch of jobs on the workers and this thread */
+
+void WorkersRun(Workers workers, WorkersJob job, void *closure, Count jobs)
+{
+  int res;
+
+  AVERT(Workers, workers);
+  AVER(FUNCHECK(job));
+  /* closure is arbitrary and can't be checked */
+
+  res = pthread_mutex_lock(&workers->mut);
+  AVER(res == 0);
+  AVER(workers->pending == 0);
+  workers->job = job;
+  workers->closure = closure;
+  workers->jobs = jobs;
+  workers->next = 0;
+  workers->pending = jobs;
+  ++workers->batch;
+  res = pthread_cond_broadcast(&workers->start);
+  AVER(res == 0);
+
+  workersWork(workers);
+  while (workers->pending > 0) {
+    res = pthread_cond_wait(&workers->done, &workers->mut);
+    AVER(res == 0);
+  }
+
+  workers->job = NULL;
+  workers->closure = NULL;
+  workers->jobs = 0;
+  workers->next = 0;
+  res = pthread_mutex_unlock(&workers->mut);
+  AVER(res == 0);
+}
+
+
+/* DaemonStruct -- the daemon thread */
+
+typedef struct DaemonStruct {
+  Sig sig;                      /* <design/sig/> */
+  DaemonMethod method;          /* method to call */
+  void *closure;                /* closure for method */
+  double interval;              /* maximum time to sleep, in seconds */
+  pthread_t thread;             /* daemon thread handle */
+  pthread_mutex_t mut;          /* protects the fields below */
+  pthread_cond_t wake;          /* signalled by DaemonWake and DaemonFinish */
+  Bool woken;                   /* DaemonWake called since last step? */
+  Bool finishing;               /* thread should exit? */
+} DaemonStruct;
+
+
+/* DaemonSize -- size of a DaemonStruct */
+
+size_t DaemonSize(void)
+{
+  return sizeof(DaemonStruct);
+}
+
+
+/* DaemonCheck -- check a daemon */
+
+Bool DaemonCheck(Daemon daemon)
+{
+  CHECKS(Daemon, daemon);
+  CHECKL(FUNCHECK(daemon->method));
+  /* closure is arbitrary and can't be checked */
+  CHECKL(daemon->interval > 0.0);
+  /* The other fields can't be checked without claiming the mutex. */
+  return TRUE;
+}
+
+
+/* daemonDeadline -- absolute time interval seconds from now */
+
+static void daemonDeadline(struct timespec *ts, double interval)
+{
+  struct timeval now;
+  double whole, frac;
+  int res;
+
+  res = gettimeofday(&now, NULL);
+  AVER(res == 0);
+  whole = (double)(long)interval;
+  frac = interval - whole;
+  ts->tv_sec = now.tv_sec + (time_t)whole;
+  ts->tv_nsec = (long)now.tv_usec * 1000 + (long)(frac * 1e9);
+  if (ts->tv_nsec >= 1000000000) {
+    ts->tv_nsec -= 1000000000;
+    ++ts->tv_sec;
+  }
+}
+
+
+/* daemonThread -- the main function of the daemon thread (.daemon) */
+
+static void *daemonThread(void *p)
+{
+  Daemon daemon = p;
+  Bool more = FALSE;
+  int res;
+
+  res = pthread_mutex_lock(&daemon->mut);
+  AVER(res == 0);
+  for (;;) {
+    if (!more && !daemon->woken && !daemon->finishing) {
+      struct timespec deadline;
+      daemonDeadline(&deadline, daemon->interval);
+      do {
+        res = pthread_cond_timedwait(&daemon->wake, &daemon->mut, &deadline);
+        AVER(res == 0 || res == ETIMEDOUT);
+      } while (res == 0 && !daemon->woken && !daemon->finishing);
+    }
+    if (daemon->finishing)
+      break;
+    daemon->woken = FALSE;
+    res = pthread_mutex_unlock(&daemon->mut);
+    AVER(res == 0);
+
+    more = (*daemon->method)(daemon->closure);
+    if (more)
+      /* Give threads waiting for locks that the method released a
+         chance to claim them before the next step. */
+      (void)sched_yield();
+
+    res = pthread_mutex_lock(&daemon->mut);
+    AVER(res == 0);
+  }
+  res = pthread_mutex_unlock(&daemon->mut);
+  AVER(res == 0);
+  return NULL;
+}
+
+
+/* DaemonInit -- initialize the daemon and start its thread */
+
+Res DaemonInit(Daemon daemon, DaemonMethod method, void *closure,
+               double interval)
+{
+  int res;
+
+  AVER(daemon != NULL);
+  AVER(FUNCHECK(method));
+  AVER(interval > 0.0);
+
+  daemon->method = method;
+  daemon->closure = closure;
+  daemon->interval = interval;
+  daemon->woken = FALSE;
+  daemon->finishing = FALSE;
+
+  res = pthread_mutex_init(&daemon->mut, NULL);
+  if (res != 0)
+    goto failMutex;
+  res = pthread_cond_init(&daemon->wake, NULL);
+  if (res != 0)
+    goto failWake;
+
+  daemon->sig = DaemonSig;
+  res = pthread_create(&daemon->thread, NULL, daemonThread, daemon);
+  if (res != 0)
+    goto failCreate;
+
+  AVERT(Daemon, daemon);
+  return ResOK;
+
+failCreate:
+  daemon->sig = SigInvalid;
+  (void)pthread_cond_destroy(&daemon->wake);
+failWake:
+  (void)pthread_mutex_destroy(&daemon->mut);
+failMutex:
+  return ResRESOURCE;
+}
+
+
+/* DaemonFinish -- stop the thread and finish the daemon */
+
+void DaemonFinish(Daemon daemon)
+{
+  int res;
+
+  AVERT(Daemon, daemon);
+
+  res = pthread_mutex_lock(&daemon->mut);
+  AVER(res == 0);
+  daemon->finishing = TRUE;
+  res = pthread_cond_signal(&daemon->wake);
+  AVER(res == 0);
+  res = pthread_mutex_unlock(&daemon->mut);
+  AVER(res == 0);
+
+  res = pthread_join(daemon->thread, NULL);
+  AVER(res == 0);
+  res = pthread_cond_destroy(&daemon->wake);
+  AVER(res == 0);
+  res = pthread_mutex_destroy(&daemon->mut);
+  AVER(res == 0);
+  daemon->sig = SigInvalid;
+}
+
+
+/* DaemonWake -- ask the daemon to call its method soon */
+
+void DaemonWake(Daemon daemon)
+{
+  int res;
+
+  AVERT(Daemon, daemon);
+
+  res = pthread_mutex_lock(&daemon->mut);
+  AVER(res == 0);
+  if (!daemon->woken) {
+    daemon->woken = TRUE;
+    res = pthread_cond_signal(&daemon->wake);
+    AVER(res == 0);
+  }
+  res = pthread_mutex_unlock(&daemon->mut);
+  AVER(res == 0);
+}
+
+
+/* C. COPYRIGHT AND LICENSE
+ *
+ * Copyright (C) 2016 Ravenbrook Limited <http://www.ravenbrook.com/>.
+ * All rights reserved.  This is an open source license.  Contact
+ * Ravenbrook for commercial licensing options.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Redistributions in any form must be accompanied by information on how
+ * to obtain complete source code for this software and any accompanying
+ * software that uses this software.  The source code must either be
+ * included in the distribution or be available for no more than the cost
+ * of distribution plus a nominal fee, and must be freely redistributable
+ * under reasonable conditions.  For an executable file, complete source
+ * code means the source code for all modules it contains. It does not
+ * include source code for modules or files that typically accompany the
+ * major components of the operating system on which the executable file
+ * runs.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE, OR NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS AND CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
@@ -28,6 +28,9 @@
  *           is a 40 MB 4-level tree of 10^5 objects; see .catalog;
  *           see also .catalog.broken.
  *   Collect -- request a synchronous full garbage collection
+ *   Overlap -- makes objects while an incremental full garbage 
+ *           collection is in progress, and checks that another 
+ *           collection ran concurrently with it; see .overlap.
  *
  *
  * CODE OVERVIEW
@@ -64,6 +67,7 @@
 #include "mpstd.h"
 
 #include <stdio.h> /* fflush, printf, putchar, puts, stdout */
+#include <stdlib.h> /* free, malloc */
 
 
 /* testChain -- generation parameters for the test */
@@ -165,6 +169,14 @@ static void showStatsText(size_t notcon, size_t con, size_t live)
   printf(")\n");
 }
 
+/* collsInProgress -- count of collections begun but not ended;
+ * collsOverlapped -- count of collections begun while another was
+ * in progress.  Maintained by get().
+ */
+static unsigned collsInProgress = 0;
+static unsigned collsOverlapped = 0;
+
+
 /* get -- get messages
  *
  */
@@ -190,6 +202,9 @@ static void get(mps_arena_t arena)
                (ulongest_t)mclockBegin, (ulongest_t)(mclockBegin - mclockEnd));
         printf("    Coll Begin                                     (%s)\n",
                mps_message_gc_start_why(arena, message));
+        if (collsInProgress > 0)
+          ++collsOverlapped;
+        ++collsInProgress;
         break;
       }
       case mps_message_type_gc(): {
@@ -200,6 +215,8 @@ static void get(mps_arena_t arena)
         size_t alimit = mps_arena_reserved(arena);
 
         mclockEnd = mps_message_clock(arena, message);
+        Insist(collsInProgress > 0);
+        --collsInProgress;
         
         printf("    %5"PRIuLONGEST": (%5"PRIuLONGEST")",
                (ulongest_t)mclockEnd, (ulongest_t)(mclockEnd - mclockBegin));
@@ -521,6 +538,103 @@ static void Make(mps_arena_t arena, mps_ap_t ap, unsigned randm, unsigned keep1i
 }
 
 
+/* Overlap -- make objects during an incremental full collection
+ *
+ * .overlap: Starts a full collection with a zero pause time, so that
+ * it only advances a quantum at each poll, then makes small objects,
+ * appending each one to one of "lists" linked lists whose heads and
+ * tails are kept in the exact roots.  Appending writes a reference to
+ * a young object into an old one, so this exercises the barriers.
+ * The nursery fills while the full collection is in progress, so a
+ * collection of the nursery must run concurrently with it (see
+ * <design/trace/#instance.limit>).  Keeps making objects until the
+ * full collection is over, then checks the lists.  The lists are
+ * started before the full collection (.overlap.old), so that it
+ * copies old list nodes whose successors it has yet to reach.
+ */
+#define overlapOLD 50
+
+static void overlapAppend(mps_ap_t ap, unsigned lists,
+                          unsigned long *listCount, size_t l,
+                          unsigned long *objCount)
+{
+  mps_word_t v;
+
+  die(make_dylan_vector(&v, ap, 2), "make_dylan_vector");
+  DYLAN_VECTOR_SLOT(v, 0) = DYLAN_INT(*objCount);
+  DYLAN_VECTOR_SLOT(v, 1) = (mps_word_t)NULL;
+  if(myrootExact[l] == NULL) {
+    myrootExact[l] = (void *)v;
+  } else {
+    DYLAN_VECTOR_SLOT(myrootExact[lists + l], 1) = v;
+  }
+  myrootExact[lists + l] = (void *)v;
+  ++listCount[l];
+  ++*objCount;
+}
+
+static void Overlap(mps_arena_t arena, mps_ap_t ap, unsigned lists)
+{
+  double pauseTime = mps_arena_pause_time(arena);
+  unsigned long objCount = 0;
+  unsigned long *listCount;
+  size_t i;
+
+  Insist(lists > 0);
+  Insist(2 * (size_t)lists <= myrootExactCOUNT);
+  listCount = malloc(lists * sizeof listCount[0]);
+  Insist(listCount != NULL);
+  for(i = 0; i < lists; ++i) {
+    myrootExact[i] = NULL;          /* head */
+    myrootExact[lists + i] = NULL;  /* tail */
+    listCount[i] = 0;
+  }
+
+  /* .overlap.old: Make the start of each list before the full */
+  /* collection, so that it has to trace chains of old objects */
+  /* through its own to-space while the nursery is collected. */
+  for(i = 0; i < (size_t)lists * overlapOLD; ++i)
+    overlapAppend(ap, lists, listCount, i % lists, &objCount);
+
+  mps_arena_park(arena);
+  get(arena);
+  Insist(collsInProgress == 0);
+  collsOverlapped = 0;
+  mps_arena_pause_time_set(arena, 0.0);
+  die(mps_arena_start_collect(arena), "mps_arena_start_collect");
+
+  do {
+    overlapAppend(ap, lists, listCount, (size_t)(rnd() % lists), &objCount);
+    get(arena);
+  } while(collsInProgress > 0);
+
+  mps_arena_pause_time_set(arena, pauseTime);
+  printf("  ...made %lu objects in %u lists; "
+         "%u collections overlapped another.\n",
+         objCount, lists, collsOverlapped);
+  cdie(collsOverlapped > 0, "no collections overlapped");
+
+  for(i = 0; i < lists; ++i) {
+    void *obj = myrootExact[i];
+    unsigned long count = 0;
+    mps_word_t last = DYLAN_INT(0);
+    while(obj != NULL) {
+      Insist(dylan_check(obj));
+      /* objCount is increasing along the list */
+      Insist(count == 0 || DYLAN_VECTOR_SLOT(obj, 0) > last);
+      last = DYLAN_VECTOR_SLOT(obj, 0);
+      ++count;
+      if(DYLAN_VECTOR_SLOT(obj, 1) == (mps_word_t)NULL) {
+        Insist(obj == myrootExact[lists + i]);
+      }
+      obj = (void *)DYLAN_VECTOR_SLOT(obj, 1);
+    }
+    Insist(count == listCount[i]);
+  }
+  free(listCount);
+}
+
+
 static void Rootdrop(char rank_char)
 {
   size_t i;
@@ -655,6 +769,16 @@ static void testscriptC(mps_arena_t arena, mps_ap_t ap, const char *script)
         Make(arena, ap, randm, keep1in, keepTotal, keepRootspace, sizemethod);
         break;
       }
+      case 'O': {
+        unsigned lists = 0;
+        si = sscanf(script, "Overlap(lists %u)%n",
+                       &lists, &sb);
+        checksi(si, 1, script, scriptAll);
+        script += sb;
+        printf("  Overlap(lists %u)\n", lists);
+        Overlap(arena, ap, lists);
+        break;
+      }
       case 'R': {
         char drop_ref = ' ';
         si = sscanf(script, "Rootdrop(rank %c)%n",
@@ -886,6 +1010,15 @@ int main(int argc, char *argv[])
                 "Rootdrop(rank E), Collect, Collect.");
   }
 
+  if(1) {
+    /* A nursery collection runs while a full collection is in
+     * progress.  See .overlap. */
+    testscriptA("Arena(size 16777216), "
+                "Make(random 1, keep-1-in 5, keep 50000, rootspace 30000, sizemethod 0), "
+                "Overlap(lists 1000), Collect, "
+                "Rootdrop(rank E), Collect.");
+  }
+
   /* LSP -- Large Segment Padding (job001811)
    *
    * BigdropSmall creates a big object & drops ref to it, 